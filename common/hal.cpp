@@ -0,0 +1,415 @@
+// Hardware abstraction layer with record/replay backends
+#ifndef __STDC_FORMAT_MACROS
+#define __STDC_FORMAT_MACROS
+#endif
+#include "hal.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace {
+
+const char kTraceMagic[8] = { 'H', 'A', 'L', 'T', 'R', 'A', 'C', 'E' };
+const unsigned char kTraceVersion = 1;
+const size_t kTraceHeaderSize = 12;
+// Guards the reader against a corrupt length field; camera frames stay far below
+const uint64_t kMaxPayloadSize = 64ULL * 1024 * 1024;
+
+uint64_t MonotonicNs()
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    uint64_t seconds = (uint64_t)now.QuadPart / (uint64_t)frequency.QuadPart;
+    uint64_t rest = (uint64_t)now.QuadPart % (uint64_t)frequency.QuadPart;
+    return seconds * 1000000000ULL + rest * 1000000000ULL / (uint64_t)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void SleepRealUs(uint64_t us)
+{
+    if (us == 0) return;
+#ifdef _WIN32
+    Sleep((DWORD)((us + 999) / 1000));
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)(us / 1000000);
+    ts.tv_nsec = (long)(us % 1000000) * 1000;
+    while (nanosleep(&ts, &ts) != 0) {
+    }
+#endif
+}
+
+void PutVarint(std::string& out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out += (char)((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += (char)value;
+}
+
+} // namespace
+
+const char* HalChannelName(int channel)
+{
+    switch (channel) {
+    case kHalPower: return "power";
+    case kHalPci: return "pci";
+    case kHalBlock: return "block";
+    case kHalUsb: return "usb";
+    case kHalCamera: return "camera";
+    default: return "unknown";
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Clocks
+
+HalRealClock::HalRealClock() : originNs_(MonotonicNs())
+{
+}
+
+uint64_t HalRealClock::nowUs()
+{
+    return (MonotonicNs() - originNs_) / 1000;
+}
+
+void HalRealClock::sleepUs(uint64_t us)
+{
+    SleepRealUs(us);
+}
+
+HalVirtualClock::HalVirtualClock(double speed) : speed_(speed), nowUs_(0), realOriginNs_(MonotonicNs())
+{
+}
+
+void HalVirtualClock::sleepUs(uint64_t us)
+{
+    advanceTo(nowUs_ + us);
+}
+
+void HalVirtualClock::advanceTo(uint64_t us)
+{
+    if (us <= nowUs_) return;
+    if (speed_ > 0.0) SleepRealUs((uint64_t)((double)(us - nowUs_) / speed_));
+    nowUs_ = us;
+}
+
+double HalVirtualClock::realSeconds() const
+{
+    return (double)(MonotonicNs() - realOriginNs_) / 1e9;
+}
+
+// ---------------------------------------------------------------------------
+// Payload codec
+
+void HalEncoder::u64(uint64_t value)
+{
+    PutVarint(data_, value);
+}
+
+void HalEncoder::i64(int64_t value)
+{
+    PutVarint(data_, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void HalEncoder::f64(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 8; ++i) data_ += (char)((bits >> (8 * i)) & 0xFF);
+}
+
+void HalEncoder::str(const std::string& value)
+{
+    bytes(value.data(), value.size());
+}
+
+void HalEncoder::bytes(const void* data, size_t size)
+{
+    PutVarint(data_, (uint64_t)size);
+    data_.append((const char*)data, size);
+}
+
+uint64_t HalDecoder::u64()
+{
+    uint64_t value = 0;
+    for (int shift = 0; ok_ && shift < 64; shift += 7) {
+        if (pos_ >= data_.size()) break;
+        unsigned char byte = (unsigned char)data_[pos_++];
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+    ok_ = false;
+    return 0;
+}
+
+int64_t HalDecoder::i64()
+{
+    uint64_t raw = u64();
+    return (int64_t)(raw >> 1) ^ -(int64_t)(raw & 1);
+}
+
+double HalDecoder::f64()
+{
+    if (!ok_ || data_.size() - pos_ < 8) {
+        ok_ = false;
+        return 0.0;
+    }
+    uint64_t bits = 0;
+    for (int i = 0; i < 8; ++i) bits |= (uint64_t)(unsigned char)data_[pos_++] << (8 * i);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+std::string HalDecoder::str()
+{
+    uint64_t size = u64();
+    if (!ok_ || size > data_.size() - pos_) {
+        ok_ = false;
+        return std::string();
+    }
+    std::string value = data_.substr(pos_, (size_t)size);
+    pos_ += (size_t)size;
+    return value;
+}
+
+// ---------------------------------------------------------------------------
+// Trace files
+
+HalTraceWriter::HalTraceWriter() : file_(NULL), lastTimestampUs_(0), records_(0), bytes_(0)
+{
+}
+
+HalTraceWriter::~HalTraceWriter()
+{
+    close();
+}
+
+bool HalTraceWriter::open(const std::string& path, int channel, std::string& error)
+{
+    close();
+    file_ = fopen(path.c_str(), "wb");
+    if (!file_) {
+        error = "cannot create trace " + path;
+        return false;
+    }
+    unsigned char header[kTraceHeaderSize];
+    memcpy(header, kTraceMagic, sizeof(kTraceMagic));
+    header[8] = kTraceVersion;
+    header[9] = (unsigned char)channel;
+    header[10] = header[11] = 0;
+    if (fwrite(header, 1, sizeof(header), file_) != sizeof(header)) {
+        error = "cannot write trace " + path;
+        close();
+        return false;
+    }
+    fflush(file_);
+    lastTimestampUs_ = 0;
+    lastPayload_.clear();
+    records_ = 0;
+    bytes_ = sizeof(header);
+    return true;
+}
+
+bool HalTraceWriter::append(uint64_t timestampUs, const std::string& payload)
+{
+    if (!file_) return false;
+    if (timestampUs < lastTimestampUs_) timestampUs = lastTimestampUs_;
+    bool repeat = records_ > 0 && payload == lastPayload_;
+
+    std::string record;
+    PutVarint(record, timestampUs - lastTimestampUs_);
+    PutVarint(record, repeat ? 1 : (uint64_t)payload.size() << 1);
+    if (!repeat) record += payload;
+    if (fwrite(record.data(), 1, record.size(), file_) != record.size()) return false;
+    fflush(file_);
+
+    lastTimestampUs_ = timestampUs;
+    if (!repeat) lastPayload_ = payload;
+    ++records_;
+    bytes_ += record.size();
+    return true;
+}
+
+void HalTraceWriter::close()
+{
+    if (file_) {
+        fclose(file_);
+        file_ = NULL;
+    }
+}
+
+HalTraceReader::HalTraceReader() : file_(NULL), timestampUs_(0), records_(0)
+{
+}
+
+HalTraceReader::~HalTraceReader()
+{
+    close();
+}
+
+bool HalTraceReader::open(const std::string& path, int channel, std::string& error)
+{
+    close();
+    file_ = fopen(path.c_str(), "rb");
+    if (!file_) {
+        error = "cannot open trace " + path;
+        return false;
+    }
+    unsigned char header[kTraceHeaderSize];
+    if (fread(header, 1, sizeof(header), file_) != sizeof(header) ||
+        memcmp(header, kTraceMagic, sizeof(kTraceMagic)) != 0) {
+        error = path + " is not a HAL trace";
+        close();
+        return false;
+    }
+    if (header[8] != kTraceVersion) {
+        error = path + ": unsupported trace version";
+        close();
+        return false;
+    }
+    if (header[9] != channel) {
+        error = path + " holds a " + HalChannelName(header[9]) + " trace, not " + HalChannelName(channel);
+        close();
+        return false;
+    }
+    timestampUs_ = 0;
+    lastPayload_.clear();
+    records_ = 0;
+    return true;
+}
+
+bool HalTraceReader::readVarint(uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = fgetc(file_);
+        if (c == EOF) return false;
+        value |= (uint64_t)(c & 0x7F) << shift;
+        if (!(c & 0x80)) return true;
+    }
+    return false;
+}
+
+bool HalTraceReader::next(uint64_t& timestampUs, std::string& payload)
+{
+    if (!file_) return false;
+    uint64_t delta, tag;
+    if (!readVarint(delta) || !readVarint(tag)) return false;
+    if (tag & 1) {
+        // A repeat needs an earlier payload to repeat
+        if (records_ == 0) return false;
+        payload = lastPayload_;
+    } else {
+        uint64_t size = tag >> 1;
+        if (size > kMaxPayloadSize) return false;
+        payload.resize((size_t)size);
+        if (size && fread(&payload[0], 1, (size_t)size, file_) != size) return false;
+        lastPayload_ = payload;
+    }
+    timestampUs_ += delta;
+    timestampUs = timestampUs_;
+    ++records_;
+    return true;
+}
+
+void HalTraceReader::close()
+{
+    if (file_) {
+        fclose(file_);
+        file_ = NULL;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Command line and session
+
+const char* const kHalUsage =
+    "--record <trace> records backend responses; --replay <trace> [--replay-speed <x|max>] plays them back";
+
+bool HalParseOption(int& i, int argc, char** argv, HalOptions& options)
+{
+    std::string arg = argv[i];
+    if (i + 1 >= argc) return false;
+    if (arg == "--record") {
+        options.recordPath = argv[++i];
+    } else if (arg == "--replay") {
+        options.replayPath = argv[++i];
+    } else if (arg == "--replay-speed") {
+        std::string value = argv[++i];
+        options.replaySpeed = value == "max" ? 0.0 : atof(value.c_str());
+        if (options.replaySpeed < 0.0) options.replaySpeed = 0.0;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+HalSession::HalSession() : clock_(new HalRealClock()), virtualClock_(NULL), writer_(NULL), reader_(NULL)
+{
+}
+
+HalSession::~HalSession()
+{
+    for (size_t i = 0; i < owned_.size(); ++i) delete owned_[i];
+    delete writer_;
+    delete reader_;
+    delete clock_;
+}
+
+bool HalSession::open(const HalOptions& options, int channel, std::string& error)
+{
+    if (!options.recordPath.empty() && !options.replayPath.empty()) {
+        error = "--record and --replay are mutually exclusive";
+        return false;
+    }
+    if (!options.replayPath.empty()) {
+        HalTraceReader* reader = new HalTraceReader();
+        if (!reader->open(options.replayPath, channel, error)) {
+            delete reader;
+            return false;
+        }
+        reader_ = reader;
+        delete clock_;
+        clock_ = virtualClock_ = new HalVirtualClock(options.replaySpeed);
+    } else if (!options.recordPath.empty()) {
+        HalTraceWriter* writer = new HalTraceWriter();
+        if (!writer->open(options.recordPath, channel, error)) {
+            delete writer;
+            return false;
+        }
+        writer_ = writer;
+    }
+    return true;
+}
+
+std::string HalSession::summary() const
+{
+    char buffer[256];
+    if (writer_) {
+        sprintf(buffer, "[hal] recorded %" PRIu64 " records, %" PRIu64 " bytes", writer_->records(), writer_->bytes());
+    } else if (reader_) {
+        double traceSeconds = (double)virtualClock_->nowUs() / 1e6;
+        double realSeconds = virtualClock_->realSeconds();
+        sprintf(buffer, "[hal] replayed %" PRIu64 " records: %.1f s of trace in %.3f s (%.0fx)", reader_->records(),
+                traceSeconds, realSeconds, realSeconds > 0.0 ? traceSeconds / realSeconds : 0.0);
+    } else {
+        sprintf(buffer, "[hal] live");
+    }
+    return buffer;
+}
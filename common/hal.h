@@ -0,0 +1,305 @@
+// Hardware abstraction layer with record/replay backends
+//
+// Each lab reads its hardware through a HalSource<Snapshot>: the live backend
+// wraps the OS calls (GetSystemPowerStatus, SetupDi*, DeviceIoControl, sysfs,
+// cv::VideoCapture), a recording source forwards to it and appends every
+// response to a trace file, and a replay source answers from such a trace
+// without touching the hardware:
+//
+//     HalSession hal;
+//     if (!hal.open(options, kHalPci, error)) ...
+//     HalSource<PciSnapshot>* pci = hal.source(live, EncodePci, DecodePci);
+//     while (pci->read(snapshot)) { ...; hal.clock().sleepMs(3000); }
+//
+// Replay runs on a virtual clock: sleeps advance virtual time and, at speed
+// 1, also wait in real time; --replay-speed max makes them free, so minutes of
+// recorded polling replay in milliseconds. Every read consumes the next record
+// and moves the clock up to its timestamp.
+//
+// Trace format, little-endian: "HALTRACE", version byte, channel byte, two
+// reserved bytes, then per record varint(timestamp delta in us),
+// varint(payload length << 1 | repeat) and the payload; a set repeat bit means
+// "same payload as the previous record" and carries none. Payloads are built
+// with HalEncoder: varints, zigzag varints, raw doubles and length-prefixed
+// strings.
+//
+// Written in C++98 like perf_stats.h, so lab3 can use it.
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+enum HalChannel {
+    kHalPower = 1,
+    kHalPci = 2,
+    kHalBlock = 3,
+    kHalUsb = 4,
+    kHalCamera = 5
+};
+
+const char* HalChannelName(int channel);
+
+// ---------------------------------------------------------------------------
+// Clocks
+
+class HalClock {
+public:
+    virtual ~HalClock() {}
+    // Microseconds since the clock was created (real) or since the trace start (virtual)
+    virtual uint64_t nowUs() = 0;
+    virtual void sleepUs(uint64_t us) = 0;
+    void sleepMs(uint64_t ms) { sleepUs(ms * 1000); }
+};
+
+class HalRealClock : public HalClock {
+public:
+    HalRealClock();
+    virtual uint64_t nowUs();
+    virtual void sleepUs(uint64_t us);
+
+private:
+    uint64_t originNs_;
+};
+
+class HalVirtualClock : public HalClock {
+public:
+    // speed: trace time per real time; 0 replays as fast as possible
+    explicit HalVirtualClock(double speed);
+    virtual uint64_t nowUs() { return nowUs_; }
+    virtual void sleepUs(uint64_t us);
+    // Moves forward to an absolute trace time; never moves back
+    void advanceTo(uint64_t us);
+    double speed() const { return speed_; }
+    double realSeconds() const;
+
+private:
+    double speed_;
+    uint64_t nowUs_;
+    uint64_t realOriginNs_;
+};
+
+// ---------------------------------------------------------------------------
+// Payload codec
+
+class HalEncoder {
+public:
+    void u64(uint64_t value);
+    void i64(int64_t value);
+    void f64(double value);
+    void boolean(bool value) { u64(value ? 1 : 0); }
+    void str(const std::string& value);
+    void bytes(const void* data, size_t size);
+    const std::string& data() const { return data_; }
+
+private:
+    std::string data_;
+};
+
+// Reads fields in the order they were encoded; past the end or on a malformed
+// field every getter returns zero/empty and ok() turns false
+class HalDecoder {
+public:
+    explicit HalDecoder(const std::string& data) : data_(data), pos_(0), ok_(true) {}
+    uint64_t u64();
+    int64_t i64();
+    double f64();
+    bool boolean() { return u64() != 0; }
+    std::string str();
+    bool ok() const { return ok_; }
+
+private:
+    const std::string& data_;
+    size_t pos_;
+    bool ok_;
+};
+
+// ---------------------------------------------------------------------------
+// Trace files
+
+class HalTraceWriter {
+public:
+    HalTraceWriter();
+    ~HalTraceWriter();
+    bool open(const std::string& path, int channel, std::string& error);
+    // Timestamps must not decrease; every record is flushed so a killed lab leaves a usable trace
+    bool append(uint64_t timestampUs, const std::string& payload);
+    void close();
+    uint64_t records() const { return records_; }
+    uint64_t bytes() const { return bytes_; }
+
+private:
+    HalTraceWriter(const HalTraceWriter&);
+    HalTraceWriter& operator=(const HalTraceWriter&);
+
+    FILE* file_;
+    uint64_t lastTimestampUs_;
+    std::string lastPayload_;
+    uint64_t records_;
+    uint64_t bytes_;
+};
+
+class HalTraceReader {
+public:
+    HalTraceReader();
+    ~HalTraceReader();
+    bool open(const std::string& path, int channel, std::string& error);
+    // Next record in file order; false at the end of the trace or on a truncated record
+    bool next(uint64_t& timestampUs, std::string& payload);
+    void close();
+    uint64_t records() const { return records_; }
+
+private:
+    HalTraceReader(const HalTraceReader&);
+    HalTraceReader& operator=(const HalTraceReader&);
+
+    bool readVarint(uint64_t& value);
+
+    FILE* file_;
+    uint64_t timestampUs_;
+    std::string lastPayload_;
+    uint64_t records_;
+};
+
+// ---------------------------------------------------------------------------
+// Sources
+
+class HalSourceBase {
+public:
+    virtual ~HalSourceBase() {}
+};
+
+template <class T>
+class HalSource : public HalSourceBase {
+public:
+    // false when the backend has no answer; replay sources also return false once the trace is over
+    virtual bool read(T& out) = 0;
+};
+
+template <class T>
+class HalRecordingSource : public HalSource<T> {
+public:
+    typedef void (*EncodeFn)(HalEncoder&, const T&);
+    HalRecordingSource(HalSource<T>* live, HalTraceWriter* writer, HalClock* clock, EncodeFn encode)
+        : live_(live), writer_(writer), clock_(clock), encode_(encode) {}
+
+    virtual bool read(T& out)
+    {
+        if (!live_->read(out)) return false;
+        HalEncoder encoder;
+        encode_(encoder, out);
+        writer_->append(clock_->nowUs(), encoder.data());
+        return true;
+    }
+
+private:
+    HalSource<T>* live_;
+    HalTraceWriter* writer_;
+    HalClock* clock_;
+    EncodeFn encode_;
+};
+
+// Plays the trace back in order: each read returns the next record and moves
+// the virtual clock up to its timestamp, so the lab sees every recorded
+// response exactly once and virtual time never falls behind the recording.
+template <class T>
+class HalReplaySource : public HalSource<T> {
+public:
+    typedef bool (*DecodeFn)(HalDecoder&, T&);
+    HalReplaySource(HalTraceReader* reader, HalVirtualClock* clock, DecodeFn decode)
+        : reader_(reader), clock_(clock), decode_(decode), finished_(false)
+    {
+    }
+
+    virtual bool read(T& out)
+    {
+        uint64_t timestampUs;
+        if (finished_ || !reader_->next(timestampUs, payload_)) return finish();
+        clock_->advanceTo(timestampUs);
+        HalDecoder decoder(payload_);
+        if (!decode_(decoder, out) || !decoder.ok()) return finish();
+        return true;
+    }
+
+    bool finished() const { return finished_; }
+
+private:
+    bool finish()
+    {
+        finished_ = true;
+        return false;
+    }
+
+    HalTraceReader* reader_;
+    HalVirtualClock* clock_;
+    DecodeFn decode_;
+    std::string payload_;
+    bool finished_;
+};
+
+// ---------------------------------------------------------------------------
+// Command line and session
+
+struct HalOptions {
+    std::string recordPath;
+    std::string replayPath;
+    double replaySpeed;   // 0 = as fast as possible
+    HalOptions() : replaySpeed(1.0) {}
+};
+
+// Consumes --record <file>, --replay <file> and --replay-speed <x|max> at argv[i],
+// advancing i past the value; false for any other argument
+bool HalParseOption(int& i, int argc, char** argv, HalOptions& options);
+extern const char* const kHalUsage;
+
+// Owns the clock, the trace and the wrapping sources of one lab
+class HalSession {
+public:
+    HalSession();
+    ~HalSession();
+
+    // Opens the trace named by the options; without --record/--replay the session is live
+    bool open(const HalOptions& options, int channel, std::string& error);
+    bool recording() const { return writer_ != NULL; }
+    bool replaying() const { return reader_ != NULL; }
+    HalClock& clock() { return *clock_; }
+    HalVirtualClock* virtualClock() { return virtualClock_; }
+    HalTraceWriter* writer() { return writer_; }
+    HalTraceReader* reader() { return reader_; }
+
+    // The source the lab should read: live itself, a recorder around it or a
+    // trace replay (live may be NULL then). The session owns the wrappers.
+    template <class T>
+    HalSource<T>* source(HalSource<T>* live, typename HalRecordingSource<T>::EncodeFn encode,
+                         typename HalReplaySource<T>::DecodeFn decode)
+    {
+        if (reader_) {
+            HalReplaySource<T>* replay = new HalReplaySource<T>(reader_, virtualClock_, decode);
+            owned_.push_back(replay);
+            return replay;
+        }
+        if (writer_) {
+            HalRecordingSource<T>* recorder = new HalRecordingSource<T>(live, writer_, clock_, encode);
+            owned_.push_back(recorder);
+            return recorder;
+        }
+        return live;
+    }
+
+    // One line for stderr: records written, or records replayed with the speed-up reached
+    std::string summary() const;
+
+private:
+    HalSession(const HalSession&);
+    HalSession& operator=(const HalSession&);
+
+    HalClock* clock_;
+    HalVirtualClock* virtualClock_;
+    HalTraceWriter* writer_;
+    HalTraceReader* reader_;
+    std::vector<HalSourceBase*> owned_;
+};
+
+#endif // HAL_H
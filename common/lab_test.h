@@ -0,0 +1,130 @@
+// Minimal checks for the lab fixture tests
+//
+// Each labN/tests/*_test.cpp is a standalone program run by run_tests.js from
+// its lab directory, so fixture paths are relative to the lab:
+//
+//     int main() {
+//         CHECK_EQ(EnergyMeter::counterDelta(10, 25, 100), 15u);
+//         return LabTestResult();
+//     }
+//
+// A failed check prints its location and the program exits non-zero.
+//
+// Fake sysfs/procfs trees are kept as manifests (labN/tests/fixtures/*.tree),
+// one "relative/path = contents" line per file ("\n" in the contents is a
+// line break), because their names (pci addresses, intel-rapl:0) are not
+// valid Windows file names. A LabFixture builds the tree in a temporary
+// directory and removes it again:
+//
+//     LabFixture sys("tests/fixtures/powercap.tree");
+//     meter.openSysfs(sys.root());
+//     sys.write("intel-rapl:0/energy_uj", "149");
+//
+// Written in C++98 like perf_stats.h, so lab3 can use it. The fixtures use
+// POSIX calls; the tests cover the Linux sysfs paths and run on Linux.
+#ifndef LAB_TEST_H
+#define LAB_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+inline int& LabTestFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+inline void LabTestFail(const char* file, int line, const std::string& what)
+{
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what.c_str());
+    ++LabTestFailures();
+}
+
+template <class A, class B>
+void LabTestCheckEq(const A& actual, const B& expected, const char* text, const char* file, int line)
+{
+    if (actual == expected) return;
+    std::ostringstream ss;
+    ss << text << " (got " << actual << ", expected " << expected << ")";
+    LabTestFail(file, line, ss.str());
+}
+
+inline int LabTestResult()
+{
+    if (LabTestFailures()) fprintf(stderr, "%d check(s) failed\n", LabTestFailures());
+    return LabTestFailures() ? 1 : 0;
+}
+
+class LabFixture {
+public:
+    explicit LabFixture(const std::string& manifest)
+    {
+        char dir[] = "/tmp/labtest.XXXXXX";
+        if (mkdtemp(dir)) root_ = dir;
+        std::ifstream in(manifest.c_str());
+        if (root_.empty() || !in) {
+            LabTestFail(__FILE__, __LINE__, "cannot build fixture " + manifest);
+            return;
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            size_t eq = line.find(" = ");
+            if (eq == std::string::npos) continue;
+            std::string contents = line.substr(eq + 3);
+            for (size_t esc = contents.find("\\n"); esc != std::string::npos; esc = contents.find("\\n", esc + 1)) {
+                contents.replace(esc, 2, "\n");
+            }
+            write(line.substr(0, eq), contents);
+        }
+    }
+
+    ~LabFixture()
+    {
+        for (size_t i = files_.size(); i-- > 0;) unlink(files_[i].c_str());
+        for (size_t i = dirs_.size(); i-- > 0;) rmdir(dirs_[i].c_str());
+        if (!root_.empty()) rmdir(root_.c_str());
+    }
+
+    const std::string& root() const { return root_; }
+    std::string path(const std::string& relative) const { return root_ + "/" + relative; }
+
+    // Creates or rewrites one file, with its parent directories; sysfs values end in a newline
+    void write(const std::string& relative, const std::string& contents)
+    {
+        for (size_t slash = relative.find('/'); slash != std::string::npos; slash = relative.find('/', slash + 1)) {
+            std::string dir = path(relative.substr(0, slash));
+            if (mkdir(dir.c_str(), 0755) == 0) dirs_.push_back(dir);
+        }
+        std::string file = path(relative);
+        std::ofstream out(file.c_str(), std::ios::trunc);
+        out << contents << "\n";
+        bool known = false;
+        for (size_t i = 0; i < files_.size(); ++i) known = known || files_[i] == file;
+        if (!known) files_.push_back(file);
+    }
+
+private:
+    LabFixture(const LabFixture&);
+    LabFixture& operator=(const LabFixture&);
+
+    std::string root_;
+    std::vector<std::string> dirs_;
+    std::vector<std::string> files_;
+};
+
+#define CHECK(cond) \
+    do { if (!(cond)) LabTestFail(__FILE__, __LINE__, #cond); } while (0)
+#define CHECK_EQ(actual, expected) \
+    LabTestCheckEq((actual), (expected), #actual " == " #expected, __FILE__, __LINE__)
+#define CHECK_NEAR(actual, expected, eps) \
+    CHECK((actual) - (expected) <= (eps) && (expected) - (actual) <= (eps))
+
+#endif // LAB_TEST_H
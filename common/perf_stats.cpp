@@ -0,0 +1,343 @@
+// Hot-path latency statistics shared by the labs
+#ifndef __STDC_FORMAT_MACROS
+#define __STDC_FORMAT_MACROS
+#endif
+#include "perf_stats.h"
+
+#include <algorithm>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+namespace {
+
+// Bucket layout: values below 64 ticks get a bucket each; above that every
+// power of two is split into 32 sub-buckets. Index = e * 32 + (v >> e) with
+// e = max(0, msb(v) - 5), covering values up to 2^41 ticks (~10 min at 4 GHz).
+const int kSubBits = 5;
+const int kSubCount = 1 << kSubBits;
+const int kMaxExponent = 36;
+const int kBucketCount = 2 * kSubCount + kMaxExponent * kSubCount;
+
+#if defined(_MSC_VER)
+#define PERF_THREAD_LOCAL __declspec(thread)
+#else
+#define PERF_THREAD_LOCAL __thread
+#endif
+
+// ---------------------------------------------------------------------------
+// Minimal lock and memory barrier; C++98 has neither
+
+class PerfLock {
+public:
+#ifdef _WIN32
+    PerfLock() { InitializeCriticalSection(&cs_); }
+    void lock() { EnterCriticalSection(&cs_); }
+    void unlock() { LeaveCriticalSection(&cs_); }
+private:
+    CRITICAL_SECTION cs_;
+#else
+    PerfLock() { pthread_mutex_init(&mutex_, NULL); }
+    void lock() { pthread_mutex_lock(&mutex_); }
+    void unlock() { pthread_mutex_unlock(&mutex_); }
+private:
+    pthread_mutex_t mutex_;
+#endif
+};
+
+class PerfLockGuard {
+public:
+    explicit PerfLockGuard(PerfLock& lock) : lock_(lock) { lock_.lock(); }
+    ~PerfLockGuard() { lock_.unlock(); }
+private:
+    PerfLockGuard(const PerfLockGuard&);
+    PerfLockGuard& operator=(const PerfLockGuard&);
+    PerfLock& lock_;
+};
+
+inline void PerfMemoryBarrier()
+{
+#if defined(_MSC_VER)
+    MemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+}
+
+inline int MostSignificantBit(uint64_t v)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+#if defined(_M_X64)
+    _BitScanReverse64(&index, v);
+    return (int)index;
+#else
+    if (_BitScanReverse(&index, (unsigned long)(v >> 32))) return (int)index + 32;
+    _BitScanReverse(&index, (unsigned long)v);
+    return (int)index;
+#endif
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+inline int BucketOf(uint64_t v)
+{
+    if (v < (uint64_t)(2 * kSubCount)) return (int)v;
+    int e = MostSignificantBit(v) - kSubBits;
+    if (e > kMaxExponent) return kBucketCount - 1;
+    return e * kSubCount + (int)(v >> e);
+}
+
+// Range of tick values counted by a bucket
+inline void BucketRange(int index, uint64_t& low, uint64_t& high)
+{
+    if (index < 2 * kSubCount) {
+        low = high = (uint64_t)index;
+        return;
+    }
+    int e = index / kSubCount - 1;
+    uint64_t mantissa = (uint64_t)(index - e * kSubCount);
+    low = mantissa << e;
+    high = ((mantissa + 1) << e) - 1;
+}
+
+// ---------------------------------------------------------------------------
+// Registries. Plain zero-initialized arrays, so metrics defined in other
+// translation units can register before this file's constructors have run.
+
+const char* g_metricNames[kPerfMaxMetrics];
+int g_metricCount;
+
+// Histograms of one thread; 32-bit counters so readers on other threads
+// never see a torn value, even in 32-bit builds
+struct ThreadHistograms {
+    uint32_t* hist[kPerfMaxMetrics];
+    ThreadHistograms* next;
+};
+
+PerfLock g_threadListLock;
+ThreadHistograms* g_threads;
+PERF_THREAD_LOCAL ThreadHistograms* t_histograms;
+
+uint32_t* AllocateHistogram(int metric)
+{
+    ThreadHistograms* block = t_histograms;
+    if (!block) {
+        block = (ThreadHistograms*)calloc(1, sizeof(ThreadHistograms));
+        if (!block) return NULL;
+        t_histograms = block;
+        // Blocks of exited threads stay on the list so their samples keep counting
+        PerfLockGuard guard(g_threadListLock);
+        block->next = g_threads;
+        PerfMemoryBarrier();
+        g_threads = block;
+    }
+    uint32_t* hist = (uint32_t*)calloc(kBucketCount, sizeof(uint32_t));
+    if (!hist) return NULL;
+    PerfMemoryBarrier();   // zeroed counters are visible before the pointer is
+    block->hist[metric] = hist;
+    return hist;
+}
+
+// ---------------------------------------------------------------------------
+// Tick calibration against the OS clock over the whole process lifetime
+
+uint64_t OsNanoseconds()
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    uint64_t seconds = (uint64_t)now.QuadPart / (uint64_t)frequency.QuadPart;
+    uint64_t rest = (uint64_t)now.QuadPart % (uint64_t)frequency.QuadPart;
+    return seconds * 1000000000ULL + rest * 1000000000ULL / (uint64_t)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+struct ClockOrigin {
+    uint64_t ticks;
+    uint64_t ns;
+    ClockOrigin() : ticks(PerfTicks()), ns(OsNanoseconds()) {}
+};
+ClockOrigin g_origin;
+
+double NanosecondsPerTick()
+{
+#if defined(PERF_STATS_TSC)
+    uint64_t ns = OsNanoseconds();
+    uint64_t ticks = PerfTicks();
+    if (ns - g_origin.ns < 20000000ULL) {
+        // Too early for a precise ratio: calibrate over a short busy wait instead
+        uint64_t ns0 = OsNanoseconds(), ticks0 = PerfTicks();
+        do {
+            ns = OsNanoseconds();
+        } while (ns - ns0 < 20000000ULL);
+        ticks = PerfTicks();
+        return (double)(ns - ns0) / (double)(ticks - ticks0);
+    }
+    return (double)(ns - g_origin.ns) / (double)(ticks - g_origin.ticks);
+#else
+    return 1.0;
+#endif
+}
+
+PerfMetric g_overheadMetric("perf_scope_self_test");
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+
+PerfMetric::PerfMetric(const char* name)
+{
+    // Static initialization is single-threaded, no lock needed
+    if (g_metricCount >= kPerfMaxMetrics) {
+        fprintf(stderr, "[perf] too many metrics, %s is not recorded\n", name);
+        id_ = -1;
+        return;
+    }
+    id_ = g_metricCount;
+    g_metricNames[g_metricCount++] = name;
+}
+
+uint64_t PerfOsTicks()
+{
+    return OsNanoseconds();
+}
+
+void PerfRecord(int metric, uint64_t ticks)
+{
+    if (metric < 0) return;
+    ThreadHistograms* block = t_histograms;
+    uint32_t* hist = block ? block->hist[metric] : NULL;
+    if (!hist && !(hist = AllocateHistogram(metric))) return;
+    ++hist[BucketOf(ticks)];
+}
+
+std::vector<PerfSummary> PerfCollect()
+{
+    double nsPerTick = NanosecondsPerTick();
+    std::vector<uint64_t> merged(kBucketCount);
+    std::vector<PerfSummary> result;
+
+    for (int m = 0; m < g_metricCount; ++m) {
+        if (m == g_overheadMetric.id()) continue;
+        std::fill(merged.begin(), merged.end(), 0);
+        uint64_t count = 0;
+        {
+            PerfLockGuard guard(g_threadListLock);
+            for (ThreadHistograms* block = g_threads; block; block = block->next) {
+                const volatile uint32_t* hist = block->hist[m];
+                if (!hist) continue;
+                for (int b = 0; b < kBucketCount; ++b) {
+                    uint32_t c = hist[b];
+                    merged[b] += c;
+                    count += c;
+                }
+            }
+        }
+
+        PerfSummary s;
+        s.name = g_metricNames[m];
+        s.count = count;
+        s.p50Us = s.p99Us = s.maxUs = 0.0;
+        if (count > 0) {
+            // Percentiles report the bucket midpoint, the maximum its upper bound
+            uint64_t rank50 = (count * 50 + 99) / 100;
+            uint64_t rank99 = (count * 99 + 99) / 100;
+            uint64_t seen = 0;
+            bool have50 = false, have99 = false;
+            for (int b = 0; b < kBucketCount; ++b) {
+                if (!merged[b]) continue;
+                uint64_t low, high;
+                BucketRange(b, low, high);
+                seen += merged[b];
+                double mid = ((double)low + (double)high) * 0.5 * nsPerTick / 1000.0;
+                if (!have50 && seen >= rank50) { s.p50Us = mid; have50 = true; }
+                if (!have99 && seen >= rank99) { s.p99Us = mid; have99 = true; }
+                s.maxUs = (double)high * nsPerTick / 1000.0;
+            }
+        }
+        result.push_back(s);
+    }
+    return result;
+}
+
+namespace {
+
+struct OverheadCalibration {
+    double scopeNs;
+    double tickReadNs;
+};
+
+// Best of three runs each, so a preempted run does not count
+const OverheadCalibration& Calibration()
+{
+    static OverheadCalibration calibration = { -1.0, -1.0 };
+    if (calibration.scopeNs >= 0.0) return calibration;
+
+    const int kIterations = 100000;
+    volatile uint64_t sink = 0;
+    for (int run = 0; run < 3; ++run) {
+        uint64_t start = OsNanoseconds();
+        for (int i = 0; i < kIterations; ++i) {
+            PerfScope scope(g_overheadMetric);
+        }
+        double scopeNs = (double)(OsNanoseconds() - start) / kIterations;
+
+        start = OsNanoseconds();
+        for (int i = 0; i < kIterations; ++i) {
+            sink += PerfTicks();
+        }
+        double tickNs = (double)(OsNanoseconds() - start) / kIterations;
+
+        if (run == 0 || scopeNs < calibration.scopeNs) calibration.scopeNs = scopeNs;
+        if (run == 0 || tickNs < calibration.tickReadNs) calibration.tickReadNs = tickNs;
+    }
+    (void)sink;
+    return calibration;
+}
+
+} // namespace
+
+double PerfScopeOverheadNs()
+{
+    return Calibration().scopeNs;
+}
+
+double PerfTickReadNs()
+{
+    return Calibration().tickReadNs;
+}
+
+std::string PerfStatsJson()
+{
+    std::vector<PerfSummary> metrics = PerfCollect();
+    std::string json;
+    char buffer[512];
+
+    sprintf(buffer, "{\"uptime_s\":%.1f,\"scope_overhead_ns\":%.1f,\"tick_read_ns\":%.1f,\"metrics\":[",
+            (double)(OsNanoseconds() - g_origin.ns) / 1e9, PerfScopeOverheadNs(), PerfTickReadNs());
+    json += buffer;
+    for (size_t i = 0; i < metrics.size(); ++i) {
+        const PerfSummary& s = metrics[i];
+        // Metric names are identifiers chosen in code; nothing to escape
+        sprintf(buffer, "%s{\"name\":\"%.64s\",\"count\":%" PRIu64 ",\"p50_us\":%.2f,\"p99_us\":%.2f,\"max_us\":%.2f}",
+                i ? "," : "", s.name.c_str(), s.count, s.p50Us, s.p99Us, s.maxUs);
+        json += buffer;
+    }
+    json += "]}";
+    return json;
+}
@@ -0,0 +1,93 @@
+// Hot-path latency statistics shared by the labs
+//
+// A PerfMetric names one instrumented site; a PerfScope on the stack times it:
+//
+//     static PerfMetric g_perfEnumerate("EnumeratePCIDevices");
+//     std::vector<Device> EnumeratePCIDevices() {
+//         PerfScope scope(g_perfEnumerate);
+//         ...
+//
+// Every thread records into its own log-linear (HDR-style) histograms of raw
+// clock ticks, so a scope costs two TSC reads and one counter increment with
+// no locks or atomics. Histograms of all threads are merged and converted to
+// time only when a report is requested. Buckets keep 5 significant bits, so
+// reported percentiles are within ~3% of the recorded value.
+//
+// Written in C++98 (lab3 builds with -std=c++98 -m32). Define metrics at
+// namespace scope: they register themselves during static initialization.
+#ifndef PERF_STATS_H
+#define PERF_STATS_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#define PERF_STATS_TSC 1
+#endif
+
+const int kPerfMaxMetrics = 64;
+
+class PerfMetric {
+public:
+    // name must outlive the metric (a string literal)
+    explicit PerfMetric(const char* name);
+    int id() const { return id_; }   // -1 when the registry is full; such a metric records nothing
+
+private:
+    int id_;
+};
+
+// Monotonic tick counter: the TSC on x86, the OS monotonic clock in ns elsewhere
+uint64_t PerfOsTicks();
+inline uint64_t PerfTicks()
+{
+#if defined(PERF_STATS_TSC) && defined(_MSC_VER)
+    return __rdtsc();
+#elif defined(PERF_STATS_TSC)
+    return __builtin_ia32_rdtsc();
+#else
+    return PerfOsTicks();
+#endif
+}
+
+void PerfRecord(int metric, uint64_t ticks);
+
+class PerfScope {
+public:
+    explicit PerfScope(const PerfMetric& metric) : metric_(metric.id()), start_(PerfTicks()) {}
+    ~PerfScope() { PerfRecord(metric_, PerfTicks() - start_); }
+
+private:
+    PerfScope(const PerfScope&);
+    PerfScope& operator=(const PerfScope&);
+
+    int metric_;
+    uint64_t start_;
+};
+
+struct PerfSummary {
+    std::string name;
+    uint64_t count;
+    double p50Us;
+    double p99Us;
+    double maxUs;
+};
+
+// Merged statistics of every registered metric, in registration order
+std::vector<PerfSummary> PerfCollect();
+
+// Cost of one empty PerfScope and of one PerfTicks() read in ns, measured
+// once on first use. A scope reads the clock twice; hypervisors that trap
+// RDTSC make those reads, not the recording, dominate the scope cost.
+double PerfScopeOverheadNs();
+double PerfTickReadNs();
+
+// {"uptime_s":..,"scope_overhead_ns":..,"tick_read_ns":..,"metrics":[{"name":..,"count":..,"p50_us":..,"p99_us":..,"max_us":..}]}
+std::string PerfStatsJson();
+
+#endif // PERF_STATS_H
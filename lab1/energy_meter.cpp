@@ -0,0 +1,350 @@
+// RAPL / Energy Meter Interface accounting for lab1
+#include "energy_meter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <setupapi.h>
+#include <initguid.h>
+#include <emi.h>
+#pragma comment(lib, "setupapi.lib")
+#else
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+static double steadySeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool readLine(const std::string& path, std::string& line) {
+    std::ifstream f(path.c_str());
+    return f && std::getline(f, line);
+}
+
+// Package-level domains are the ones processes are charged against
+static bool isPackageDomain(const EnergyDomain& d) {
+    if (d.name.find('/') != std::string::npos) return false;
+    return d.name.compare(0, 8, "package-") == 0 || d.name.find("PKG") != std::string::npos;
+}
+
+EnergyMeter::EnergyMeter(double windowSeconds, Clock clock)
+    : window_(windowSeconds), clock_(clock ? clock : Clock(steadySeconds)) {
+}
+
+EnergyMeter::~EnergyMeter() {
+#ifdef _WIN32
+    for (void* h : emiHandles_) CloseHandle((HANDLE)h);
+#endif
+}
+
+uint64_t EnergyMeter::counterDelta(uint64_t previous, uint64_t current, uint64_t maxRange) {
+    if (current >= previous) return current - previous;
+    // RAPL counters run 0..max_energy_range_uj inclusive and restart at zero,
+    // so stepping from max to 0 is one unit
+    if (maxRange == 0 || previous > maxRange) return 0;
+    return (maxRange - previous) + current + 1;
+}
+
+size_t EnergyMeter::openSysfs(const std::string& powercapRoot) {
+#ifdef _WIN32
+    (void)powercapRoot;
+    return 0;
+#else
+    DIR* dir = opendir(powercapRoot.c_str());
+    if (!dir) return 0;
+    std::vector<std::string> zones;
+    while (struct dirent* e = readdir(dir)) {
+        std::string n = e->d_name;
+        // intel-rapl:0, intel-rapl:0:1, intel-rapl-mmio:0 (the bare "intel-rapl" is the control type)
+        if (n.compare(0, 10, "intel-rapl") == 0 && n.find(':') != std::string::npos) zones.push_back(n);
+    }
+    closedir(dir);
+    std::sort(zones.begin(), zones.end());
+
+    size_t added = 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& zone : zones) {
+        std::string zoneDir = powercapRoot + "/" + zone;
+        std::string name, range, probe;
+        if (!readLine(zoneDir + "/name", name)) continue;
+        // energy_uj is root-only on patched kernels; skip zones we cannot read
+        if (!readLine(zoneDir + "/energy_uj", probe)) continue;
+
+        EnergyDomain d;
+        d.name = name;
+        // Subzones (intel-rapl:0:1) are named after their parent package
+        size_t lastColon = zone.rfind(':');
+        if (lastColon != zone.find(':')) {
+            std::string parentName;
+            if (readLine(powercapRoot + "/" + zone.substr(0, lastColon) + "/name", parentName)) d.name = parentName + "/" + name;
+        }
+        d.source = zoneDir;
+        d.joulesPerUnit = 1e-6;
+        if (readLine(zoneDir + "/max_energy_range_uj", range)) d.maxRange = strtoull(range.c_str(), NULL, 10);
+        domains_.push_back(d);
+        ++added;
+    }
+    return added;
+#endif
+}
+
+size_t EnergyMeter::openEmi() {
+#ifdef _WIN32
+    HDEVINFO set = SetupDiGetClassDevs(&GUID_DEVICE_ENERGY_METER, NULL, NULL, DIGCF_PRESENT | DIGCF_DEVICEINTERFACE);
+    if (set == INVALID_HANDLE_VALUE) return 0;
+
+    size_t added = 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    SP_DEVICE_INTERFACE_DATA ifData = {0};
+    ifData.cbSize = sizeof(ifData);
+    for (DWORD i = 0; SetupDiEnumDeviceInterfaces(set, NULL, &GUID_DEVICE_ENERGY_METER, i, &ifData); ++i) {
+        DWORD size = 0;
+        SetupDiGetDeviceInterfaceDetail(set, &ifData, NULL, 0, &size, NULL);
+        if (size == 0) continue;
+        std::vector<BYTE> detailBuf(size);
+        PSP_DEVICE_INTERFACE_DETAIL_DATA detail = (PSP_DEVICE_INTERFACE_DETAIL_DATA)detailBuf.data();
+        detail->cbSize = sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA);
+        if (!SetupDiGetDeviceInterfaceDetail(set, &ifData, detail, size, NULL, NULL)) continue;
+
+        HANDLE h = CreateFile(detail->DevicePath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (h == INVALID_HANDLE_VALUE) continue;
+
+        DWORD returned = 0;
+        EMI_VERSION version = {0};
+        EMI_METADATA_SIZE metaSize = {0};
+        if (!DeviceIoControl(h, IOCTL_EMI_GET_VERSION, NULL, 0, &version, sizeof(version), &returned, NULL) ||
+            !DeviceIoControl(h, IOCTL_EMI_GET_METADATA_SIZE, NULL, 0, &metaSize, sizeof(metaSize), &returned, NULL) ||
+            metaSize.MetadataSize == 0) {
+            CloseHandle(h);
+            continue;
+        }
+        std::vector<BYTE> meta(metaSize.MetadataSize);
+        if (!DeviceIoControl(h, IOCTL_EMI_GET_METADATA, NULL, 0, meta.data(), (DWORD)meta.size(), &returned, NULL)) {
+            CloseHandle(h);
+            continue;
+        }
+
+        std::string path(detail->DevicePath);
+        if (version.EmiVersion == EMI_VERSION_V1) {
+            const EMI_METADATA_V1* v1 = (const EMI_METADATA_V1*)meta.data();
+            std::wstring wname(v1->MeteredHardwareName, v1->MeteredHardwareNameSize / sizeof(WCHAR));
+            EnergyDomain d;
+            d.name = std::string(wname.begin(), wname.end());
+            d.source = path;
+            d.device = emiHandles_.size();
+            d.joulesPerUnit = 3.6e-9; // picowatt-hours
+            domains_.push_back(d);
+            ++added;
+        } else {
+            const EMI_METADATA_V2* v2 = (const EMI_METADATA_V2*)meta.data();
+            const EMI_CHANNEL_V2* channel = &v2->Channels[0];
+            for (USHORT c = 0; c < v2->ChannelCount; ++c) {
+                std::wstring wname(channel->ChannelName, channel->ChannelNameSize / sizeof(WCHAR));
+                while (!wname.empty() && wname.back() == L'\0') wname.pop_back();
+                EnergyDomain d;
+                d.name = std::string(wname.begin(), wname.end());
+                d.source = path;
+                d.device = emiHandles_.size();
+                d.channel = c;
+                d.joulesPerUnit = 3.6e-9;
+                domains_.push_back(d);
+                ++added;
+                channel = EMI_CHANNEL_V2_NEXT_CHANNEL(channel);
+            }
+        }
+        emiHandles_.push_back(h);
+    }
+    SetupDiDestroyDeviceInfoList(set);
+    return added;
+#else
+    return 0;
+#endif
+}
+
+bool EnergyMeter::readRaw(const EnergyDomain& d, uint64_t& raw) {
+#ifdef _WIN32
+    if (d.device >= emiHandles_.size()) return false;
+    EMI_CHANNEL_MEASUREMENT_DATA data[16] = {0};
+    DWORD returned = 0;
+    if (!DeviceIoControl((HANDLE)emiHandles_[d.device], IOCTL_EMI_GET_MEASUREMENT, NULL, 0, data, sizeof(data), &returned, NULL) ||
+        (d.channel + 1) * sizeof(EMI_CHANNEL_MEASUREMENT_DATA) > returned) {
+        return false;
+    }
+    raw = data[d.channel].AbsoluteEnergy;
+    return true;
+#else
+    std::string line;
+    if (!readLine(d.source + "/energy_uj", line)) return false;
+    raw = strtoull(line.c_str(), NULL, 10);
+    return true;
+#endif
+}
+
+void EnergyMeter::sample() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    double now = clock_();
+    double packageJoules = 0.0;
+
+    for (auto& d : domains_) {
+        uint64_t raw = 0;
+        if (!readRaw(d, raw)) continue;
+        if (!d.primed) {
+            d.primed = true;
+            d.lastRaw = raw;
+            d.lastTime = now;
+            d.history.push_back(std::make_pair(now, d.total));
+            continue;
+        }
+
+        uint64_t delta = counterDelta(d.lastRaw, raw, d.maxRange);
+        double dt = now - d.lastTime;
+        d.total += delta;
+        d.lastRaw = raw;
+        d.lastTime = now;
+        if (dt > 0.0) d.instantWatts = delta * d.joulesPerUnit / dt;
+        if (isPackageDomain(d)) packageJoules += delta * d.joulesPerUnit;
+
+        d.history.push_back(std::make_pair(now, d.total));
+        // Keep one sample at or before the window start so the window is always fully covered
+        while (d.history.size() > 2 && d.history[1].first <= now - window_) d.history.pop_front();
+        double span = now - d.history.front().first;
+        if (span > 0.0) d.windowWatts = (d.total - d.history.front().second) * d.joulesPerUnit / span;
+    }
+
+    double tick = sampled_ ? now - lastSampleTime_ : 0.0;
+    sampled_ = true;
+    lastSampleTime_ = now;
+    updateProcesses(packageJoules, tick);
+}
+
+bool EnergyMeter::readProcessCpuSeconds(int pid, double& seconds) {
+#ifdef _WIN32
+    HANDLE h = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, (DWORD)pid);
+    if (!h) return false;
+    FILETIME created, exited, kernel, user;
+    BOOL ok = GetProcessTimes(h, &created, &exited, &kernel, &user);
+    CloseHandle(h);
+    if (!ok) return false;
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime; u.HighPart = user.dwHighDateTime;
+    seconds = (k.QuadPart + u.QuadPart) * 1e-7;
+    return true;
+#else
+    std::string line;
+    if (!readLine(procRoot_ + "/" + std::to_string(pid) + "/stat", line)) return false;
+    // The command name may contain spaces and parentheses; fields resume after the last ')'
+    size_t close = line.rfind(')');
+    if (close == std::string::npos) return false;
+    std::istringstream fields(line.substr(close + 1));
+    std::string field;
+    unsigned long long utime = 0, stime = 0;
+    for (int index = 3; fields >> field; ++index) {
+        if (index == 14) utime = strtoull(field.c_str(), NULL, 10);
+        if (index == 15) { stime = strtoull(field.c_str(), NULL, 10); break; }
+    }
+    seconds = (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+    return true;
+#endif
+}
+
+bool EnergyMeter::readTotalCpuSeconds(double& seconds) {
+#ifdef _WIN32
+    FILETIME idle, kernel, user;
+    if (!GetSystemTimes(&idle, &kernel, &user)) return false;
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime; u.HighPart = user.dwHighDateTime;
+    // Kernel time already includes idle time
+    seconds = (k.QuadPart + u.QuadPart) * 1e-7;
+    return true;
+#else
+    std::string line;
+    if (!readLine(procRoot_ + "/stat", line) || line.compare(0, 4, "cpu ") != 0) return false;
+    std::istringstream fields(line.substr(4));
+    // user nice system idle iowait irq softirq steal; guest time is already part of user
+    unsigned long long value = 0, total = 0;
+    for (int i = 0; i < 8 && fields >> value; ++i) total += value;
+    seconds = (double)total / sysconf(_SC_CLK_TCK);
+    return true;
+#endif
+}
+
+void EnergyMeter::updateProcesses(double packageJoules, double tick) {
+    if (processes_.empty()) return;
+    double total = 0.0;
+    if (!readTotalCpuSeconds(total)) return;
+    double totalDelta = totalPrimed_ ? total - lastTotalCpuSeconds_ : 0.0;
+    totalPrimed_ = true;
+    lastTotalCpuSeconds_ = total;
+
+    for (auto& p : processes_) {
+        double cpu = 0.0;
+        p.alive = readProcessCpuSeconds(p.pid, cpu);
+        if (!p.alive) { p.cpuShare = 0.0; p.watts = 0.0; continue; }
+        p.cpuShare = 0.0;
+        p.watts = 0.0;
+        if (p.primed && totalDelta > 0.0) {
+            p.cpuShare = std::max(0.0, cpu - p.lastCpuSeconds) / totalDelta;
+            double joules = packageJoules * p.cpuShare;
+            p.joules += joules;
+            if (tick > 0.0) p.watts = joules / tick;
+        }
+        p.primed = true;
+        p.lastCpuSeconds = cpu;
+    }
+}
+
+void EnergyMeter::attributeProcess(int pid) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& p : processes_) {
+        if (p.pid == pid) return;
+    }
+    ProcessEnergy p;
+    p.pid = pid;
+    processes_.push_back(p);
+}
+
+void EnergyMeter::stopAttributing(int pid) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    processes_.erase(std::remove_if(processes_.begin(), processes_.end(),
+                                    [pid](const ProcessEnergy& p) { return p.pid == pid; }),
+                     processes_.end());
+}
+
+std::vector<EnergyDomain> EnergyMeter::domains() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return domains_;
+}
+
+std::vector<ProcessEnergy> EnergyMeter::processes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return processes_;
+}
+
+std::string EnergyMeter::toJson() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ostringstream ss;
+    ss.setf(std::ios::fixed);
+    ss.precision(3);
+    ss << "{\"DOMAINS\":[";
+    for (size_t i = 0; i < domains_.size(); ++i) {
+        const auto& d = domains_[i];
+        ss << (i ? "," : "") << "{\"NAME\":\"" << d.name << "\",\"ENERGY_J\":" << d.total * d.joulesPerUnit
+           << ",\"POWER_W\":" << d.instantWatts << ",\"AVG_POWER_W\":" << d.windowWatts << "}";
+    }
+    ss << "],\"WINDOW_S\":" << window_ << ",\"PROCESSES\":[";
+    for (size_t i = 0; i < processes_.size(); ++i) {
+        const auto& p = processes_[i];
+        ss << (i ? "," : "") << "{\"PID\":" << p.pid << ",\"ALIVE\":" << (p.alive ? "true" : "false")
+           << ",\"CPU_SHARE\":" << p.cpuShare << ",\"ENERGY_J\":" << p.joules << ",\"POWER_W\":" << p.watts << "}";
+    }
+    ss << "]}";
+    return ss.str();
+}
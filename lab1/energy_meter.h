@@ -0,0 +1,98 @@
+// RAPL / Energy Meter Interface accounting for lab1
+//
+// Linux reads the powercap tree (/sys/class/powercap/intel-rapl*), Windows the
+// Energy Meter Interface devices (GUID_DEVICE_ENERGY_METER), which expose the
+// same RAPL counters on Windows 10+. Counters are sampled once per status tick;
+// wraparound is folded into a 64-bit running total per domain.
+#ifndef ENERGY_METER_H
+#define ENERGY_METER_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct EnergyDomain {
+    std::string name;            // "package-0", "package-0/core", "package-0/dram", "RAPL_Package0_PKG"...
+    std::string source;          // sysfs directory or EMI device path
+    size_t device = 0;           // EMI device handle index
+    unsigned channel = 0;        // EMI channel index
+    uint64_t maxRange = 0;       // raw counter wraps after this value (0 = never wraps)
+    double joulesPerUnit = 1e-6; // sysfs counts uJ, EMI counts pWh
+
+    bool primed = false;
+    uint64_t lastRaw = 0;
+    double lastTime = 0.0;
+    uint64_t total = 0;          // wrap-corrected raw units since the first sample
+    double instantWatts = 0.0;   // over the last tick
+    double windowWatts = 0.0;    // over the sliding window
+    std::deque<std::pair<double, uint64_t> > history; // (time, total) inside the window
+};
+
+struct ProcessEnergy {
+    int pid = 0;
+    bool primed = false;
+    bool alive = true;
+    double lastCpuSeconds = 0.0;
+    double cpuShare = 0.0;       // share of all CPU time over the last tick
+    double joules = 0.0;         // attributed package energy since attribution started
+    double watts = 0.0;
+};
+
+class EnergyMeter {
+public:
+    typedef std::function<double()> Clock; // monotonic seconds
+
+    explicit EnergyMeter(double windowSeconds = 10.0, Clock clock = Clock());
+    ~EnergyMeter();
+    EnergyMeter(const EnergyMeter&) = delete;
+    EnergyMeter& operator=(const EnergyMeter&) = delete;
+
+    // Domain discovery; both return the number of domains added
+    size_t openSysfs(const std::string& powercapRoot = "/sys/class/powercap");
+    size_t openEmi();
+
+    // Root used for /proc/<pid>/stat and /proc/stat on Linux
+    void setProcRoot(const std::string& procRoot) { procRoot_ = procRoot; }
+
+    // Reads every counter once and updates power figures and process attribution
+    void sample();
+
+    void attributeProcess(int pid);
+    void stopAttributing(int pid);
+
+    bool empty() const { return domains_.empty(); }
+    std::vector<EnergyDomain> domains() const;
+    std::vector<ProcessEnergy> processes() const;
+
+    // {"DOMAINS":[...],"WINDOW_S":..,"PROCESSES":[...]}
+    std::string toJson() const;
+
+    // Wrap-aware difference of two raw readings of a counter that wraps after maxRange
+    static uint64_t counterDelta(uint64_t previous, uint64_t current, uint64_t maxRange);
+
+private:
+    bool readRaw(const EnergyDomain& d, uint64_t& raw);
+    bool readProcessCpuSeconds(int pid, double& seconds);
+    bool readTotalCpuSeconds(double& seconds);
+    void updateProcesses(double packageJoules, double tickSeconds);
+
+    double window_;
+    Clock clock_;
+    std::string procRoot_ = "/proc";
+    mutable std::mutex mutex_;
+    std::vector<EnergyDomain> domains_;
+    std::vector<ProcessEnergy> processes_;
+    bool sampled_ = false;
+    double lastSampleTime_ = 0.0;
+    bool totalPrimed_ = false;
+    double lastTotalCpuSeconds_ = 0.0;
+#ifdef _WIN32
+    std::vector<void*> emiHandles_;
+#endif
+};
+
+#endif // ENERGY_METER_H
@@ -1,9 +1,15 @@
-#include <windows.h>
 #include <iostream>
 #include <string>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <thread>
 #include <vector>
+#include <atomic>
+#include <sstream>
+#ifdef _WIN32
+#include <windows.h>
 #include <PowrProf.h>
 #include <winternl.h>
 #include <comdef.h>
@@ -20,7 +26,15 @@
 #include <batclass.h>  // For battery IOCTLs
 #include <initguid.h>
 #include <devguid.h>   // For GUID_DEVCLASS_BATTERY
-#include <sstream>
+#endif
+
+#include "energy_meter.h"
+#include "throttle_monitor.h"
+#include "power_source.h"
+#include "../common/perf_stats.h"
+#include "../common/hal.h"
+
+#ifdef _WIN32
 
 // Simple batteryMonitor class (working example integrated)
 class batteryMonitor{
@@ -243,6 +257,7 @@ std::string batteryMonitor::getBatteryInfo() {
     }
     return ss.str();
 }
+#endif
 
 // --- Глобальные переменные ---
 bool wasOnBattery = false;
@@ -251,14 +266,30 @@ bool wasOnBattery = false;
 bool trackingActive = false;
 std::chrono::steady_clock::time_point batteryStartTime;
 std::chrono::steady_clock::time_point monitorStartTime;
+// RAPL package/core/DRAM energy counters (EMI devices on Windows, powercap on Linux)
+EnergyMeter g_energyMeter;
+// Per-core frequency, thermal zones and throttle counters; raises FREQ_DROP below 60% of max
+CpuThrottleMonitor g_throttleMonitor;
+// Latency of one status record; PERF rides along every 10th record or after a "stats" command
+PerfMetric g_perfPrintPowerStatus("printPowerStatus");
+std::atomic<bool> g_perfRequested(false);
+int g_recordsSincePerf = 0;
+// Power readings come through the HAL: live, recorded to a trace or replayed from one
+HalSession g_hal;
 // Last known remaining battery time (seconds). Used as fallback when OS reports unknown.
 long long lastKnownRemainingBatteryTime = -1;
 // For estimation when BatteryLifeTime is unknown
 int prevBatteryPercent = -1;
 std::chrono::steady_clock::time_point prevPercentTime;
 
+// Time base of the status logic; virtual while a trace is replayed
+std::chrono::steady_clock::time_point monitorNow() {
+    return std::chrono::steady_clock::time_point(std::chrono::microseconds(g_hal.clock().nowUs()));
+}
+
 // --- Функции управления питанием ---
 
+#ifdef _WIN32
 // Устанавливает привилегии для операций сна/гибернации
 BOOL setPrivilege() {
     HANDLE hToken; TOKEN_PRIVILEGES tkp;
@@ -283,150 +314,210 @@ void goToHibernate() {
         SetSuspendState(TRUE, FALSE, TRUE); 
     }
 }
+#else
+void goToSleep() { fprintf(stderr, "[powermonitor] sleep is supported on Windows only\n"); }
+void goToHibernate() { fprintf(stderr, "[powermonitor] hibernate is supported on Windows only\n"); }
+#endif
 
 // Определение типа батареи
 std::string getBatteryChemistryWMI() {
     return "Li-Ion";
 }
 
-// Проверяет состояние режима энергосбережения через реестр
-std::string getSaverModeStatus() {
-    HKEY hKey;
-    if (RegOpenKeyEx(HKEY_CURRENT_USER, "Software\Microsoft\Windows\CurrentVersion\Explorer\Advanced", 0, KEY_READ, &hKey) == ERROR_SUCCESS) {
-        DWORD value = 0;
-        DWORD size = sizeof(value);
-        if (RegQueryValueEx(hKey, "LastBatterySaverTogglerState", NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS) {
-            RegCloseKey(hKey);
-            return value == 1 ? "On" : "Off";
-        }
-        RegCloseKey(hKey);
-    }
-    return "Unknown";
-}
-
 // Выводит статус питания в формате JSON
-void printPowerStatus() {
-    SYSTEM_POWER_STATUS sps;
-    if (GetSystemPowerStatus(&sps)) {
-        bool isOnBattery = (sps.ACLineStatus == 0);
-
-        // Remaining battery runtime (BatteryLifeTime) — system reported remaining seconds
-        long long remainingBatteryTime = -1; // -1 unknown
-        if (sps.BatteryLifeTime != (DWORD)-1) {
-            remainingBatteryTime = (long long)sps.BatteryLifeTime;
-            lastKnownRemainingBatteryTime = remainingBatteryTime; // update fallback
-        } else {
-            // fallback to last known remaining value if available
-            if (lastKnownRemainingBatteryTime != -1) {
-                remainingBatteryTime = lastKnownRemainingBatteryTime;
-            }
+void printPowerStatus(const PowerSample& sps) {
+    PerfScope perfScope(g_perfPrintPowerStatus);
+    bool isOnBattery = (sps.acLineStatus == 0);
+
+    // Remaining battery runtime (BatteryLifeTime) — system reported remaining seconds
+    long long remainingBatteryTime = -1; // -1 unknown
+    if (sps.batteryLifeTime != 0xFFFFFFFF) {
+        remainingBatteryTime = (long long)sps.batteryLifeTime;
+        lastKnownRemainingBatteryTime = remainingBatteryTime; // update fallback
+    } else {
+        // fallback to last known remaining value if available
+        if (lastKnownRemainingBatteryTime != -1) {
+            remainingBatteryTime = lastKnownRemainingBatteryTime;
         }
+    }
 
-        // If still unknown, try to estimate remaining time using percent change rate
-        auto now = std::chrono::steady_clock::now();
-        if (isOnBattery) {
-            int percent = (int)sps.BatteryLifePercent;
-            if (percent >= 0 && percent <= 100) {
-                if (prevBatteryPercent == -1) {
-                    prevBatteryPercent = percent;
-                    prevPercentTime = now;
-                } else if (percent != prevBatteryPercent) {
-                    // compute rate only when percent decreases (discharging)
-                    auto deltaPercent = prevBatteryPercent - percent;
-                    auto deltaSeconds = std::chrono::duration_cast<std::chrono::seconds>(now - prevPercentTime).count();
-                    if (deltaPercent > 0 && deltaSeconds > 0) {
-                        double secondsPerPercent = (double)deltaSeconds / (double)deltaPercent;
-                        long long estimatedRemaining = (long long)std::round(secondsPerPercent * percent);
-                        // use estimated remaining if we don't have a better value
-                        if (remainingBatteryTime == -1) remainingBatteryTime = estimatedRemaining;
-                        // update last known
-                        lastKnownRemainingBatteryTime = remainingBatteryTime;
-                    }
-                    prevBatteryPercent = percent;
-                    prevPercentTime = now;
+    // If still unknown, try to estimate remaining time using percent change rate
+    auto now = monitorNow();
+    if (isOnBattery) {
+        int percent = (int)sps.batteryLifePercent;
+        if (percent >= 0 && percent <= 100) {
+            if (prevBatteryPercent == -1) {
+                prevBatteryPercent = percent;
+                prevPercentTime = now;
+            } else if (percent != prevBatteryPercent) {
+                // compute rate only when percent decreases (discharging)
+                auto deltaPercent = prevBatteryPercent - percent;
+                auto deltaSeconds = std::chrono::duration_cast<std::chrono::seconds>(now - prevPercentTime).count();
+                if (deltaPercent > 0 && deltaSeconds > 0) {
+                    double secondsPerPercent = (double)deltaSeconds / (double)deltaPercent;
+                    long long estimatedRemaining = (long long)std::round(secondsPerPercent * percent);
+                    // use estimated remaining if we don't have a better value
+                    if (remainingBatteryTime == -1) remainingBatteryTime = estimatedRemaining;
+                    // update last known
+                    lastKnownRemainingBatteryTime = remainingBatteryTime;
                 }
+                prevBatteryPercent = percent;
+                prevPercentTime = now;
             }
-        } else {
-            // reset percent tracking when on AC
-            prevBatteryPercent = -1;
         }
+    } else {
+        // reset percent tracking when on AC
+        prevBatteryPercent = -1;
+    }
 
-        // Elapsed time on battery since unplug (best-effort). We set batteryStartTime
-        // when we see an AC->battery transition, or at program start if already on battery.
-        if (isOnBattery) {
-            if (!trackingActive) {
-                batteryStartTime = std::chrono::steady_clock::now();
-                trackingActive = true;
-                if (!wasOnBattery) fprintf(stderr, "[powermonitor] Transition detected: AC->BATTERY. Tracking started.\n");
-            }
-        } else {
-            if (trackingActive) fprintf(stderr, "[powermonitor] Transition detected: BATTERY->AC. Tracking stopped.\n");
-            trackingActive = false;
+    // Elapsed time on battery since unplug (best-effort). We set batteryStartTime
+    // when we see an AC->battery transition, or at program start if already on battery.
+    if (isOnBattery) {
+        if (!trackingActive) {
+            batteryStartTime = monitorNow();
+            trackingActive = true;
+            if (!wasOnBattery) fprintf(stderr, "[powermonitor] Transition detected: AC->BATTERY. Tracking started.\n");
         }
+    } else {
+        if (trackingActive) fprintf(stderr, "[powermonitor] Transition detected: BATTERY->AC. Tracking stopped.\n");
+        trackingActive = false;
+    }
 
-        wasOnBattery = isOnBattery;
+    wasOnBattery = isOnBattery;
 
-        long long elapsedOnBattery = -1; // -1 unknown/not applicable
-        if (isOnBattery) {
-            // Report time since monitoring started (monitorStartTime)
-            elapsedOnBattery = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - monitorStartTime).count();
-        }
+    long long elapsedOnBattery = -1; // -1 unknown/not applicable
+    if (isOnBattery) {
+        // Report time since monitoring started (monitorStartTime)
+        elapsedOnBattery = std::chrono::duration_cast<std::chrono::seconds>(monitorNow() - monitorStartTime).count();
+    }
 
-        std::string battery_flags;
-        if (sps.BatteryFlag != 255 && sps.BatteryFlag != 0) {
-            if (sps.BatteryFlag & 1) battery_flags += "High "; if (sps.BatteryFlag & 2) battery_flags += "Low ";
-            if (sps.BatteryFlag & 4) battery_flags += "Critical "; if (sps.BatteryFlag & 8) battery_flags += "Charging ";
-            if (sps.BatteryFlag & 128) battery_flags += "NoBattery ";
-        } else if (sps.BatteryFlag == 0) {
-            battery_flags = "Normal";
-        } else {
-            battery_flags = "Unknown";
-        }
-        
-        if (!battery_flags.empty() && battery_flags.back() == ' ') {
-            battery_flags.pop_back();
-        }
+    std::string battery_flags;
+    if (sps.batteryFlag != 255 && sps.batteryFlag != 0) {
+        if (sps.batteryFlag & 1) battery_flags += "High "; if (sps.batteryFlag & 2) battery_flags += "Low ";
+        if (sps.batteryFlag & 4) battery_flags += "Critical "; if (sps.batteryFlag & 8) battery_flags += "Charging ";
+        if (sps.batteryFlag & 128) battery_flags += "NoBattery ";
+    } else if (sps.batteryFlag == 0) {
+        battery_flags = "Normal";
+    } else {
+        battery_flags = "Unknown";
+    }
+    
+    if (!battery_flags.empty() && battery_flags.back() == ' ') {
+        battery_flags.pop_back();
+    }
 
-        char buffer[512];
-        sprintf_s(buffer, 
-            "{\"AC_LINE_STATUS\":\"%s\",\"BATTERY_PERCENT\":\"%d\",\"BATTERY_LIFE_TIME\":\"%lu\",\"ELAPSED_ON_BATTERY\":\"%lld\",\"REMAINING_BATTERY_TIME\":\"%lld\",\"TRACKING_ACTIVE\":\"%s\",\"SAVER_MODE\":\"%s\",\"BATTERY_CHEMISTRY\":\"%s\",\"BATTERY_INFO\":\"%s\"}",
-            (sps.ACLineStatus == 1 ? "Online" : "Offline"),
-            (int)sps.BatteryLifePercent,
-            sps.BatteryLifeTime,
-            elapsedOnBattery,
-            remainingBatteryTime,
-            (trackingActive ? "true" : "false"),
-            getSaverModeStatus().c_str(),
-            getBatteryChemistryWMI().c_str(),
-            battery_flags.c_str()
-        );
-        std::cout << buffer << std::endl;
-        std::cout.flush();
+    const std::string& saverMode = sps.saverMode;
+
+    char buffer[512];
+    snprintf(buffer, sizeof(buffer),
+        "{\"AC_LINE_STATUS\":\"%s\",\"BATTERY_PERCENT\":\"%d\",\"BATTERY_LIFE_TIME\":\"%lu\",\"ELAPSED_ON_BATTERY\":\"%lld\",\"REMAINING_BATTERY_TIME\":\"%lld\",\"TRACKING_ACTIVE\":\"%s\",\"SAVER_MODE\":\"%s\",\"BATTERY_CHEMISTRY\":\"%s\",\"BATTERY_INFO\":\"%s\"}",
+        (sps.acLineStatus == 1 ? "Online" : sps.acLineStatus == 0 ? "Offline" : "Unknown"),
+        sps.batteryLifePercent,
+        (unsigned long)sps.batteryLifeTime,
+        elapsedOnBattery,
+        remainingBatteryTime,
+        (trackingActive ? "true" : "false"),
+        saverMode.c_str(),
+        getBatteryChemistryWMI().c_str(),
+        battery_flags.c_str()
+    );
+    // Energy counters ride along in the same record: {"...","ENERGY":{"DOMAINS":[...],"PROCESSES":[...]}}
+    std::string record(buffer);
+    g_energyMeter.sample();
+    if (!g_energyMeter.empty()) {
+        record.pop_back();
+        record += ",\"ENERGY\":" + g_energyMeter.toJson() + "}";
+    }
+    // So does the frequency/thermal state, with FREQ_DROP events tagged by power source and saver mode
+    g_throttleMonitor.sample(isOnBattery, saverMode == "On");
+    if (!g_throttleMonitor.empty()) {
+        record.pop_back();
+        record += ",\"CPU\":" + g_throttleMonitor.toJson() + "}";
     }
+    bool perfRequested = g_perfRequested.exchange(false);
+    if (perfRequested || ++g_recordsSincePerf >= 10) {
+        g_recordsSincePerf = 0;
+        record.pop_back();
+        record += ",\"PERF\":" + PerfStatsJson() + "}";
+    }
+    std::cout << record << std::endl;
+    std::cout.flush();
 }
 
 // --- Поток для команд и основной цикл ---
 void commandListener() {
     std::string line;
     while (std::getline(std::cin, line)) {
-        if (line == "sleep") goToSleep();
+        // A replayed trace must not put the machine running it to sleep
+        if ((line == "sleep" || line == "hibernate") && g_hal.replaying()) fprintf(stderr, "[powermonitor] %s ignored during replay\n", line.c_str());
+        else if (line == "sleep") goToSleep();
         else if (line == "hibernate") goToHibernate();
+        // "attribute <pid>" / "attribute_stop <pid>": charge package energy to a process by its CPU-time share
+        else if (line.compare(0, 10, "attribute ") == 0) g_energyMeter.attributeProcess(atoi(line.c_str() + 10));
+        else if (line.compare(0, 15, "attribute_stop ") == 0) g_energyMeter.stopAttributing(atoi(line.c_str() + 15));
+        // "freq_threshold 0.7": effective/max frequency ratio below which FREQ_DROP is raised
+        else if (line.compare(0, 15, "freq_threshold ") == 0) g_throttleMonitor.setThreshold(atof(line.c_str() + 15));
+        // "stats": latency histograms in the next record instead of waiting for the periodic one
+        else if (line == "stats") g_perfRequested = true;
     }
 }
 
-int main() {
+#ifndef _WIN32
+// Off Windows there is no battery API to read: every tick reports an unknown power state and
+// the record is carried by the energy and frequency counters
+class UnknownPowerSource : public HalSource<PowerSample> {
+public:
+    bool read(PowerSample& out) override {
+        out = PowerSample();
+        return true;
+    }
+};
+#endif
+
+// Options: --record <trace> saves every power reading, --replay <trace> [--replay-speed <x|max>]
+// plays one back and exits at its end. --sysfs-root <dir>, --powercap-root <dir> and
+// --proc-root <dir> move the cpufreq/thermal, RAPL and process accounting reads away from
+// /sys, /sys/class/powercap and /proc (fixture trees); the powercap root follows the sysfs
+// root unless given
+int main(int argc, char** argv) {
+    HalOptions halOptions;
+    std::string sysfsRoot = "/sys";
+    std::string powercapRoot;
+    std::string procRoot = "/proc";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--sysfs-root" && i + 1 < argc) sysfsRoot = argv[++i];
+        else if (arg == "--powercap-root" && i + 1 < argc) powercapRoot = argv[++i];
+        else if (arg == "--proc-root" && i + 1 < argc) procRoot = argv[++i];
+        else if (!HalParseOption(i, argc, argv, halOptions)) fprintf(stderr, "[powermonitor] unknown option %s (%s)\n", argv[i], kHalUsage);
+    }
+    if (powercapRoot.empty()) powercapRoot = sysfsRoot + "/class/powercap";
+    std::string halError;
+    if (!g_hal.open(halOptions, kHalPower, halError)) {
+        fprintf(stderr, "[powermonitor] %s\n", halError.c_str());
+        return 1;
+    }
+#ifdef _WIN32
+    Win32PowerSource livePower;
+    HalSource<PowerSample>* power = g_hal.source<PowerSample>(&livePower, EncodePowerSample, DecodePowerSample);
+#else
+    UnknownPowerSource livePower;
+    if (!g_hal.replaying()) fprintf(stderr, "[powermonitor] no live power backend on this platform, reporting energy and CPU counters only\n");
+    HalSource<PowerSample>* power = g_hal.source<PowerSample>(&livePower, EncodePowerSample, DecodePowerSample);
+#endif
+
     std::thread listener(commandListener);
     listener.detach();
 
     // Initialize wasOnBattery from the current system state so that if the program
     // is started while already on battery we DON'T treat that as an AC->battery transition.
-    SYSTEM_POWER_STATUS initSps;
-    if (GetSystemPowerStatus(&initSps)) {
-        wasOnBattery = (initSps.ACLineStatus == 0);
+    PowerSample initSample;
+    if (power->read(initSample)) {
+        wasOnBattery = (initSample.acLineStatus == 0);
         // If we launched already on battery, start tracking from now so we can
         // show elapsed time since the app started (best-effort).
         if (wasOnBattery) {
-            batteryStartTime = std::chrono::steady_clock::now();
+            batteryStartTime = monitorNow();
             trackingActive = true;
         } else {
             trackingActive = false;
@@ -434,10 +525,21 @@ int main() {
         fprintf(stderr, "[powermonitor] Initial AC status: %s (wasOnBattery=%d)\n", (wasOnBattery ? "Offline" : "Online"), wasOnBattery);
     }
     // Record the time the monitor was started
-    monitorStartTime = std::chrono::steady_clock::now();
+    monitorStartTime = monitorNow();
+    // Energy and frequency counters are not part of the power trace; a replay leaves them out
+    if (!g_hal.replaying()) {
+        g_energyMeter.setProcRoot(procRoot);
+        size_t energyDomains = g_energyMeter.openEmi() + g_energyMeter.openSysfs(powercapRoot);
+        fprintf(stderr, "[powermonitor] Energy domains found: %u\n", (unsigned)energyDomains);
+        size_t cpufreqCores = g_throttleMonitor.openSysfs(sysfsRoot);
+        fprintf(stderr, "[powermonitor] cpufreq cores found: %u\n", (unsigned)cpufreqCores);
+    }
+    PowerSample sample;
     while (true) {
-        printPowerStatus();
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        if (power->read(sample)) printPowerStatus(sample);
+        else if (g_hal.replaying()) break;
+        g_hal.clock().sleepMs(1000);
     }
+    fprintf(stderr, "%s\n", g_hal.summary().c_str());
     return 0;
-}
\ No newline at end of file
+}
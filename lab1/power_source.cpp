@@ -0,0 +1,56 @@
+// Power channel of the HAL for lab1
+#include "power_source.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+void EncodePowerSample(HalEncoder& e, const PowerSample& sample)
+{
+    e.u64(sample.acLineStatus);
+    e.u64(sample.batteryFlag);
+    e.u64(sample.batteryLifePercent);
+    e.u64(sample.systemStatusFlag);
+    e.u64(sample.batteryLifeTime);
+    e.str(sample.saverMode);
+}
+
+bool DecodePowerSample(HalDecoder& d, PowerSample& sample)
+{
+    sample.acLineStatus = (int)d.u64();
+    sample.batteryFlag = (int)d.u64();
+    sample.batteryLifePercent = (int)d.u64();
+    sample.systemStatusFlag = (int)d.u64();
+    sample.batteryLifeTime = (uint32_t)d.u64();
+    sample.saverMode = d.str();
+    return d.ok();
+}
+
+#ifdef _WIN32
+// Проверяет состояние режима энергосбережения через реестр
+static std::string getSaverModeStatus() {
+    HKEY hKey;
+    if (RegOpenKeyExA(HKEY_CURRENT_USER, "Software\\Microsoft\\Windows\\CurrentVersion\\Explorer\\Advanced", 0, KEY_READ, &hKey) == ERROR_SUCCESS) {
+        DWORD value = 0;
+        DWORD size = sizeof(value);
+        if (RegQueryValueExA(hKey, "LastBatterySaverTogglerState", NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS) {
+            RegCloseKey(hKey);
+            return value == 1 ? "On" : "Off";
+        }
+        RegCloseKey(hKey);
+    }
+    return "Unknown";
+}
+
+bool Win32PowerSource::read(PowerSample& out) {
+    SYSTEM_POWER_STATUS sps;
+    if (!GetSystemPowerStatus(&sps)) return false;
+    out.acLineStatus = sps.ACLineStatus;
+    out.batteryFlag = sps.BatteryFlag;
+    out.batteryLifePercent = sps.BatteryLifePercent;
+    out.systemStatusFlag = sps.SystemStatusFlag;
+    out.batteryLifeTime = sps.BatteryLifeTime;
+    out.saverMode = getSaverModeStatus();
+    return true;
+}
+#endif
@@ -0,0 +1,36 @@
+// Power channel of the HAL for lab1
+//
+// A PowerSample is what one status tick reads from the OS: the
+// SYSTEM_POWER_STATUS fields printPowerStatus uses plus the battery saver
+// state from the registry. The live source exists on Windows only; elsewhere
+// lab1 reports an unknown power state next to its energy and CPU counters, or
+// runs from a recorded trace (--replay).
+#ifndef POWER_SOURCE_H
+#define POWER_SOURCE_H
+
+#include <cstdint>
+#include <string>
+
+#include "../common/hal.h"
+
+struct PowerSample {
+    int acLineStatus = 255;      // 0 offline, 1 online, 255 unknown
+    int batteryFlag = 255;       // SYSTEM_POWER_STATUS::BatteryFlag bits
+    int batteryLifePercent = 255;
+    int systemStatusFlag = 0;    // 1 = battery saver on
+    uint32_t batteryLifeTime = 0xFFFFFFFF; // seconds, 0xFFFFFFFF unknown
+    std::string saverMode = "Unknown";     // "On", "Off" or "Unknown"
+};
+
+void EncodePowerSample(HalEncoder& e, const PowerSample& sample);
+bool DecodePowerSample(HalDecoder& d, PowerSample& sample);
+
+#ifdef _WIN32
+// GetSystemPowerStatus plus the LastBatterySaverTogglerState registry value
+class Win32PowerSource : public HalSource<PowerSample> {
+public:
+    bool read(PowerSample& out) override;
+};
+#endif
+
+#endif // POWER_SOURCE_H
@@ -0,0 +1,75 @@
+// EnergyMeter against a fake powercap tree and /proc
+#include "../energy_meter.h"
+#include "../../common/lab_test.h"
+
+#include <unistd.h>
+
+static void testCounterDelta() {
+    const uint64_t max = 262143328850ULL;
+    CHECK_EQ(EnergyMeter::counterDelta(100, 250, max), 150u);
+    // max_energy_range_uj is the last value before the counter restarts at 0
+    CHECK_EQ(EnergyMeter::counterDelta(max, 0, max), 1u);
+    CHECK_EQ(EnergyMeter::counterDelta(max - 850, 149, max), 1000u);
+    // A counter without a range, or a reading above it, gives no delta rather than a huge one
+    CHECK_EQ(EnergyMeter::counterDelta(500, 100, 0), 0u);
+    CHECK_EQ(EnergyMeter::counterDelta(max + 5, 100, max), 0u);
+}
+
+static void testPowercapTree() {
+    LabFixture powercap("tests/fixtures/powercap.tree");
+    LabFixture proc("tests/fixtures/proc.tree");
+    double now = 100.0;
+    EnergyMeter meter(10.0, [&now] { return now; });
+    meter.setProcRoot(proc.root());
+
+    CHECK_EQ(meter.openSysfs(powercap.root()), 2u);
+    std::vector<EnergyDomain> domains = meter.domains();
+    CHECK_EQ(domains.size(), 2u);
+    if (domains.size() != 2) return;
+    CHECK_EQ(domains[0].name, "package-0");
+    CHECK_EQ(domains[1].name, "package-0/core");
+    CHECK_EQ(domains[0].maxRange, 262143328850ULL);
+
+    meter.attributeProcess(4242);
+    meter.sample();
+
+    // One second later the package counter has wrapped: 850 uJ to the end of the range,
+    // one step from max to 0 and 149 after it
+    now = 101.0;
+    long hz = sysconf(_SC_CLK_TCK);
+    powercap.write("intel-rapl:0/energy_uj", "149");
+    powercap.write("intel-rapl:0:0/energy_uj", "1500");
+    // The machine ran 4 * hz ticks in that second, a quarter of them in pid 4242
+    proc.write("stat", "cpu  " + std::to_string(1000 + 2 * hz) + " 0 " + std::to_string(500 + hz) + " " +
+               std::to_string(8000 + hz) + " 0 0 0 0 0 0");
+    proc.write("4242/stat", "4242 (fake (worker)) S 1 4242 4242 0 -1 4194304 100 0 0 0 " + std::to_string(40 + hz) +
+               " 10 0 0 20 0 1 0 100 1000000 100");
+    meter.sample();
+
+    domains = meter.domains();
+    CHECK_EQ(domains[0].total, 1000u);
+    CHECK_NEAR(domains[0].instantWatts, 1000e-6, 1e-12);
+    CHECK_NEAR(domains[0].windowWatts, 1000e-6, 1e-12);
+    CHECK_EQ(domains[1].total, 500u);
+
+    std::vector<ProcessEnergy> processes = meter.processes();
+    CHECK_EQ(processes.size(), 1u);
+    if (processes.size() != 1) return;
+    CHECK(processes[0].alive);
+    CHECK_NEAR(processes[0].cpuShare, 0.25, 1e-9);
+    CHECK_NEAR(processes[0].joules, 250e-6, 1e-12);
+
+    // A process that went away stays listed but is no longer charged
+    now = 102.0;
+    unlink(proc.path("4242/stat").c_str());
+    meter.sample();
+    processes = meter.processes();
+    CHECK(!processes[0].alive);
+    CHECK_NEAR(processes[0].joules, 250e-6, 1e-12);
+}
+
+int main() {
+    testCounterDelta();
+    testPowercapTree();
+    return LabTestResult();
+}
@@ -0,0 +1,87 @@
+// CpuThrottleMonitor against a fake cpufreq/thermal_throttle tree
+#include "../throttle_monitor.h"
+#include "../../common/lab_test.h"
+
+static void testDiscovery() {
+    LabFixture sys("tests/fixtures/sys.tree");
+    CpuThrottleMonitor monitor(0.6, [] { return 0.0; });
+    // cpu11 has no cpufreq driver and is left out
+    CHECK_EQ(monitor.openSysfs(sys.root()), 4u);
+    monitor.sample(false, false);
+
+    std::vector<CoreFrequency> cores = monitor.cores();
+    CHECK_EQ(cores.size(), 4u);
+    if (cores.size() != 4) return;
+    // Numeric order: cpu10 after cpu2
+    CHECK_EQ(cores[2].cpu, 2);
+    CHECK_EQ(cores[3].cpu, 10);
+    CHECK_EQ(cores[1].package, 0);
+    CHECK_EQ(cores[3].package, 1);
+    CHECK_NEAR(cores[0].curMhz, 3000.0, 1e-9);
+    CHECK_NEAR(cores[0].maxMhz, 4000.0, 1e-9);
+    CHECK_EQ(cores[0].governor, "powersave");
+    CHECK_EQ(cores[1].coreThrottleCount, 2u);
+    CHECK_EQ(cores[3].packageThrottleCount, 100u);
+
+    std::string json = monitor.toJson();
+    CHECK(json.find("\"EFFECTIVE_RATIO\":0.75") != std::string::npos);
+    CHECK(json.find("{\"ZONE\":\"x86_pkg_temp\",\"TEMP_C\":55.00}") != std::string::npos);
+    // A zone without a type is reported under its directory name
+    CHECK(json.find("{\"ZONE\":\"thermal_zone1\",\"TEMP_C\":48.00}") != std::string::npos);
+}
+
+static void testThrottleCounters() {
+    LabFixture sys("tests/fixtures/sys.tree");
+    double now = 0.0;
+    CpuThrottleMonitor monitor(0.6, [&now] { return now; });
+    monitor.openSysfs(sys.root());
+    monitor.sample(false, false);
+    // Core counts 1 + 2 + 0 + 3, package 0 once (10) and package 1 once (100)
+    CHECK_EQ(monitor.throttleCount(), 116u);
+
+    // Package 1 throttles 5 more times (seen by both of its cores), cpu0 twice more, and the
+    // clocks fall to a third of max
+    now = 1.0;
+    const char* cpus[] = {"cpu0", "cpu1", "cpu2", "cpu10"};
+    for (const char* cpu : cpus) {
+        sys.write(std::string("devices/system/cpu/") + cpu + "/cpufreq/scaling_cur_freq", "1000000");
+    }
+    sys.write("devices/system/cpu/cpu0/thermal_throttle/core_throttle_count", "3");
+    sys.write("devices/system/cpu/cpu2/thermal_throttle/package_throttle_count", "105");
+    sys.write("devices/system/cpu/cpu10/thermal_throttle/package_throttle_count", "105");
+    monitor.sample(true, false);
+    CHECK_EQ(monitor.throttleCount(), 123u);
+
+    std::string json = monitor.toJson();
+    CHECK(json.find("\"EVENT\":\"POWER_SOURCE_CHANGED\"") != std::string::npos);
+    CHECK(json.find("\"EVENT\":\"FREQ_DROP\",\"EFFECTIVE_RATIO\":0.25") != std::string::npos);
+    CHECK(json.find("\"THROTTLE_DELTA\":7}") != std::string::npos);
+    CHECK(json.find("\"THROTTLE_DELTA\":12") == std::string::npos);
+    // Events are reported once
+    CHECK(monitor.toJson().find("\"EVENT\"") == std::string::npos);
+}
+
+static void testFailedFrequencyRead() {
+    LabFixture sys("tests/fixtures/sys.tree");
+    CpuThrottleMonitor monitor(0.6, [] { return 0.0; });
+    monitor.openSysfs(sys.root());
+    monitor.sample(false, false);
+
+    // cpu0 can not be read for one sample: it keeps 3000 MHz instead of dropping to 0
+    sys.write("devices/system/cpu/cpu0/cpufreq/scaling_cur_freq", "");
+    monitor.sample(false, false);
+    std::vector<CoreFrequency> cores = monitor.cores();
+    CHECK_EQ(cores.size(), 4u);
+    if (cores.empty()) return;
+    CHECK_NEAR(cores[0].curMhz, 3000.0, 1e-9);
+    std::string json = monitor.toJson();
+    CHECK(json.find("\"EFFECTIVE_RATIO\":0.75") != std::string::npos);
+    CHECK(json.find("\"EVENT\"") == std::string::npos);
+}
+
+int main() {
+    testDiscovery();
+    testThrottleCounters();
+    testFailedFrequencyRead();
+    return LabTestResult();
+}
@@ -0,0 +1,337 @@
+// CPU frequency / thermal throttling monitor for lab1
+#include "throttle_monitor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <PowrProf.h>
+#pragma comment(lib, "PowrProf.lib")
+
+// Not declared in any SDK header; layout from the CallNtPowerInformation documentation
+typedef struct {
+    ULONG Number;
+    ULONG MaxMhz;
+    ULONG CurrentMhz;
+    ULONG MhzLimit;
+    ULONG MaxIdleState;
+    ULONG CurrentIdleState;
+} ProcessorPowerInformation;
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+struct CpuThrottleMonitor::SysfsCore {
+    int cpu = 0;
+    int package = 0;        // physical_package_id, read once
+    int curFreqFd = -1;     // scaling_cur_freq, kHz
+    int governorFd = -1;    // scaling_governor
+    int coreThrottleFd = -1;
+    int packageThrottleFd = -1;
+    double maxMhz = 0.0;    // cpuinfo_max_freq never changes, read once
+};
+
+struct CpuThrottleMonitor::SysfsZone {
+    std::string type;
+    int tempFd = -1;        // millidegrees Celsius
+};
+
+static double steadySeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifndef _WIN32
+static int openAttr(const std::string& path) {
+    return open(path.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+// Re-reads an attribute through an already open descriptor
+static bool preadAttr(int fd, std::string& value) {
+    if (fd < 0) return false;
+    char buf[128];
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) return false;
+    while (n > 0 && (buf[n - 1] == '\n' || buf[n - 1] == ' ')) --n;
+    value.assign(buf, (size_t)n);
+    return true;
+}
+
+static double preadNumber(int fd, double fallback) {
+    std::string value;
+    if (!preadAttr(fd, value)) return fallback;
+    char* end = NULL;
+    double number = strtod(value.c_str(), &end);
+    return end != value.c_str() ? number : fallback;
+}
+
+static void closeAttr(int fd) {
+    if (fd >= 0) close(fd);
+}
+
+static std::vector<std::string> listDir(const std::string& path, const char* prefix) {
+    std::vector<std::string> names;
+    size_t len = strlen(prefix);
+    if (DIR* dir = opendir(path.c_str())) {
+        while (struct dirent* e = readdir(dir)) {
+            if (strncmp(e->d_name, prefix, len) == 0 && isdigit((unsigned char)e->d_name[len])) names.push_back(e->d_name);
+        }
+        closedir(dir);
+    }
+    // cpu2 before cpu10
+    std::sort(names.begin(), names.end(), [len](const std::string& a, const std::string& b) {
+        return atoi(a.c_str() + len) < atoi(b.c_str() + len);
+    });
+    return names;
+}
+#endif
+
+CpuThrottleMonitor::CpuThrottleMonitor(double threshold, Clock clock)
+    : threshold_(threshold), clock_(clock ? clock : Clock(steadySeconds)) {
+}
+
+CpuThrottleMonitor::~CpuThrottleMonitor() {
+    for (SysfsCore* c : sysfsCores_) {
+#ifndef _WIN32
+        closeAttr(c->curFreqFd);
+        closeAttr(c->governorFd);
+        closeAttr(c->coreThrottleFd);
+        closeAttr(c->packageThrottleFd);
+#endif
+        delete c;
+    }
+    for (SysfsZone* z : sysfsZones_) {
+#ifndef _WIN32
+        closeAttr(z->tempFd);
+#endif
+        delete z;
+    }
+}
+
+size_t CpuThrottleMonitor::openSysfs(const std::string& sysfsRoot) {
+#ifdef _WIN32
+    (void)sysfsRoot;
+    return 0;
+#else
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string cpuRoot = sysfsRoot + "/devices/system/cpu";
+    for (const auto& name : listDir(cpuRoot, "cpu")) {
+        std::string dir = cpuRoot + "/" + name;
+        SysfsCore* core = new SysfsCore();
+        core->cpu = atoi(name.c_str() + 3);
+        core->curFreqFd = openAttr(dir + "/cpufreq/scaling_cur_freq");
+        if (core->curFreqFd < 0) {
+            // No cpufreq driver (VMs, offline cores): nothing to sample
+            delete core;
+            continue;
+        }
+        int maxFd = openAttr(dir + "/cpufreq/cpuinfo_max_freq");
+        core->maxMhz = preadNumber(maxFd, 0.0) / 1000.0;
+        closeAttr(maxFd);
+        int packageFd = openAttr(dir + "/topology/physical_package_id");
+        core->package = (int)preadNumber(packageFd, 0.0);
+        closeAttr(packageFd);
+        core->governorFd = openAttr(dir + "/cpufreq/scaling_governor");
+        core->coreThrottleFd = openAttr(dir + "/thermal_throttle/core_throttle_count");
+        core->packageThrottleFd = openAttr(dir + "/thermal_throttle/package_throttle_count");
+        sysfsCores_.push_back(core);
+    }
+
+    std::string thermalRoot = sysfsRoot + "/class/thermal";
+    for (const auto& name : listDir(thermalRoot, "thermal_zone")) {
+        std::string dir = thermalRoot + "/" + name;
+        int typeFd = openAttr(dir + "/type");
+        SysfsZone* zone = new SysfsZone();
+        if (!preadAttr(typeFd, zone->type)) zone->type = name;
+        closeAttr(typeFd);
+        zone->tempFd = openAttr(dir + "/temp");
+        sysfsZones_.push_back(zone);
+    }
+    return sysfsCores_.size();
+#endif
+}
+
+void CpuThrottleMonitor::setThreshold(double ratio) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    threshold_ = ratio;
+}
+
+bool CpuThrottleMonitor::empty() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cores_.empty();
+}
+
+void CpuThrottleMonitor::sampleSysfs() {
+#ifndef _WIN32
+    cores_.resize(sysfsCores_.size());
+    for (size_t i = 0; i < sysfsCores_.size(); ++i) {
+        const SysfsCore* src = sysfsCores_[i];
+        CoreFrequency& c = cores_[i];
+        c.cpu = src->cpu;
+        c.package = src->package;
+        // A failed read keeps the last frequency: reading it as 0 MHz would fake a FREQ_DROP
+        c.curMhz = preadNumber(src->curFreqFd, c.curMhz * 1000.0) / 1000.0;
+        c.maxMhz = src->maxMhz;
+        preadAttr(src->governorFd, c.governor);
+        c.coreThrottleCount = (uint64_t)preadNumber(src->coreThrottleFd, 0.0);
+        c.packageThrottleCount = (uint64_t)preadNumber(src->packageThrottleFd, 0.0);
+    }
+    zones_.resize(sysfsZones_.size());
+    for (size_t i = 0; i < sysfsZones_.size(); ++i) {
+        zones_[i].type = sysfsZones_[i]->type;
+        zones_[i].celsius = preadNumber(sysfsZones_[i]->tempFd, 0.0) / 1000.0;
+    }
+#endif
+}
+
+void CpuThrottleMonitor::sampleWindows() {
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    std::vector<ProcessorPowerInformation> info(si.dwNumberOfProcessors);
+    if (CallNtPowerInformation(ProcessorInformation, NULL, 0, info.data(),
+                               (ULONG)(info.size() * sizeof(ProcessorPowerInformation))) != 0) {
+        return;
+    }
+
+    // The active power plan is the closest thing Windows has to a cpufreq governor
+    std::string scheme;
+    GUID* active = NULL;
+    if (PowerGetActiveScheme(NULL, &active) == ERROR_SUCCESS) {
+        wchar_t name[128] = {0};
+        DWORD size = sizeof(name);
+        if (PowerReadFriendlyName(NULL, active, NULL, NULL, (UCHAR*)name, &size) == ERROR_SUCCESS) {
+            std::wstring w(name);
+            scheme.assign(w.begin(), w.end());
+        }
+        LocalFree(active);
+    }
+
+    cores_.resize(info.size());
+    for (size_t i = 0; i < info.size(); ++i) {
+        CoreFrequency& c = cores_[i];
+        c.cpu = (int)info[i].Number;
+        c.maxMhz = info[i].MaxMhz;
+        c.limitMhz = info[i].MhzLimit;
+        // CurrentMhz is not capped by MhzLimit, which is where saver/thermal limits show up
+        c.curMhz = std::min<double>(info[i].CurrentMhz, info[i].MhzLimit ? info[i].MhzLimit : info[i].CurrentMhz);
+        c.governor = scheme;
+    }
+#endif
+}
+
+void CpuThrottleMonitor::raise(const char* kind, double now, double maxTemp, uint64_t throttleDelta) {
+    ThrottleEvent e;
+    e.kind = kind;
+    e.time = now;
+    e.effectiveRatio = effectiveRatio_;
+    e.threshold = threshold_;
+    e.onBattery = onBattery_;
+    e.saverOn = saverOn_;
+    e.sincePowerChange = lastPowerChange_ < 0 ? -1.0 : now - lastPowerChange_;
+    e.maxTempC = maxTemp;
+    e.throttleDelta = throttleDelta;
+    events_.push_back(e);
+    const char* power = onBattery_ ? "on battery" : "on AC";
+    const char* saver = saverOn_ ? ", saver on" : "";
+    if (strcmp(kind, "POWER_SOURCE_CHANGED") == 0) {
+        fprintf(stderr, "[powermonitor] %s: now %s%s\n", kind, power, saver);
+    } else {
+        fprintf(stderr, "[powermonitor] %s: effective frequency %.0f%% of max (threshold %.0f%%), %s%s\n", kind,
+                effectiveRatio_ * 100.0, threshold_ * 100.0, power, saver);
+    }
+}
+
+void CpuThrottleMonitor::sample(bool onBattery, bool saverOn) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    double now = clock_();
+    if (!sysfsCores_.empty()) sampleSysfs();
+    else sampleWindows();
+    if (cores_.empty()) return;
+
+    double ratioSum = 0.0;
+    int counted = 0;
+    uint64_t throttleTotal = 0;
+    std::set<int> packagesCounted;
+    for (const auto& c : cores_) {
+        // A core whose frequency has never been read is left out rather than counted as stopped
+        if (c.maxMhz > 0.0 && c.curMhz > 0.0) {
+            ratioSum += c.curMhz / c.maxMhz;
+            ++counted;
+        }
+        throttleTotal += c.coreThrottleCount;
+        // package_throttle_count is repeated on every core of a package: count it once per package
+        if (packagesCounted.insert(c.package).second) throttleTotal += c.packageThrottleCount;
+    }
+    effectiveRatio_ = counted ? ratioSum / counted : 1.0;
+
+    double maxTemp = 0.0;
+    for (const auto& z : zones_) maxTemp = std::max(maxTemp, z.celsius);
+    uint64_t throttleDelta = primed_ && throttleTotal >= lastThrottleTotal_ ? throttleTotal - lastThrottleTotal_ : 0;
+    lastThrottleTotal_ = throttleTotal;
+
+    bool powerChanged = primed_ && (onBattery != onBattery_ || saverOn != saverOn_);
+    onBattery_ = onBattery;
+    saverOn_ = saverOn;
+    if (powerChanged) {
+        lastPowerChange_ = now;
+        raise("POWER_SOURCE_CHANGED", now, maxTemp, throttleDelta);
+    }
+    primed_ = true;
+
+    if (!below_ && effectiveRatio_ < threshold_) {
+        below_ = true;
+        raise("FREQ_DROP", now, maxTemp, throttleDelta);
+    } else if (below_ && effectiveRatio_ >= threshold_) {
+        below_ = false;
+        raise("FREQ_RECOVERED", now, maxTemp, throttleDelta);
+    }
+}
+
+std::vector<CoreFrequency> CpuThrottleMonitor::cores() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cores_;
+}
+
+uint64_t CpuThrottleMonitor::throttleCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lastThrottleTotal_;
+}
+
+std::string CpuThrottleMonitor::toJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ostringstream ss;
+    ss.setf(std::ios::fixed);
+    ss.precision(2);
+    ss << "{\"EFFECTIVE_RATIO\":" << effectiveRatio_ << ",\"THRESHOLD\":" << threshold_ << ",\"CORES\":[";
+    for (size_t i = 0; i < cores_.size(); ++i) {
+        const auto& c = cores_[i];
+        ss << (i ? "," : "") << "{\"CPU\":" << c.cpu << ",\"PACKAGE\":" << c.package << ",\"MHZ\":" << c.curMhz << ",\"MAX_MHZ\":" << c.maxMhz;
+        if (c.limitMhz > 0.0) ss << ",\"LIMIT_MHZ\":" << c.limitMhz;
+        ss << ",\"GOVERNOR\":\"" << c.governor << "\",\"CORE_THROTTLE\":" << c.coreThrottleCount
+           << ",\"PACKAGE_THROTTLE\":" << c.packageThrottleCount << "}";
+    }
+    ss << "],\"THERMAL\":[";
+    for (size_t i = 0; i < zones_.size(); ++i) {
+        ss << (i ? "," : "") << "{\"ZONE\":\"" << zones_[i].type << "\",\"TEMP_C\":" << zones_[i].celsius << "}";
+    }
+    ss << "],\"EVENTS\":[";
+    for (size_t i = 0; i < events_.size(); ++i) {
+        const auto& e = events_[i];
+        ss << (i ? "," : "") << "{\"EVENT\":\"" << e.kind << "\",\"EFFECTIVE_RATIO\":" << e.effectiveRatio
+           << ",\"THRESHOLD\":" << e.threshold << ",\"POWER_SOURCE\":\"" << (e.onBattery ? "Battery" : "AC")
+           << "\",\"SAVER_MODE\":\"" << (e.saverOn ? "On" : "Off") << "\",\"SINCE_POWER_CHANGE_S\":" << e.sincePowerChange
+           << ",\"MAX_TEMP_C\":" << e.maxTempC << ",\"THROTTLE_DELTA\":" << e.throttleDelta << "}";
+    }
+    ss << "]}";
+    events_.clear();
+    return ss.str();
+}
@@ -0,0 +1,94 @@
+// CPU frequency / thermal throttling monitor for lab1
+//
+// Linux keeps every cpufreq, thermal_zone and thermal_throttle attribute open
+// and re-reads them with pread() once per tick; Windows asks
+// CallNtPowerInformation(ProcessorInformation) for all cores in one call.
+// Each tick is tagged with the power source so a frequency drop can be
+// lined up with an AC->battery transition or battery saver.
+#ifndef THROTTLE_MONITOR_H
+#define THROTTLE_MONITOR_H
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct CoreFrequency {
+    int cpu = 0;
+    int package = 0;              // topology/physical_package_id
+    double curMhz = 0.0;
+    double maxMhz = 0.0;
+    double limitMhz = 0.0;        // Windows MhzLimit (0 = not reported)
+    std::string governor;         // scaling_governor / active power scheme
+    uint64_t coreThrottleCount = 0;
+    uint64_t packageThrottleCount = 0;
+};
+
+struct ThermalZone {
+    std::string type;             // "x86_pkg_temp", "acpitz"...
+    double celsius = 0.0;
+};
+
+struct ThrottleEvent {
+    std::string kind;             // "FREQ_DROP", "FREQ_RECOVERED", "POWER_SOURCE_CHANGED"
+    double time = 0.0;
+    double effectiveRatio = 0.0;  // mean cur/max over all cores
+    double threshold = 0.0;
+    bool onBattery = false;
+    bool saverOn = false;
+    double sincePowerChange = -1; // seconds since the last AC/battery transition, -1 = none seen
+    double maxTempC = 0.0;
+    uint64_t throttleDelta = 0;   // thermal_throttle events since the previous tick
+};
+
+class CpuThrottleMonitor {
+public:
+    typedef std::function<double()> Clock; // monotonic seconds
+
+    explicit CpuThrottleMonitor(double threshold = 0.6, Clock clock = Clock());
+    ~CpuThrottleMonitor();
+    CpuThrottleMonitor(const CpuThrottleMonitor&) = delete;
+    CpuThrottleMonitor& operator=(const CpuThrottleMonitor&) = delete;
+
+    // Opens every attribute under <sysfsRoot>/devices/system/cpu and <sysfsRoot>/class/thermal;
+    // returns the number of cores found. Always 0 on Windows.
+    size_t openSysfs(const std::string& sysfsRoot = "/sys");
+
+    void setThreshold(double ratio);
+
+    // One batched read of all cores and zones, tagged with the current power state
+    void sample(bool onBattery, bool saverOn);
+
+    bool empty() const;
+    std::vector<CoreFrequency> cores() const;
+    // Core plus package thermal_throttle events at the last tick, each package counted once
+    uint64_t throttleCount() const;
+    // {"EFFECTIVE_RATIO":..,"CORES":[...],"THERMAL":[...],"EVENTS":[...]}; events are reported once
+    std::string toJson();
+
+private:
+    struct SysfsCore;
+    struct SysfsZone;
+    void sampleSysfs();
+    void sampleWindows();
+    void raise(const char* kind, double now, double maxTemp, uint64_t throttleDelta);
+
+    double threshold_;
+    Clock clock_;
+    mutable std::mutex mutex_;
+    std::vector<SysfsCore*> sysfsCores_;
+    std::vector<SysfsZone*> sysfsZones_;
+    std::vector<CoreFrequency> cores_;
+    std::vector<ThermalZone> zones_;
+    std::vector<ThrottleEvent> events_;
+    double effectiveRatio_ = 1.0;
+    bool below_ = false;
+    bool primed_ = false;
+    bool onBattery_ = false;
+    bool saverOn_ = false;
+    double lastPowerChange_ = -1.0;
+    uint64_t lastThrottleTotal_ = 0;
+};
+
+#endif // THROTTLE_MONITOR_H
@@ -1,8 +1,22 @@
 // Simple PCI enumerator and JSON emitter for Lab2
 #include "pci_codes.h"
+#include "pci_link.h"
+#include "pci_topology.h"
+#include "pci_aer.h"
+#include "../common/perf_stats.h"
+#include "../common/hal.h"
+#ifdef _WIN32
 #include <windows.h>
 #include <setupapi.h>
 #include <cfgmgr32.h>
+#include <initguid.h>
+#include <devpkey.h>
+#include <pciprop.h>
+#else
+#include <dirent.h>
+#include <algorithm>
+#include <fstream>
+#endif
 
 #include <string>
 #include <vector>
@@ -11,6 +25,17 @@
 #include <thread>
 #include <chrono>
 #include <iomanip>
+#include <mutex>
+
+static PerfMetric g_perfEnumerate("EnumeratePCIDevices");
+// The command listener and the main loop both write records
+static std::mutex g_outputMutex;
+
+static void EmitLine(const std::string& line) {
+    std::lock_guard<std::mutex> lock(g_outputMutex);
+    std::cout << line << std::endl;
+    std::cout.flush();
+}
 
 struct Device {
     std::string slot;
@@ -18,8 +43,47 @@ struct Device {
     std::string did;
     std::string vendor;
     std::string deviceName;
+    PciLinkInfo link;
+    PciLocality locality;
 };
 
+#ifndef _WIN32
+// AER counters are sampled on their own thread, every --aer-interval ms; only live runs have them
+static AerSampler* g_aer = nullptr;
+
+static void AppendByType(std::ostringstream& ss, const std::vector<std::pair<std::string, unsigned long long> >& byType) {
+    ss << "{";
+    for (size_t i = 0; i < byType.size(); ++i) {
+        ss << (i ? "," : "") << "\"" << byType[i].first << "\":" << byType[i].second;
+    }
+    ss << "}";
+}
+
+// {"aer_alert":{"slot":...,"class":"correctable","window":10,"rate":2.5,"threshold":1,"state":"raised","byType":{...}}}
+static void AerSamplerLoop(int intervalMs) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<AerAlert> alerts;
+    for (;;) {
+        double now = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        alerts.clear();
+        g_aer->sample(now, alerts);
+        for (const auto& a : alerts) {
+            std::ostringstream ss;
+            ss << "{\"aer_alert\":{\"slot\":\"" << a.slot << "\",\"class\":\"" << AerClassName(a.cls)
+               << "\",\"window\":" << a.windowSec << ",\"rate\":" << a.rate << ",\"threshold\":" << a.threshold
+               << ",\"state\":\"" << (a.raised ? "raised" : "cleared") << "\"";
+            if (a.cls == kAerCorrectable) {
+                ss << ",\"byType\":";
+                AppendByType(ss, a.correctableByType);
+            }
+            ss << "}}";
+            EmitLine(ss.str());
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+    }
+}
+#endif
+
 std::string find_vendor_name(unsigned short id) {
     // To avoid dependency on PciVenTable size in this TU, just format the vendor id as hex.
     std::ostringstream ss;
@@ -27,6 +91,77 @@ std::string find_vendor_name(unsigned short id) {
     return ss.str();
 }
 
+#ifdef _WIN32
+// Reads a UINT32 PCI device property (link speed/width are published this way since Windows 7)
+static bool GetPciUint32Property(HDEVINFO deviceInfoSet, SP_DEVINFO_DATA& deviceInfoData, const DEVPROPKEY& key, UINT32& value) {
+    DEVPROPTYPE type = 0;
+    value = 0;
+    return SetupDiGetDevicePropertyW(deviceInfoSet, &deviceInfoData, &key, &type, (PBYTE)&value, sizeof(value), NULL, 0) &&
+           type == DEVPROP_TYPE_UINT32;
+}
+
+static void ReadPciLinkProperties(HDEVINFO deviceInfoSet, SP_DEVINFO_DATA& deviceInfoData, PciLinkInfo& link) {
+    UINT32 curSpeed = 0, curWidth = 0, maxSpeed = 0, maxWidth = 0;
+    // Conventional PCI devices have none of these properties
+    if (!GetPciUint32Property(deviceInfoSet, deviceInfoData, DEVPKEY_PciDevice_CurrentLinkSpeed, curSpeed) ||
+        !GetPciUint32Property(deviceInfoSet, deviceInfoData, DEVPKEY_PciDevice_MaxLinkSpeed, maxSpeed)) {
+        return;
+    }
+    GetPciUint32Property(deviceInfoSet, deviceInfoData, DEVPKEY_PciDevice_CurrentLinkWidth, curWidth);
+    GetPciUint32Property(deviceInfoSet, deviceInfoData, DEVPKEY_PciDevice_MaxLinkWidth, maxWidth);
+
+    link.present = true;
+    link.currentSpeedGTs = LinkSpeedFromEncoding(curSpeed);
+    link.currentWidth = (int)curWidth;
+    link.maxSpeedGTs = LinkSpeedFromEncoding(maxSpeed);
+    link.maxWidth = (int)maxWidth;
+    link.source = "devprop";
+    EvaluateLinkDegradation(link);
+}
+
+// NUMA node from the device properties, local CPUs from the node's processor mask and
+// the IRQ (or MSI vectors) with their affinity from the allocated resource descriptors
+static void ReadPciLocality(HDEVINFO deviceInfoSet, SP_DEVINFO_DATA& deviceInfoData, PciLocality& locality) {
+    UINT32 node = 0;
+    if (GetPciUint32Property(deviceInfoSet, deviceInfoData, DEVPKEY_Device_Numa_Node, node)) {
+        locality.numaNode = (int)node;
+        GROUP_AFFINITY group = {0};
+        if (GetNumaNodeProcessorMaskEx((USHORT)node, &group)) {
+            for (int bit = 0; bit < (int)(sizeof(KAFFINITY) * 8); ++bit) {
+                if (group.Mask & ((KAFFINITY)1 << bit)) locality.localCpus.push_back(group.Group * 64 + bit);
+            }
+        }
+    }
+
+    LOG_CONF logConf = 0;
+    if (CM_Get_First_Log_Conf(&logConf, deviceInfoData.DevInst, ALLOC_LOG_CONF) != CR_SUCCESS) {
+        EvaluateIrqLocality(locality);
+        return;
+    }
+    RES_DES resDes = 0;
+    RES_DES current = (RES_DES)logConf;
+    while (CM_Get_Next_Res_Des(&resDes, current, ResType_IRQ, NULL, 0) == CR_SUCCESS) {
+        if (current != (RES_DES)logConf) CM_Free_Res_Des_Handle(current);
+        current = resDes;
+
+        ULONG size = 0;
+        if (CM_Get_Res_Des_Data_Size(&size, resDes, 0) != CR_SUCCESS || size < sizeof(IRQ_DES)) continue;
+        std::vector<BYTE> data(size);
+        if (CM_Get_Res_Des_Data(resDes, data.data(), size, 0) != CR_SUCCESS) continue;
+        const IRQ_DES* irqDes = (const IRQ_DES*)data.data();
+
+        PciIrq irq;
+        irq.irq = irqDes->IRQD_Alloc_Num;
+        for (int bit = 0; bit < (int)(sizeof(irqDes->IRQD_Affinity) * 8); ++bit) {
+            if (irqDes->IRQD_Affinity & ((ULONG_PTR)1 << bit)) irq.affinity.push_back(bit);
+        }
+        locality.irqs.push_back(irq);
+    }
+    if (current != (RES_DES)logConf) CM_Free_Res_Des_Handle(current);
+    CM_Free_Log_Conf_Handle(logConf);
+    EvaluateIrqLocality(locality);
+}
+
 static Device ExtractDeviceInfo(const std::wstring& hardwareId, const std::string& slotIndex, HDEVINFO deviceInfoSet, SP_DEVINFO_DATA& deviceInfoData) {
     Device d;
     d.slot = slotIndex;
@@ -60,11 +195,15 @@ static Device ExtractDeviceInfo(const std::wstring& hardwareId, const std::strin
         d.deviceName = "Unknown Device";
     }
 
+    ReadPciLinkProperties(deviceInfoSet, deviceInfoData, d.link);
+    ReadPciLocality(deviceInfoSet, deviceInfoData, d.locality);
+
     return d;
 }
 
 std::vector<Device> EnumeratePCIDevices()
 {
+    PerfScope perfScope(g_perfEnumerate);
     std::vector<Device> devices;
     HDEVINFO deviceInfoSet = SetupDiGetClassDevsW(
         NULL,
@@ -89,12 +228,195 @@ std::vector<Device> EnumeratePCIDevices()
 
     return devices;
 }
+#else
+// Roots of the sysfs and procfs trees; overridable with --sysfs-root/--proc-root so
+// fixture trees can stand in for /sys and /proc
+static std::string g_sysfsRoot = "/sys";
+static std::string g_procRoot = "/proc";
+
+static std::string ReadSysfsAttr(const std::string& path) {
+    std::ifstream f(path.c_str());
+    std::string value;
+    std::getline(f, value);
+    return value;
+}
+
+// "0x8086" -> "8086"
+static std::string SysfsIdToHex(const std::string& raw) {
+    if (raw.size() < 6) return "----";
+    std::string hex = raw.substr(2, 4);
+    std::transform(hex.begin(), hex.end(), hex.begin(), ::toupper);
+    return hex;
+}
+
+std::vector<Device> EnumeratePCIDevices()
+{
+    PerfScope perfScope(g_perfEnumerate);
+    std::vector<Device> devices;
+    std::string base = g_sysfsRoot + "/bus/pci/devices";
+    DIR* dir = opendir(base.c_str());
+    if (!dir) return devices;
+
+    std::vector<std::string> slots;
+    while (struct dirent* e = readdir(dir)) {
+        if (e->d_name[0] != '.') slots.push_back(e->d_name);
+    }
+    closedir(dir);
+    std::sort(slots.begin(), slots.end());
+
+    for (const auto& slot : slots) {
+        std::string devDir = base + "/" + slot;
+        Device d;
+        d.slot = slot;
+        d.vid = SysfsIdToHex(ReadSysfsAttr(devDir + "/vendor"));
+        d.did = SysfsIdToHex(ReadSysfsAttr(devDir + "/device"));
+        d.vendor = d.vid == "----" ? "Unknown" : find_vendor_name((unsigned short)strtol(d.vid.c_str(), NULL, 16));
+        // sysfs carries no device names; the firmware label is the best we have
+        d.deviceName = ReadSysfsAttr(devDir + "/label");
+        if (d.deviceName.empty()) d.deviceName = "PCI device (class " + ReadSysfsAttr(devDir + "/class") + ")";
+        ReadSysfsPciLink(devDir, d.link);
+        ReadSysfsPciLocality(devDir, g_procRoot, d.locality);
+        devices.push_back(d);
+    }
+    return devices;
+}
+#endif
+
+// PCI channel of the HAL: a snapshot is the device list of one enumeration
+typedef std::vector<Device> PciSnapshot;
+
+class LivePciSource : public HalSource<PciSnapshot> {
+public:
+    bool read(PciSnapshot& out) override {
+        out = EnumeratePCIDevices();
+        return true;
+    }
+};
+
+static void EncodeIntList(HalEncoder& e, const std::vector<int>& values) {
+    e.u64(values.size());
+    for (int v : values) e.i64(v);
+}
+
+static std::vector<int> DecodeIntList(HalDecoder& d) {
+    std::vector<int> values((size_t)d.u64());
+    for (auto& v : values) v = (int)d.i64();
+    return d.ok() ? values : std::vector<int>();
+}
+
+static void EncodePciSnapshot(HalEncoder& e, const PciSnapshot& devices) {
+    e.u64(devices.size());
+    for (const auto& d : devices) {
+        e.str(d.slot); e.str(d.vid); e.str(d.did); e.str(d.vendor); e.str(d.deviceName);
+        e.boolean(d.link.present);
+        e.f64(d.link.currentSpeedGTs); e.i64(d.link.currentWidth);
+        e.f64(d.link.maxSpeedGTs); e.i64(d.link.maxWidth);
+        e.boolean(d.link.degraded); e.str(d.link.source);
+        e.i64(d.locality.numaNode);
+        EncodeIntList(e, d.locality.localCpus);
+        e.u64(d.locality.irqs.size());
+        for (const auto& irq : d.locality.irqs) {
+            e.u64(irq.irq);
+            EncodeIntList(e, irq.affinity);
+            e.boolean(irq.local);
+        }
+    }
+}
+
+static bool DecodePciSnapshot(HalDecoder& dec, PciSnapshot& devices) {
+    uint64_t count = dec.u64();
+    devices.clear();
+    for (uint64_t i = 0; i < count && dec.ok(); ++i) {
+        Device d;
+        d.slot = dec.str(); d.vid = dec.str(); d.did = dec.str(); d.vendor = dec.str(); d.deviceName = dec.str();
+        d.link.present = dec.boolean();
+        d.link.currentSpeedGTs = dec.f64(); d.link.currentWidth = (int)dec.i64();
+        d.link.maxSpeedGTs = dec.f64(); d.link.maxWidth = (int)dec.i64();
+        d.link.degraded = dec.boolean(); d.link.source = dec.str();
+        d.locality.numaNode = (int)dec.i64();
+        d.locality.localCpus = DecodeIntList(dec);
+        uint64_t irqCount = dec.u64();
+        for (uint64_t k = 0; k < irqCount && dec.ok(); ++k) {
+            PciIrq irq;
+            irq.irq = (unsigned)dec.u64();
+            irq.affinity = DecodeIntList(dec);
+            irq.local = dec.boolean();
+            d.locality.irqs.push_back(irq);
+        }
+        devices.push_back(d);
+    }
+    return dec.ok();
+}
 
 // Emit JSON to stdout periodically. Format: {"devices":[{"slot":"...","vid":"....","did":"....","vendor":"..."}, ...]}
+// PCIe devices also carry "link":{...}; "degraded":true marks a link trained below capability.
+// Locality: "numaNode", "localCpus" and "irqs" per device, plus a "topology" summary with the
+// device count per NUMA node and every IRQ whose affinity reaches CPUs off the device's node.
+// Every 10th record carries "perf" with the enumeration latency; "stats" on stdin prints {"perf":{...}} at once.
+// Linux devices with AER carry "aer" with their error totals and per-second rates over 10 s, 60 s and 300 s;
+// {"aer_alert":{...}} records report a rate crossing its threshold (and falling back to half of it).
+// Options: --sysfs-root/--proc-root <dir> (Linux) read from different trees, --once prints a single record,
+// --aer-interval <ms> (default 1000) and --aer-threshold <correctable errors/s> (default 1) tune the AER sampling,
+// --record <trace> saves every enumeration, --replay <trace> [--replay-speed <x|max>] plays one back and exits at its end.
+static void CommandListener() {
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (line == "stats") EmitLine("{\"perf\":" + PerfStatsJson() + "}");
+    }
+}
+
 int main(int argc, char** argv) {
-    (void)argc; (void)argv;
-    while (true) {
-        auto devices = EnumeratePCIDevices();
+    bool once = false;
+    HalOptions halOptions;
+#ifndef _WIN32
+    int aerIntervalMs = 1000;
+    AerOptions aerOptions;
+#endif
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--once") once = true;
+        else if (HalParseOption(i, argc, argv, halOptions)) continue;
+#ifndef _WIN32
+        else if (arg == "--sysfs-root" && i + 1 < argc) g_sysfsRoot = argv[++i];
+        else if (arg == "--proc-root" && i + 1 < argc) g_procRoot = argv[++i];
+        else if (arg == "--aer-interval" && i + 1 < argc) aerIntervalMs = std::max(10, atoi(argv[++i]));
+        else if (arg == "--aer-threshold" && i + 1 < argc) aerOptions.thresholds[kAerCorrectable] = atof(argv[++i]);
+#endif
+    }
+    HalSession hal;
+    std::string halError;
+    if (!hal.open(halOptions, kHalPci, halError)) {
+        std::cerr << "[lab2] " << halError << std::endl;
+        return 1;
+    }
+    LivePciSource livePci;
+    HalSource<PciSnapshot>* pci = hal.source<PciSnapshot>(&livePci, EncodePciSnapshot, DecodePciSnapshot);
+
+    if (!once) std::thread(CommandListener).detach();
+#ifndef _WIN32
+    // A replayed trace has no counters behind it
+    AerSampler aer(aerOptions);
+    if (!hal.replaying()) g_aer = &aer;
+    bool aerStarted = false;
+#endif
+    int recordsSincePerf = 0;
+    PciSnapshot devices;
+    while (pci->read(devices)) {
+#ifndef _WIN32
+        if (g_aer) {
+            std::vector<std::pair<std::string, std::string> > tracked;
+            for (const auto& d : devices) tracked.push_back(std::make_pair(d.slot, g_sysfsRoot + "/bus/pci/devices/" + d.slot));
+            g_aer->setDevices(tracked);
+            if (!aerStarted) {
+                // The first record already has the totals; rates start with the sampler thread
+                std::vector<AerAlert> alerts;
+                g_aer->sample(0.0, alerts);
+                if (!once) std::thread(AerSamplerLoop, aerIntervalMs).detach();
+                aerStarted = true;
+            }
+        }
+#endif
+        PciTopologySummary topology;
         std::ostringstream ss;
         ss << "{\"devices\": [";
         for (size_t i = 0; i < devices.size(); ++i) {
@@ -113,14 +435,60 @@ int main(int argc, char** argv) {
                 if (c == '\n' || c == '\r' || c == '\t') c = ' ';
             }
             
-            ss << "{\"slot\":\"" << d.slot << "\",\"vid\":\"" << d.vid << "\",\"did\":\"" << d.did << "\",\"vendor\":\"" << cleanVendor << "\",\"deviceName\":\"" << cleanDeviceName << "\"}";
+            ss << "{\"slot\":\"" << d.slot << "\",\"vid\":\"" << d.vid << "\",\"did\":\"" << d.did << "\",\"vendor\":\"" << cleanVendor << "\",\"deviceName\":\"" << cleanDeviceName << "\"";
+            if (d.link.present) {
+                ss << ",\"link\":{\"currentSpeed\":" << d.link.currentSpeedGTs << ",\"currentWidth\":" << d.link.currentWidth
+                   << ",\"maxSpeed\":" << d.link.maxSpeedGTs << ",\"maxWidth\":" << d.link.maxWidth
+                   << ",\"degraded\":" << (d.link.degraded ? "true" : "false")
+                   << ",\"source\":\"" << d.link.source << "\",\"detail\":\"" << DescribeLink(d.link) << "\"}";
+            }
+            ss << ",\"numaNode\":" << d.locality.numaNode << ",\"localCpus\":\"" << FormatCpuList(d.locality.localCpus) << "\",\"irqs\":[";
+            for (size_t k = 0; k < d.locality.irqs.size(); ++k) {
+                const auto& irq = d.locality.irqs[k];
+                ss << (k ? "," : "") << "{\"irq\":" << irq.irq << ",\"affinity\":\"" << FormatCpuList(irq.affinity)
+                   << "\",\"local\":" << (irq.local ? "true" : "false") << "}";
+            }
+            ss << "]";
+#ifndef _WIN32
+            AerDeviceState aerState;
+            if (g_aer && g_aer->state(d.slot, aerState)) {
+                ss << ",\"aer\":{\"correctable\":" << aerState.totals[kAerCorrectable] << ",\"nonfatal\":" << aerState.totals[kAerNonFatal]
+                   << ",\"fatal\":" << aerState.totals[kAerFatal] << ",\"correctableByType\":";
+                AppendByType(ss, aerState.correctableByType);
+                ss << ",\"rates\":[";
+                for (size_t k = 0; k < aerState.rates.size(); ++k) {
+                    const auto& r = aerState.rates[k];
+                    ss << (k ? "," : "") << "{\"window\":" << r.windowSec << ",\"correctable\":" << r.perSec[kAerCorrectable]
+                       << ",\"nonfatal\":" << r.perSec[kAerNonFatal] << ",\"fatal\":" << r.perSec[kAerFatal]
+                       << ",\"covered\":" << (r.covered ? "true" : "false") << "}";
+                }
+                ss << "]}";
+            }
+#endif
+            ss << "}";
+            AddToTopologySummary(topology, d.slot, d.locality);
             if (i + 1 < devices.size()) ss << ",";
         }
+        ss << "],\"topology\":{\"nodes\":[";
+        for (size_t i = 0; i < topology.devicesPerNode.size(); ++i) {
+            ss << (i ? "," : "") << "{\"node\":" << topology.devicesPerNode[i].first << ",\"devices\":" << topology.devicesPerNode[i].second << "}";
+        }
+        ss << "],\"irqMismatches\":[";
+        for (size_t i = 0; i < topology.irqMismatches.size(); ++i) {
+            const auto& m = topology.irqMismatches[i];
+            ss << (i ? "," : "") << "{\"slot\":\"" << m.slot << "\",\"irq\":" << m.irq << ",\"affinity\":\"" << FormatCpuList(m.affinity)
+               << "\",\"localCpus\":\"" << FormatCpuList(m.localCpus) << "\"}";
+        }
         ss << "]}";
-        std::string out = ss.str();
-        std::cout << out << std::endl;
-        std::cout.flush();
-        std::this_thread::sleep_for(std::chrono::seconds(3));
+        if (++recordsSincePerf >= 10) {
+            recordsSincePerf = 0;
+            ss << ",\"perf\":" << PerfStatsJson();
+        }
+        ss << "}";
+        EmitLine(ss.str());
+        if (once) break;
+        hal.clock().sleepMs(3000);
     }
+    if (hal.recording() || hal.replaying()) std::cerr << hal.summary() << std::endl;
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,207 @@
+// PCIe AER error counters and error-rate alerts for Lab2
+#include "pci_aer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+static const char* const kAerFiles[kAerClassCount] = {"aer_dev_correctable", "aer_dev_nonfatal", "aer_dev_fatal"};
+
+const char* AerClassName(int cls) {
+    switch (cls) {
+        case kAerCorrectable: return "correctable";
+        case kAerNonFatal: return "nonfatal";
+        case kAerFatal: return "fatal";
+        default: return "";
+    }
+}
+
+bool ParseAerCounters(const char* text, size_t len, AerCounters& counters) {
+    counters = AerCounters();
+    bool haveTotal = false, any = false;
+    unsigned long long sum = 0;
+    const char* end = text + len;
+    for (const char* line = text; line < end;) {
+        const char* eol = (const char*)memchr(line, '\n', end - line);
+        if (!eol) eol = end;
+        const char* space = line;
+        while (space < eol && *space != ' ') ++space;
+        if (space > line && space < eol) {
+            const char* digits = space;
+            while (digits < eol && *digits == ' ') ++digits;
+            if (digits < eol && isdigit((unsigned char)*digits)) {
+                unsigned long long value = strtoull(digits, NULL, 10);
+                std::string name(line, space);
+                any = true;
+                if (name.compare(0, 10, "TOTAL_ERR_") == 0) {
+                    counters.total = value;
+                    haveTotal = true;
+                } else {
+                    counters.byType.push_back(std::make_pair(name, value));
+                    sum += value;
+                }
+            }
+        }
+        line = eol + 1;
+    }
+    if (!haveTotal) counters.total = sum;
+    return any;
+}
+
+AerSampler::AerSampler(const AerOptions& options) : options_(options), buffer_(4096) {
+    if (options_.windowsSec.empty()) options_.windowsSec.push_back(10);
+    std::sort(options_.windowsSec.begin(), options_.windowsSec.end());
+#ifndef _WIN32
+    // Three descriptors per device: a few hundred devices pass the usual soft limit of 1024
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+#endif
+}
+
+AerSampler::~AerSampler() {
+    for (auto& d : devices_) close(d.second);
+}
+
+void AerSampler::close(Tracked& t) {
+#ifndef _WIN32
+    for (int& fd : t.fds) {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+#else
+    (void)t;
+#endif
+}
+
+void AerSampler::setDevices(const std::vector<std::pair<std::string, std::string> >& devices) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::map<std::string, Tracked> next;
+    for (const auto& device : devices) {
+        auto it = devices_.find(device.first);
+        if (it != devices_.end()) {
+            next[device.first] = it->second;
+            it->second.fds[0] = it->second.fds[1] = it->second.fds[2] = -1;  // moved
+            continue;
+        }
+        Tracked& t = next[device.first];
+        t.state.slot = device.first;
+#ifndef _WIN32
+        // Devices without AER (or kernels without the counters) simply have no files
+        for (int cls = 0; cls < kAerClassCount; ++cls) {
+            t.fds[cls] = open((device.second + "/" + kAerFiles[cls]).c_str(), O_RDONLY | O_CLOEXEC);
+        }
+#endif
+    }
+    for (auto& d : devices_) close(d.second);
+    devices_.swap(next);
+}
+
+void AerSampler::sample(double nowSec, std::vector<AerAlert>& alerts) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int longest = options_.windowsSec.back();
+    for (auto& d : devices_) {
+        Tracked& t = d.second;
+        Sample s;
+        s.t = nowSec;
+        bool present = false;
+        for (int cls = 0; cls < kAerClassCount; ++cls) {
+            s.totals[cls] = 0;
+#ifndef _WIN32
+            if (t.fds[cls] < 0) continue;
+            ssize_t n = pread(t.fds[cls], &buffer_[0], buffer_.size(), 0);
+            AerCounters counters;
+            if (n <= 0 || !ParseAerCounters(&buffer_[0], (size_t)n, counters)) continue;
+            present = true;
+            s.totals[cls] = counters.total;
+            if (cls == kAerCorrectable) t.state.correctableByType.swap(counters.byType);
+#endif
+        }
+        // An unreadable pass keeps the last good sample
+        if (!present) continue;
+        t.state.present = true;
+
+        if (!t.history.empty()) {
+            const Sample& last = t.history.back();
+            for (int cls = 0; cls < kAerClassCount; ++cls) {
+                if (s.totals[cls] < last.totals[cls]) {
+                    t.history.clear();
+                    break;
+                }
+            }
+        }
+        t.history.push_back(s);
+        // Keep one sample at or before the start of the longest window
+        while (t.history.size() > 2 && t.history[1].t <= nowSec - longest) t.history.pop_front();
+        for (int cls = 0; cls < kAerClassCount; ++cls) t.state.totals[cls] = s.totals[cls];
+
+        t.state.rates.clear();
+        for (size_t w = 0; w < options_.windowsSec.size(); ++w) {
+            int window = options_.windowsSec[w];
+            AerRate rate;
+            rate.windowSec = window;
+            // Newest sample that is at least a window old, else the oldest one
+            const Sample* from = &t.history.front();
+            for (size_t k = t.history.size(); k-- > 0;) {
+                if (t.history[k].t <= nowSec - window) {
+                    from = &t.history[k];
+                    break;
+                }
+            }
+            rate.covered = from->t <= nowSec - window;
+            double span = nowSec - from->t;
+            for (int cls = 0; cls < kAerClassCount && span > 0.0; ++cls) {
+                rate.perSec[cls] = (double)(s.totals[cls] - from->totals[cls]) / span;
+            }
+            t.state.rates.push_back(rate);
+
+            for (int cls = 0; cls < kAerClassCount; ++cls) {
+                double threshold = options_.thresholds[cls];
+                // "Any error" thresholds are judged on the shortest window only, so one
+                // error doesn't raise an alert per window; rate thresholds need the
+                // whole window, or one burst in a short history would look sustained
+                if (threshold <= 0.0 ? w != 0 : !rate.covered) continue;
+                bool& raised = t.alerting[std::make_pair(cls, window)];
+                double value = rate.perSec[cls];
+                bool above = threshold <= 0.0 ? value > 0.0 : value > threshold;
+                bool below = threshold <= 0.0 ? value <= 0.0 : value <= threshold / 2;
+                if (raised ? !below : !above) continue;
+                raised = !raised;
+                AerAlert alert;
+                alert.slot = d.first;
+                alert.cls = cls;
+                alert.windowSec = window;
+                alert.rate = value;
+                alert.threshold = threshold;
+                alert.raised = raised;
+                if (cls == kAerCorrectable) alert.correctableByType = t.state.correctableByType;
+                alerts.push_back(alert);
+            }
+        }
+    }
+}
+
+bool AerSampler::state(const std::string& slot, AerDeviceState& out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = devices_.find(slot);
+    if (it == devices_.end() || !it->second.state.present) return false;
+    out = it->second.state;
+    return true;
+}
+
+size_t AerSampler::trackedFiles() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t n = 0;
+    for (const auto& d : devices_) {
+        for (int fd : d.second.fds) n += fd >= 0;
+    }
+    return n;
+}
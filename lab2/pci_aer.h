@@ -0,0 +1,98 @@
+// PCIe AER error counters and error-rate alerts for Lab2
+#ifndef PCI_AER_H
+#define PCI_AER_H
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+enum AerClass { kAerCorrectable = 0, kAerNonFatal = 1, kAerFatal = 2, kAerClassCount = 3 };
+
+// "correctable", "nonfatal", "fatal"
+const char* AerClassName(int cls);
+
+// One aer_dev_* file: "RxErr 0\nBadTLP 3\n...\nTOTAL_ERR_COR 3\n"
+struct AerCounters {
+    unsigned long long total = 0;   // TOTAL_ERR_* line, or the sum when there is none
+    std::vector<std::pair<std::string, unsigned long long> > byType;
+};
+
+// Parses the text of an aer_dev_* file; false if it holds no counter
+bool ParseAerCounters(const char* text, size_t len, AerCounters& counters);
+
+struct AerRate {
+    int windowSec = 0;
+    double perSec[kAerClassCount] = {0.0, 0.0, 0.0};
+    bool covered = false;           // the history spans the whole window
+};
+
+struct AerDeviceState {
+    std::string slot;
+    bool present = false;           // the device has AER counters
+    unsigned long long totals[kAerClassCount] = {0, 0, 0};
+    std::vector<std::pair<std::string, unsigned long long> > correctableByType;
+    std::vector<AerRate> rates;     // one per configured window
+};
+
+// Raised when a class's rate over a window goes above its threshold, cleared
+// once it falls to half of it
+struct AerAlert {
+    std::string slot;
+    int cls = kAerCorrectable;
+    int windowSec = 0;
+    double rate = 0.0;
+    double threshold = 0.0;
+    bool raised = true;
+    std::vector<std::pair<std::string, unsigned long long> > correctableByType;
+};
+
+struct AerOptions {
+    std::vector<int> windowsSec = {10, 60, 300};
+    // Errors per second; non-fatal and fatal errors alert on the first one
+    double thresholds[kAerClassCount] = {1.0, 0.0, 0.0};
+};
+
+// Keeps the three aer_dev_* files of every tracked device open and rereads
+// them with pread at offset 0 (sysfs regenerates an attribute on each read
+// from the start), so a sample costs three syscalls per device and no path
+// lookups. A counter that goes backwards (device reset, driver reload)
+// restarts that device's history.
+class AerSampler {
+public:
+    explicit AerSampler(const AerOptions& options = AerOptions());
+    ~AerSampler();
+
+    // Tracks exactly these devices (slot, sysfs device dir): new ones are
+    // opened, missing ones closed
+    void setDevices(const std::vector<std::pair<std::string, std::string> >& devices);
+
+    // Reads every counter, updates the rates and appends alerts whose state changed
+    void sample(double nowSec, std::vector<AerAlert>& alerts);
+
+    bool state(const std::string& slot, AerDeviceState& out) const;
+    size_t trackedFiles() const;
+
+private:
+    struct Sample {
+        double t;
+        unsigned long long totals[kAerClassCount];
+    };
+    struct Tracked {
+        int fds[kAerClassCount] = {-1, -1, -1};
+        std::deque<Sample> history;
+        AerDeviceState state;
+        std::map<std::pair<int, int>, bool> alerting;   // (class, window) -> raised
+    };
+
+    void close(Tracked& t);
+
+    AerOptions options_;
+    mutable std::mutex mutex_;
+    std::map<std::string, Tracked> devices_;
+    std::vector<char> buffer_;
+};
+
+#endif // PCI_AER_H
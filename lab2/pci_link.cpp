@@ -0,0 +1,133 @@
+// PCIe link state (speed/width) helpers for Lab2
+#include "pci_link.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+
+// Config space layout (PCI Local Bus / PCI Express Base specs)
+static const size_t PCI_STATUS = 0x06;
+static const unsigned PCI_STATUS_CAP_LIST = 0x10;
+static const size_t PCI_CAPABILITY_LIST = 0x34;
+static const unsigned PCI_CAP_ID_EXP = 0x10;
+static const size_t PCI_EXP_LNKCAP = 0x0C;
+static const size_t PCI_EXP_LNKSTA = 0x12;
+
+static bool ReadTrimmed(const std::string& path, std::string& out) {
+    std::ifstream f(path.c_str());
+    if (!f) return false;
+    std::getline(f, out);
+    while (!out.empty() && (out.back() == '\n' || out.back() == '\r' || out.back() == ' ')) out.pop_back();
+    return true;
+}
+
+double ParseLinkSpeedGTs(const std::string& text) {
+    // Unknown, empty or garbage all come out as 0
+    const char* s = text.c_str();
+    char* end = nullptr;
+    double v = strtod(s, &end);
+    if (end == s || v <= 0.0) return 0.0;
+    return v;
+}
+
+double LinkSpeedFromEncoding(unsigned code) {
+    switch (code) {
+        case 1: return 2.5;
+        case 2: return 5.0;
+        case 3: return 8.0;
+        case 4: return 16.0;
+        case 5: return 32.0;
+        case 6: return 64.0;
+        default: return 0.0;
+    }
+}
+
+std::string LinkGeneration(double gts) {
+    if (gts <= 0.0) return "";
+    if (gts < 5.0) return "Gen1";
+    if (gts < 8.0) return "Gen2";
+    if (gts < 16.0) return "Gen3";
+    if (gts < 32.0) return "Gen4";
+    if (gts < 64.0) return "Gen5";
+    return "Gen6";
+}
+
+bool ParsePcieLinkFromConfig(const unsigned char* cfg, size_t len, PciLinkInfo& link) {
+    if (!cfg || len <= PCI_CAPABILITY_LIST) return false;
+    unsigned status = cfg[PCI_STATUS] | (cfg[PCI_STATUS + 1] << 8);
+    if (!(status & PCI_STATUS_CAP_LIST)) return false;
+
+    // Capability pointers are dword aligned; bound the walk so a corrupt
+    // blob with a pointer loop cannot spin forever.
+    size_t pos = cfg[PCI_CAPABILITY_LIST] & ~3u;
+    for (int guard = 0; pos >= 0x40 && pos + 1 < len && guard < 48; ++guard) {
+        unsigned id = cfg[pos];
+        if (id == PCI_CAP_ID_EXP) {
+            if (pos + PCI_EXP_LNKSTA + 2 > len) return false;
+            const unsigned char* c = cfg + pos;
+            unsigned long lnkcap = c[PCI_EXP_LNKCAP] | (c[PCI_EXP_LNKCAP + 1] << 8) |
+                                   ((unsigned long)c[PCI_EXP_LNKCAP + 2] << 16) | ((unsigned long)c[PCI_EXP_LNKCAP + 3] << 24);
+            unsigned lnksta = c[PCI_EXP_LNKSTA] | (c[PCI_EXP_LNKSTA + 1] << 8);
+
+            link.present = true;
+            link.maxSpeedGTs = LinkSpeedFromEncoding(lnkcap & 0xF);
+            link.maxWidth = (int)((lnkcap >> 4) & 0x3F);
+            link.currentSpeedGTs = LinkSpeedFromEncoding(lnksta & 0xF);
+            link.currentWidth = (int)((lnksta >> 4) & 0x3F);
+            link.source = "config";
+            return true;
+        }
+        pos = cfg[pos + 1] & ~3u;
+    }
+    return false;
+}
+
+bool ReadSysfsPciLink(const std::string& deviceDir, PciLinkInfo& link) {
+    std::string cur, curW, max, maxW;
+    bool haveAttrs = ReadTrimmed(deviceDir + "/current_link_speed", cur) &&
+                     ReadTrimmed(deviceDir + "/current_link_width", curW) &&
+                     ReadTrimmed(deviceDir + "/max_link_speed", max) &&
+                     ReadTrimmed(deviceDir + "/max_link_width", maxW);
+    if (haveAttrs) {
+        link.present = true;
+        link.currentSpeedGTs = ParseLinkSpeedGTs(cur);
+        link.currentWidth = atoi(curW.c_str());
+        link.maxSpeedGTs = ParseLinkSpeedGTs(max);
+        link.maxWidth = atoi(maxW.c_str());
+        link.source = "sysfs";
+        EvaluateLinkDegradation(link);
+        return true;
+    }
+
+    // Older kernels (and non-root readers of some attributes) only give us the
+    // raw config space; unprivileged reads of it are cut at 64 bytes, in which
+    // case the capability list is out of reach and we report nothing.
+    std::ifstream f((deviceDir + "/config").c_str(), std::ios::binary);
+    if (!f) return false;
+    std::vector<unsigned char> cfg((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    if (!ParsePcieLinkFromConfig(cfg.data(), cfg.size(), link)) return false;
+    EvaluateLinkDegradation(link);
+    return true;
+}
+
+void EvaluateLinkDegradation(PciLinkInfo& link) {
+    bool slower = link.currentSpeedGTs > 0.0 && link.maxSpeedGTs > 0.0 && link.currentSpeedGTs < link.maxSpeedGTs;
+    bool narrower = link.currentWidth > 0 && link.maxWidth > 0 && link.currentWidth < link.maxWidth;
+    link.degraded = slower || narrower;
+}
+
+static std::string DescribeSide(int width, double gts) {
+    std::ostringstream ss;
+    ss << "x" << width << " " << std::fixed << std::setprecision(1) << gts << " GT/s";
+    std::string gen = LinkGeneration(gts);
+    if (!gen.empty()) ss << " (" << gen << ")";
+    return ss.str();
+}
+
+std::string DescribeLink(const PciLinkInfo& link) {
+    if (!link.present) return "";
+    return DescribeSide(link.currentWidth, link.currentSpeedGTs) + " of " + DescribeSide(link.maxWidth, link.maxSpeedGTs);
+}
@@ -0,0 +1,41 @@
+// PCIe link state (speed/width) helpers for Lab2
+#ifndef PCI_LINK_H
+#define PCI_LINK_H
+
+#include <string>
+#include <cstddef>
+
+struct PciLinkInfo {
+    bool present = false;         // device exposes a PCIe link (sysfs attributes, config space or devprops)
+    double currentSpeedGTs = 0.0; // negotiated speed, GT/s (0 = unknown)
+    int currentWidth = 0;         // negotiated width, lanes (0 = unknown)
+    double maxSpeedGTs = 0.0;     // speed the device is capable of
+    int maxWidth = 0;             // width the device is capable of
+    bool degraded = false;        // trained below capability
+    std::string source;           // "sysfs", "config" or "devprop"
+};
+
+// "8.0 GT/s PCIe", "2.5 GT/s", "Unknown" -> GT/s (0 when unknown)
+double ParseLinkSpeedGTs(const std::string& text);
+
+// Link speed field encoding from LnkCap/LnkSta (1 = 2.5 GT/s ... 6 = 64 GT/s)
+double LinkSpeedFromEncoding(unsigned code);
+
+// "Gen1".."Gen6" for a speed in GT/s, empty when unknown
+std::string LinkGeneration(double gts);
+
+// Walks the capability list of a raw config-space blob and fills the link fields
+// from the PCI Express capability. Returns false if there is no PCIe capability.
+bool ParsePcieLinkFromConfig(const unsigned char* cfg, size_t len, PciLinkInfo& link);
+
+// Reads current/max link speed and width of a device directory such as
+// <root>/bus/pci/devices/0000:01:00.0, falling back to its "config" blob.
+bool ReadSysfsPciLink(const std::string& deviceDir, PciLinkInfo& link);
+
+// Sets link.degraded when the negotiated speed or width is below capability
+void EvaluateLinkDegradation(PciLinkInfo& link);
+
+// Human readable "x4 8.0 GT/s (Gen3) of x16 16.0 GT/s (Gen4)"
+std::string DescribeLink(const PciLinkInfo& link);
+
+#endif // PCI_LINK_H
@@ -0,0 +1,117 @@
+// NUMA/IRQ locality of PCI devices for Lab2
+#include "pci_topology.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+
+std::vector<int> ParseCpuList(const std::string& text) {
+    std::vector<int> cpus;
+    std::stringstream ss(text);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty() || !isdigit((unsigned char)range[0])) continue;
+        char* end = nullptr;
+        long first = strtol(range.c_str(), &end, 10);
+        long last = first;
+        if (*end == '-') last = strtol(end + 1, &end, 10);
+        for (long cpu = first; cpu <= last && cpu - first < 4096; ++cpu) cpus.push_back((int)cpu);
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+std::string FormatCpuList(const std::vector<int>& cpus) {
+    std::ostringstream ss;
+    for (size_t i = 0; i < cpus.size();) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) ++j;
+        if (i) ss << ",";
+        ss << cpus[i];
+        if (j > i) ss << "-" << cpus[j];
+        i = j + 1;
+    }
+    return ss.str();
+}
+
+void EvaluateIrqLocality(PciLocality& locality) {
+    for (auto& irq : locality.irqs) {
+        irq.local = true;
+        if (locality.localCpus.empty()) continue;
+        for (int cpu : irq.affinity) {
+            if (!std::binary_search(locality.localCpus.begin(), locality.localCpus.end(), cpu)) {
+                irq.local = false;
+                break;
+            }
+        }
+    }
+}
+
+static std::string ReadFirstLine(const std::string& path) {
+    std::ifstream f(path.c_str());
+    std::string line;
+    std::getline(f, line);
+    return line;
+}
+
+static void AddIrq(PciLocality& locality, unsigned irq, const std::string& procRoot) {
+    PciIrq entry;
+    entry.irq = irq;
+    entry.affinity = ParseCpuList(ReadFirstLine(procRoot + "/irq/" + std::to_string(irq) + "/smp_affinity_list"));
+    locality.irqs.push_back(entry);
+}
+
+void ReadSysfsPciLocality(const std::string& deviceDir, const std::string& procRoot, PciLocality& locality) {
+    // A value that isn't a number leaves the node unknown instead of reading as node 0
+    std::string node = ReadFirstLine(deviceDir + "/numa_node");
+    char* end = nullptr;
+    long value = strtol(node.c_str(), &end, 10);
+    if (end != node.c_str() && value >= -1) locality.numaNode = (int)value;
+    locality.localCpus = ParseCpuList(ReadFirstLine(deviceDir + "/local_cpulist"));
+
+#ifndef _WIN32
+    // With MSI/MSI-X enabled every vector is listed under msi_irqs; the "irq"
+    // attribute then just repeats the first one.
+    std::vector<unsigned> vectors;
+    if (DIR* dir = opendir((deviceDir + "/msi_irqs").c_str())) {
+        while (struct dirent* e = readdir(dir)) {
+            if (isdigit((unsigned char)e->d_name[0])) vectors.push_back((unsigned)strtoul(e->d_name, NULL, 10));
+        }
+        closedir(dir);
+    }
+    std::sort(vectors.begin(), vectors.end());
+    for (unsigned irq : vectors) AddIrq(locality, irq, procRoot);
+#endif
+    if (locality.irqs.empty()) {
+        unsigned irq = (unsigned)strtoul(ReadFirstLine(deviceDir + "/irq").c_str(), NULL, 10);
+        if (irq) AddIrq(locality, irq, procRoot);
+    }
+    EvaluateIrqLocality(locality);
+}
+
+void AddToTopologySummary(PciTopologySummary& summary, const std::string& slot, const PciLocality& locality) {
+    auto node = std::find_if(summary.devicesPerNode.begin(), summary.devicesPerNode.end(),
+                             [&](const std::pair<int, int>& n) { return n.first == locality.numaNode; });
+    if (node == summary.devicesPerNode.end()) {
+        summary.devicesPerNode.push_back(std::make_pair(locality.numaNode, 1));
+        std::sort(summary.devicesPerNode.begin(), summary.devicesPerNode.end());
+    } else {
+        node->second++;
+    }
+
+    for (const auto& irq : locality.irqs) {
+        if (irq.local) continue;
+        PciIrqMismatch m;
+        m.slot = slot;
+        m.irq = irq.irq;
+        m.affinity = irq.affinity;
+        m.localCpus = locality.localCpus;
+        summary.irqMismatches.push_back(m);
+    }
+}
@@ -0,0 +1,47 @@
+// NUMA/IRQ locality of PCI devices for Lab2
+#ifndef PCI_TOPOLOGY_H
+#define PCI_TOPOLOGY_H
+
+#include <string>
+#include <vector>
+
+struct PciIrq {
+    unsigned irq = 0;
+    std::vector<int> affinity;  // CPUs the interrupt may be delivered to
+    bool local = true;          // every affinity CPU is local to the device
+};
+
+struct PciLocality {
+    int numaNode = -1;          // -1 = no NUMA information (single node or unknown)
+    std::vector<int> localCpus; // CPUs on the device's node
+    std::vector<PciIrq> irqs;   // MSI/MSI-X vectors, or the legacy INTx line
+};
+
+struct PciIrqMismatch {
+    std::string slot;
+    unsigned irq;
+    std::vector<int> affinity;
+    std::vector<int> localCpus;
+};
+
+struct PciTopologySummary {
+    std::vector<std::pair<int, int> > devicesPerNode; // (node, device count), node -1 = unknown
+    std::vector<PciIrqMismatch> irqMismatches;
+};
+
+// "0-3,8,10-11" <-> {0,1,2,3,8,10,11}
+std::vector<int> ParseCpuList(const std::string& text);
+std::string FormatCpuList(const std::vector<int>& cpus);
+
+// Marks each IRQ whose affinity reaches outside localCpus. No local CPU
+// information means nothing can be judged, so the IRQs stay local.
+void EvaluateIrqLocality(PciLocality& locality);
+
+// Reads numa_node, local_cpulist, msi_irqs/* (or irq) from a device directory such as
+// <sysfs>/bus/pci/devices/0000:01:00.0 and each IRQ's <procRoot>/irq/N/smp_affinity_list.
+void ReadSysfsPciLocality(const std::string& deviceDir, const std::string& procRoot, PciLocality& locality);
+
+// Accumulates one device into the topology summary
+void AddToTopologySummary(PciTopologySummary& summary, const std::string& slot, const PciLocality& locality);
+
+#endif // PCI_TOPOLOGY_H
@@ -0,0 +1,94 @@
+// AER counters and rate alerts against the fake /sys/bus/pci tree
+#include "../pci_aer.h"
+#include "../../common/lab_test.h"
+
+#include <cstring>
+
+static const char* const kDevices = "sys/bus/pci/devices/";
+
+static void testParse() {
+    const char* text = "RxErr 1\nBadTLP 3\nTOTAL_ERR_COR 4\n";
+    AerCounters counters;
+    CHECK(ParseAerCounters(text, strlen(text), counters));
+    CHECK_EQ(counters.total, 4u);
+    CHECK_EQ(counters.byType.size(), 2u);
+
+    // Older kernels have no TOTAL_ERR_* line: the total is the sum
+    text = "RxErr 1\nBadTLP 3";
+    CHECK(ParseAerCounters(text, strlen(text), counters));
+    CHECK_EQ(counters.total, 4u);
+
+    text = "not a counter file\n";
+    CHECK(!ParseAerCounters(text, strlen(text), counters));
+    CHECK(!ParseAerCounters("", 0, counters));
+}
+
+static void testSampler() {
+    LabFixture sys("tests/fixtures/pci.tree");
+    std::string gpuDir = sys.path(kDevices) + "0000:01:00.0";
+    AerOptions options;
+    options.windowsSec.assign(1, 10);
+    AerSampler sampler(options);
+    std::vector<std::pair<std::string, std::string> > devices;
+    devices.push_back(std::make_pair("0000:01:00.0", gpuDir));
+    devices.push_back(std::make_pair("0000:00:1f.0", sys.path(kDevices) + "0000:00:1f.0"));
+    devices.push_back(std::make_pair("0000:03:00.0", sys.path(kDevices) + "0000:03:00.0"));
+    sampler.setDevices(devices);
+    // The device without AER has no files to keep open
+    CHECK_EQ(sampler.trackedFiles(), 6u);
+
+    std::vector<AerAlert> alerts;
+    sampler.sample(0.0, alerts);
+    CHECK(alerts.empty());
+
+    AerDeviceState gpu;
+    CHECK(sampler.state("0000:01:00.0", gpu));
+    CHECK_EQ(gpu.totals[kAerCorrectable], 3u);
+    CHECK_EQ(gpu.correctableByType.size(), 3u);
+    AerDeviceState other;
+    // Missing counters, and counter files with nothing parseable in them
+    CHECK(!sampler.state("0000:00:1f.0", other));
+    CHECK(!sampler.state("0000:03:00.0", other));
+
+    // 30 more correctable errors over 10 s is 3/s, above the default 1/s
+    sys.write("sys/bus/pci/devices/0000:01:00.0/aer_dev_correctable", "RxErr 0\nBadTLP 33\nBadDLLP 0\nTOTAL_ERR_COR 33");
+    sampler.sample(10.0, alerts);
+    CHECK_EQ(alerts.size(), 1u);
+    if (alerts.size() == 1) {
+        CHECK_EQ(alerts[0].slot, "0000:01:00.0");
+        CHECK_EQ(alerts[0].cls, (int)kAerCorrectable);
+        CHECK(alerts[0].raised);
+        CHECK_NEAR(alerts[0].rate, 3.0, 1e-9);
+        CHECK_EQ(alerts[0].correctableByType.size(), 3u);
+    }
+
+    // A single non-fatal error alerts at once
+    alerts.clear();
+    sys.write("sys/bus/pci/devices/0000:01:00.0/aer_dev_nonfatal", "Undefined 0\nDLP 1\nTOTAL_ERR_NONFATAL 1");
+    sampler.sample(11.0, alerts);
+    bool nonFatal = false;
+    for (size_t i = 0; i < alerts.size(); ++i) nonFatal = nonFatal || (alerts[i].cls == kAerNonFatal && alerts[i].raised);
+    CHECK(nonFatal);
+
+    // Counters going backwards (device reset) restart the history instead of
+    // producing a huge unsigned rate
+    alerts.clear();
+    sys.write("sys/bus/pci/devices/0000:01:00.0/aer_dev_correctable", "TOTAL_ERR_COR 0");
+    sys.write("sys/bus/pci/devices/0000:01:00.0/aer_dev_nonfatal", "TOTAL_ERR_NONFATAL 0");
+    sampler.sample(12.0, alerts);
+    CHECK(sampler.state("0000:01:00.0", gpu));
+    CHECK_EQ(gpu.totals[kAerCorrectable], 0u);
+    CHECK_EQ(gpu.rates.size(), 1u);
+    if (!gpu.rates.empty()) CHECK_EQ(gpu.rates[0].perSec[kAerCorrectable], 0.0);
+
+    // Dropping a device closes its files
+    devices.resize(1);
+    sampler.setDevices(devices);
+    CHECK_EQ(sampler.trackedFiles(), 3u);
+}
+
+int main() {
+    testParse();
+    testSampler();
+    return LabTestResult();
+}
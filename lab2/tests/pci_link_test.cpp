@@ -0,0 +1,110 @@
+// PCIe link parsing against the fake /sys/bus/pci tree
+#include "../pci_link.h"
+#include "../../common/lab_test.h"
+
+#include <fstream>
+#include <vector>
+
+static const char* const kDevices = "sys/bus/pci/devices/";
+
+// 256 bytes of config space with a PCI Express capability at 0x40
+static std::vector<unsigned char> configWithPcie(unsigned lnkcap, unsigned lnksta) {
+    std::vector<unsigned char> cfg(256, 0);
+    cfg[0x06] = 0x10;       // status: capability list present
+    cfg[0x34] = 0x40;       // first capability
+    cfg[0x40] = 0x10;       // PCI Express
+    cfg[0x41] = 0x00;       // last in the list
+    for (int i = 0; i < 4; ++i) cfg[0x4C + i] = (unsigned char)(lnkcap >> (8 * i));
+    cfg[0x52] = (unsigned char)lnksta;
+    cfg[0x53] = (unsigned char)(lnksta >> 8);
+    return cfg;
+}
+
+static void writeBlob(const std::string& path, const std::vector<unsigned char>& blob) {
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    out.write((const char*)blob.data(), (std::streamsize)blob.size());
+}
+
+static void testParsers() {
+    CHECK_EQ(ParseLinkSpeedGTs("8.0 GT/s PCIe"), 8.0);
+    CHECK_EQ(ParseLinkSpeedGTs("2.5 GT/s"), 2.5);
+    CHECK_EQ(ParseLinkSpeedGTs("Unknown"), 0.0);
+    CHECK_EQ(ParseLinkSpeedGTs(""), 0.0);
+    CHECK_EQ(LinkSpeedFromEncoding(4), 16.0);
+    CHECK_EQ(LinkSpeedFromEncoding(7), 0.0);
+    CHECK_EQ(LinkGeneration(8.0), "Gen3");
+    CHECK_EQ(LinkGeneration(0.0), "");
+}
+
+static void testSysfsAttributes() {
+    LabFixture sys("tests/fixtures/pci.tree");
+
+    PciLinkInfo gpu;
+    CHECK(ReadSysfsPciLink(sys.path(kDevices) + "0000:01:00.0", gpu));
+    CHECK(gpu.present);
+    CHECK_EQ(gpu.source, "sysfs");
+    CHECK_EQ(gpu.currentWidth, 8);
+    CHECK_EQ(gpu.maxWidth, 16);
+    CHECK(gpu.degraded);
+    CHECK_EQ(DescribeLink(gpu), "x8 8.0 GT/s (Gen3) of x16 16.0 GT/s (Gen4)");
+
+    PciLinkInfo nvme;
+    CHECK(ReadSysfsPciLink(sys.path(kDevices) + "0000:02:00.0", nvme));
+    CHECK(!nvme.degraded);
+
+    // Missing: one link file alone and no config space to fall back to
+    PciLinkInfo bridge;
+    CHECK(!ReadSysfsPciLink(sys.path(kDevices) + "0000:00:1f.0", bridge));
+    CHECK(!bridge.present);
+    CHECK_EQ(DescribeLink(bridge), "");
+
+    // Malformed: the link is there, the unreadable values stay unknown and
+    // unknown values never count as degraded
+    PciLinkInfo usb;
+    CHECK(ReadSysfsPciLink(sys.path(kDevices) + "0000:03:00.0", usb));
+    CHECK(usb.present);
+    CHECK_EQ(usb.currentSpeedGTs, 0.0);
+    CHECK_EQ(usb.currentWidth, 0);
+    CHECK_EQ(usb.maxSpeedGTs, 8.0);
+    CHECK_EQ(usb.maxWidth, 0);
+    CHECK(!usb.degraded);
+}
+
+static void testConfigFallback() {
+    LabFixture sys("tests/fixtures/pci.tree");
+    std::string bridge = sys.path(kDevices) + "0000:00:1f.0";
+
+    // LnkCap x16 16 GT/s, LnkSta x4 8 GT/s
+    writeBlob(bridge + "/config", configWithPcie((16 << 4) | 4, (4 << 4) | 3));
+    PciLinkInfo link;
+    CHECK(ReadSysfsPciLink(bridge, link));
+    CHECK_EQ(link.source, "config");
+    CHECK_EQ(link.maxSpeedGTs, 16.0);
+    CHECK_EQ(link.maxWidth, 16);
+    CHECK_EQ(link.currentSpeedGTs, 8.0);
+    CHECK_EQ(link.currentWidth, 4);
+    CHECK(link.degraded);
+
+    // Unprivileged readers get the first 64 bytes only: no capability list
+    std::vector<unsigned char> cfg = configWithPcie((16 << 4) | 4, (4 << 4) | 3);
+    cfg.resize(64);
+    writeBlob(bridge + "/config", cfg);
+    PciLinkInfo truncated;
+    CHECK(!ReadSysfsPciLink(bridge, truncated));
+
+    // A capability that points at itself must not hang the walk
+    cfg = configWithPcie(0, 0);
+    cfg[0x40] = 0x05;
+    cfg[0x41] = 0x40;
+    writeBlob(bridge + "/config", cfg);
+    PciLinkInfo looped;
+    CHECK(!ReadSysfsPciLink(bridge, looped));
+    unlink((bridge + "/config").c_str());
+}
+
+int main() {
+    testParsers();
+    testSysfsAttributes();
+    testConfigFallback();
+    return LabTestResult();
+}
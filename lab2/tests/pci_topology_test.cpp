@@ -0,0 +1,92 @@
+// NUMA/IRQ locality against the fake /sys/bus/pci and /proc/irq trees
+#include "../pci_topology.h"
+#include "../../common/lab_test.h"
+
+static const char* const kDevices = "sys/bus/pci/devices/";
+
+static void testCpuLists() {
+    std::vector<int> cpus = ParseCpuList("0-3,8,10-11");
+    CHECK_EQ(cpus.size(), 7u);
+    CHECK_EQ(FormatCpuList(cpus), "0-3,8,10-11");
+    CHECK_EQ(FormatCpuList(ParseCpuList("5,4,4,6")), "4-6");
+    CHECK(ParseCpuList("").empty());
+    CHECK(ParseCpuList(",,-3,a-b").empty());
+}
+
+static void testLocality() {
+    LabFixture fs("tests/fixtures/pci.tree");
+    std::string proc = fs.path("proc");
+    PciTopologySummary summary;
+
+    PciLocality gpu;
+    ReadSysfsPciLocality(fs.path(kDevices) + "0000:01:00.0", proc, gpu);
+    CHECK_EQ(gpu.numaNode, 1);
+    CHECK_EQ(FormatCpuList(gpu.localCpus), "4-7");
+    // Every MSI-X vector, not just the "irq" attribute that repeats the first one
+    CHECK_EQ(gpu.irqs.size(), 2u);
+    if (gpu.irqs.size() == 2) {
+        CHECK_EQ(gpu.irqs[0].irq, 129u);
+        CHECK(gpu.irqs[0].local);
+        CHECK_EQ(gpu.irqs[1].irq, 130u);
+        CHECK(!gpu.irqs[1].local);
+    }
+    AddToTopologySummary(summary, "0000:01:00.0", gpu);
+
+    PciLocality nvme;
+    ReadSysfsPciLocality(fs.path(kDevices) + "0000:02:00.0", proc, nvme);
+    CHECK_EQ(nvme.numaNode, -1);
+    CHECK_EQ(nvme.irqs.size(), 1u);
+    if (!nvme.irqs.empty()) {
+        CHECK_EQ(nvme.irqs[0].irq, 17u);
+        CHECK(nvme.irqs[0].local);
+    }
+    AddToTopologySummary(summary, "0000:02:00.0", nvme);
+
+    // Missing: no numa_node, local_cpulist or irq at all
+    PciLocality bridge;
+    ReadSysfsPciLocality(fs.path(kDevices) + "0000:00:1f.0", proc, bridge);
+    CHECK_EQ(bridge.numaNode, -1);
+    CHECK(bridge.localCpus.empty());
+    CHECK(bridge.irqs.empty());
+    AddToTopologySummary(summary, "0000:00:1f.0", bridge);
+
+    // Malformed: nothing usable, and a bad numa_node is unknown rather than node 0
+    PciLocality usb;
+    ReadSysfsPciLocality(fs.path(kDevices) + "0000:03:00.0", proc, usb);
+    CHECK_EQ(usb.numaNode, -1);
+    CHECK(usb.localCpus.empty());
+    CHECK(usb.irqs.empty());
+    AddToTopologySummary(summary, "0000:03:00.0", usb);
+
+    CHECK_EQ(summary.devicesPerNode.size(), 2u);
+    if (summary.devicesPerNode.size() == 2) {
+        CHECK_EQ(summary.devicesPerNode[0].first, -1);
+        CHECK_EQ(summary.devicesPerNode[0].second, 3);
+        CHECK_EQ(summary.devicesPerNode[1].first, 1);
+        CHECK_EQ(summary.devicesPerNode[1].second, 1);
+    }
+    CHECK_EQ(summary.irqMismatches.size(), 1u);
+    if (!summary.irqMismatches.empty()) {
+        CHECK_EQ(summary.irqMismatches[0].slot, "0000:01:00.0");
+        CHECK_EQ(summary.irqMismatches[0].irq, 130u);
+        CHECK_EQ(FormatCpuList(summary.irqMismatches[0].affinity), "0");
+    }
+}
+
+static void testNoLocalCpus() {
+    // Without local CPU information an IRQ can't be judged and stays local
+    PciLocality locality;
+    PciIrq irq;
+    irq.irq = 5;
+    irq.affinity.push_back(3);
+    locality.irqs.push_back(irq);
+    EvaluateIrqLocality(locality);
+    CHECK(locality.irqs[0].local);
+}
+
+int main() {
+    testCpuLists();
+    testLocality();
+    testNoLocalCpus();
+    return LabTestResult();
+}
@@ -1,7 +1,22 @@
+// Disk monitor for lab3. The disk records need Windows (IOCTL_STORAGE_QUERY_PROPERTY
+// on \\.\PhysicalDriveN); elsewhere they come only from a recorded trace (--replay).
+// The space usage commands (usage, usage_bench and "usage <path>" on stdin) run on
+// both, so the Linux walk of space_usage.cpp is reachable from here.
+#ifdef _WIN32
 #include <windows.h>
 #include <winioctl.h>
 #include <setupapi.h>
 #include <cfgmgr32.h>
+#include <io.h> // for access function
+#include <aclapi.h> // for security functions
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,9 +24,6 @@
 #include <sstream>
 #include <vector>
 #include <string>
-#include <io.h> // for access function
-#include <windows.h>
-#include <aclapi.h> // for security functions
 
 // Define types for Windows XP compatibility
 #ifndef __STDC_FORMAT_MACROS
@@ -19,6 +31,118 @@
 #endif
 #include <inttypes.h>
 
+#include "../common/perf_stats.h"
+#include "../common/hal.h"
+#include "space_usage.h"
+
+static PerfMetric g_perfGetDiskInfo("getDiskInfo");
+static PerfMetric g_perfGetVolumeSpaceInfo("getVolumeSpaceInfo");
+// The command listener, a usage walk and the main loop all print records
+#ifdef _WIN32
+static CRITICAL_SECTION g_outputLock;
+static void initOutputLock() { InitializeCriticalSection(&g_outputLock); }
+static void lockOutput() { EnterCriticalSection(&g_outputLock); }
+static void unlockOutput() { LeaveCriticalSection(&g_outputLock); }
+#else
+static pthread_mutex_t g_outputLock = PTHREAD_MUTEX_INITIALIZER;
+static void initOutputLock() {}
+static void lockOutput() { pthread_mutex_lock(&g_outputLock); }
+static void unlockOutput() { pthread_mutex_unlock(&g_outputLock); }
+#endif
+
+static void emitLine(const std::string& line) {
+    lockOutput();
+    std::cout << line << std::endl;
+    std::cout.flush();
+    unlockOutput();
+}
+
+static double nowMs() {
+#ifdef _WIN32
+    return (double)GetTickCount();
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+#endif
+}
+
+// Runs fn(arg) on a thread of its own that nobody joins
+struct DetachedCall {
+    void (*fn)(void*);
+    void* arg;
+};
+
+#ifdef _WIN32
+static DWORD WINAPI detachedTrampoline(LPVOID p) {
+#else
+static void* detachedTrampoline(void* p) {
+#endif
+    DetachedCall call = *(DetachedCall*)p;
+    delete (DetachedCall*)p;
+    call.fn(call.arg);
+    return 0;
+}
+
+static bool startDetached(void (*fn)(void*), void* arg) {
+    DetachedCall* call = new DetachedCall();
+    call->fn = fn;
+    call->arg = arg;
+#ifdef _WIN32
+    HANDLE h = CreateThread(NULL, 0, detachedTrampoline, call, 0, NULL);
+    if (h) {
+        CloseHandle(h);
+        return true;
+    }
+#else
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, detachedTrampoline, call) == 0) {
+        pthread_detach(thread);
+        return true;
+    }
+#endif
+    delete call;
+    return false;
+}
+
+std::string escapeJsonString(const char* input);
+static int runUsage(const UsageOptions& options);
+
+// One stdin walk at a time; set and cleared under the output lock
+static bool g_usageRunning = false;
+
+static void usageWorker(void* arg) {
+    UsageOptions* options = (UsageOptions*)arg;
+    runUsage(*options);
+    delete options;
+    lockOutput();
+    g_usageRunning = false;
+    unlockOutput();
+}
+
+// "stats" on stdin prints {"perf":{...}} with the latency of the disk queries;
+// "usage <path>" walks path on a worker thread and prints {"usage":{...}}
+// records until it is done, so "stats" keeps answering during a long walk
+static void commandListener(void*) {
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (line == "stats") emitLine("{\"perf\":" + PerfStatsJson() + "}");
+        else if (line.compare(0, 6, "usage ") == 0) {
+            lockOutput();
+            bool busy = g_usageRunning;
+            g_usageRunning = true;
+            unlockOutput();
+            if (busy) {
+                emitLine("{\"message\":\"a usage walk is already running\"}");
+                continue;
+            }
+            UsageOptions* options = new UsageOptions();
+            options->root = line.substr(6);
+            if (!startDetached(usageWorker, options)) usageWorker(options);
+        }
+    }
+}
+
 // Structure to hold disk information
 struct DiskInfo {
     char model[256];
@@ -32,8 +156,10 @@ struct DiskInfo {
     int diskNumber; // physical disk number
 };
 
+#ifdef _WIN32
 // Function to get detailed disk information using direct port/low-level Windows APIs
 bool getDiskInfo(int diskNumber, DiskInfo& diskInfo) {
+    PerfScope perfScope(g_perfGetDiskInfo);
     char drivePath[64];
     sprintf(drivePath, "\\\\.\\PhysicalDrive%d", diskNumber);
     
@@ -188,6 +314,7 @@ bool getDiskInfo(int diskNumber, DiskInfo& diskInfo) {
 
 // Function to get volume information and calculate used/free space
 bool getVolumeSpaceInfo(int diskNumber, char* volumePath, char* spaceInfo) {
+    PerfScope perfScope(g_perfGetVolumeSpaceInfo);
     // Try to find a volume associated with this disk
     char driveLetters[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
     for(int i = 0; i < 26; i++) {
@@ -209,6 +336,77 @@ bool getVolumeSpaceInfo(int diskNumber, char* volumePath, char* spaceInfo) {
     return false;
 }
 
+#endif
+
+// Block device channel of the HAL: one snapshot is the disk list of one status
+// record, with the volume space already filled in
+typedef std::vector<DiskInfo> BlockSnapshot;
+
+#ifdef _WIN32
+class LiveBlockSource : public HalSource<BlockSnapshot> {
+public:
+    explicit LiveBlockSource(const BlockSnapshot& disks) : disks_(disks) {}
+
+    virtual bool read(BlockSnapshot& out) {
+        out = disks_;
+        for (size_t i = 0; i < out.size(); ++i) {
+            // Update memory info with volume space if available
+            char volumePath[256];
+            char fullSpaceInfo[256];
+            if (getVolumeSpaceInfo(out[i].diskNumber, volumePath, fullSpaceInfo)) {
+                strcpy_s(out[i].memoryInfo, sizeof(out[i].memoryInfo), fullSpaceInfo);
+            }
+        }
+        return true;
+    }
+
+private:
+    BlockSnapshot disks_;
+};
+#endif
+
+static void decodeField(HalDecoder& d, char* field, size_t size) {
+    std::string value = d.str();
+    strncpy(field, value.c_str(), size - 1);
+    field[size - 1] = '\0';
+}
+
+static void encodeBlockSnapshot(HalEncoder& e, const BlockSnapshot& disks) {
+    e.u64(disks.size());
+    for (size_t i = 0; i < disks.size(); ++i) {
+        const DiskInfo& d = disks[i];
+        e.str(d.model);
+        e.str(d.manufacturer);
+        e.str(d.serial);
+        e.str(d.firmware);
+        e.str(d.memoryInfo);
+        e.str(d.interfaceType);
+        e.str(d.supportedModes);
+        e.boolean(d.isSSD);
+        e.i64(d.diskNumber);
+    }
+}
+
+static bool decodeBlockSnapshot(HalDecoder& d, BlockSnapshot& disks) {
+    uint64_t count = d.u64();
+    disks.clear();
+    for (uint64_t i = 0; i < count && d.ok(); ++i) {
+        DiskInfo disk;
+        memset(&disk, 0, sizeof(DiskInfo));
+        decodeField(d, disk.model, sizeof(disk.model));
+        decodeField(d, disk.manufacturer, sizeof(disk.manufacturer));
+        decodeField(d, disk.serial, sizeof(disk.serial));
+        decodeField(d, disk.firmware, sizeof(disk.firmware));
+        decodeField(d, disk.memoryInfo, sizeof(disk.memoryInfo));
+        decodeField(d, disk.interfaceType, sizeof(disk.interfaceType));
+        decodeField(d, disk.supportedModes, sizeof(disk.supportedModes));
+        disk.isSSD = d.boolean();
+        disk.diskNumber = (int)d.i64();
+        disks.push_back(disk);
+    }
+    return d.ok();
+}
+
 // Function to escape special characters in JSON strings (C++98 compatible)
 std::string escapeJsonString(const char* input) {
     std::string output = input;
@@ -245,7 +443,10 @@ std::string escapeJsonString(const char* input) {
     return output;
 }
 
-int main(int argc, char* argv[]) {
+#ifdef _WIN32
+// Waits for administrator rights, then collects the disks matching the variant;
+// the live block backend re-reads their volume space on every record
+static std::vector<DiskInfo> findTargetDisks(const char* variant) {
     // Simple check: try to access a system-level resource to test admin privileges
     HANDLE hDevice = CreateFileA("\\\\.\\PhysicalDrive0", 
         GENERIC_READ, 
@@ -282,17 +483,6 @@ int main(int argc, char* argv[]) {
         CloseHandle(hDevice);
     }
 
-    // Determine variant from command line argument
-    // Usage: diskscan.exe [HDD|SSD]
-    char variant[10] = "BOTH"; // Default to show both
-    if (argc > 1) {
-        if (strcmp(argv[1], "HDD") == 0 || strcmp(argv[1], "hdd") == 0) {
-            strcpy_s(variant, sizeof(variant), "HDD");
-        } else if (strcmp(argv[1], "SSD") == 0 || strcmp(argv[1], "ssd") == 0) {
-            strcpy_s(variant, sizeof(variant), "SSD");
-        }
-    }
-    
     // Enumerate physical drives to get disk info
     std::vector<DiskInfo> allDisks;
     std::vector<DiskInfo> targetDisks; // Disks matching the variant (HDD or SSD)
@@ -344,20 +534,249 @@ int main(int argc, char* argv[]) {
         targetDisks = allDisks; // If looking for both and none found, show empty
     }
 
-    // Emit JSON to stdout periodically
-    while (true) {
+    return targetDisks;
+}
+#endif
+
+static void emitUsageRecord(const std::string& json, void*) {
+    emitLine(json);
+}
+
+static int runUsage(const UsageOptions& options) {
+    SpaceUsageScanner scanner(options);
+    std::string error;
+    if (!scanner.run(emitUsageRecord, NULL, error)) {
+        emitLine("{\"message\":\"" + escapeJsonString(error.c_str()) + "\"}");
+        return 1;
+    }
+    return 0;
+}
+
+// File system calls of the usage benchmark
+#ifdef _WIN32
+static const char kPathSep = '\\';
+
+static std::string benchRootPath() {
+    char temp[MAX_PATH];
+    GetTempPathA(sizeof(temp), temp);
+    char root[MAX_PATH + 64];
+    sprintf(root, "%sdiskscan_usage_%lu", temp, (unsigned long)GetCurrentProcessId());
+    return root;
+}
+
+static bool makeDir(const std::string& path) { return CreateDirectoryA(path.c_str(), NULL) != 0; }
+
+static bool writeBenchFile(const std::string& path, const char* data, size_t size) {
+    HANDLE h = CreateFileA(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    DWORD written = 0;
+    if (size) WriteFile(h, data, (DWORD)size, &written, NULL);
+    CloseHandle(h);
+    return true;
+}
+
+static bool makeHardLink(const std::string& link, const std::string& target) {
+    return CreateHardLinkA(link.c_str(), target.c_str(), NULL) != 0;
+}
+
+// Deletes a directory tree made by the usage benchmark
+static void removeTree(const std::string& dir) {
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA((dir + "\\*").c_str(), &data);
+    if (find != INVALID_HANDLE_VALUE) {
+        do {
+            std::string name = data.cFileName;
+            if (name == "." || name == "..") continue;
+            std::string path = dir + "\\" + name;
+            if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) removeTree(path);
+            else DeleteFileA(path.c_str());
+        } while (FindNextFileA(find, &data));
+        FindClose(find);
+    }
+    RemoveDirectoryA(dir.c_str());
+}
+#else
+static const char kPathSep = '/';
+
+static std::string benchRootPath() {
+    const char* temp = getenv("TMPDIR");
+    char root[4096];
+    snprintf(root, sizeof(root), "%s/diskscan_usage_%lu", temp && *temp ? temp : "/tmp", (unsigned long)getpid());
+    return root;
+}
+
+static bool makeDir(const std::string& path) { return mkdir(path.c_str(), 0755) == 0; }
+
+static bool writeBenchFile(const std::string& path, const char* data, size_t size) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    if (size && write(fd, data, size) < 0) {
+        close(fd);
+        return false;
+    }
+    close(fd);
+    return true;
+}
+
+static bool makeHardLink(const std::string& link, const std::string& target) {
+    return ::link(target.c_str(), link.c_str()) == 0;
+}
+
+// Deletes a directory tree made by the usage benchmark
+static void removeTree(const std::string& dir) {
+    if (DIR* d = opendir(dir.c_str())) {
+        while (struct dirent* e = readdir(d)) {
+            std::string name = e->d_name;
+            if (name == "." || name == "..") continue;
+            std::string path = dir + "/" + name;
+            struct stat st;
+            if (lstat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) removeTree(path);
+            else unlink(path.c_str());
+        }
+        closedir(d);
+    }
+    rmdir(dir.c_str());
+}
+#endif
+
+// "usage_bench [files] [threads]": builds a tree of files under the temp
+// directory (100 top directories, 50 files per leaf, every 64th file 4 KiB,
+// every 500th with a second link), walks it with the one-thread readdir
+// baseline and with the scanner on 1 and on threads threads, then deletes it.
+// Each walk runs with a warm cache, after the tree was just written.
+static int runUsageBench(int files, int threads) {
+    std::string root = benchRootPath();
+    removeTree(root);
+    if (!makeDir(root)) {
+        emitLine("{\"message\":\"cannot create the benchmark tree\"}");
+        return 1;
+    }
+
+    const int kTop = 100, kFilesPerDir = 50;
+    int leaves = (files + kFilesPerDir - 1) / kFilesPerDir;
+    int leavesPerTop = (leaves + kTop - 1) / kTop;
+    char block[4096];
+    memset(block, 'u', sizeof(block));
+    double started = nowMs();
+    int made = 0, links = 0;
+    char name[32];
+    for (int t = 0; t < kTop && made < files; ++t) {
+        sprintf(name, "t%03d", t);
+        std::string top = root + kPathSep + name;
+        makeDir(top);
+        for (int l = 0; l < leavesPerTop && made < files; ++l) {
+            sprintf(name, "d%05d", l);
+            std::string leaf = top + kPathSep + name;
+            makeDir(leaf);
+            for (int f = 0; f < kFilesPerDir && made < files; ++f, ++made) {
+                sprintf(name, "f%02d.dat", f);
+                std::string path = leaf + kPathSep + name;
+                if (!writeBenchFile(path, block, made % 64 == 0 ? sizeof(block) : 0)) continue;
+                if (made % 500 == 0) {
+                    sprintf(name, "f%02d.lnk", f);
+                    if (makeHardLink(leaf + kPathSep + name, path)) ++links;
+                }
+            }
+        }
+    }
+    double createMs = nowMs() - started;
+
+    std::string error;
+    UsageTotals single;
+    WalkSingleThreaded(root, true, single, error);
+
+    UsageOptions options;
+    options.root = root;
+    options.reportMs = 0;
+    options.threads = 1;
+    SpaceUsageScanner one(options);
+    one.run(NULL, NULL, error);
+    options.threads = threads;
+    SpaceUsageScanner many(options);
+    many.run(NULL, NULL, error);
+
+    UsageTotals a = one.totals(), b = many.totals();
+    bool match = single.files == a.files && a.files == b.files && single.dirs == a.dirs && a.dirs == b.dirs &&
+                 a.bytes == b.bytes && a.apparentBytes == b.apparentBytes;
+    char buf[768];
+    sprintf(buf, "{\"bench\":\"usage\",\"files\":%" PRIu64 ",\"dirs\":%" PRIu64 ",\"links\":%d,\"bytes\":%" PRIu64
+            ",\"create_ms\":%.0f,\"single_ms\":%.1f,\"parallel1_ms\":%.1f,\"parallel_ms\":%.1f,\"threads\":%d"
+            ",\"steals\":%" PRIu64 ",\"speedup\":%.2f,\"match\":%s}",
+            b.files, b.dirs, links, b.bytes, createMs, single.elapsedMs, a.elapsedMs, b.elapsedMs, many.threads(),
+            many.steals(), b.elapsedMs > 0 ? single.elapsedMs / b.elapsedMs : 0.0, match ? "true" : "false");
+    emitLine(buf);
+    removeTree(root);
+    return match ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    initOutputLock();
+    startDetached(commandListener, NULL);
+
+    // Usage: diskscan.exe usage <path> [--top N] [--threads N] [--interval ms]
+    //        diskscan.exe usage_bench [files] [threads]
+    if (argc >= 2 && strcmp(argv[1], "usage") == 0) {
+        UsageOptions options;
+#ifdef _WIN32
+        options.root = "C:\\";
+#else
+        options.root = "/";
+#endif
+        for (int i = 2; i < argc; ++i) {
+            if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) options.top = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) options.threads = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) options.reportMs = atoi(argv[++i]);
+            else options.root = argv[i];
+        }
+        return runUsage(options);
+    }
+    if (argc >= 2 && strcmp(argv[1], "usage_bench") == 0) {
+        int files = argc >= 3 ? atoi(argv[2]) : 5000000;
+        int threads = argc >= 4 ? atoi(argv[3]) : 0;
+        return runUsageBench(files > 0 ? files : 5000000, threads);
+    }
+
+    // Determine variant from command line argument
+    // Usage: diskscan.exe [HDD|SSD] [--record <trace> | --replay <trace> [--replay-speed <x|max>]]
+    char variant[10] = "BOTH"; // Default to show both
+    HalOptions halOptions;
+    for (int i = 1; i < argc; ++i) {
+        if (HalParseOption(i, argc, argv, halOptions)) continue;
+        if (strcmp(argv[i], "HDD") == 0 || strcmp(argv[i], "hdd") == 0) {
+            strcpy(variant, "HDD");
+        } else if (strcmp(argv[i], "SSD") == 0 || strcmp(argv[i], "ssd") == 0) {
+            strcpy(variant, "SSD");
+        }
+    }
+
+    // A replay answers from the trace: no administrator check and no disk access
+    HalSession hal;
+    std::string halError;
+    if (!hal.open(halOptions, kHalBlock, halError)) {
+        std::cout << "{\"message\":\"" << escapeJsonString(halError.c_str()) << "\"}" << std::endl;
+        return 1;
+    }
+#ifdef _WIN32
+    LiveBlockSource* liveDisks = NULL;
+    if (!hal.replaying()) liveDisks = new LiveBlockSource(findTargetDisks(variant));
+#else
+    HalSource<BlockSnapshot>* liveDisks = NULL;
+    if (!hal.replaying()) {
+        std::cout << "{\"message\":\"no live disk backend on this platform, use --replay <trace> or usage <path>\"}" << std::endl;
+        return 1;
+    }
+#endif
+    HalSource<BlockSnapshot>* disks = hal.source<BlockSnapshot>(liveDisks, encodeBlockSnapshot, decodeBlockSnapshot);
+
+    // Emit JSON to stdout periodically; every 6th record (30 s) carries "perf"
+    int recordsSincePerf = 0;
+    BlockSnapshot targetDisks;
+    while (disks->read(targetDisks)) {
         std::ostringstream ss;
         ss << "{\"disks\": [";
         for (size_t i = 0; i < targetDisks.size(); ++i) {
-            DiskInfo d = targetDisks[i];
-            
-            // Update memory info with volume space if available
-            char volumePath[256];
-            char fullSpaceInfo[256];
-            if (getVolumeSpaceInfo(d.diskNumber, volumePath, fullSpaceInfo)) {
-                strcpy_s(d.memoryInfo, sizeof(d.memoryInfo), fullSpaceInfo);
-            }
-            
+            const DiskInfo& d = targetDisks[i];
+
             std::string model = escapeJsonString(d.model);
             std::string manufacturer = escapeJsonString(d.manufacturer);
             std::string serial = escapeJsonString(d.serial);
@@ -378,14 +797,19 @@ int main(int argc, char* argv[]) {
             ss << "}";
             if (i + 1 < targetDisks.size()) ss << ",";
         }
-        ss << "]}";
-        std::string out = ss.str();
-        std::cout << out << std::endl;
-        std::cout.flush();
+        ss << "]";
+        if (++recordsSincePerf >= 6) {
+            recordsSincePerf = 0;
+            ss << ",\"perf\":" << PerfStatsJson();
+        }
+        ss << "}";
+        emitLine(ss.str());
         
-        // Sleep for 5 seconds using Windows API for XP compatibility
-        Sleep(5000);
+        // Sleep for 5 seconds (Sleep() on Windows, virtual during a replay)
+        hal.clock().sleepMs(5000);
     }
 
+    std::cerr << hal.summary() << std::endl;
+    delete liveDisks;
     return 0;
 }
\ No newline at end of file
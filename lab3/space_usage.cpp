@@ -0,0 +1,956 @@
+// Space usage analyzer for lab3
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#ifndef __STDC_FORMAT_MACROS
+#define __STDC_FORMAT_MACROS
+#endif
+#include "space_usage.h"
+
+#include <algorithm>
+#include <deque>
+#include <inttypes.h>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utility>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+#ifndef FIND_FIRST_EX_LARGE_FETCH
+#define FIND_FIRST_EX_LARGE_FETCH 2
+#endif
+#endif
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// Locks, atomics and threads; C++98 has none of them
+
+class UsageLock {
+public:
+#ifdef _WIN32
+    UsageLock() { InitializeCriticalSection(&cs_); }
+    ~UsageLock() { DeleteCriticalSection(&cs_); }
+    void lock() { EnterCriticalSection(&cs_); }
+    void unlock() { LeaveCriticalSection(&cs_); }
+private:
+    CRITICAL_SECTION cs_;
+#else
+    UsageLock() { pthread_mutex_init(&mutex_, NULL); }
+    ~UsageLock() { pthread_mutex_destroy(&mutex_); }
+    void lock() { pthread_mutex_lock(&mutex_); }
+    void unlock() { pthread_mutex_unlock(&mutex_); }
+private:
+    pthread_mutex_t mutex_;
+#endif
+    UsageLock(const UsageLock&);
+    UsageLock& operator=(const UsageLock&);
+};
+
+class UsageLockGuard {
+public:
+    explicit UsageLockGuard(UsageLock& lock) : lock_(lock) { lock_.lock(); }
+    ~UsageLockGuard() { lock_.unlock(); }
+private:
+    UsageLockGuard(const UsageLockGuard&);
+    UsageLockGuard& operator=(const UsageLockGuard&);
+    UsageLock& lock_;
+};
+
+inline int64_t atomicAdd(volatile int64_t* value, int64_t delta)
+{
+#ifdef _WIN32
+    return InterlockedExchangeAdd64((volatile LONGLONG*)value, delta);
+#else
+    return __sync_fetch_and_add(value, delta);
+#endif
+}
+
+// A plain 64-bit read can tear in a 32-bit build
+inline int64_t atomicLoad(volatile int64_t* value)
+{
+    return atomicAdd(value, 0);
+}
+
+inline int32_t atomicAdd32(volatile int32_t* value, int32_t delta)
+{
+#ifdef _WIN32
+    return InterlockedExchangeAdd((volatile LONG*)value, delta);
+#else
+    return __sync_fetch_and_add(value, delta);
+#endif
+}
+
+inline void memoryBarrier()
+{
+#if defined(_MSC_VER)
+    MemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+}
+
+double monotonicMs()
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart * 1000.0 / frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+#endif
+}
+
+void sleepMs(int ms)
+{
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    usleep(ms * 1000);
+#endif
+}
+
+void yieldThread()
+{
+#ifdef _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+int cpuCount()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+class UsageThread {
+public:
+    typedef void (*Main)(void* arg);
+
+    UsageThread() : started_(false) {}
+
+    bool start(Main main, void* arg)
+    {
+        main_ = main;
+        arg_ = arg;
+#ifdef _WIN32
+        handle_ = CreateThread(NULL, 0, trampoline, this, 0, NULL);
+        started_ = handle_ != NULL;
+#else
+        started_ = pthread_create(&thread_, NULL, trampoline, this) == 0;
+#endif
+        return started_;
+    }
+
+    void join()
+    {
+        if (!started_) {
+            return;
+        }
+#ifdef _WIN32
+        WaitForSingleObject(handle_, INFINITE);
+        CloseHandle(handle_);
+#else
+        pthread_join(thread_, NULL);
+#endif
+        started_ = false;
+    }
+
+private:
+#ifdef _WIN32
+    static DWORD WINAPI trampoline(LPVOID self)
+    {
+        ((UsageThread*)self)->main_(((UsageThread*)self)->arg_);
+        return 0;
+    }
+    HANDLE handle_;
+#else
+    static void* trampoline(void* self)
+    {
+        ((UsageThread*)self)->main_(((UsageThread*)self)->arg_);
+        return NULL;
+    }
+    pthread_t thread_;
+#endif
+    Main main_;
+    void* arg_;
+    bool started_;
+};
+
+std::string jsonEscape(const std::string& text)
+{
+    std::string out;
+    out.reserve(text.size() + 8);
+    for (size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = (unsigned char)text[i];
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += (char)c;
+        } else if (c < 0x20) {
+            char buf[8];
+            sprintf(buf, "\\u%04x", c);
+            out += buf;
+        } else {
+            out += (char)c;
+        }
+    }
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// Prefix tree of directories
+
+struct UsageNode {
+    uint32_t parent;
+    uint32_t depth;
+    const char* name;               // not terminated; nameLen bytes
+    uint32_t nameLen;
+    volatile int32_t ready;         // set once the fields above are written
+    int64_t selfBytes;              // the directory's own blocks, added when it is read
+    volatile int64_t bytes;         // subtree totals, complete once every
+    volatile int64_t apparentBytes; // directory below has been read
+    volatile int64_t files;
+};
+
+// Nodes live in fixed chunks so an index stays valid while other threads append
+class NodeStore {
+public:
+    static const uint32_t kChunkBits = 16;
+    static const uint32_t kChunkSize = 1u << kChunkBits;
+    static const uint32_t kMaxChunks = 1u << 14;
+    static const uint32_t kNone = 0xffffffffu;
+
+    NodeStore() : count_(0)
+    {
+        chunks_ = new UsageNode* volatile[kMaxChunks];
+        for (uint32_t i = 0; i < kMaxChunks; ++i) chunks_[i] = NULL;
+    }
+
+    ~NodeStore()
+    {
+        for (uint32_t i = 0; i < kMaxChunks; ++i) delete[] chunks_[i];
+        delete[] chunks_;
+    }
+
+    // Index of a new zeroed node, or kNone when the store is full
+    uint32_t allocate()
+    {
+        uint32_t index = (uint32_t)atomicAdd32(&count_, 1);
+        uint32_t chunk = index >> kChunkBits;
+        if (chunk >= kMaxChunks) {
+            return kNone;
+        }
+        if (!chunks_[chunk]) {
+            UsageLockGuard guard(lock_);
+            if (!chunks_[chunk]) {
+                UsageNode* nodes = new UsageNode[kChunkSize];
+                memset(nodes, 0, sizeof(UsageNode) * kChunkSize);
+                memoryBarrier();
+                chunks_[chunk] = nodes;
+            }
+        }
+        return index;
+    }
+
+    // NULL while the chunk is still being allocated
+    UsageNode* get(uint32_t index) const
+    {
+        UsageNode* chunk = chunks_[index >> kChunkBits];
+        return chunk ? &chunk[index & (kChunkSize - 1)] : NULL;
+    }
+
+    uint32_t size() const
+    {
+        uint32_t n = (uint32_t)count_;
+        return std::min(n, kMaxChunks * kChunkSize);
+    }
+
+private:
+    NodeStore(const NodeStore&);
+    NodeStore& operator=(const NodeStore&);
+
+    volatile int32_t count_;
+    UsageNode* volatile* chunks_;
+    UsageLock lock_;
+};
+
+// Names of one thread's nodes, in 1 MiB blocks that are never moved
+class NameArena {
+public:
+    NameArena() : used_(kBlockSize) {}
+    ~NameArena()
+    {
+        for (size_t i = 0; i < blocks_.size(); ++i) free(blocks_[i]);
+    }
+
+    const char* copy(const char* name, size_t length)
+    {
+        if (length > kBlockSize / 4) {
+            char* own = (char*)malloc(length);
+            memcpy(own, name, length);
+            blocks_.push_back(own);
+            return own;
+        }
+        if (used_ + length > kBlockSize) {
+            blocks_.push_back((char*)malloc(kBlockSize));
+            used_ = 0;
+        }
+        char* out = blocks_.back() + used_;
+        memcpy(out, name, length);
+        used_ += length;
+        return out;
+    }
+
+private:
+    static const size_t kBlockSize = 1 << 20;
+    NameArena(const NameArena&);
+    NameArena& operator=(const NameArena&);
+
+    std::vector<char*> blocks_;
+    size_t used_;
+};
+
+// (device, inode) of every multiply linked file seen so far
+class InodeSet {
+public:
+    // False if it was already there
+    bool insert(uint64_t device, uint64_t inode)
+    {
+        Shard& shard = shards_[(inode * 0x9E3779B97F4A7C15ull) >> 58];
+        UsageLockGuard guard(shard.lock);
+        return shard.seen.insert(std::make_pair(device, inode)).second;
+    }
+
+private:
+    struct Shard {
+        UsageLock lock;
+        std::set<std::pair<uint64_t, uint64_t> > seen;
+    };
+    Shard shards_[64];
+};
+
+struct EntryStat {
+    bool isDir;
+    uint64_t device;
+    uint64_t inode;
+    uint64_t links;
+    uint64_t size;
+    uint64_t blocks;    // bytes allocated
+};
+
+#ifndef _WIN32
+volatile int g_noStatx = 0;
+
+// stat of name relative to an open directory, without following links
+bool statEntry(int dirFd, const char* name, EntryStat& st)
+{
+#ifdef STATX_BASIC_STATS
+    if (!g_noStatx) {
+        struct statx sx;
+        if (statx(dirFd, name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT,
+                  STATX_TYPE | STATX_INO | STATX_NLINK | STATX_SIZE | STATX_BLOCKS, &sx) == 0) {
+            st.isDir = S_ISDIR(sx.stx_mode);
+            st.device = ((uint64_t)sx.stx_dev_major << 32) | sx.stx_dev_minor;
+            st.inode = sx.stx_ino;
+            st.links = sx.stx_nlink;
+            st.size = sx.stx_size;
+            st.blocks = sx.stx_blocks * 512;
+            return true;
+        }
+        if (errno != ENOSYS) {
+            return false;
+        }
+        g_noStatx = 1;
+    }
+#endif
+    struct stat s;
+    if (fstatat(dirFd, name, &s, AT_SYMLINK_NOFOLLOW) != 0) {
+        return false;
+    }
+    st.isDir = S_ISDIR(s.st_mode);
+    st.device = ((uint64_t)major(s.st_dev) << 32) | minor(s.st_dev);
+    st.inode = s.st_ino;
+    st.links = s.st_nlink;
+    st.size = s.st_size;
+    st.blocks = (uint64_t)s.st_blocks * 512;
+    return true;
+}
+
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+#endif
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+
+struct SpaceUsageScanner::Impl {
+    struct Worker {
+        Worker() : impl(NULL), index(0), files(0), dirs(0), errors(0), hardlinks(0), steals(0) {}
+
+        Impl* impl;
+        int index;
+        UsageLock lock;
+        std::deque<uint32_t> tasks;     // owner works on the back, thieves take the front
+        NameArena names;
+        std::vector<char> buffer;       // getdents64 batch
+        std::vector<uint32_t> chain;
+        std::string path;
+        UsageThread thread;
+        volatile int64_t files;
+        volatile int64_t dirs;
+        volatile int64_t errors;
+        volatile int64_t hardlinks;
+        volatile int64_t steals;
+    };
+
+    Impl() : outstanding(0), running(0), started(0.0), elapsed(0.0), clusterBytes(4096), rootDevice(0)
+#ifndef _WIN32
+        , rootFd(-1)
+#endif
+    {}
+
+    ~Impl()
+    {
+        for (size_t i = 0; i < workers.size(); ++i) delete workers[i];
+#ifndef _WIN32
+        if (rootFd >= 0) close(rootFd);
+#endif
+    }
+
+    void push(Worker* w, uint32_t node)
+    {
+        atomicAdd32(&outstanding, 1);
+        UsageLockGuard guard(w->lock);
+        w->tasks.push_back(node);
+    }
+
+    bool take(Worker* w, uint32_t& node)
+    {
+        {
+            UsageLockGuard guard(w->lock);
+            if (!w->tasks.empty()) {
+                node = w->tasks.back();
+                w->tasks.pop_back();
+                return true;
+            }
+        }
+        size_t n = workers.size();
+        for (size_t k = 1; k < n; ++k) {
+            Worker* victim = workers[(w->index + k) % n];
+            UsageLockGuard guard(victim->lock);
+            if (!victim->tasks.empty()) {
+                node = victim->tasks.front();
+                victim->tasks.pop_front();
+                atomicAdd(&w->steals, 1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void workerMain(void* arg)
+    {
+        Worker* w = (Worker*)arg;
+        Impl* impl = w->impl;
+        int idle = 0;
+        for (;;) {
+            uint32_t node;
+            if (impl->take(w, node)) {
+                idle = 0;
+                impl->scanDirectory(w, node);
+                atomicAdd32(&impl->outstanding, -1);
+                continue;
+            }
+            // Nothing queued anywhere and nothing being read: the walk is over
+            if (atomicAdd32(&impl->outstanding, 0) == 0) {
+                break;
+            }
+            if (++idle < 64) {
+                yieldThread();
+            } else {
+                sleepMs(1);
+            }
+        }
+        atomicAdd32(&impl->running, -1);
+    }
+
+    // Path of node relative to the root, '/'-separated ("." for the root)
+    void relativePath(Worker* w, uint32_t node)
+    {
+        w->chain.clear();
+        for (uint32_t i = node; i != 0; i = nodes.get(i)->parent) {
+            w->chain.push_back(i);
+        }
+        w->path.clear();
+        if (w->chain.empty()) {
+            w->path = ".";
+            return;
+        }
+        for (size_t k = w->chain.size(); k-- > 0;) {
+            const UsageNode* n = nodes.get(w->chain[k]);
+            if (!w->path.empty()) w->path += '/';
+            w->path.append(n->name, n->nameLen);
+        }
+    }
+
+    // Adds a subdirectory node and queues it
+    void addDirectory(Worker* w, uint32_t parent, const char* name, size_t length, uint64_t selfBytes)
+    {
+        uint32_t index = nodes.allocate();
+        if (index == NodeStore::kNone) {
+            atomicAdd(&w->errors, 1);
+            return;
+        }
+        UsageNode* node = nodes.get(index);
+        node->parent = parent;
+        node->depth = nodes.get(parent)->depth + 1;
+        node->name = w->names.copy(name, length);
+        node->nameLen = (uint32_t)length;
+        node->selfBytes = (int64_t)selfBytes;
+        memoryBarrier();
+        node->ready = 1;
+        atomicAdd(&w->dirs, 1);
+        push(w, index);
+    }
+
+    // Adds what one directory holds directly to it and every ancestor
+    void propagate(uint32_t node, int64_t bytes, int64_t apparent, int64_t files)
+    {
+        for (uint32_t i = node;; ) {
+            UsageNode* n = nodes.get(i);
+            atomicAdd(&n->bytes, bytes);
+            atomicAdd(&n->apparentBytes, apparent);
+            atomicAdd(&n->files, files);
+            if (i == 0) break;
+            i = n->parent;
+        }
+    }
+
+    void scanDirectory(Worker* w, uint32_t node)
+    {
+        UsageNode* self = nodes.get(node);
+        int64_t bytes = self->selfBytes, apparent = 0, files = 0;
+        relativePath(w, node);
+#ifdef _WIN32
+        std::string dir = rootPath;
+        if (w->path != ".") {
+            std::string rel = w->path;
+            std::replace(rel.begin(), rel.end(), '/', '\\');
+            dir += "\\" + rel;
+        }
+        WIN32_FIND_DATAA data;
+        HANDLE find = FindFirstFileExA((dir + "\\*").c_str(), (FINDEX_INFO_LEVELS)1 /* FindExInfoBasic */, &data,
+                                       FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+        if (find == INVALID_HANDLE_VALUE) {
+            atomicAdd(&w->errors, 1);
+        } else {
+            do {
+                const char* name = data.cFileName;
+                if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))) continue;
+                if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                    // Junctions and mounted folders lead elsewhere
+                    if (!(data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+                        addDirectory(w, node, name, strlen(name), 0);
+                    }
+                    continue;
+                }
+                uint64_t size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+                bytes += (int64_t)((size + clusterBytes - 1) / clusterBytes * clusterBytes);
+                apparent += (int64_t)size;
+                ++files;
+            } while (FindNextFileA(find, &data));
+            FindClose(find);
+        }
+#else
+        int fd = node == 0 ? dup(rootFd) : openat(rootFd, w->path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd < 0) {
+            atomicAdd(&w->errors, 1);
+        } else {
+            for (;;) {
+                long n = syscall(SYS_getdents64, fd, &w->buffer[0], w->buffer.size());
+                if (n <= 0) {
+                    if (n < 0) atomicAdd(&w->errors, 1);
+                    break;
+                }
+                // One statx per entry, relative to the open directory, while the buffer is hot
+                for (long pos = 0; pos < n;) {
+                    const LinuxDirent64* e = (const LinuxDirent64*)(&w->buffer[0] + pos);
+                    pos += e->d_reclen;
+                    const char* name = e->d_name;
+                    if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))) continue;
+                    EntryStat st;
+                    if (!statEntry(fd, name, st)) {
+                        atomicAdd(&w->errors, 1);
+                        continue;
+                    }
+                    if (st.isDir) {
+                        if (!oneFileSystem || st.device == rootDevice) {
+                            addDirectory(w, node, name, strlen(name), st.blocks);
+                        }
+                        continue;
+                    }
+                    if (st.links > 1 && !inodes.insert(st.device, st.inode)) {
+                        atomicAdd(&w->hardlinks, 1);
+                        continue;
+                    }
+                    bytes += (int64_t)st.blocks;
+                    apparent += (int64_t)st.size;
+                    ++files;
+                }
+            }
+            close(fd);
+        }
+#endif
+        atomicAdd(&w->files, files);
+        propagate(node, bytes, apparent, files);
+    }
+
+    NodeStore nodes;
+    InodeSet inodes;
+    std::vector<Worker*> workers;
+    volatile int32_t outstanding;   // directories queued or being read
+    volatile int32_t running;       // workers that have not exited
+    double started;
+    double elapsed;
+    uint64_t clusterBytes;
+    uint64_t rootDevice;
+    bool oneFileSystem;
+    std::string rootPath;
+#ifndef _WIN32
+    int rootFd;
+#endif
+};
+
+SpaceUsageScanner::SpaceUsageScanner(const UsageOptions& options)
+    : options_(options), threadCount_(options.threads > 0 ? options.threads : cpuCount()), impl_(new Impl)
+{
+}
+
+SpaceUsageScanner::~SpaceUsageScanner()
+{
+    delete impl_;
+}
+
+bool SpaceUsageScanner::run(UsageReport report, void* context, std::string& error)
+{
+    Impl& impl = *impl_;
+    impl.rootPath = options_.root;
+    while (impl.rootPath.size() > 1 && (impl.rootPath[impl.rootPath.size() - 1] == '/' ||
+                                        impl.rootPath[impl.rootPath.size() - 1] == '\\')) {
+        impl.rootPath.erase(impl.rootPath.size() - 1);
+    }
+    impl.oneFileSystem = options_.oneFileSystem;
+    uint64_t rootBytes = 0;
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(impl.rootPath.c_str());
+    if (attributes == INVALID_FILE_ATTRIBUTES || !(attributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        error = "cannot open " + options_.root;
+        return false;
+    }
+    DWORD sectorsPerCluster = 0, bytesPerSector = 0, freeClusters = 0, totalClusters = 0;
+    std::string volume = impl.rootPath.size() >= 2 && impl.rootPath[1] == ':' ? impl.rootPath.substr(0, 2) + "\\" : std::string();
+    if (GetDiskFreeSpaceA(volume.empty() ? NULL : volume.c_str(), &sectorsPerCluster, &bytesPerSector,
+                          &freeClusters, &totalClusters)) {
+        impl.clusterBytes = (uint64_t)sectorsPerCluster * bytesPerSector;
+    }
+#else
+    impl.rootFd = open(impl.rootPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    EntryStat st;
+    if (impl.rootFd < 0 || !statEntry(AT_FDCWD, impl.rootPath.c_str(), st)) {
+        error = "cannot open " + options_.root + ": " + strerror(errno);
+        return false;
+    }
+    impl.rootDevice = st.device;
+    rootBytes = st.blocks;
+#endif
+
+    uint32_t root = impl.nodes.allocate();
+    UsageNode* node = impl.nodes.get(root);
+    node->parent = root;
+    node->name = impl.rootPath.c_str();
+    node->nameLen = (uint32_t)impl.rootPath.size();
+    node->selfBytes = (int64_t)rootBytes;
+    memoryBarrier();
+    node->ready = 1;
+
+    impl.started = monotonicMs();
+    for (int i = 0; i < threadCount_; ++i) {
+        Impl::Worker* w = new Impl::Worker;
+        w->impl = &impl;
+        w->index = i;
+        w->buffer.resize(64 * 1024);
+        impl.workers.push_back(w);
+    }
+    impl.push(impl.workers[0], root);
+    impl.running = threadCount_;
+    for (int i = 0; i < threadCount_; ++i) {
+        if (!impl.workers[i]->thread.start(Impl::workerMain, impl.workers[i])) {
+            // Its deque is still drained by the others
+            atomicAdd32(&impl.running, -1);
+        }
+    }
+
+    double lastReport = impl.started;
+    while (atomicAdd32(&impl.running, 0) > 0) {
+        sleepMs(options_.reportMs > 0 ? std::min(options_.reportMs, 20) : 20);
+        double now = monotonicMs();
+        if (options_.reportMs > 0 && now - lastReport >= options_.reportMs) {
+            lastReport = now;
+            impl.elapsed = now - impl.started;
+            if (report) report(json(false), context);
+        }
+    }
+    for (int i = 0; i < threadCount_; ++i) {
+        impl.workers[i]->thread.join();
+    }
+    impl.elapsed = monotonicMs() - impl.started;
+    if (report) report(json(true), context);
+    return true;
+}
+
+UsageTotals SpaceUsageScanner::totals() const
+{
+    UsageTotals t;
+    for (size_t i = 0; i < impl_->workers.size(); ++i) {
+        Impl::Worker* w = impl_->workers[i];
+        t.files += (uint64_t)atomicLoad(&w->files);
+        t.dirs += (uint64_t)atomicLoad(&w->dirs);
+        t.errors += (uint64_t)atomicLoad(&w->errors);
+        t.hardlinksSkipped += (uint64_t)atomicLoad(&w->hardlinks);
+    }
+    UsageNode* root = impl_->nodes.size() ? impl_->nodes.get(0) : NULL;
+    if (root) {
+        t.bytes = (uint64_t)atomicLoad(&root->bytes);
+        t.apparentBytes = (uint64_t)atomicLoad(&root->apparentBytes);
+    }
+    t.elapsedMs = impl_->elapsed;
+    return t;
+}
+
+uint64_t SpaceUsageScanner::steals() const
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < impl_->workers.size(); ++i) {
+        total += (uint64_t)atomicLoad(&impl_->workers[i]->steals);
+    }
+    return total;
+}
+
+namespace {
+
+struct HeavierFirst {
+    explicit HeavierFirst(const std::vector<int64_t>& bytes) : bytes_(bytes) {}
+    bool operator()(uint32_t a, uint32_t b) const { return bytes_[a] > bytes_[b]; }
+    const std::vector<int64_t>& bytes_;
+};
+
+} // namespace
+
+std::vector<UsageEntry> SpaceUsageScanner::top(size_t n) const
+{
+    const NodeStore& nodes = impl_->nodes;
+    uint32_t count = nodes.size();
+    std::vector<int64_t> bytes(count, -1), heaviestChild(count, 0);
+    for (uint32_t i = 0; i < count; ++i) {
+        UsageNode* node = nodes.get(i);
+        if (node && node->ready) {
+            bytes[i] = atomicLoad(&node->bytes);
+        }
+    }
+    // A node is allocated after its parent, so parents come first
+    for (uint32_t i = 1; i < count; ++i) {
+        if (bytes[i] >= 0) {
+            uint32_t parent = nodes.get(i)->parent;
+            heaviestChild[parent] = std::max(heaviestChild[parent], bytes[i]);
+        }
+    }
+    std::vector<uint32_t> candidates;
+    for (uint32_t i = 1; i < count; ++i) {
+        if (bytes[i] > 0 && heaviestChild[i] * 10 < bytes[i] * 9) {
+            candidates.push_back(i);
+        }
+    }
+    size_t keep = std::min(n, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + keep, candidates.end(), HeavierFirst(bytes));
+
+    std::vector<UsageEntry> entries;
+    std::vector<uint32_t> chain;
+    for (size_t k = 0; k < keep; ++k) {
+        UsageNode* node = nodes.get(candidates[k]);
+        chain.clear();
+        for (uint32_t i = candidates[k]; i != 0; i = nodes.get(i)->parent) chain.push_back(i);
+        UsageEntry entry;
+        entry.path = impl_->rootPath;
+        for (size_t c = chain.size(); c-- > 0;) {
+            const UsageNode* part = nodes.get(chain[c]);
+#ifdef _WIN32
+            entry.path += '\\';
+#else
+            entry.path += '/';
+#endif
+            entry.path.append(part->name, part->nameLen);
+        }
+        entry.bytes = (uint64_t)bytes[candidates[k]];
+        entry.apparentBytes = (uint64_t)atomicLoad(&node->apparentBytes);
+        entry.files = (uint64_t)atomicLoad(&node->files);
+        entries.push_back(entry);
+    }
+    return entries;
+}
+
+std::string SpaceUsageScanner::json(bool done) const
+{
+    UsageTotals t = totals();
+    std::vector<UsageEntry> heaviest = top((size_t)std::max(0, options_.top));
+    char buf[512];
+    sprintf(buf, "\",\"done\":%s,\"elapsed_ms\":%.1f,\"threads\":%d,\"files\":%" PRIu64
+            ",\"dirs\":%" PRIu64 ",\"bytes\":%" PRIu64 ",\"apparent_bytes\":%" PRIu64 ",\"hardlinks_skipped\":%" PRIu64
+            ",\"errors\":%" PRIu64 ",\"steals\":%" PRIu64 ",\"top\":[",
+            done ? "true" : "false", t.elapsedMs, threadCount_, t.files, t.dirs, t.bytes, t.apparentBytes,
+            t.hardlinksSkipped, t.errors, steals());
+    std::string out = "{\"usage\":{\"root\":\"" + jsonEscape(impl_->rootPath) + buf;
+    for (size_t i = 0; i < heaviest.size(); ++i) {
+        sprintf(buf, "\",\"bytes\":%" PRIu64 ",\"apparent_bytes\":%" PRIu64 ",\"files\":%" PRIu64 "}",
+                heaviest[i].bytes, heaviest[i].apparentBytes, heaviest[i].files);
+        out += i ? ",{\"path\":\"" : "{\"path\":\"";
+        out += jsonEscape(heaviest[i].path);
+        out += buf;
+    }
+    out += "]}}";
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+
+namespace {
+
+#ifdef _WIN32
+void walkDirectory(const std::string& dir, uint64_t cluster, UsageTotals& totals)
+{
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA((dir + "\\*").c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE) {
+        ++totals.errors;
+        return;
+    }
+    do {
+        const char* name = data.cFileName;
+        if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))) continue;
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            if (!(data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+                ++totals.dirs;
+                walkDirectory(dir + "\\" + name, cluster, totals);
+            }
+            continue;
+        }
+        uint64_t size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+        totals.bytes += (size + cluster - 1) / cluster * cluster;
+        totals.apparentBytes += size;
+        ++totals.files;
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+}
+#else
+void walkDirectory(const std::string& dir, dev_t rootDevice, bool oneFileSystem,
+                   std::set<std::pair<uint64_t, uint64_t> >& seen, UsageTotals& totals)
+{
+    DIR* d = opendir(dir.c_str());
+    if (!d) {
+        ++totals.errors;
+        return;
+    }
+    while (struct dirent* e = readdir(d)) {
+        const char* name = e->d_name;
+        if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))) continue;
+        std::string path = dir + "/" + name;
+        struct stat st;
+        if (lstat(path.c_str(), &st) != 0) {
+            ++totals.errors;
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            if (!oneFileSystem || st.st_dev == rootDevice) {
+                ++totals.dirs;
+                totals.bytes += (uint64_t)st.st_blocks * 512;
+                walkDirectory(path, rootDevice, oneFileSystem, seen, totals);
+            }
+            continue;
+        }
+        if (st.st_nlink > 1 && !seen.insert(std::make_pair((uint64_t)st.st_dev, (uint64_t)st.st_ino)).second) {
+            ++totals.hardlinksSkipped;
+            continue;
+        }
+        totals.bytes += (uint64_t)st.st_blocks * 512;
+        totals.apparentBytes += (uint64_t)st.st_size;
+        ++totals.files;
+    }
+    closedir(d);
+}
+#endif
+
+} // namespace
+
+bool WalkSingleThreaded(const std::string& root, bool oneFileSystem, UsageTotals& totals, std::string& error)
+{
+    totals = UsageTotals();
+    double started = monotonicMs();
+#ifdef _WIN32
+    (void)oneFileSystem;
+    DWORD attributes = GetFileAttributesA(root.c_str());
+    if (attributes == INVALID_FILE_ATTRIBUTES || !(attributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        error = "cannot open " + root;
+        return false;
+    }
+    DWORD sectorsPerCluster = 0, bytesPerSector = 0, freeClusters = 0, totalClusters = 0;
+    std::string volume = root.size() >= 2 && root[1] == ':' ? root.substr(0, 2) + "\\" : std::string();
+    uint64_t cluster = 4096;
+    if (GetDiskFreeSpaceA(volume.empty() ? NULL : volume.c_str(), &sectorsPerCluster, &bytesPerSector,
+                          &freeClusters, &totalClusters)) {
+        cluster = (uint64_t)sectorsPerCluster * bytesPerSector;
+    }
+    walkDirectory(root, cluster, totals);
+#else
+    struct stat st;
+    if (lstat(root.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        error = "cannot open " + root;
+        return false;
+    }
+    totals.bytes = (uint64_t)st.st_blocks * 512;
+    std::set<std::pair<uint64_t, uint64_t> > seen;
+    walkDirectory(root, st.st_dev, oneFileSystem, seen, totals);
+#endif
+    totals.elapsedMs = monotonicMs() - started;
+    return true;
+}
@@ -0,0 +1,97 @@
+// Space usage analyzer for lab3 ("diskscan usage <path>")
+//
+// Walks a directory tree on several threads and sums the space it takes, so
+// a full volume can be explained without a separate tool. Every directory
+// becomes a node of a prefix tree (parent index, name, subtree totals);
+// names are copied once into per-thread arenas and paths are rebuilt from
+// the parent chain when needed. Directories are tasks in per-thread deques:
+// a thread takes its newest task (depth first, the directory it just saw),
+// an idle thread steals another's oldest one, which is usually the biggest
+// untouched subtree.
+//
+// Linux opens each directory with openat() relative to the root and reads it
+// with getdents64 into a 64 KiB buffer. There is no batch stat call, so every
+// entry of the buffer gets its own statx() (fstatat() on kernels without
+// statx), relative to the open directory descriptor: one syscall per entry
+// but no path lookup from the root. Sizes are allocated blocks, as du reports
+// them. Files with
+// more than one link are counted once per (device, inode), and the walk stays
+// on the root's file system. Windows lists directories with
+// FindFirstFileEx(FIND_FIRST_EX_LARGE_FETCH); it gives no file ID, so hard
+// links are counted per name, and sizes are rounded up to the cluster size.
+//
+// While the walk runs, a record with the heaviest subtrees so far is reported
+// every reportMs. A directory is left out of that list when one of its
+// children holds at least 90% of it, since the child is the better answer.
+#ifndef SPACE_USAGE_H
+#define SPACE_USAGE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct UsageOptions {
+    UsageOptions() : threads(0), top(10), reportMs(1000), oneFileSystem(true) {}
+
+    std::string root;
+    int threads;            // 0: one per CPU
+    int top;                // subtrees per record
+    int reportMs;           // progress record interval; 0 reports only at the end
+    bool oneFileSystem;     // don't cross into other mounts
+};
+
+struct UsageTotals {
+    UsageTotals() : files(0), dirs(0), bytes(0), apparentBytes(0), hardlinksSkipped(0), errors(0), elapsedMs(0.0) {}
+
+    uint64_t files;
+    uint64_t dirs;
+    uint64_t bytes;             // allocated
+    uint64_t apparentBytes;     // file sizes
+    uint64_t hardlinksSkipped;  // further names of an inode already counted
+    uint64_t errors;            // entries or directories that could not be read
+    double elapsedMs;
+};
+
+struct UsageEntry {
+    std::string path;
+    uint64_t bytes;
+    uint64_t apparentBytes;
+    uint64_t files;
+};
+
+// Receives each JSON record, from the thread that called run()
+typedef void (*UsageReport)(const std::string& json, void* context);
+
+class SpaceUsageScanner {
+public:
+    explicit SpaceUsageScanner(const UsageOptions& options);
+    ~SpaceUsageScanner();
+
+    // Walks options.root; report gets a progress record every reportMs and a
+    // final one with "done":true. False if the root can't be opened.
+    bool run(UsageReport report, void* context, std::string& error);
+
+    UsageTotals totals() const;
+    int threads() const { return threadCount_; }
+    uint64_t steals() const;
+    // Heaviest subtrees, heaviest first
+    std::vector<UsageEntry> top(size_t n) const;
+    // {"usage":{"root":...,"done":...,"files":...,...,"top":[...]}}
+    std::string json(bool done) const;
+
+    struct Impl;
+
+private:
+    SpaceUsageScanner(const SpaceUsageScanner&);
+    SpaceUsageScanner& operator=(const SpaceUsageScanner&);
+
+    UsageOptions options_;
+    int threadCount_;
+    Impl* impl_;
+};
+
+// Recursive readdir + lstat with full paths on one thread, the way a simple
+// du does it; the baseline for the usage benchmark
+bool WalkSingleThreaded(const std::string& root, bool oneFileSystem, UsageTotals& totals, std::string& error);
+
+#endif // SPACE_USAGE_H
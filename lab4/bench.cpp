@@ -0,0 +1,1139 @@
+// Benchmarks of lab4: one JSON record per run on stdout
+#include "bench.h"
+#include "camera_app.h"
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/core/utils/arena.hpp>
+#include <opencv2/core/utils/trace.hpp>
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <iomanip>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#ifdef _WIN32
+#include <direct.h>
+#include <fcntl.h>
+#include <io.h>
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#include <limits.h>
+#endif
+
+#include "frame_timing.h"
+#include "mjpeg_passthrough.h"
+#include "serve_protocol.h"
+#include "status_block.h"
+
+// Бенчмарк serve на файловом источнике: холодный путь одноразового вызова
+// ("main info": инициализация камеры + чтение свойств) против запросов к тёплому серверу.
+// Холодные цифры не включают запуск процесса и загрузку DLL, т.е. это нижняя оценка.
+int run_bench(int requests)
+{
+    if (!file_source()) {
+        std::cerr << "bench требует --source <файл>" << std::endl;
+        return 1;
+    }
+
+    g_serve_mode = true;
+    g_serve_started = std::chrono::steady_clock::now();
+    ServeOutput output;
+    if (g_photos_dir.empty()) {
+        g_photos_dir = exe_directory() + "/bench_photos";
+    }
+    std::vector<std::string> saved_files;
+    g_saved_files = &saved_files;
+
+    LatencyStats cold;
+    for (int i = 0; i < 3; i++) {
+        {
+            std::lock_guard<std::mutex> lock(g_camera_mutex);
+            release_camera_locked();
+        }
+        auto start = std::chrono::steady_clock::now();
+        if (!init_camera()) {
+            std::cerr << "Не удалось открыть источник: " << g_capture_source << std::endl;
+            return 1;
+        }
+        display_camera_info();
+        cold.add(ms_since(start));
+    }
+
+    start_grabber();
+    uint64_t seq = 0;
+    cv::Mat first;
+    wait_fresh_frame(seq, 5000, first);
+    {
+        std::lock_guard<std::mutex> lock(g_stats_mutex);
+        g_command_stats.clear();
+    }
+
+    bool quit = false;
+    int failures = 0;
+    for (int i = 0; i < requests; i++) {
+        const char* cmd = (i % 10 == 9) ? "capture" : (i % 10 == 8) ? "capture raw" : (i % 10 == 4) ? "ping" : "info";
+        std::string reply = handle_serve_line(std::to_string(i) + " " + cmd, quit);
+        if (reply.find("\"ok\":true") == std::string::npos) {
+            failures++;
+        }
+    }
+
+    std::string stats = serve_stats_json();
+    shutdown_serve();
+    for (size_t i = 0; i < saved_files.size(); i++) {
+        std::remove(saved_files[i].c_str());
+    }
+    g_saved_files = nullptr;
+
+    double warm_info_p50 = 0.0;
+    {
+        std::lock_guard<std::mutex> lock(g_stats_mutex);
+        warm_info_p50 = g_command_stats["info"].percentile(50);
+    }
+    std::ostringstream os;
+    os << "{\"bench\":\"serve\",\"source\":\"" << JsonEscape(g_capture_source) << "\""
+       << ",\"requests\":" << requests << ",\"failures\":" << failures
+       << ",\"cold_info\":" << cold.toJson()
+       << ",\"warm\":" << stats
+       << ",\"info_speedup\":" << (warm_info_p50 > 0 ? cold.percentile(50) / warm_info_p50 : 0.0) << "}";
+    emit_line(os.str());
+    return failures ? 2 : 0;
+}
+
+// Проверка блока состояния: писатель обновляет его с частотой 1 кГц, читатели в
+// отдельных отображениях проверяют, что каждый снимок целостный. Писатель кладёт
+// во все счётчики и в имя файла один и тот же номер обновления, так что
+// разорванное чтение сразу видно.
+int run_status_stress(int seconds, int readers)
+{
+    std::string name = g_status_name + "_stress_" + std::to_string(tick_count_ms());
+    StatusBlockWriter writer;
+    if (!writer.open(name)) {
+        std::cout << "{\"error\":\"cannot create status block " << JsonEscape(name) << "\"}" << std::endl;
+        return 1;
+    }
+
+    auto file_for = [](uint64_t n) {
+        return std::string(200, (char)('0' + n % 10)) + std::to_string(n);
+    };
+
+    std::atomic<bool> running{ true };
+    std::atomic<uint64_t> updates{ 0 };
+    std::thread writer_thread([&] {
+        auto next = std::chrono::steady_clock::now();
+        for (uint64_t n = 1; running; n++) {
+            std::string file = file_for(n);
+            writer.update([&](Lab4Status& s) {
+                s.framesGrabbed = s.grabFailures = s.photosSaved = s.periodicPhotos = n;
+                s.lastCaptureUnixMs = n;
+                s.fps = (double)n;
+                s.width = s.height = (int32_t)n;
+                CopyStatusString(s.lastCaptureFile, sizeof(s.lastCaptureFile), file);
+            });
+            updates = n;
+            next += std::chrono::milliseconds(1);
+            std::this_thread::sleep_until(next);
+        }
+    });
+
+    struct ReaderResult {
+        uint64_t reads = 0, retries = 0, torn = 0, backwards = 0, failed = 0;
+        double seconds = 0;
+    };
+    // Второй писатель (как второй serve с тем же именем блока) всё время пытается
+    // захватить блок; пока первый жив, ни одна попытка не должна пройти
+    std::atomic<uint64_t> rival_attempts{ 0 };
+    std::atomic<uint64_t> rival_opened{ 0 };
+    std::thread rival_thread([&] {
+        while (running) {
+            StatusBlockWriter rival;
+            rival_attempts++;
+            if (rival.open(name)) {
+                rival_opened++;
+                rival.update([](Lab4Status& s) { s.framesGrabbed = 0; });
+                rival.close();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    std::vector<ReaderResult> results(readers);
+    std::vector<std::thread> threads;
+    bool open_failed = false;
+    for (int r = 0; r < readers; r++) {
+        std::unique_ptr<StatusBlockReader> reader(new StatusBlockReader());
+        if (!reader->open(name)) {
+            open_failed = true;
+            break;
+        }
+        threads.emplace_back([&, r](std::unique_ptr<StatusBlockReader> own) {
+            ReaderResult& res = results[r];
+            uint64_t last = 0;
+            auto start = std::chrono::steady_clock::now();
+            while (running) {
+                Lab4Status s;
+                unsigned retries = 0;
+                bool ok = own->snapshot(s, 100000, &retries);
+                res.retries += retries;
+                if (!ok) {
+                    res.failed++;
+                    continue;
+                }
+                res.reads++;
+                uint64_t n = s.framesGrabbed;
+                if (s.grabFailures != n || s.photosSaved != n || s.periodicPhotos != n ||
+                    s.lastCaptureUnixMs != n || s.fps != (double)n || s.width != (int32_t)n || s.height != (int32_t)n ||
+                    (n > 0 && std::string(s.lastCaptureFile) != file_for(n))) {
+                    res.torn++;
+                }
+                if (n < last) {
+                    res.backwards++;
+                }
+                last = n;
+            }
+            res.seconds = ms_since(start) / 1000.0;
+        }, std::move(reader));
+    }
+
+    if (!open_failed) {
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    }
+    running = false;
+    writer_thread.join();
+    rival_thread.join();
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    writer.close();
+    if (open_failed) {
+        std::cout << "{\"error\":\"cannot map status block " << JsonEscape(name) << "\"}" << std::endl;
+        return 1;
+    }
+
+    uint64_t torn = 0, backwards = 0, failed = 0;
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(1);
+    os << "{\"bench\":\"status_block\",\"seconds\":" << seconds
+       << ",\"updates\":" << updates.load()
+       << ",\"writer_hz\":" << updates.load() / (double)seconds
+       << ",\"readers\":[";
+    for (int r = 0; r < readers; r++) {
+        const ReaderResult& res = results[r];
+        torn += res.torn;
+        backwards += res.backwards;
+        failed += res.failed;
+        os << (r ? "," : "") << "{\"reads\":" << res.reads
+           << ",\"reads_per_s\":" << (res.seconds > 0 ? res.reads / res.seconds : 0.0)
+           << ",\"ns_per_read\":" << (res.reads ? res.seconds * 1e9 / res.reads : 0.0)
+           << ",\"retries\":" << res.retries
+           << ",\"torn\":" << res.torn << ",\"backwards\":" << res.backwards
+           << ",\"failed\":" << res.failed << "}";
+    }
+    os << "],\"rival_attempts\":" << rival_attempts.load() << ",\"rival_opened\":" << rival_opened.load()
+       << ",\"torn\":" << torn << ",\"backwards\":" << backwards << ",\"failed\":" << failed << "}";
+    std::cout << os.str() << std::endl;
+    return torn || backwards || rival_opened ? 2 : 0;
+}
+
+// Масштабирование multi: 1..max_streams одновременных потоков, каждый кадр кодируется
+// (без улучшения, чтобы мерить именно пул). Источники берутся по кругу из --devices,
+// по умолчанию synthetic:1280x720@30; для каждого числа потоков одна строка JSON.
+int run_multi_bench(int max_streams, int seconds)
+{
+    std::vector<std::string> sources = SplitDeviceSpecs(g_device_list.empty() ? "synthetic:1280x720@30" : g_device_list);
+    for (int n = 1; n <= max_streams; n++) {
+        std::vector<std::string> specs;
+        for (int i = 0; i < n; i++) {
+            specs.push_back(sources[i % sources.size()]);
+        }
+        MultiCaptureOptions options = multi_capture_options();
+        options.encodeEvery = 1;
+        MultiCapture multi(options);
+        std::string error;
+        if (!multi.open(specs, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        auto start = std::chrono::steady_clock::now();
+        multi.start();
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+        multi.stop();
+        double elapsed = ms_since(start) / 1000.0;
+
+        uint64_t grabbed = 0, encoded = 0, drops = 0;
+        double p50_sum = 0.0, worst_p99 = 0.0;
+        std::ostringstream per_stream;
+        for (size_t i = 0; i < multi.size(); i++) {
+            const CaptureDevice& dev = multi.device(i);
+            grabbed += dev.grabbed();
+            encoded += dev.encoded();
+            drops += dev.drops();
+            p50_sum += dev.latencyPercentile(50);
+            worst_p99 = std::max(worst_p99, dev.latencyPercentile(99));
+            per_stream << (i ? "," : "") << dev.encoded() / elapsed;
+        }
+        std::ostringstream os;
+        os << "{\"bench\":\"multi\",\"streams\":" << n << ",\"encoders\":" << multi.encoders()
+           << ",\"seconds\":" << elapsed << ",\"grabbed\":" << grabbed << ",\"encoded\":" << encoded
+           << ",\"drops\":" << drops << ",\"drop_pct\":" << (grabbed ? 100.0 * drops / grabbed : 0.0)
+           << ",\"offered_fps\":" << grabbed / elapsed << ",\"encoded_fps\":" << encoded / elapsed
+           << ",\"per_stream_fps\":[" << per_stream.str() << "]"
+           << ",\"mean_p50_ms\":" << p50_sum / n << ",\"worst_p99_ms\":" << worst_p99 << "}";
+        emit_line(os.str());
+    }
+    return 0;
+}
+
+// Бенчмарк фильтра неизменившихся кадров: синтетическая сцена с шумом сенсора, объект
+// сдвигается в доле (1 - stillness) кадров, кадры идут с шагом 5 с виртуального времени.
+// Для каждой доли неподвижности — сколько кадров прошло фильтр, сколько стоило их
+// кодирование и сколько байт записалось бы, против сохранения всех кадров.
+int run_gate_bench(int frames)
+{
+    const int width = 640, height = 480, step_ms = 5000;
+    ChangeGateOptions options = g_change_gate_options;
+    if (options.threshold <= 0) {
+        options.threshold = 4;
+    }
+
+    cv::Mat scene(height, width, CV_8UC3);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            scene.at<cv::Vec3b>(y, x) = cv::Vec3b((uchar)(x * 200 / width + 20), (uchar)(y * 200 / height + 20), 90);
+        }
+    }
+    cv::rectangle(scene, cv::Rect(60, 300, 160, 120), cv::Scalar(30, 30, 160), cv::FILLED);
+    cv::circle(scene, cv::Point(480, 140), 70, cv::Scalar(200, 220, 60), cv::FILLED);
+    cv::RNG rng(36);
+    std::vector<cv::Mat> noise(8);
+    for (size_t i = 0; i < noise.size(); i++) {
+        noise[i].create(height, width, CV_16SC3);
+        rng.fill(noise[i], cv::RNG::NORMAL, cv::Scalar::all(0), cv::Scalar::all(6));
+    }
+
+    const double stillness[] = { 0.0, 0.5, 0.9, 0.99, 1.0 };
+    for (double still : stillness) {
+        ChangeGate gate(options);
+        cv::RNG motion(7);
+        int object_x = 0, moving = 0, missed = 0;
+        uint64_t bytes_all = 0, bytes_saved = 0;
+        double encode_all_ms = 0, encode_saved_ms = 0, hash_ms = 0;
+        for (int i = 0; i < frames; i++) {
+            bool moved = i > 0 && motion.uniform(0.0, 1.0) >= still;
+            if (moved) {
+                object_x = (object_x + 40) % (width - 120);
+                moving++;
+            }
+            cv::Mat frame;
+            scene.copyTo(frame);
+            cv::rectangle(frame, cv::Rect(object_x, 40, 120, 90), cv::Scalar(240, 240, 240), cv::FILLED);
+            cv::Mat noisy;
+            cv::add(frame, noise[i % noise.size()], noisy, cv::noArray(), CV_8UC3);
+
+            auto hash_start = std::chrono::steady_clock::now();
+            ChangeGate::Decision decision = gate.check(noisy, (int64_t)i * step_ms);
+            hash_ms += ms_since(hash_start);
+            if (decision == ChangeGate::kSkip && moved) {
+                missed++;
+            }
+
+            std::vector<uchar> encoded;
+            auto encode_start = std::chrono::steady_clock::now();
+            cv::imencode(".jpg", noisy, encoded, g_jpeg_params);
+            double encode_ms = ms_since(encode_start);
+            encode_all_ms += encode_ms;
+            bytes_all += encoded.size();
+            if (decision != ChangeGate::kSkip) {
+                encode_saved_ms += encode_ms;
+                bytes_saved += encoded.size();
+            }
+        }
+        std::ostringstream os;
+        os << "{\"bench\":\"change_gate\",\"hash\":\"" << FrameHashName(options.hash) << "\""
+           << ",\"threshold\":" << options.threshold << ",\"heartbeat_ms\":" << options.heartbeatMs
+           << ",\"stillness\":" << still << ",\"frames\":" << frames << ",\"moving\":" << moving
+           << ",\"saved\":" << gate.saved() << ",\"heartbeats\":" << gate.heartbeats()
+           << ",\"missed_changes\":" << missed
+           << ",\"saved_pct\":" << 100.0 * gate.saved() / frames
+           << ",\"hash_ms_per_frame\":" << hash_ms / frames
+           << ",\"encode_ms\":{\"all\":" << encode_all_ms << ",\"gated\":" << encode_saved_ms + hash_ms << "}"
+           << ",\"bytes\":{\"all\":" << bytes_all << ",\"gated\":" << bytes_saved << "}}";
+        emit_line(os.str());
+    }
+    return 0;
+}
+
+// Сквозной бенчмарк конвейера на синтетической камере: захват → проверка → улучшение →
+// JPEG → запись, по стадиям и целиком. Источники без темпа (nopace), так что меряется
+// сам конвейер; --source synthetic:... заменяет набор конфигураций одной своей.
+int run_pipeline_bench(int frames)
+{
+    struct Config {
+        std::string source;
+        bool raw;       // MJPEG passthrough: без декодирования, улучшения и перекодирования
+    };
+    std::vector<Config> configs;
+    if (IsSyntheticSource(g_capture_source)) {
+        configs.push_back(Config{ g_capture_source, g_mjpeg_passthrough });
+    } else {
+        configs.push_back(Config{ "synthetic:640x480@1000:nopace", false });
+        configs.push_back(Config{ "synthetic:1280x720@1000:nopace", false });
+        configs.push_back(Config{ "synthetic:1920x1080@1000:nopace", false });
+        configs.push_back(Config{ "synthetic:1280x720@1000:nopace:mjpg", false });
+        configs.push_back(Config{ "synthetic:1280x720@1000:nopace:mjpg", true });
+    }
+    std::string dir = g_photos_dir.empty() ? exe_directory() + "/bench_photos" : g_photos_dir;
+    ensure_dir(dir);
+
+    int status = 0;
+    for (const Config& config : configs) {
+        // Генератор сам по себе: сколько кадров в секунду он отдаёт
+        double source_fps = 0.0;
+        {
+            HalCapture source(g_hal);
+            if (!source.open(config.source, cv::CAP_ANY)) {
+                std::cerr << "Не удалось открыть источник: " << config.source << std::endl;
+                return 1;
+            }
+            if (config.raw) {
+                source.set(cv::CAP_PROP_FORMAT, -1);
+            }
+            cv::Mat frame;
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < frames; i++) {
+                source.read(frame);
+            }
+            source_fps = frames / (ms_since(start) / 1000.0);
+        }
+
+        HalCapture capture(g_hal);
+        capture.open(config.source, cv::CAP_ANY);
+        if (config.raw && !capture.set(cv::CAP_PROP_FORMAT, -1)) {
+            std::cerr << "Источник не отдаёт MJPEG: " << config.source << std::endl;
+            return 1;
+        }
+        double fps = capture.get(cv::CAP_PROP_FPS);
+        LatencyStats capture_ms, validate_ms, enhance_ms, encode_ms, write_ms, total_ms;
+        uint64_t bytes = 0;
+        int timestamp_errors = 0, invalid = 0, failures = 0;
+        std::vector<std::string> files;
+        auto run_start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; i++) {
+            auto t0 = std::chrono::steady_clock::now();
+            cv::Mat frame;
+            if (!capture.read(frame) || frame.empty()) {
+                failures++;
+                continue;
+            }
+            // Метка кадра n обязана быть ровно n / fps
+            double index = capture.get(cv::CAP_PROP_POS_FRAMES) - 1;
+            if (std::fabs(capture.get(cv::CAP_PROP_POS_MSEC) - index * 1000.0 / fps) > 1e-6 || index != i) {
+                timestamp_errors++;
+            }
+            auto t1 = std::chrono::steady_clock::now();
+            double mean = 0.0, variance = 0.0;
+            if (!validate_frame(frame, mean, variance)) {
+                invalid++;
+            }
+            auto t2 = std::chrono::steady_clock::now();
+            std::vector<uchar> encoded;
+            auto t3 = t2;
+            bool written = false;
+            std::string file = dir + "/pipeline_" + std::to_string(i) + ".jpg";
+            if (config.raw) {
+                written = WriteJpegBuffer(file, frame);
+                bytes += frame.total();
+            } else {
+                cv::ScopedArena arena;
+                cv::Mat enhanced = enhance_frame(frame);
+                t3 = std::chrono::steady_clock::now();
+                cv::imencode(".jpg", enhanced, encoded, g_jpeg_params);
+                bytes += encoded.size();
+            }
+            auto t4 = std::chrono::steady_clock::now();
+            if (!config.raw) {
+                written = write_file(file, encoded);
+            }
+            auto t5 = std::chrono::steady_clock::now();
+            if (!written) {
+                failures++;
+            }
+            files.push_back(file);
+
+            capture_ms.add(ms_since(t0) - ms_since(t1));
+            validate_ms.add(ms_since(t1) - ms_since(t2));
+            if (!config.raw) {
+                enhance_ms.add(ms_since(t2) - ms_since(t3));
+                encode_ms.add(ms_since(t3) - ms_since(t4));
+                write_ms.add(ms_since(t4) - ms_since(t5));
+            } else {
+                write_ms.add(ms_since(t2) - ms_since(t5));
+            }
+            total_ms.add(ms_since(t0) - ms_since(t5));
+        }
+        double seconds = ms_since(run_start) / 1000.0;
+        for (size_t i = 0; i < files.size(); i++) {
+            std::remove(files[i].c_str());
+        }
+
+        std::ostringstream os;
+        os << "{\"bench\":\"pipeline\",\"source\":\"" << JsonEscape(config.source) << "\""
+           << ",\"passthrough\":" << (config.raw ? "true" : "false")
+           << ",\"frames\":" << frames << ",\"source_fps\":" << source_fps
+           << ",\"fps\":" << frames / seconds << ",\"bytes_per_frame\":" << (frames ? bytes / frames : 0)
+           << ",\"stages\":{\"capture\":" << capture_ms.toJson() << ",\"validate\":" << validate_ms.toJson();
+        if (!config.raw) {
+            os << ",\"enhance\":" << enhance_ms.toJson() << ",\"encode\":" << encode_ms.toJson();
+        }
+        os << ",\"write\":" << write_ms.toJson() << "}"
+           << ",\"end_to_end\":" << total_ms.toJson()
+           << ",\"timestamp_errors\":" << timestamp_errors << ",\"invalid_frames\":" << invalid
+           << ",\"failures\":" << failures << "}";
+        emit_line(os.str());
+        if (timestamp_errors || failures) {
+            status = 2;
+        }
+    }
+    return status;
+}
+
+// Один прогон цикла захват → проверка → улучшение → JPEG → запись. Кадр и его стадии
+// размечены областями CV_TRACE_REGION: без активной трассировки они ничего не стоят.
+static double run_capture_encode_loop(const std::string& source, int frames, const std::string& dir,
+                                      LatencyStats& frame_ms, int& failures)
+{
+    HalCapture capture(g_hal);
+    if (!capture.open(source, cv::CAP_ANY)) {
+        failures = frames;
+        return 0.0;
+    }
+    auto run_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        auto t0 = std::chrono::steady_clock::now();
+        CV_TRACE_REGION("frame");
+        cv::Mat frame;
+        bool ok;
+        {
+            CV_TRACE_REGION("capture");
+            ok = capture.read(frame) && !frame.empty();
+        }
+        if (!ok) {
+            failures++;
+            continue;
+        }
+        {
+            CV_TRACE_REGION("validate");
+            double mean = 0.0, variance = 0.0;
+            validate_frame(frame, mean, variance);
+        }
+        std::vector<uchar> encoded;
+        {
+            cv::ScopedArena arena;
+            CV_TRACE_REGION("enhance");
+            cv::Mat enhanced = enhance_frame(frame);
+            CV_TRACE_REGION_NEXT("encode");
+            cv::imencode(".jpg", enhanced, encoded, g_jpeg_params);
+        }
+        {
+            CV_TRACE_REGION("write");
+            std::string file = dir + "/trace_" + std::to_string(i % 8) + ".jpg";
+            if (!write_file(file, encoded)) {
+                failures++;
+            }
+        }
+        frame_ms.add(ms_since(t0));
+    }
+    double seconds = ms_since(run_start) / 1000.0;
+    for (int i = 0; i < 8 && i < frames; i++) {
+        std::remove((dir + "/trace_" + std::to_string(i) + ".jpg").c_str());
+    }
+    return frames / seconds;
+}
+
+// Трасса цикла захват → кодирование в формате Chrome trace-event: файл открывается в
+// chrome://tracing или ui.perfetto.dev, в нём кадры, их стадии, функции OpenCV и полосы
+// parallel_for_ на рабочих потоках. Цикл прогоняется без трассировки и с ней, чтобы
+// видеть её цену; файл трассы остаётся в каталоге фото (--photos-dir).
+int run_trace_bench(int frames)
+{
+    std::string source = IsSyntheticSource(g_capture_source) ? g_capture_source : "synthetic:1280x720@1000:nopace";
+    std::string dir = g_photos_dir.empty() ? exe_directory() + "/bench_photos" : g_photos_dir;
+    ensure_dir(dir);
+    std::string trace_file = dir + "/capture_trace.json";
+
+    // Прогрев: кодек, пул потоков, арены
+    LatencyStats warmup_ms, plain_ms, traced_ms;
+    int failures = 0;
+    run_capture_encode_loop(source, std::min(frames, 20), dir, warmup_ms, failures);
+
+    double plain_fps = run_capture_encode_loop(source, frames, dir, plain_ms, failures);
+    if (!cv::utils::trace::startTraceEventExport(trace_file.c_str())) {
+        std::cerr << "Трассировка недоступна: OpenCV собран без OPENCV_TRACE или не удалось создать "
+                  << trace_file << std::endl;
+        return 1;
+    }
+    double traced_fps = run_capture_encode_loop(source, frames, dir, traced_ms, failures);
+    cv::utils::trace::TraceEventExportStats stats = cv::utils::trace::stopTraceEventExport();
+
+    std::ostringstream os;
+    os << "{\"bench\":\"trace\",\"source\":\"" << JsonEscape(source) << "\""
+       << ",\"frames\":" << frames << ",\"threads\":" << cv::getNumThreads()
+       << ",\"fps_untraced\":" << plain_fps << ",\"fps_traced\":" << traced_fps
+       << ",\"overhead_pct\":" << (traced_fps > 0.0 ? (plain_fps / traced_fps - 1.0) * 100.0 : 0.0)
+       << ",\"frame_untraced\":" << plain_ms.toJson() << ",\"frame_traced\":" << traced_ms.toJson()
+       << ",\"events\":" << stats.events << ",\"events_per_frame\":" << (frames ? (double)stats.events / frames : 0.0)
+       << ",\"dropped\":" << stats.dropped << ",\"trace_bytes\":" << stats.bytes
+       << ",\"trace_file\":\"" << JsonEscape(trace_file) << "\""
+       << ",\"failures\":" << failures << "}";
+    emit_line(os.str());
+    return failures ? 2 : 0;
+}
+
+// Бенчмарк серийной съёмки на источнике 60 fps (по умолчанию синтетическая камера
+// 1280x720@60, или --source): отложенное кодирование на одном и на всех кодировщиках
+// против кодирования прямо в цикле захвата. Первый прогон выделяет арену, остальные
+// обходятся без выделений.
+int run_burst_bench(int frames)
+{
+    std::string source = IsSyntheticSource(g_capture_source) || file_source() ? g_capture_source : "synthetic:1280x720@60";
+    bool pace = !IsSyntheticSource(source);
+    std::string dir = g_photos_dir.empty() ? exe_directory() + "/bench_photos" : g_photos_dir;
+    ensure_dir(dir);
+    int pool = g_multi_options.encoders > 0 ? g_multi_options.encoders : std::max(1, (int)std::thread::hardware_concurrency());
+
+    struct Run {
+        const char* mode;
+        BurstKeep keep;
+        int encoders;
+        bool inlineEncode;
+    };
+    const Run runs[] = {
+        { "deferred", BurstKeep::kBest, pool, false },
+        { "deferred", BurstKeep::kAll, 1, false },
+        { "deferred", BurstKeep::kAll, pool, false },
+        { "inline", BurstKeep::kAll, 1, true },
+    };
+
+    int status = 0;
+    std::lock_guard<std::mutex> burst_lock(g_burst_mutex);
+    for (const Run& run : runs) {
+        HalCapture camera(g_hal);
+        if (!camera.open(source, cv::CAP_ANY)) {
+            std::cerr << "Не удалось открыть источник: " << source << std::endl;
+            return 1;
+        }
+        if (g_mjpeg_passthrough) {
+            camera.set(cv::CAP_PROP_FORMAT, -1);
+        }
+        BurstOptions options;
+        options.frames = frames;
+        options.keep = run.keep;
+        options.encoders = run.encoders;
+        options.inlineEncode = run.inlineEncode;
+        options.index = false;
+        BurstResult result;
+        std::string prefix = dir + "/burst_bench_";
+        auto start = std::chrono::steady_clock::now();
+        if (!capture_burst_locked(camera, pace, options, prefix, result)) {
+            std::cerr << result.error << std::endl;
+            return 1;
+        }
+        if (!run.inlineEncode) {
+            encode_burst(options, prefix, result);
+        } else {
+            result.encoders = 1;
+        }
+        double total_ms = ms_since(start);
+        for (size_t i = 0; i < result.files.size(); i++) {
+            std::remove(result.files[i].c_str());
+        }
+
+        std::ostringstream os;
+        os << "{\"bench\":\"burst\",\"source\":\"" << JsonEscape(source) << "\",\"mode\":\"" << run.mode << "\""
+           << ",\"keep\":\"" << BurstKeepName(run.keep) << "\",\"encoders\":" << result.encoders
+           << ",\"frames\":" << result.frames << ",\"source_fps\":" << result.sourceFps << ",\"fps\":" << result.fps
+           << ",\"dropped\":" << result.dropped << ",\"interval\":" << result.intervals.toJson()
+           << ",\"capture_ms\":" << result.captureMs << ",\"score_ms\":" << result.scoreMs
+           << ",\"encode_ms\":" << result.encodeMs << ",\"total_ms\":" << total_ms
+           << ",\"arena_bytes\":" << result.arenaBytes << ",\"arena_allocations\":" << result.arenaAllocations
+           << ",\"out_of_place\":" << result.outOfPlace << ",\"best\":" << SharpestFrame(result.scores)
+           << ",\"files\":" << result.files.size() << "}";
+        emit_line(os.str());
+        if (!result.error.empty()) {
+            std::cerr << result.error << std::endl;
+            status = 2;
+        }
+    }
+    return status;
+}
+
+// Жёсткая ссылка: каталог на 100 тысяч фото без 100 тысяч копий на диске
+static bool link_file(const std::string& from, const std::string& to)
+{
+#ifdef _WIN32
+    return CreateHardLinkA(to.c_str(), from.c_str(), NULL) != 0;
+#else
+    return link(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+static void remove_dir(const std::string& dir)
+{
+#ifdef _WIN32
+    _rmdir(dir.c_str());
+#else
+    rmdir(dir.c_str());
+#endif
+}
+
+// Бенчмарк индекса фото на каталоге из count снимков 1280x720 (жёсткие ссылки на
+// один файл): построение индекса сканированием, загрузка готового индекса, листинг
+// страницы, превью — первое (уменьшенное декодирование файла) и из кэша — против
+// полного декодирования оригинала, и добавление нового снимка с превью.
+int run_index_bench(int count)
+{
+    std::string base = g_photos_dir.empty() ? exe_directory() + "/bench_photos" : g_photos_dir;
+    ensure_dir(base);
+    std::string dir = base + "/index_bench_" + std::to_string(tick_count_ms());
+    ensure_dir(dir);
+
+    cv::Mat frame;
+    {
+        HalCapture source(g_hal);
+        if (!source.open("synthetic:1280x720:pattern=checker", cv::CAP_ANY) || !source.read(frame)) {
+            std::cerr << "Не удалось получить кадр синтетической камеры" << std::endl;
+            return 1;
+        }
+    }
+    std::vector<uchar> encoded;
+    cv::imencode(".jpg", frame, encoded, g_jpeg_params);
+    // ext4 allows 65000 links per inode, so every 50000 names get their own copy
+    const int kLinksPerSeed = 50000;
+    std::vector<std::string> seeds;
+
+    std::vector<std::string> names;
+    names.reserve(count);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        if (i % kLinksPerSeed == 0) {
+            seeds.push_back(dir + "/seed" + std::to_string(seeds.size()) + ".tmp");
+            write_file(seeds.back(), encoded);
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "photo_bench_%07d.jpg", i);
+        if (!link_file(seeds.back(), dir + "/" + name)) {
+            std::cerr << "Не удалось создать " << name << std::endl;
+            break;
+        }
+        names.push_back(name);
+    }
+    double populate_ms = ms_since(start);
+
+    // Первый запуск: индекса нет, каталог сканируется
+    PhotoIndex index;
+    std::string error;
+    start = std::chrono::steady_clock::now();
+    bool ok = index.open(dir, error);
+    double build_ms = ms_since(start);
+
+    // Следующие запуски читают готовый индекс
+    start = std::chrono::steady_clock::now();
+    ok = ok && index.open(dir, error);
+    double load_ms = ms_since(start);
+
+    start = std::chrono::steady_clock::now();
+    size_t rescanned = index.rebuild();
+    double rescan_ms = ms_since(start);
+
+    cv::RNG rng(12345);
+    const int samples = 200;
+    LatencyStats list_ms, cold_ms, warm_ms, full_ms, add_ms;
+    size_t listed = 0;
+    for (int i = 0; i < samples; i++) {
+        size_t offset = (size_t)rng.uniform(0, std::max(1, (int)names.size() - 50));
+        auto t = std::chrono::steady_clock::now();
+        listed += index.list(offset, 50).size();
+        list_ms.add(ms_since(t));
+    }
+    int preview_failures = 0;
+    for (int i = 0; i < samples && !names.empty(); i++) {
+        const std::string& name = names[rng.uniform(0, (int)names.size())];
+        std::string path;
+        bool generated = false;
+
+        // Что делал интерфейс: полное декодирование оригинала и уменьшение
+        auto t = std::chrono::steady_clock::now();
+        cv::Mat full = cv::imread(dir + "/" + name, cv::IMREAD_COLOR);
+        FitPreview(full, PhotoIndex::kPreviewSide);
+        full_ms.add(ms_since(t));
+
+        t = std::chrono::steady_clock::now();
+        bool made = index.preview(name, path, generated, error);
+        double ms = ms_since(t);
+        if (made && generated) {
+            cold_ms.add(ms);
+        }
+        // Из кэша: путь из индекса и чтение готового файла превью
+        t = std::chrono::steady_clock::now();
+        std::ifstream cached(path.c_str(), std::ios::binary);
+        std::vector<char> bytes((std::istreambuf_iterator<char>(cached)), std::istreambuf_iterator<char>());
+        made = made && index.preview(name, path, generated, error) && !generated && !bytes.empty();
+        warm_ms.add(ms_since(t));
+        if (!made) {
+            preview_failures++;
+        }
+    }
+    // Новый снимок: превью из только что закодированного кадра, без чтения файла
+    for (int i = 0; i < samples; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "photo_new_%05d.jpg", i);
+        std::string path = dir + "/" + name;
+        write_file(path, encoded);
+        auto t = std::chrono::steady_clock::now();
+        index.add(path, frame, (int64_t)unix_time_ms());
+        add_ms.add(ms_since(t));
+        names.push_back(name);
+    }
+
+    std::ostringstream os;
+    os << "{\"bench\":\"photo_index\",\"photos\":" << rescanned << ",\"populate_ms\":" << populate_ms
+       << ",\"build_ms\":" << build_ms << ",\"load_ms\":" << load_ms << ",\"rescan_ms\":" << rescan_ms
+       << ",\"rescanned\":" << rescanned << ",\"list\":" << list_ms.toJson() << ",\"listed\":" << listed
+       << ",\"preview_full_decode\":" << full_ms.toJson() << ",\"preview_cold\":" << cold_ms.toJson()
+       << ",\"preview_cached\":" << warm_ms.toJson() << ",\"add\":" << add_ms.toJson()
+       << ",\"indexed\":" << index.size() << ",\"preview_failures\":" << preview_failures << "}";
+    emit_line(os.str());
+
+    for (size_t i = 0; i < names.size(); i++) {
+        std::remove((dir + "/" + names[i]).c_str());
+        std::remove((dir + "/previews/" + names[i]).c_str());
+    }
+    for (size_t i = 0; i < seeds.size(); i++) {
+        std::remove(seeds[i].c_str());
+    }
+    std::remove((dir + "/photo_index.tsv").c_str());
+    remove_dir(dir + "/previews");
+    remove_dir(dir);
+    return ok && preview_failures == 0 ? 0 : 2;
+}
+
+// Бенчмарк анализатора тайминга: синтетическая камера 30 fps, теряющая каждый 7-й кадр
+// и отдающая кадры с задержкой до 4 мс (или --source; видеофайл выдаётся с его частотой).
+// Выведенные пропуски сравниваются с известными (разрыв в номерах кадров по
+// CAP_PROP_POS_MSEC), джиттер — по времени бэкенда и только по часам хоста; плюс цена
+// одной записи в кольцо.
+int run_timing_bench(int seconds)
+{
+    std::string source = IsSyntheticSource(g_capture_source) || file_source() ? g_capture_source
+                                                                              : "synthetic:640x480@30:noise=0:drop=7:jitter=4";
+    HalCapture camera(g_hal);
+    if (!camera.open(source, cv::CAP_ANY)) {
+        std::cerr << "Не удалось открыть источник: " << source << std::endl;
+        return 1;
+    }
+    double fps = camera.get(cv::CAP_PROP_FPS);
+    FrameTimingAnalyzer backend;
+    FrameTimingAnalyzer host;
+    backend.reset(fps);
+    host.reset(fps);
+    // Файл отдаёт кадры со скоростью декодера: выдаём их с его частотой, как
+    // граббер, иначе fps показал бы скорость декодирования, а не источника
+    bool pace = !IsSyntheticSource(source) && !g_hal.replaying() && fps > 0.0;
+    auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(pace ? 1.0 / fps : 0.0));
+
+    long long first_index = -1;
+    long long last_index = -1;
+    long long delivered = 0;
+    cv::Mat frame;
+    auto start = std::chrono::steady_clock::now();
+    auto next = start;
+    while (ms_since(start) < seconds * 1000.0 && camera.read(frame)) {
+        int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now().time_since_epoch()).count();
+        double pos_ms = camera.get(cv::CAP_PROP_POS_MSEC);
+        backend.record(now_ns, pos_ms);
+        host.record(now_ns, -1.0);
+        long long index = fps > 0 ? std::llround(pos_ms * fps / 1000.0) : 0;
+        if (first_index < 0) {
+            first_index = index;
+        }
+        last_index = index;
+        delivered++;
+        // Сливаем кольцо так же, как это делает ответ на info
+        if (delivered % 256 == 0) {
+            backend.stats();
+            host.stats();
+        }
+        if (pace) {
+            next += interval;
+            std::this_thread::sleep_until(next);
+        }
+    }
+    long long injected = first_index >= 0 ? (last_index - first_index + 1) - delivered : 0;
+    FrameTimingStats b = backend.stats();
+
+    // Цена записи: пачки меньше ёмкости кольца, между пачками кольцо сливается
+    FrameTimingAnalyzer cost;
+    const int kBatch = 4000;
+    const int kBatches = 250;
+    double push_ms = 0.0;
+    for (int i = 0; i < kBatches; i++) {
+        auto push_start = std::chrono::steady_clock::now();
+        for (int j = 0; j < kBatch; j++) {
+            cost.record((int64_t)(i * kBatch + j) * 33333333, (i * kBatch + j) * 33.333);
+        }
+        push_ms += ms_since(push_start);
+        cost.stats();
+    }
+
+    std::ostringstream os;
+    os << "{\"bench\":\"timing\",\"source\":\"" << JsonEscape(source) << "\",\"seconds\":" << seconds
+       << ",\"delivered\":" << delivered << ",\"injected_drops\":" << injected
+       << ",\"backend\":" << backend.json() << ",\"host\":" << host.json()
+       << ",\"push_ns\":" << push_ms * 1e6 / ((double)kBatch * kBatches) << "}";
+    emit_line(os.str());
+    // Пропуски по часам бэкенда должны совпасть с внесёнными
+    return b.dropped == (uint64_t)std::max(0LL, injected) ? 0 : 2;
+}
+
+// Процессорное время процесса и текущего потока, мс
+static double process_cpu_ms()
+{
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user);
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime; u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) / 1e4;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+#endif
+}
+
+static double thread_cpu_ms()
+{
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user);
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime; u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) / 1e4;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+#endif
+}
+
+// Поток вывода в дескриптор канала ОС, без буфера: запись уходит сразу
+class FdOutBuf : public std::streambuf {
+public:
+    explicit FdOutBuf(int fd) : fd_(fd) {}
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        if (c == traits_type::eof()) {
+            return traits_type::not_eof(c);
+        }
+        char ch = (char)c;
+        return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+    }
+    std::streamsize xsputn(const char* data, std::streamsize n) override
+    {
+        std::streamsize done = 0;
+        while (done < n) {
+#ifdef _WIN32
+            int w = _write(fd_, data + done, (unsigned)(n - done));
+#else
+            ssize_t w = write(fd_, data + done, (size_t)(n - done));
+#endif
+            if (w <= 0) {
+                break;
+            }
+            done += w;
+        }
+        return done;
+    }
+
+private:
+    int fd_;
+};
+
+// Бенчмарк живого предпросмотра 720p30 (синтетическая камера или --source) через
+// настоящий канал ОС: граббер -> кодирование -> канал -> потребитель, который разбирает
+// записи, декодирует JPEG, как это сделал бы UI, и подтверждает кадр. Задержка — от
+// получения кадра граббером до конца декодирования у потребителя; CPU — время процесса
+// без потока потребителя, с предпросмотром и только с граббером. Второй прогон:
+// потребитель тратит на кадр 100 мс, уровень должен опуститься до того, что он успевает.
+int run_live_bench(int seconds)
+{
+    if (!file_source()) {
+        g_capture_source = "synthetic:1280x720@30";
+    }
+    int fds[2];
+#ifdef _WIN32
+    if (_pipe(fds, 1 << 16, _O_BINARY) != 0) {
+#else
+    if (pipe(fds) != 0) {
+#endif
+        std::cerr << "Не удалось создать канал" << std::endl;
+        return 1;
+    }
+    FdOutBuf pipe_buf(fds[1]);
+    std::ostream pipe_out(&pipe_buf);
+
+    g_serve_mode = true;
+    g_serve_started = std::chrono::steady_clock::now();
+    ServeOutput output;
+    if (!init_camera()) {
+        std::cerr << "Не удалось открыть источник: " << g_capture_source << std::endl;
+        return 1;
+    }
+    start_grabber();
+    std::ostream* replies = g_reply_out;
+    {
+        std::lock_guard<std::mutex> lock(g_reply_mutex);
+        g_reply_out = &pipe_out;
+    }
+
+    // Потребитель: заголовок до \n, bytes байт JPEG, \n; подтверждение как от UI
+    std::atomic<int> consumer_delay_ms{ 0 };
+    std::atomic<bool> consuming{ true };
+    std::mutex consumer_mutex;
+    LatencyStats latency;
+    uint64_t frames = 0, bytes = 0;
+    int last_side = 0;
+    std::atomic<double> consumer_cpu_ms{ 0.0 };
+    std::thread consumer([&] {
+        std::vector<char> buf;
+        size_t start = 0;
+        char chunk[1 << 16];
+        bool quit = false;
+        for (;;) {
+#ifdef _WIN32
+            int n = _read(fds[0], chunk, sizeof(chunk));
+#else
+            ssize_t n = read(fds[0], chunk, sizeof(chunk));
+#endif
+            if (n <= 0) {
+                break;
+            }
+            buf.insert(buf.end(), chunk, chunk + n);
+            for (;;) {
+                auto nl = std::find(buf.begin() + start, buf.end(), '\n');
+                if (nl == buf.end()) {
+                    break;
+                }
+                std::string header(buf.begin() + start, nl);
+                size_t body = (size_t)(nl - buf.begin()) + 1;
+                size_t at = header.find("\"bytes\":");
+                if (header.find("\"event\":\"live\"") == std::string::npos || at == std::string::npos) {
+                    start = body;
+                    continue;
+                }
+                size_t size = strtoull(header.c_str() + at + 8, nullptr, 10);
+                if (buf.size() < body + size + 1) {
+                    break;
+                }
+                cv::Mat jpeg(1, (int)size, CV_8UC1, &buf[body]);
+                cv::Mat shown = cv::imdecode(jpeg, cv::IMREAD_COLOR);
+                if (consumer_delay_ms > 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(consumer_delay_ms.load()));
+                }
+                double t_ms = atof(header.c_str() + header.find("\"t_ms\":") + 7);
+                {
+                    std::lock_guard<std::mutex> lock(consumer_mutex);
+                    if (consuming) {
+                        latency.add(ms_since(g_serve_started) - t_ms);
+                        frames++;
+                        bytes += size;
+                        last_side = std::max(shown.cols, shown.rows);
+                    }
+                }
+                handle_serve_line("ack live_ack " + header.substr(header.find("\"seq\":") + 6), quit);
+                start = body + size + 1;
+            }
+            if (start > 0) {
+                buf.erase(buf.begin(), buf.begin() + start);
+                start = 0;
+            }
+            consumer_cpu_ms = thread_cpu_ms();
+        }
+    });
+
+    auto run = [&](const char* name, bool live, int delay_ms) {
+        consumer_delay_ms = delay_ms;
+        if (live) {
+            start_live(1280);
+        }
+        {
+            std::lock_guard<std::mutex> lock(consumer_mutex);
+            latency = LatencyStats();
+            frames = bytes = 0;
+            consuming = true;
+        }
+        double cpu_start = process_cpu_ms() - consumer_cpu_ms;
+        auto start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+        double wall_ms = ms_since(start);
+        double cpu_ms = process_cpu_ms() - consumer_cpu_ms - cpu_start;
+        std::string rate = live_json();
+        std::ostringstream os;
+        {
+            std::lock_guard<std::mutex> lock(consumer_mutex);
+            consuming = false;
+            os << "{\"bench\":\"live\",\"run\":\"" << name << "\",\"source\":\"" << JsonEscape(g_capture_source)
+               << "\",\"seconds\":" << seconds << ",\"consumer_delay_ms\":" << delay_ms
+               << ",\"cpu_pct\":" << cpu_ms * 100.0 / wall_ms << ",\"frames\":" << frames
+               << ",\"fps\":" << frames * 1000.0 / wall_ms << ",\"kbps\":" << (int)(bytes * 8.0 / wall_ms)
+               << ",\"side\":" << last_side << ",\"latency\":" << latency.toJson() << ",\"live\":" << rate << "}";
+        }
+        stop_live();
+        // Ответы сервера идут в канал, запись замера — сразу в настоящий stdout
+        std::lock_guard<std::mutex> lock(g_reply_mutex);
+        *replies << os.str() << std::endl;
+    };
+
+    run("grabber_only", false, 0);
+    run("fast_consumer", true, 0);
+    run("slow_consumer", true, 100);
+
+    {
+        std::lock_guard<std::mutex> lock(g_reply_mutex);
+        g_reply_out = replies;
+    }
+#ifdef _WIN32
+    _close(fds[1]);
+#else
+    close(fds[1]);
+#endif
+    consumer.join();
+#ifdef _WIN32
+    _close(fds[0]);
+#else
+    close(fds[0]);
+#endif
+    stop_grabber();
+    {
+        std::lock_guard<std::mutex> lock(g_camera_mutex);
+        release_camera_locked();
+    }
+    return 0;
+}
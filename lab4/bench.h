@@ -0,0 +1,32 @@
+// Benchmarks of lab4
+//
+// Each command prints one JSON record per run on stdout and returns the
+// process exit code: 0, 1 when the bench could not start, 2 when a check
+// inside the bench failed. Sources default to the synthetic camera; most
+// benches take --source instead.
+#ifndef BENCH_H
+#define BENCH_H
+
+// serve: cold one-shot info against requests to the warm server (needs --source)
+int run_bench(int requests);
+// status_block: seqlock readers against a 1 kHz writer, while a second writer keeps
+// trying to claim the block
+int run_status_stress(int seconds, int readers);
+// multi: 1..max_streams devices on the shared encoder pool
+int run_multi_bench(int max_streams, int seconds);
+// gate: frames and bytes the change gate saves by scene stillness
+int run_gate_bench(int frames);
+// pipeline: capture, enhance and encode stages per source configuration
+int run_pipeline_bench(int frames);
+// trace: Chrome trace of the capture and encode loop, and what tracing costs
+int run_trace_bench(int frames);
+// burst: arena burst capture against encoding inside the capture loop
+int run_burst_bench(int frames);
+// index: photo index scan, lookups and preview cache over count files
+int run_index_bench(int count);
+// timing: drops and jitter the frame timing analyzer infers
+int run_timing_bench(int seconds);
+// live: live preview rate with a fast and a slow consumer
+int run_live_bench(int seconds);
+
+#endif // BENCH_H
@@ -0,0 +1,94 @@
+// Burst capture for lab4
+#include "burst_capture.h"
+
+#include <opencv2/imgproc.hpp>
+
+#include <cstring>
+
+bool ParseBurstKeep(const std::string& name, BurstKeep& keep)
+{
+    if (name == "best") {
+        keep = BurstKeep::kBest;
+        return true;
+    }
+    if (name == "all") {
+        keep = BurstKeep::kAll;
+        return true;
+    }
+    return false;
+}
+
+const char* BurstKeepName(BurstKeep keep)
+{
+    return keep == BurstKeep::kAll ? "all" : "best";
+}
+
+void FrameArena::reserve(int count, const cv::Mat& sample, bool raw, cv::Size pixelSize)
+{
+    size_t need = raw ? (size_t)pixelSize.area() * 3 : sample.total() * sample.elemSize();
+    if (raw != raw_ || need > slotBytes_ || (!raw && (sample.size() != size_ || sample.type() != type_))) {
+        slots_.clear();
+        slotBytes_ = need;
+    }
+    raw_ = raw;
+    size_ = raw ? pixelSize : sample.size();
+    type_ = sample.type();
+    while ((int)slots_.size() < count) {
+        Slot slot;
+        slot.buffer.create(1, (int)slotBytes_, CV_8UC1);
+        allocations_++;
+        slots_.push_back(slot);
+    }
+    // A shorter burst leaves the extra buffers for the next long one
+    for (int i = 0; i < count; i++) {
+        rewind(i);
+    }
+}
+
+void FrameArena::rewind(int i)
+{
+    Slot& slot = slots_[i];
+    slot.view = raw_ ? slot.buffer.colRange(0, 0) : cv::Mat(size_, type_, slot.buffer.data);
+}
+
+bool FrameArena::storeRaw(int i, const cv::Mat& buffer)
+{
+    Slot& slot = slots_[i];
+    size_t bytes = buffer.total() * buffer.elemSize();
+    if (bytes > slotBytes_ || !buffer.isContinuous()) {
+        return false;
+    }
+    std::memcpy(slot.buffer.data, buffer.data, bytes);
+    slot.view = slot.buffer.colRange(0, (int)bytes);
+    return true;
+}
+
+double SharpnessScore(const cv::Mat& pixels)
+{
+    if (pixels.empty()) {
+        return 0.0;
+    }
+    cv::Mat gray, laplacian;
+    if (pixels.channels() == 3) {
+        cv::cvtColor(pixels, gray, cv::COLOR_BGR2GRAY);
+    } else if (pixels.channels() == 4) {
+        cv::cvtColor(pixels, gray, cv::COLOR_BGRA2GRAY);
+    } else {
+        gray = pixels;
+    }
+    cv::Laplacian(gray, laplacian, CV_16S);
+    cv::Scalar mean, stddev;
+    cv::meanStdDev(laplacian, mean, stddev);
+    return stddev[0] * stddev[0];
+}
+
+int SharpestFrame(const std::vector<double>& scores)
+{
+    int best = -1;
+    for (size_t i = 0; i < scores.size(); i++) {
+        if (best < 0 || scores[i] > scores[best]) {
+            best = (int)i;
+        }
+    }
+    return best;
+}
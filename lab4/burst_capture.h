@@ -0,0 +1,71 @@
+// Burst capture for lab4
+//
+// A burst reads N frames back to back at the camera's own rate into a
+// FrameArena: one buffer per frame, allocated before the burst and kept for
+// the next burst of the same format, so the capture loop only reads. Scoring
+// and encoding wait until the last frame is in, which keeps their cost out
+// of the frame intervals. Frames are scored by the variance of the Laplacian
+// of a grayscale copy (blur flattens edges, so a lower score is a softer
+// frame); a burst keeps either the sharpest frame or all of them.
+#ifndef BURST_CAPTURE_H
+#define BURST_CAPTURE_H
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class BurstKeep {
+    kBest,
+    kAll
+};
+
+// "best" or "all"; false for anything else
+bool ParseBurstKeep(const std::string& name, BurstKeep& keep);
+const char* BurstKeepName(BurstKeep keep);
+
+class FrameArena {
+public:
+    // Makes room for count frames shaped like sample: decoded frames of its
+    // size and type or, for compressed buffers (raw), up to 3 bytes per pixel
+    // of pixelSize. Buffers that already fit are kept.
+    void reserve(int count, const cv::Mat& sample, bool raw, cv::Size pixelSize);
+
+    int capacity() const { return (int)slots_.size(); }
+    bool raw() const { return raw_; }
+
+    // Header over slot i's buffer; a decoded frame is read straight into it
+    cv::Mat& slot(int i) { return slots_[i].view; }
+    // Copies a compressed frame into slot i; false if it does not fit
+    bool storeRaw(int i, const cv::Mat& buffer);
+    // False once a read replaced slot i's header with a Mat of its own
+    // (the frame changed size or type), i.e. the read allocated
+    bool inPlace(int i) const { return slots_[i].view.data == slots_[i].buffer.data; }
+    // Points slot i back at its buffer
+    void rewind(int i);
+
+    size_t bytes() const { return slotBytes_ * slots_.size(); }
+    uint64_t allocations() const { return allocations_; }
+
+private:
+    struct Slot {
+        cv::Mat buffer;     // slotBytes_ contiguous bytes
+        cv::Mat view;       // the frame inside it
+    };
+
+    std::vector<Slot> slots_;
+    cv::Size size_;
+    int type_ = -1;
+    bool raw_ = false;
+    size_t slotBytes_ = 0;
+    uint64_t allocations_ = 0;
+};
+
+// Variance of the Laplacian of a BGR or grayscale frame; 0 for an empty one
+double SharpnessScore(const cv::Mat& pixels);
+
+// Index of the highest score, -1 for none
+int SharpestFrame(const std::vector<double>& scores);
+
+#endif // BURST_CAPTURE_H
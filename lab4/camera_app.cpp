@@ -0,0 +1,1760 @@
+// Camera side of lab4: capture, grabber, bursts, hidden mode, live preview and serve
+#include "camera_app.h"
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/core/utils/arena.hpp>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <ctime>
+#include <iomanip>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#ifdef _WIN32
+#include <direct.h>
+#include <fcntl.h>
+#include <io.h>
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#include <limits.h>
+#endif
+
+#include "frame_timing.h"
+#include "live_preview.h"
+#include "mjpeg_passthrough.h"
+#include "serve_protocol.h"
+#include "status_block.h"
+
+static HalCapture* g_camera = nullptr;
+// Кадры камеры через HAL: --record пишет их в трассу, --replay проигрывает трассу вместо камеры
+HalSession g_hal;
+std::string g_replay_trace;
+std::mutex g_camera_mutex;
+std::atomic<bool> g_app_running{ true };
+static std::atomic<bool> g_camera_initialized{ false };
+std::vector<int> g_jpeg_params{ cv::IMWRITE_JPEG_QUALITY, 90 };
+
+std::atomic<bool> g_hidden_mode{ false };
+static std::atomic<int> g_hidden_photos_count{ 0 };
+static std::mutex g_hidden_mode_mutex;
+static std::atomic<int> g_periodic_interval_ms{ 5000 };
+static std::atomic<unsigned> g_periodic_generation{ 0 };
+// Пропуск неизменившихся кадров в периодической съёмке (--change-threshold)
+ChangeGateOptions g_change_gate_options;
+static ChangeGate g_change_gate;
+static std::mutex g_change_gate_mutex;
+// Тайминг кадров граббера: реальный fps, пропуски, джиттер (info, metrics)
+static FrameTimingAnalyzer g_frame_timing;
+
+// Requested capture format; the backend may pick the nearest mode it supports
+static const int kRequestedWidth = 1280;
+static const int kRequestedHeight = 720;
+static const int kRequestedFps = 30;
+
+// Источник кадров вместо камеры 0 (--source <файл>): видеофайл, MJPEG-поток или
+// последовательность изображений. Файл проигрывается по кругу.
+std::string g_capture_source;
+// Каталог для фото (--photos-dir), по умолчанию <каталог exe>/photos
+std::string g_photos_dir;
+// --mjpeg: запросить у камеры MJPG и получать сжатые кадры без декодирования
+bool g_mjpeg_passthrough = false;
+static std::atomic<bool> g_raw_frames{ false };   // backend actually hands out JPEG buffers
+
+// Параметры камеры, снятые при инициализации: serve отвечает на info без
+// обращения к драйверу, пока граббер держит камеру
+struct CameraProps {
+    bool opened = false;
+    std::string backend;
+    double width = 0, height = 0, fps = 0;
+    double brightness = 0, contrast = 0, saturation = 0;
+    double init_ms = 0;
+    bool passthrough = false;
+};
+static CameraProps g_camera_props;
+
+// Режим serve: stdout отдаётся только под JSON-ответы, остальной вывод идёт в stderr
+std::atomic<bool> g_serve_mode{ false };
+std::ostream* g_reply_out = &std::cout;
+std::mutex g_reply_mutex;
+
+// Фоновый граббер: держит камеру "тёплой" и хранит последний кадр
+static std::thread g_grabber;
+static std::atomic<bool> g_grabber_running{ false };
+static std::mutex g_frame_mutex;
+static std::condition_variable g_frame_cv;
+static cv::Mat g_latest_frame;
+static uint64_t g_frame_seq = 0;
+static std::chrono::steady_clock::time_point g_latest_frame_at;
+static std::atomic<uint64_t> g_grab_failures{ 0 };
+static std::chrono::steady_clock::time_point g_grabber_started;
+
+std::mutex g_stats_mutex;
+std::map<std::string, LatencyStats> g_command_stats;
+static std::atomic<uint64_t> g_photos_saved{ 0 };
+std::chrono::steady_clock::time_point g_serve_started;
+std::vector<std::string>* g_saved_files = nullptr;   // bench collects its photos to delete them
+// Индекс и превью каталога фото; открывается при первом обращении
+static PhotoIndex g_photo_index;
+static std::once_flag g_photo_index_once;
+
+// Задержки этапов съёмки; в serve отдаются командой stats и событием metrics раз в 30 с
+static PerfMetric g_perf_capture("capture");
+static PerfMetric g_perf_validate("validate");
+static PerfMetric g_perf_enhance("enhance");
+static PerfMetric g_perf_encode("encode");
+static PerfMetric g_perf_write("write");
+static PerfMetric g_perf_hash("hash");
+static const int kMetricsIntervalMs = 30000;
+static std::thread g_metrics_reporter;
+static std::atomic<bool> g_metrics_running{ false };
+
+// Живой предпросмотр для UI (команда live): кадры граббера в JPEG, записи "live" в stdout
+static LivePreviewRate g_live_rate;
+static std::mutex g_live_mutex;
+static std::thread g_live_thread;
+static std::atomic<bool> g_live_running{ false };
+
+// Живое состояние в разделяемой памяти (--status-name); открывается только в serve
+static StatusBlockWriter g_status;
+std::string g_status_name = DefaultStatusBlockName();
+
+// Несколько устройств одновременно (--devices), режимы multi и multi_bench
+std::string g_device_list;
+MultiCaptureOptions g_multi_options;
+
+// Функция для получения текущего времени в формате строки
+static std::string now_timestamp()
+{
+    auto t = std::time(nullptr);
+    std::tm tm{};
+#ifdef _WIN32
+    localtime_s(&tm, &t);
+#else
+    localtime_r(&t, &tm);
+#endif
+    std::ostringstream os;
+    os << std::put_time(&tm, "%Y%m%d_%H%M%S");
+    return os.str();
+}
+
+// Функция для создания директории
+void ensure_dir(const std::string& dir)
+{
+#ifdef _WIN32
+    _mkdir(dir.c_str());
+#else
+    mkdir(dir.c_str(), 0755);
+#endif
+}
+
+unsigned long long tick_count_ms()
+{
+#ifdef _WIN32
+    return GetTickCount();
+#else
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+bool write_file(const std::string& path, const std::vector<uchar>& data)
+{
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) {
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    ok = (fclose(f) == 0) && ok;
+    return ok;
+}
+
+uint64_t unix_time_ms()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+double ms_since(const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Каталог исполняемого файла
+std::string exe_directory()
+{
+    std::string exe_dir;
+#ifdef _WIN32
+    char exe_path[MAX_PATH];
+    GetModuleFileNameA(NULL, exe_path, MAX_PATH);
+    exe_dir = exe_path;
+#else
+    char exe_path[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", exe_path, sizeof(exe_path) - 1);
+    if (len <= 0) return ".";
+    exe_path[len] = '\0';
+    exe_dir = exe_path;
+#endif
+    // Удаляем имя файла, оставляем только путь к директории
+    size_t last_separator = exe_dir.find_last_of("\\/");
+    if (last_separator != std::string::npos) {
+        exe_dir = exe_dir.substr(0, last_separator);
+    }
+    return exe_dir;
+}
+
+static std::string photos_directory()
+{
+    return g_photos_dir.empty() ? exe_directory() + "/photos" : g_photos_dir;
+}
+
+PhotoIndex& photo_index()
+{
+    std::call_once(g_photo_index_once, [] {
+        std::string error;
+        if (!g_photo_index.open(photos_directory(), error)) {
+            std::cerr << "Индекс фото недоступен: " << error << std::endl;
+        }
+    });
+    return g_photo_index;
+}
+
+bool file_source()
+{
+    return !g_capture_source.empty();
+}
+
+// Имя источника кадров для info и блока состояния
+static std::string source_name()
+{
+    if (g_hal.replaying()) {
+        return g_replay_trace;
+    }
+    return file_source() ? g_capture_source : std::string("camera 0");
+}
+
+// Вывод одной строки протокола serve
+void emit_line(const std::string& line)
+{
+    std::lock_guard<std::mutex> lock(g_reply_mutex);
+    *g_reply_out << line << std::endl;
+}
+
+// Запись с двоичным хвостом: строка-заголовок, ровно data.size() байт и перевод строки
+static void emit_binary(const std::string& header, const std::vector<unsigned char>& data)
+{
+    std::lock_guard<std::mutex> lock(g_reply_mutex);
+    *g_reply_out << header << '\n';
+    g_reply_out->write((const char*)data.data(), (std::streamsize)data.size());
+    *g_reply_out << std::endl;
+}
+
+// Чтение кадра; вызывается под g_camera_mutex. Файловый источник перематывается в начало.
+static bool read_frame_locked(cv::Mat& frame)
+{
+    if (!g_camera || !g_camera->isOpened()) {
+        return false;
+    }
+    PerfScope perf_scope(g_perf_capture);
+    if (g_camera->read(frame) && !frame.empty()) {
+        return true;
+    }
+    if (file_source()) {
+        g_camera->set(cv::CAP_PROP_POS_FRAMES, 0);
+        return g_camera->read(frame) && !frame.empty();
+    }
+    return false;
+}
+
+static bool camera_open()
+{
+    std::lock_guard<std::mutex> lock(g_camera_mutex);
+    return g_camera && g_camera->isOpened();
+}
+
+// Закрытие камеры; вызывается под g_camera_mutex
+void release_camera_locked()
+{
+    if (g_camera) {
+        g_camera->release();
+        delete g_camera;
+        g_camera = nullptr;
+    }
+    g_camera_initialized = false;
+    g_raw_frames = false;
+    g_camera_props = CameraProps();
+}
+
+// Включение выдачи сжатых MJPEG-буферов без декодирования; вызывается под g_camera_mutex
+static bool enable_raw_mjpeg_locked()
+{
+    // V4L2 and MSMF expose raw buffers through CONVERT_RGB=0, FFmpeg and the
+    // built-in AVI reader through FORMAT=-1
+    bool requested = file_source()
+        ? (g_camera->set(cv::CAP_PROP_FORMAT, -1) || g_camera->set(cv::CAP_PROP_CONVERT_RGB, 0))
+        : (g_camera->set(cv::CAP_PROP_CONVERT_RGB, 0) || g_camera->set(cv::CAP_PROP_FORMAT, -1));
+
+    cv::Mat probe;
+    if (requested && read_frame_locked(probe) && IsJpegBuffer(probe)) {
+        g_raw_frames = true;
+        return true;
+    }
+
+    // Camera delivers YUYV or the backend can't return compressed frames: keep decoding
+    g_camera->set(cv::CAP_PROP_CONVERT_RGB, 1);
+    g_raw_frames = false;
+    std::cout << " MJPEG passthrough недоступен, кадры будут декодироваться" << std::endl;
+    return false;
+}
+
+// Пиксели кадра. Сжатый MJPEG-буфер декодируется только здесь; для проверок
+// хватает уменьшенной в 4 раза копии (масштабирование идёт внутри IDCT)
+static cv::Mat frame_pixels(const cv::Mat& frame, bool reduced)
+{
+    if (!IsJpegBuffer(frame)) {
+        return frame;
+    }
+    return cv::imdecode(frame, reduced ? cv::IMREAD_REDUCED_COLOR_4 : cv::IMREAD_COLOR);
+}
+
+// Функция инициализации камеры; вызывается под g_camera_mutex
+static bool init_camera_locked()
+{
+    if (g_camera_initialized.load()) {
+        return g_camera && g_camera->isOpened();
+    }
+
+    if (g_camera) {
+        g_camera->release();
+        delete g_camera;
+        g_camera = nullptr;
+    }
+
+    std::cout << " Инициализация камеры..." << std::endl;
+    auto init_start = std::chrono::steady_clock::now();
+
+    // Try different backends in order of preference
+    std::vector<std::pair<int, const char*>> backends;
+    if (g_hal.replaying()) {
+        backends.push_back(std::make_pair(cv::CAP_ANY, "replay"));
+    } else if (file_source()) {
+        backends.push_back(std::make_pair(cv::CAP_ANY, IsSyntheticSource(g_capture_source) ? "synthetic" : "file"));
+    } else {
+        backends.push_back(std::make_pair(cv::CAP_MSMF, "MediaFoundation"));  // Try MF first as it's more robust
+        backends.push_back(std::make_pair(cv::CAP_DSHOW, "DirectShow"));     // Fallback to DSHOW
+        backends.push_back(std::make_pair(cv::CAP_V4L2, "V4L2"));            // For compatibility, though not used on Windows
+    }
+
+    for (size_t i = 0; i < backends.size(); ++i) {
+        int api = backends[i].first;
+        const char* name = backends[i].second;
+        g_camera = new HalCapture(g_hal);
+
+        // Try to open the camera with specific API
+        bool opened = file_source() ? g_camera->open(g_capture_source, api) : g_camera->open(0, api);
+        if (opened) {
+            if (!file_source() && !g_hal.replaying()) {
+                if (g_mjpeg_passthrough) {
+                    // FOURCC first: V4L2 re-negotiates the whole format when it changes
+                    g_camera->set(cv::CAP_PROP_FOURCC, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'));
+                }
+                // Set camera properties with error checking
+                bool propsSet = g_camera->set(cv::CAP_PROP_FRAME_WIDTH, kRequestedWidth) &&
+                               g_camera->set(cv::CAP_PROP_FRAME_HEIGHT, kRequestedHeight) &&
+                               g_camera->set(cv::CAP_PROP_FPS, kRequestedFps);
+                if (!propsSet) {
+                    std::cout << " Камера не приняла запрошенный режим, используется режим по умолчанию" << std::endl;
+                }
+            }
+
+            if (g_mjpeg_passthrough) {
+                enable_raw_mjpeg_locked();
+            }
+
+            // Wait a bit for camera to settle after setting properties
+            if (!g_hal.replaying()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            }
+
+            // Wait and try to get multiple valid frames to ensure camera is ready
+            cv::Mat frame;
+            bool gotValidFrame = false;
+            for (int attempt = 0; attempt < 40; attempt++) {  // Try for up to 4 seconds (40 attempts * 100ms)
+                if (read_frame_locked(frame)) {
+                    // Verify that the frame actually has proper pixel data (not all black)
+                    cv::Scalar meanValue = cv::mean(frame_pixels(frame, true));
+                    if (meanValue[0] > 10.0 || meanValue[1] > 10.0 || meanValue[2] > 10.0) {
+                        // At least one channel has meaningful brightness (increased threshold)
+                        gotValidFrame = true;
+                        break;
+                    }
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+
+            if (gotValidFrame) {
+                g_camera_initialized = true;
+                g_camera_props.opened = true;
+                bool video_file = file_source() && !g_hal.replaying() && !IsSyntheticSource(g_capture_source);
+                g_camera_props.backend = video_file ? std::string("file") : g_camera->backendName();
+                g_camera_props.width = g_camera->get(cv::CAP_PROP_FRAME_WIDTH);
+                g_camera_props.height = g_camera->get(cv::CAP_PROP_FRAME_HEIGHT);
+                g_camera_props.fps = g_camera->get(cv::CAP_PROP_FPS);
+                g_frame_timing.reset(g_camera_props.fps);
+                g_camera_props.brightness = g_camera->get(cv::CAP_PROP_BRIGHTNESS);
+                g_camera_props.contrast = g_camera->get(cv::CAP_PROP_CONTRAST);
+                g_camera_props.saturation = g_camera->get(cv::CAP_PROP_SATURATION);
+                g_camera_props.init_ms = ms_since(init_start);
+                g_camera_props.passthrough = g_raw_frames;
+                std::cout << "Камера инициализирована: " << name << std::endl;
+                return true;
+            }
+
+            std::cout << " Камера открыта с " << name << ", но не удалось получить валидный фрейм" << std::endl;
+            g_camera->release();
+            delete g_camera;
+            g_camera = nullptr;
+        } else {
+            std::cout << "Не удалось открыть камеру с " << name << std::endl;
+        }
+    }
+
+    std::cerr << " Не удалось открыть камеру" << std::endl;
+    g_camera_initialized = true;
+    return false;
+}
+
+// Функция инициализации камеры
+bool init_camera()
+{
+    std::lock_guard<std::mutex> lock(g_camera_mutex);
+    return init_camera_locked();
+}
+
+// Функция захвата кадра
+static cv::Mat capture_frame()
+{
+    std::lock_guard<std::mutex> lock(g_camera_mutex);
+
+    cv::Mat frame;
+    read_frame_locked(frame);
+
+    return frame.empty() ? cv::Mat() : frame;
+}
+
+// Функция получения информации о камере
+void display_camera_info()
+{
+    std::lock_guard<std::mutex> lock(g_camera_mutex);
+
+    if (!g_camera || !g_camera->isOpened()) {
+        std::cout << "Камера недоступна!" << std::endl;
+        return;
+    }
+
+    double w = g_camera->get(cv::CAP_PROP_FRAME_WIDTH);
+    double h = g_camera->get(cv::CAP_PROP_FRAME_HEIGHT);
+    double fps = g_camera->get(cv::CAP_PROP_FPS);
+    double br = g_camera->get(cv::CAP_PROP_BRIGHTNESS);
+    double co = g_camera->get(cv::CAP_PROP_CONTRAST);
+    double sa = g_camera->get(cv::CAP_PROP_SATURATION);
+
+    std::cout << "========================================" << std::endl;
+    std::cout << "Информация о веб-камере:" << std::endl;
+    std::cout << "  Ширина: " << (int)w << " пикселей" << std::endl;
+    std::cout << "  Высота: " << (int)h << " пикселей" << std::endl;
+    std::cout << "  FPS: " << (int)fps << std::endl;
+    FrameTimingStats timing = g_frame_timing.stats();
+    if (timing.frames > 1) {
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(1) << "  Реальный FPS: " << timing.fps
+             << ", пропущено кадров: " << timing.dropped << ", джиттер p95: " << timing.jitterP95Ms << " мс";
+        std::cout << line.str() << std::endl;
+    }
+    std::cout << "  Яркость: " << br << std::endl;
+    std::cout << "  Контрастность: " << co << std::endl;
+    std::cout << "  Насыщенность: " << sa << std::endl;
+    std::cout << "========================================" << std::endl;
+}
+
+// Проверка кадра: достаточная яркость и вариация (не чёрный и не одноцветный)
+bool validate_frame(const cv::Mat& captured, double& totalMean, double& totalVariance)
+{
+    PerfScope perf_scope(g_perf_validate);
+    // Все временные буферы проверки живут до конца функции: из арены потока
+    cv::ScopedArena arena;
+    cv::Mat frame = frame_pixels(captured, true);
+    if (frame.empty()) {
+        totalMean = totalVariance = 0.0;
+        return false;
+    }
+
+    cv::Scalar meanValue = cv::mean(frame);
+    totalMean = (meanValue[0] + meanValue[1] + meanValue[2]) / 3.0;
+
+    // Additionally check for variance to ensure it's not a uniform color frame
+    cv::Mat frame_f;
+    frame.convertTo(frame_f, CV_32F);
+    cv::Mat squared_diff;
+    cv::pow(frame_f - static_cast<float>(totalMean), 2.0, squared_diff);
+    cv::Scalar variance = cv::mean(squared_diff);
+    totalVariance = (variance[0] + variance[1] + variance[2]) / 3.0;
+
+    return totalMean > 15.0 && totalVariance > 100.0;  // Ensure both brightness and variation are adequate
+}
+
+// Optional: enhance contrast slightly in case image is too dark
+cv::Mat enhance_frame(const cv::Mat& frame)
+{
+    PerfScope perf_scope(g_perf_enhance);
+    if (frame.channels() != 3) {
+        return frame;
+    }
+
+    cv::Mat hsv, enhanced;
+    cv::cvtColor(frame, hsv, cv::COLOR_BGR2HSV);
+    std::vector<cv::Mat> hsv_planes;
+    cv::split(hsv, hsv_planes);
+
+    // Enhance value channel slightly
+    cv::Mat enhanced_v;
+    cv::equalizeHist(hsv_planes[2], enhanced_v);
+    hsv_planes[2] = enhanced_v;
+
+    cv::merge(hsv_planes, hsv);
+    cv::cvtColor(hsv, enhanced, cv::COLOR_HSV2BGR);
+    return enhanced;
+}
+
+struct CaptureResult {
+    bool ok = false;
+    std::string file;
+    std::string error;
+    int width = 0;
+    int height = 0;
+    double brightness = 0;
+    double variance = 0;
+    double ms = 0;
+    double wait_ms = 0;         // part of ms spent waiting for a fresh frame
+    bool passthrough = false;   // camera JPEG written as delivered
+};
+
+static std::string capture_result_json(const CaptureResult& r)
+{
+    std::ostringstream os;
+    os << "{\"file\":\"" << JsonEscape(r.file) << "\",\"width\":" << r.width << ",\"height\":" << r.height
+       << ",\"brightness\":" << r.brightness << ",\"variance\":" << r.variance << ",\"ms\":" << r.ms
+       << ",\"wait_ms\":" << r.wait_ms << ",\"passthrough\":" << (r.passthrough ? "true" : "false") << "}";
+    return os.str();
+}
+
+// Сохранение кадра в каталог фото
+static bool save_photo(const cv::Mat& frame, bool enhance, CaptureResult& result)
+{
+    std::string photos_dir = photos_directory();
+    ensure_dir(photos_dir); // Создаем директорию для фото, если её нет
+    result.file = photos_dir + "/photo_" + now_timestamp() + "_" + std::to_string(tick_count_ms()) + ".jpg";
+
+    cv::Mat written = frame;    // what ended up in the file, for the preview
+    if (IsJpegBuffer(frame) && !enhance) {
+        // MJPEG passthrough: no decode, no re-encode
+        ReadJpegSize(frame.ptr<unsigned char>(), frame.total(), result.width, result.height);
+        result.passthrough = true;
+        PerfScope perf_scope(g_perf_write);
+        if (!WriteJpegBuffer(result.file, frame)) {
+            result.error = "failed to write " + result.file;
+            return false;
+        }
+    } else {
+        cv::Mat pixels = frame_pixels(frame, false);
+        if (pixels.empty()) {
+            result.error = "failed to decode camera frame";
+            return false;
+        }
+        result.width = pixels.cols;
+        result.height = pixels.rows;
+
+        // Additional processing to enhance image before saving if needed
+        cv::Mat processed_frame = enhance ? enhance_frame(pixels) : pixels;
+        written = processed_frame;
+
+        // Encoding and writing are timed separately
+        std::vector<uchar> encoded;
+        {
+            PerfScope perf_scope(g_perf_encode);
+            if (!cv::imencode(".jpg", processed_frame, encoded, g_jpeg_params)) {
+                result.error = "failed to encode frame";
+                return false;
+            }
+        }
+        PerfScope perf_scope(g_perf_write);
+        if (!write_file(result.file, encoded)) {
+            result.error = "failed to write " + result.file;
+            return false;
+        }
+    }
+    g_photos_saved++;
+    uint64_t saved_at = unix_time_ms();
+    g_status.update([&](Lab4Status& s) {
+        s.photosSaved++;
+        s.lastCaptureUnixMs = saved_at;
+        CopyStatusString(s.lastCaptureFile, sizeof(s.lastCaptureFile), result.file);
+    });
+    if (g_saved_files) {
+        g_saved_files->push_back(result.file);
+    } else {
+        photo_index().add(result.file, written, (int64_t)saved_at);
+    }
+    return true;
+}
+
+// Функция захвата и сохранения фото
+void capture_and_save_photo()
+{
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    // Try to initialize camera again before capture (in case it was taken by another process)
+    bool camera_available = false;
+    {
+        std::lock_guard<std::mutex> lock(g_camera_mutex);
+        if (!g_camera || !g_camera->isOpened()) {
+            g_camera_initialized = false;
+            init_camera_locked();
+        }
+        camera_available = (g_camera && g_camera->isOpened());
+    }
+
+    if (!camera_available) {
+        std::cout << " Камера недоступна!" << std::endl;
+        return;
+    }
+
+    std::cout << "Настройка камеры и параметров..." << std::endl;
+
+    // Camera "warming up" phase - capture and discard several frames
+    // This helps many cameras adjust exposure, white balance, etc.
+    {
+        std::lock_guard<std::mutex> lock(g_camera_mutex);
+        for (int warmup = 0; warmup < 20; warmup++) {
+            cv::Mat warmup_frame;
+            read_frame_locked(warmup_frame);
+            std::this_thread::sleep_for(std::chrono::milliseconds(100)); // 100ms between frames
+        }
+    }
+
+    // Extra delay for camera to fully adjust settings
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+
+    cv::Mat frame;
+    bool frame_captured = false;
+    bool frame_valid = false;
+
+    // Try to capture frame multiple times with more attempts
+    for (int attempt = 0; attempt < 40; attempt++) {  // Increased attempts
+        {
+            std::lock_guard<std::mutex> lock(g_camera_mutex);
+            // Attempt to re-read the frame in case camera state changed
+            if (!g_camera || !g_camera->isOpened()) {
+                // If camera was closed by another process, try to reopen
+                std::cout << "Камера была закрыта другим процессом, пытаемся открыть заново..." << std::endl;
+                g_camera_initialized = false;
+                init_camera_locked();
+            }
+            read_frame_locked(frame);
+        }
+
+        if (!frame.empty()) {
+            frame_captured = true;
+
+            double totalMean = 0.0, totalVariance = 0.0;
+            if (validate_frame(frame, totalMean, totalVariance)) {
+                // Frame has good brightness and sufficient detail variation
+                frame_valid = true;
+                std::cout << "Валидный кадр обнаружен, яркость: " << totalMean << ", вариация: " << totalVariance << std::endl;
+                break;
+            } else {
+                std::cout << "Кадр #" << attempt << " не прошел проверку, яркость: " << totalMean
+                         << ", вариация: " << totalVariance << std::endl;
+            }
+        } else {
+            std::cout << "Кадр #" << attempt << " пустой" << std::endl;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(150)); // Reduced delay to check more frequently
+    }
+
+    if (!frame_captured || frame.empty() || !frame_valid) {
+        std::cout << " Не удалось захватить валидный кадр! (Пустой или черный)" << std::endl;
+
+        // If we have a captured frame but it's all black, save it anyway but with a warning
+        if (frame_captured && !frame.empty() && !frame_valid) {
+            std::cout << " Захваченный кадр выглядит черным или одноцветным." << std::endl;
+        }
+        return;
+    }
+
+    std::cout << "Захватываем фото..." << std::endl;
+
+    CaptureResult result;
+    bool saved = save_photo(frame, true, result);
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+
+    if (saved) {
+        std::cout << "Фото сохранено: " << result.file << std::endl;
+        std::cout << "Обработка заняла: " << duration.count() << " мс" << std::endl;
+    } else {
+        std::cerr << "Ошибка сохранения фото: " << result.file << std::endl;
+    }
+}
+
+// Фоновый граббер: непрерывно читает кадры, пока работает serve
+static void grabber_loop()
+{
+    double interval = 0.0;  // file sources are paced at their nominal fps, cameras block in read()
+    auto next = std::chrono::steady_clock::now();
+    auto last_frame = next;
+    double fps = 0.0;       // smoothed rate for the status block
+
+    while (g_grabber_running) {
+        cv::Mat frame;  // fresh buffer every time: consumers may still hold the previous one
+        bool ok = false;
+        {
+            std::lock_guard<std::mutex> lock(g_camera_mutex);
+            ok = read_frame_locked(frame);
+            if (ok) {
+                g_frame_timing.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                          std::chrono::steady_clock::now().time_since_epoch()).count(),
+                                      g_camera->get(cv::CAP_PROP_POS_MSEC));
+            }
+            if (ok && file_source() && interval == 0.0) {
+                double fps = g_camera->get(cv::CAP_PROP_FPS);
+                interval = 1.0 / (fps > 0 && fps <= 1000 ? fps : kRequestedFps);
+            }
+        }
+
+        if (!ok && g_hal.replaying() && !camera_open()) {
+            // Трасса закончилась: камера "отключена", serve продолжает отвечать на команды
+            emit_line("{\"event\":\"replay_finished\",\"frames\":" + std::to_string(g_hal.reader()->records()) + "}");
+            std::cerr << g_hal.summary() << std::endl;
+            break;
+        }
+        if (!ok) {
+            g_grab_failures++;
+            g_status.update([](Lab4Status& s) { s.grabFailures++; });
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(g_frame_mutex);
+            g_latest_frame = frame;
+            g_latest_frame_at = std::chrono::steady_clock::now();
+            ++g_frame_seq;
+        }
+        g_frame_cv.notify_all();
+
+        auto now = std::chrono::steady_clock::now();
+        double dt = std::chrono::duration<double>(now - last_frame).count();
+        last_frame = now;
+        if (dt > 0.0) {
+            fps = fps == 0.0 ? 1.0 / dt : fps * 0.9 + 0.1 / dt;
+        }
+        g_status.update([fps](Lab4Status& s) {
+            s.framesGrabbed++;
+            s.fps = fps;
+        });
+
+        if (interval > 0.0) {
+            next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(interval));
+            auto now = std::chrono::steady_clock::now();
+            if (next < now - std::chrono::seconds(1)) {
+                next = now;  // fell far behind, don't burst to catch up
+            }
+            std::this_thread::sleep_until(next);
+        }
+    }
+    g_frame_cv.notify_all();
+}
+
+void start_grabber()
+{
+    if (g_grabber_running.exchange(true)) {
+        return;
+    }
+    g_grabber_started = std::chrono::steady_clock::now();
+    g_grabber = std::thread(grabber_loop);
+}
+
+void stop_grabber()
+{
+    if (!g_grabber_running.exchange(false)) {
+        return;
+    }
+    g_frame_cv.notify_all();
+    if (g_grabber.joinable()) {
+        g_grabber.join();
+    }
+}
+
+static uint64_t current_frame_seq()
+{
+    std::lock_guard<std::mutex> lock(g_frame_mutex);
+    return g_frame_seq;
+}
+
+// Ожидание кадра, полученного граббером после seq; seq обновляется до номера кадра
+bool wait_fresh_frame(uint64_t& seq, int timeout_ms, cv::Mat& frame,
+                      std::chrono::steady_clock::time_point* grabbed_at)
+{
+    std::unique_lock<std::mutex> lock(g_frame_mutex);
+    uint64_t after = seq;
+    g_frame_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                        [after] { return g_frame_seq > after || !g_grabber_running; });
+    if (g_frame_seq <= after) {
+        return false;
+    }
+    frame = g_latest_frame;
+    seq = g_frame_seq;
+    if (grabbed_at) {
+        *grabbed_at = g_latest_frame_at;
+    }
+    return true;
+}
+
+// Захват с тёплой камеры: без прогрева, берётся первый валидный кадр после запроса
+static CaptureResult capture_warm(bool enhance)
+{
+    auto start = std::chrono::steady_clock::now();
+    CaptureResult result;
+    uint64_t seq = current_frame_seq();
+    cv::Mat frame;
+
+    for (int attempt = 0; attempt < 10; attempt++) {
+        auto wait_start = std::chrono::steady_clock::now();
+        bool got_frame = wait_fresh_frame(seq, 2000, frame);
+        result.wait_ms += ms_since(wait_start);
+        if (!got_frame) {
+            result.error = "no frame from camera";
+            break;
+        }
+        if (validate_frame(frame, result.brightness, result.variance)) {
+            result.ok = save_photo(frame, enhance, result);
+            break;
+        }
+        result.error = "no valid frame (empty or black)";
+    }
+
+    result.ms = ms_since(start);
+    return result;
+}
+
+// Серийная съёмка: N кадров подряд с частотой камеры в заранее выделенную арену.
+// Цикл захвата только читает кадры; резкость и JPEG считаются после последнего
+// кадра на пуле кодировщиков, так что их время не попадает в интервалы между кадрами.
+std::mutex g_burst_mutex;    // одна серия за раз: арена общая и живёт между сериями
+static FrameArena g_burst_arena;
+
+// Кодирование и запись одного кадра серии; потокобезопасно
+static bool write_burst_frame(const cv::Mat& frame, bool enhance, bool index, const std::string& file)
+{
+    if (IsJpegBuffer(frame) && !enhance) {
+        bool ok;
+        {
+            PerfScope perf_scope(g_perf_write);
+            ok = WriteJpegBuffer(file, frame);
+        }
+        return ok && (!index || photo_index().add(file, frame, (int64_t)unix_time_ms()));
+    }
+    // Декодирование, улучшение и превью кадра серии не переживают вызов: арена потока пула
+    cv::ScopedArena arena;
+    cv::Mat pixels = frame_pixels(frame, false);
+    if (pixels.empty()) {
+        return false;
+    }
+    cv::Mat processed = enhance ? enhance_frame(pixels) : pixels;
+    std::vector<uchar> encoded;
+    {
+        PerfScope perf_scope(g_perf_encode);
+        if (!cv::imencode(".jpg", processed, encoded, g_jpeg_params)) {
+            return false;
+        }
+    }
+    {
+        PerfScope perf_scope(g_perf_write);
+        if (!write_file(file, encoded)) {
+            return false;
+        }
+    }
+    return !index || photo_index().add(file, processed, (int64_t)unix_time_ms());
+}
+
+// Резкость кадра серии; сжатый кадр оценивается по уменьшенной копии
+static double burst_frame_score(const cv::Mat& frame)
+{
+    return SharpnessScore(frame_pixels(frame, true));
+}
+
+// Захват серии в g_burst_arena; вызывается под g_burst_mutex и под замком камеры.
+// pace: видеофайл читается с его номинальной частотой, как его читает граббер
+bool capture_burst_locked(HalCapture& camera, bool pace, const BurstOptions& options,
+                          const std::string& prefix, BurstResult& result)
+{
+    int n = options.frames;
+    cv::Mat probe;
+    if (!camera.isOpened() || !camera.read(probe) || probe.empty()) {
+        result.error = "no frame from camera";
+        return false;
+    }
+    bool raw = IsJpegBuffer(probe);
+    cv::Size pixel_size = probe.size();
+    if (raw) {
+        ReadJpegSize(probe.ptr<unsigned char>(), probe.total(), pixel_size.width, pixel_size.height);
+    }
+    uint64_t allocations = g_burst_arena.allocations();
+    g_burst_arena.reserve(n, probe, raw, pixel_size);
+    result.arenaAllocations = g_burst_arena.allocations() - allocations;
+    result.arenaBytes = g_burst_arena.bytes();
+    result.sourceFps = camera.get(cv::CAP_PROP_FPS);
+    double period_ms = result.sourceFps > 0 && result.sourceFps <= 1000 ? 1000.0 / result.sourceFps : 1000.0 / kRequestedFps;
+
+    // Всё, что нужно циклу, выделено заранее
+    std::vector<std::chrono::steady_clock::time_point> stamps(n);
+    if (options.inlineEncode) {
+        result.scores.assign(n, 0.0);
+        result.files.assign(n, std::string());
+    }
+    cv::Mat scratch;    // compressed frames arrive here and are copied into their slot
+    auto start = std::chrono::steady_clock::now();
+    auto next = start;
+    for (int i = 0; i < n; i++) {
+        if (pace) {
+            next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(period_ms));
+            std::this_thread::sleep_until(next);
+        }
+        cv::Mat& slot = raw ? scratch : g_burst_arena.slot(i);
+        bool ok = camera.read(slot) && !slot.empty();
+        if (!ok && file_source()) {
+            camera.set(cv::CAP_PROP_POS_FRAMES, 0);
+            ok = camera.read(slot) && !slot.empty();
+        }
+        if (!ok) {
+            result.error = "camera stopped delivering frames";
+            return false;
+        }
+        stamps[i] = std::chrono::steady_clock::now();
+        if (raw ? !g_burst_arena.storeRaw(i, scratch) : !g_burst_arena.inPlace(i)) {
+            result.outOfPlace++;
+            if (raw) {
+                g_burst_arena.slot(i) = scratch.clone();
+            }
+        }
+        if (options.inlineEncode) {
+            result.scores[i] = burst_frame_score(g_burst_arena.slot(i));
+            result.files[i] = prefix + std::to_string(i) + ".jpg";
+            write_burst_frame(g_burst_arena.slot(i), options.enhance, options.index, result.files[i]);
+        }
+    }
+    result.captureMs = ms_since(start);
+    result.frames = n;
+
+    for (int i = 1; i < n; i++) {
+        double dt = std::chrono::duration<double, std::milli>(stamps[i] - stamps[i - 1]).count();
+        result.intervals.add(dt);
+        int periods = (int)std::floor(dt / period_ms + 0.5);
+        if (dt > 1.5 * period_ms && periods > 1) {
+            result.dropped += periods - 1;
+        }
+    }
+    if (n > 1) {
+        result.fps = (n - 1) * 1000.0 / std::chrono::duration<double, std::milli>(stamps[n - 1] - stamps[0]).count();
+    }
+    return true;
+}
+
+// Оценка и кодирование захваченной серии на пуле; вызывается под g_burst_mutex
+void encode_burst(const BurstOptions& options, const std::string& prefix, BurstResult& result)
+{
+    int n = result.frames;
+    result.encoders = options.encoders > 0 ? options.encoders : std::max(1, (int)std::thread::hardware_concurrency());
+    result.scores.assign(n, 0.0);
+    result.files.clear();
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        EncoderPool pool(result.encoders);
+        for (int i = 0; i < n; i++) {
+            pool.submit(i, [i, &result] { result.scores[i] = burst_frame_score(g_burst_arena.slot(i)); });
+        }
+    }
+    result.scoreMs = ms_since(start);
+    result.best = SharpestFrame(result.scores);
+
+    std::vector<int> keep;
+    if (options.keep == BurstKeep::kAll) {
+        for (int i = 0; i < n; i++) {
+            keep.push_back(i);
+        }
+    } else if (result.best >= 0) {
+        keep.push_back(result.best);
+    }
+    std::vector<char> written(keep.size(), 0);
+    for (size_t k = 0; k < keep.size(); k++) {
+        result.files.push_back(prefix + std::to_string(keep[k]) + ".jpg");
+    }
+
+    start = std::chrono::steady_clock::now();
+    {
+        EncoderPool pool(result.encoders);
+        for (size_t k = 0; k < keep.size(); k++) {
+            int i = keep[k];
+            const std::string& file = result.files[k];
+            bool enhance = options.enhance;
+            bool index = options.index;
+            char* ok = &written[k];
+            pool.submit((int)k, [i, &file, enhance, index, ok] {
+                *ok = write_burst_frame(g_burst_arena.slot(i), enhance, index, file);
+            });
+        }
+    }
+    result.encodeMs = ms_since(start);
+
+    for (size_t k = 0; k < keep.size(); k++) {
+        if (!written[k]) {
+            result.error = "failed to write " + result.files[k];
+            return;
+        }
+    }
+}
+
+// Серия с открытой камеры g_camera: захват под g_camera_mutex, кодирование уже без него
+BurstResult capture_burst(const BurstOptions& options)
+{
+    BurstResult result;
+    std::lock_guard<std::mutex> burst_lock(g_burst_mutex);
+    std::string photos_dir = photos_directory();
+    ensure_dir(photos_dir);
+    std::string prefix = photos_dir + "/burst_" + now_timestamp() + "_" + std::to_string(tick_count_ms()) + "_";
+    {
+        std::lock_guard<std::mutex> lock(g_camera_mutex);
+        if (!g_camera || !g_camera->isOpened()) {
+            result.error = "camera not available";
+            return result;
+        }
+        bool pace = file_source() && !IsSyntheticSource(g_capture_source) && !g_hal.replaying();
+        if (!capture_burst_locked(*g_camera, pace, options, prefix, result)) {
+            return result;
+        }
+    }
+    encode_burst(options, prefix, result);
+    if (!result.error.empty()) {
+        return result;
+    }
+
+    g_photos_saved += result.files.size();
+    uint64_t saved_at = unix_time_ms();
+    const std::string& last = result.files.back();
+    size_t saved = result.files.size();
+    g_status.update([&](Lab4Status& s) {
+        s.photosSaved += saved;
+        s.lastCaptureUnixMs = saved_at;
+        CopyStatusString(s.lastCaptureFile, sizeof(s.lastCaptureFile), last);
+    });
+    result.ok = true;
+    return result;
+}
+
+static std::string burst_result_json(const BurstResult& r, const BurstOptions& options)
+{
+    std::ostringstream os;
+    os << "{\"frames\":" << r.frames << ",\"keep\":\"" << BurstKeepName(options.keep) << "\""
+       << ",\"fps\":" << r.fps << ",\"source_fps\":" << r.sourceFps << ",\"dropped\":" << r.dropped
+       << ",\"interval\":" << r.intervals.toJson()
+       << ",\"capture_ms\":" << r.captureMs << ",\"score_ms\":" << r.scoreMs << ",\"encode_ms\":" << r.encodeMs
+       << ",\"encoders\":" << r.encoders << ",\"arena_bytes\":" << r.arenaBytes
+       << ",\"arena_allocations\":" << r.arenaAllocations << ",\"out_of_place\":" << r.outOfPlace
+       << ",\"best\":" << r.best << ",\"scores\":[";
+    for (size_t i = 0; i < r.scores.size(); i++) {
+        os << (i ? "," : "") << r.scores[i];
+    }
+    os << "],\"files\":[";
+    for (size_t i = 0; i < r.files.size(); i++) {
+        os << (i ? "," : "") << "\"" << JsonEscape(r.files[i]) << "\"";
+    }
+    os << "]}";
+    return os.str();
+}
+
+// Аргументы серии: [кадров] [best|all] [raw]
+bool parse_burst_args(const std::vector<std::string>& args, BurstOptions& options, std::string& error)
+{
+    options.encoders = g_multi_options.encoders;
+    for (size_t i = 0; i < args.size(); i++) {
+        const std::string& arg = args[i];
+        if (arg == "raw") {
+            options.enhance = false;
+        } else if (ParseBurstKeep(arg, options.keep)) {
+        } else if (!arg.empty() && isdigit((unsigned char)arg[0])) {
+            options.frames = atoi(arg.c_str());
+        } else {
+            error = "unknown burst argument: " + arg;
+            return false;
+        }
+    }
+    if (options.frames < 1 || options.frames > kMaxBurstFrames) {
+        error = "burst length must be 1.." + std::to_string(kMaxBurstFrames);
+        return false;
+    }
+    return true;
+}
+
+// Функция запуска скрытого режима (периодическая съёмка)
+void start_hidden_mode(int interval_ms, bool hide_console)
+{
+    std::lock_guard<std::mutex> lock(g_hidden_mode_mutex);
+
+    if (g_hidden_mode.load()) {
+        std::cout << " Скрытый режим уже активирован!" << std::endl;
+        return;
+    }
+
+    g_hidden_mode = true;
+    g_hidden_photos_count = 0;
+    g_periodic_interval_ms = interval_ms;
+    unsigned generation = ++g_periodic_generation;
+    {
+        std::lock_guard<std::mutex> gate_lock(g_change_gate_mutex);
+        g_change_gate = ChangeGate(g_change_gate_options);
+    }
+    g_status.update([interval_ms](Lab4Status& s) {
+        s.flags |= kStatusPeriodic;
+        s.periodicIntervalMs = interval_ms;
+        s.periodicPhotos = 0;
+    });
+
+    ensure_dir(photos_directory());
+
+    std::cout << " Скрытый режим фотонаблюдения АКТИВИРОВАН" << std::endl;
+
+#ifdef _WIN32
+    if (hide_console) {
+        // Скрываем консольное окно
+        HWND hWnd = GetConsoleWindow();
+        if (hWnd) {
+            ShowWindow(hWnd, SW_HIDE);
+            ShowWindow(hWnd, SW_MINIMIZE);
+            ShowWindow(hWnd, SW_FORCEMINIMIZE);
+            ShowWindow(hWnd, SW_HIDE);
+        }
+        std::cout << "Консольное окно скрыто" << std::endl;
+    }
+#else
+    (void)hide_console;
+#endif
+
+    // Запускаем фоновый поток для скрытой съёмки
+    std::thread([generation]{
+        auto still_active = [generation] {
+            return g_app_running && g_hidden_mode.load() && g_periodic_generation.load() == generation;
+        };
+
+        while (still_active()) {
+            // Sleep in short slices so stop/start take effect immediately
+            auto wake = std::chrono::steady_clock::now() + std::chrono::milliseconds(g_periodic_interval_ms.load());
+            while (still_active() && std::chrono::steady_clock::now() < wake) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            }
+
+            if (!still_active()) {
+                break;
+            }
+
+            cv::Mat frame;
+            if (g_grabber_running) {
+                uint64_t seq = current_frame_seq();
+                wait_fresh_frame(seq, 2000, frame);
+            } else {
+                // Проверяем камеру без блокировки: если занята, пропускаем кадр
+                bool camera_ready = false;
+                if (g_camera_mutex.try_lock()) {
+                    camera_ready = (g_camera && g_camera->isOpened());
+                    g_camera_mutex.unlock();
+                } else {
+                    // Камера занята — пропускаем кадр
+                    continue;
+                }
+                if (!camera_ready) {
+                    continue;
+                }
+                frame = capture_frame();
+            }
+
+            if (!frame.empty() && g_change_gate_options.threshold > 0) {
+                // Хеш по уменьшенной копии; сцена не изменилась — не кодируем и не пишем
+                uint64_t hash = 0;
+                {
+                    PerfScope perf_scope(g_perf_hash);
+                    hash = FrameHash(frame_pixels(frame, true), g_change_gate_options.hash);
+                }
+                std::lock_guard<std::mutex> gate_lock(g_change_gate_mutex);
+                if (g_change_gate.check(hash, (int64_t)tick_count_ms()) == ChangeGate::kSkip) {
+                    continue;
+                }
+            }
+
+            if (!frame.empty()) {
+                CaptureResult result;
+                if (save_photo(frame, false, result)) {
+                    int count = ++g_hidden_photos_count;
+                    g_status.update([](Lab4Status& s) { s.periodicPhotos++; });
+                    std::cout << " [СКРЫТЫЙ РЕЖИМ] Снимок #" << count
+                              << " сохранен: " << result.file << std::endl;
+                    if (g_serve_mode) {
+                        emit_line("{\"event\":\"photo\",\"count\":" + std::to_string(count) +
+                                  ",\"file\":\"" + JsonEscape(result.file) + "\"}");
+                    }
+                }
+            }
+        }
+
+        std::cout << "Скрытый режим фотонаблюдения ОСТАНОВЛЕН. Всего снимков: "
+                  << g_hidden_photos_count.load() << std::endl;
+    }).detach();
+}
+
+// Функция остановки скрытого режима
+void stop_hidden_mode()
+{
+    std::lock_guard<std::mutex> lock(g_hidden_mode_mutex);
+
+    if (!g_hidden_mode.load()) {
+        std::cout << " Скрытый режим не активирован!" << std::endl;
+        return;
+    }
+
+    g_hidden_mode = false;
+    ++g_periodic_generation;
+    g_status.update([](Lab4Status& s) { s.flags &= ~(uint32_t)kStatusPeriodic; });
+
+#ifdef _WIN32
+    // Показываем консольное окно обратно
+    ShowWindow(GetConsoleWindow(), SW_SHOW);
+    std::cout << " Консольное окно показано обратно" << std::endl;
+#endif
+
+    int photo_count = g_hidden_photos_count.load();
+    std::cout << " Скрытый режим остановлен. Всего снимков: " << photo_count << std::endl;
+}
+
+static std::string camera_info_json()
+{
+    CameraProps props;
+    {
+        std::lock_guard<std::mutex> lock(g_camera_mutex);
+        props = g_camera_props;
+    }
+
+    std::ostringstream os;
+    os << "{\"camera_info\":{\"index\":0,\"name\":\""
+       << JsonEscape(source_name()) << "\""
+       << ",\"backend\":\"" << JsonEscape(props.backend) << "\""
+       << ",\"width\":" << (int)props.width << ",\"height\":" << (int)props.height
+       << ",\"fps\":" << props.fps << ",\"brightness\":" << props.brightness
+       << ",\"contrast\":" << props.contrast << ",\"saturation\":" << props.saturation
+       << ",\"is_opened\":" << (props.opened ? "true" : "false")
+       << ",\"simulated\":" << (file_source() ? "true" : "false")
+       << ",\"passthrough\":" << (props.passthrough ? "true" : "false")
+       << ",\"init_ms\":" << props.init_ms
+       << ",\"timing\":" << g_frame_timing.json() << "}}";
+    return os.str();
+}
+
+// Публикация параметров камеры в блок состояния (после init/reopen)
+static void publish_camera_status()
+{
+    CameraProps props;
+    {
+        std::lock_guard<std::mutex> lock(g_camera_mutex);
+        props = g_camera_props;
+    }
+    std::string source = source_name();
+    g_status.update([&](Lab4Status& s) {
+        s.flags &= ~(uint32_t)(kStatusCameraOpen | kStatusPassthrough | kStatusSimulated);
+        s.flags |= kStatusServe;
+        if (props.opened) s.flags |= kStatusCameraOpen;
+        if (props.passthrough) s.flags |= kStatusPassthrough;
+        if (file_source()) s.flags |= kStatusSimulated;
+        s.width = (int32_t)props.width;
+        s.height = (int32_t)props.height;
+        s.nominalFps = props.fps;
+        s.brightness = props.brightness;
+        s.contrast = props.contrast;
+        s.saturation = props.saturation;
+        CopyStatusString(s.backend, sizeof(s.backend), props.backend);
+        CopyStatusString(s.source, sizeof(s.source), source);
+    });
+}
+
+std::string serve_stats_json()
+{
+    uint64_t frames;
+    {
+        std::lock_guard<std::mutex> lock(g_frame_mutex);
+        frames = g_frame_seq;
+    }
+    double grab_s = g_grabber_running ? ms_since(g_grabber_started) / 1000.0 : 0.0;
+
+    std::ostringstream os;
+    os << "{\"uptime_s\":" << ms_since(g_serve_started) / 1000.0
+       << ",\"frames_grabbed\":" << frames
+       << ",\"grab_failures\":" << g_grab_failures.load()
+       << ",\"fps\":" << (grab_s > 0 ? frames / grab_s : 0.0)
+       << ",\"photos_saved\":" << g_photos_saved.load()
+       << ",\"periodic\":{\"active\":" << (g_hidden_mode.load() ? "true" : "false")
+       << ",\"interval_ms\":" << g_periodic_interval_ms.load()
+       << ",\"photos\":" << g_hidden_photos_count.load();
+    if (g_change_gate_options.threshold > 0) {
+        std::lock_guard<std::mutex> gate_lock(g_change_gate_mutex);
+        os << ",\"gate\":" << g_change_gate.toJson();
+    }
+    os << "}"
+       << ",\"perf\":" << PerfStatsJson()
+       << ",\"commands\":{";
+    std::lock_guard<std::mutex> lock(g_stats_mutex);
+    bool first = true;
+    for (const auto& entry : g_command_stats) {
+        os << (first ? "" : ",") << "\"" << JsonEscape(entry.first) << "\":" << entry.second.toJson();
+        first = false;
+    }
+    os << "}}";
+    return os.str();
+}
+
+static double live_clock()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Поток живого предпросмотра: берёт кадры граббера (те же, что и capture), кодирует
+// по текущему уровню и отправляет записью "live", пока потребитель успевает подтверждать
+static void live_loop()
+{
+    uint64_t seq = current_frame_seq();
+    uint64_t sent = 0;
+    LivePreviewFrame preview;
+    while (g_live_running) {
+        cv::Mat frame;
+        std::chrono::steady_clock::time_point grabbed_at;
+        if (!wait_fresh_frame(seq, 500, frame, &grabbed_at)) {
+            continue;
+        }
+        LivePreviewLevel level;
+        int level_index = 0;
+        {
+            std::lock_guard<std::mutex> lock(g_live_mutex);
+            if (!g_live_rate.admit(live_clock())) {
+                continue;
+            }
+            level = g_live_rate.level();
+            level_index = g_live_rate.levelIndex();
+        }
+        auto encode_start = std::chrono::steady_clock::now();
+        if (!EncodeLivePreview(frame, level, level_index == 0, preview)) {
+            continue;
+        }
+        double encode_ms = ms_since(encode_start);
+        {
+            std::lock_guard<std::mutex> lock(g_live_mutex);
+            g_live_rate.sent(++sent, preview.jpeg.size(), encode_ms, live_clock());
+        }
+        std::ostringstream os;
+        os << "{\"event\":\"live\",\"seq\":" << sent << ",\"width\":" << preview.width << ",\"height\":" << preview.height
+           << ",\"quality\":" << (preview.passthrough ? 0 : level.quality) << ",\"level\":" << level_index
+           << ",\"passthrough\":" << (preview.passthrough ? "true" : "false")
+           << ",\"t_ms\":" << std::chrono::duration<double, std::milli>(grabbed_at - g_serve_started).count()
+           << ",\"age_ms\":" << ms_since(grabbed_at) << ",\"bytes\":" << preview.jpeg.size() << "}";
+        emit_binary(os.str(), preview.jpeg);
+    }
+}
+
+void stop_live()
+{
+    if (g_live_running.exchange(false) && g_live_thread.joinable()) {
+        g_live_thread.join();
+    }
+}
+
+void start_live(int max_side)
+{
+    stop_live();
+    CameraProps props;
+    {
+        std::lock_guard<std::mutex> lock(g_camera_mutex);
+        props = g_camera_props;
+    }
+    LivePreviewOptions options;
+    options.maxSide = max_side;
+    {
+        std::lock_guard<std::mutex> lock(g_live_mutex);
+        g_live_rate = LivePreviewRate(options);
+        g_live_rate.reset(live_clock(), props.fps, (int)std::max(props.width, props.height));
+    }
+#ifdef _WIN32
+    // JPEG-хвосты записей идут как есть: stdout без замены \n на \r\n
+    fflush(stdout);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    g_live_running = true;
+    g_live_thread = std::thread(live_loop);
+}
+
+std::string live_json()
+{
+    std::lock_guard<std::mutex> lock(g_live_mutex);
+    return "{\"running\":" + std::string(g_live_running ? "true" : "false") + ",\"rate\":" + g_live_rate.json() + "}";
+}
+
+// Обработка одной строки протокола serve; возвращает строку ответа
+std::string handle_serve_line(const std::string& line, bool& quit)
+{
+    ServeRequest req;
+    if (!ParseServeRequest(line, req)) {
+        return std::string();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::string result;
+    std::string error;
+
+    if (req.cmd == "ping") {
+        result = "{\"pong\":true}";
+    }
+    else if (req.cmd == "info") {
+        result = camera_info_json();
+    }
+    else if (req.cmd == "capture") {
+        // "capture raw" saves the frame as grabbed, without contrast enhancement
+        bool enhance = req.args.empty() || req.args[0] != "raw";
+        CaptureResult r = capture_warm(enhance);
+        if (r.ok) {
+            result = capture_result_json(r);
+        } else {
+            error = r.error;
+        }
+    }
+    else if (req.cmd == "burst") {
+        // "burst [кадров=10] [best|all] [raw]"
+        BurstOptions options;
+        if (parse_burst_args(req.args, options, error)) {
+            BurstResult r = capture_burst(options);
+            if (r.ok) {
+                result = burst_result_json(r, options);
+            } else {
+                error = r.error;
+            }
+        }
+    }
+    else if (req.cmd == "photos") {
+        // "photos [offset=0] [limit=50]": newest first, straight from the index
+        size_t offset = req.args.size() > 0 ? strtoul(req.args[0].c_str(), nullptr, 10) : 0;
+        size_t limit = req.args.size() > 1 ? strtoul(req.args[1].c_str(), nullptr, 10) : 50;
+        limit = std::min<size_t>(limit ? limit : 50, 1000);
+        PhotoIndex& index = photo_index();
+        std::vector<PhotoEntry> page = index.list(offset, limit);
+        std::ostringstream os;
+        os << "{\"total\":" << index.size() << ",\"offset\":" << offset << ",\"photos\":[";
+        for (size_t i = 0; i < page.size(); i++) {
+            os << (i ? "," : "") << PhotoIndex::EntryJson(page[i]);
+        }
+        os << "]}";
+        result = os.str();
+    }
+    else if (req.cmd == "preview") {
+        // "preview <имя>": путь к уменьшенной копии, при необходимости она создаётся
+        std::string path;
+        bool generated = false;
+        if (req.args.empty()) {
+            error = "usage: preview <name>";
+        } else if (photo_index().preview(req.args[0], path, generated, error)) {
+            result = "{\"name\":\"" + JsonEscape(req.args[0]) + "\",\"file\":\"" + JsonEscape(path) +
+                     "\",\"generated\":" + (generated ? "true" : "false") + "}";
+        }
+    }
+    else if (req.cmd == "live") {
+        // "live [on|off] [длинная сторона=1280]": кадры предпросмотра записями "live"
+        if (!req.args.empty() && req.args[0] == "off") {
+            stop_live();
+            result = live_json();
+        } else if (!req.args.empty() && req.args[0] != "on") {
+            error = "usage: live [on|off] [max_side]";
+        } else {
+            int max_side = req.args.size() > 1 ? atoi(req.args[1].c_str()) : 1280;
+            if (max_side < 160) {
+                error = "max_side must be at least 160";
+            } else {
+                start_live(max_side);
+                result = live_json();
+            }
+        }
+    }
+    else if (req.cmd == "live_ack") {
+        // "live_ack <seq>": кадр показан (и все до него)
+        if (req.args.empty()) {
+            error = "usage: live_ack <seq>";
+        } else {
+            std::lock_guard<std::mutex> lock(g_live_mutex);
+            g_live_rate.acked(strtoull(req.args[0].c_str(), nullptr, 10), live_clock());
+        }
+    }
+    else if (req.cmd == "reindex") {
+        result = "{\"photos\":" + std::to_string(photo_index().rebuild()) + "}";
+    }
+    else if (req.cmd == "start_periodic") {
+        int interval_ms = req.args.empty() ? 5000 : atoi(req.args[0].c_str());
+        if (interval_ms < 100) {
+            error = "interval must be at least 100 ms";
+        } else if (g_hidden_mode.load()) {
+            error = "periodic capture already active";
+        } else {
+            start_hidden_mode(interval_ms, false);
+            result = "{\"interval_ms\":" + std::to_string(interval_ms) + "}";
+        }
+    }
+    else if (req.cmd == "stop_periodic") {
+        if (!g_hidden_mode.load()) {
+            error = "periodic capture not active";
+        } else {
+            stop_hidden_mode();
+            result = "{\"photos\":" + std::to_string(g_hidden_photos_count.load()) + "}";
+        }
+    }
+    else if (req.cmd == "stats") {
+        result = serve_stats_json();
+    }
+    else if (req.cmd == "reopen") {
+        {
+            std::lock_guard<std::mutex> lock(g_camera_mutex);
+            release_camera_locked();
+            init_camera_locked();
+        }
+        publish_camera_status();
+        result = camera_info_json();
+    }
+    else if (req.cmd == "quit") {
+        quit = true;
+        result = "{\"bye\":true}";
+    }
+    else {
+        error = "unknown command";
+    }
+
+    double ms = ms_since(start);
+    {
+        std::lock_guard<std::mutex> lock(g_stats_mutex);
+        std::string key = error == "unknown command" ? std::string("unknown") : req.cmd;
+        if (req.cmd == "capture" && !req.args.empty()) {
+            key += " " + req.args[0];
+        }
+        g_command_stats[key].add(ms);
+    }
+    if (req.cmd == "live_ack" && error.empty()) {
+        return std::string();   // подтверждения идут с частотой кадров, ответ на каждое не нужен
+    }
+    return error.empty() ? FormatServeReply(req, ms, result) : FormatServeError(req, ms, error);
+}
+
+// Периодическое событие с метриками, пока работает serve или multi
+static void start_metrics_reporter(std::function<std::string()> report)
+{
+    if (g_metrics_running.exchange(true)) {
+        return;
+    }
+    g_metrics_reporter = std::thread([report] {
+        auto next = std::chrono::steady_clock::now() + std::chrono::milliseconds(kMetricsIntervalMs);
+        while (g_metrics_running) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            if (std::chrono::steady_clock::now() >= next) {
+                next += std::chrono::milliseconds(kMetricsIntervalMs);
+                emit_line(report());
+            }
+        }
+    });
+}
+
+static void stop_metrics_reporter()
+{
+    if (g_metrics_running.exchange(false) && g_metrics_reporter.joinable()) {
+        g_metrics_reporter.join();
+    }
+}
+
+void shutdown_serve()
+{
+    stop_metrics_reporter();
+    stop_live();
+    if (g_hidden_mode.load()) {
+        stop_hidden_mode();
+    }
+    stop_grabber();
+    {
+        std::lock_guard<std::mutex> lock(g_camera_mutex);
+        release_camera_locked();
+    }
+    g_status.close();
+    if (g_hal.recording()) {
+        std::cerr << g_hal.summary() << std::endl;
+    }
+}
+
+// Режим serve: камера открывается один раз и остаётся тёплой, команды читаются из stdin
+int run_serve()
+{
+    g_serve_mode = true;
+    g_serve_started = std::chrono::steady_clock::now();
+    ServeOutput output;
+
+    if (!g_status.open(g_status_name)) {
+        std::cerr << "Не удалось создать блок состояния " << g_status_name << std::endl;
+    }
+    init_camera();
+    publish_camera_status();
+    start_grabber();
+    start_metrics_reporter([] {
+        return "{\"event\":\"metrics\",\"perf\":" + PerfStatsJson() + ",\"timing\":" + g_frame_timing.json() +
+               ",\"live\":" + live_json() + "}";
+    });
+    emit_line("{\"event\":\"ready\",\"status\":\"ready\"," + camera_info_json().substr(1));
+
+    std::string line;
+    bool quit = false;
+    while (!quit && std::getline(std::cin, line)) {
+        std::string reply = handle_serve_line(line, quit);
+        if (!reply.empty()) {
+            emit_line(reply);
+        }
+    }
+
+    shutdown_serve();
+    return 0;
+}
+
+// Чтение блока состояния работающего serve из другого процесса; interval_ms > 0 — следить
+int run_status(int interval_ms)
+{
+    StatusBlockReader reader;
+    if (!reader.open(g_status_name)) {
+        std::cout << "{\"error\":\"status block " << JsonEscape(g_status_name) << " not found\"}" << std::endl;
+        return 1;
+    }
+    do {
+        Lab4Status status;
+        if (!reader.snapshot(status)) {
+            std::cout << "{\"error\":\"status block busy\"}" << std::endl;
+            return 1;
+        }
+        std::cout << "{\"pid\":" << reader.writerPid() << ",\"status\":" << StatusToJson(status) << "}" << std::endl;
+        if (interval_ms > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+        }
+    } while (interval_ms > 0);
+    return 0;
+}
+
+MultiCaptureOptions multi_capture_options()
+{
+    MultiCaptureOptions options = g_multi_options;
+    options.width = kRequestedWidth;
+    options.height = kRequestedHeight;
+    options.fps = kRequestedFps;
+    options.jpegParams = g_jpeg_params;
+    return options;
+}
+
+// Режим multi: все устройства из --devices снимают параллельно, каждое в своём потоке,
+// улучшение и JPEG — в общем пуле кодировщиков. Протокол строк как у serve:
+// "<id> capture [устройство|all]", "<id> stats", "<id> quit"; фото пишутся в cam<N>/
+int run_multi()
+{
+    ServeOutput output;
+    MultiCaptureOptions options = multi_capture_options();
+    options.enhance = enhance_frame;
+    std::string photos_dir = photos_directory();
+    options.sink = [photos_dir](const EncodedFrame& f) {
+        std::string dir = photos_dir + "/cam" + std::to_string(f.device);
+        ensure_dir(photos_dir);
+        ensure_dir(dir);
+        std::string file = dir + "/photo_" + now_timestamp() + "_" + std::to_string(f.seq) + ".jpg";
+        bool ok = false;
+        {
+            PerfScope perf_scope(g_perf_write);
+            ok = write_file(file, f.jpeg);
+        }
+        std::ostringstream os;
+        os << "{\"event\":\"photo\",\"device\":" << f.device << ",\"ok\":" << (ok ? "true" : "false")
+           << ",\"file\":\"" << JsonEscape(file) << "\",\"width\":" << f.width << ",\"height\":" << f.height
+           << ",\"latency_ms\":" << f.latencyMs << ",\"requested\":" << (f.requested ? "true" : "false") << "}";
+        if (ok) {
+            g_photos_saved++;
+        }
+        emit_line(os.str());
+    };
+
+    MultiCapture multi(options);
+    std::string open_error;
+    if (!multi.open(SplitDeviceSpecs(g_device_list.empty() ? "0" : g_device_list), open_error)) {
+        emit_line("{\"event\":\"error\",\"error\":\"" + JsonEscape(open_error) + "\"}");
+        return 1;
+    }
+    multi.start();
+    start_metrics_reporter([&multi] { return "{\"event\":\"multi_metrics\",\"metrics\":" + multi.metricsJson() + "}"; });
+    emit_line("{\"event\":\"ready\",\"devices\":" + std::to_string(multi.size())
+              + ",\"encoders\":" + std::to_string(multi.encoders()) + "}");
+
+    std::string line;
+    bool quit = false;
+    while (!quit && std::getline(std::cin, line)) {
+        ServeRequest req;
+        if (!ParseServeRequest(line, req)) {
+            continue;
+        }
+        auto start = std::chrono::steady_clock::now();
+        std::string result;
+        std::string error;
+        if (req.cmd == "capture") {
+            std::string target = req.args.empty() ? "all" : req.args[0];
+            int device = target == "all" ? -1 : atoi(target.c_str());
+            if (target != "all" && target.find_first_not_of("0123456789") != std::string::npos) {
+                error = "bad device: " + target;
+            } else if (!multi.requestCapture(device)) {
+                error = "no device " + target;
+            } else {
+                result = "{\"requested\":" + std::to_string(device < 0 ? multi.size() : 1) + "}";
+            }
+        } else if (req.cmd == "stats") {
+            result = multi.metricsJson();
+        } else if (req.cmd == "quit") {
+            quit = true;
+        } else {
+            error = "unknown command";
+        }
+        double ms = ms_since(start);
+        emit_line(error.empty() ? FormatServeReply(req, ms, result) : FormatServeError(req, ms, error));
+    }
+
+    stop_metrics_reporter();
+    multi.stop();
+    emit_line("{\"event\":\"multi_metrics\",\"metrics\":" + multi.metricsJson() + "}");
+    return 0;
+}
@@ -0,0 +1,156 @@
+// Camera side of lab4 shared by the commands in main.cpp and the benches
+//
+// One camera (or file, synthetic or replayed source) is opened through the
+// HAL and guarded by g_camera_mutex. The grabber keeps it warm and holds the
+// latest frame; photos, bursts, periodic (hidden mode) capture, the live
+// preview and the serve protocol all take their frames from there. main()
+// fills the option globals below before it dispatches a command.
+#ifndef CAMERA_APP_H
+#define CAMERA_APP_H
+
+#include <opencv2/core.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "burst_capture.h"
+#include "change_gate.h"
+#include "hal_capture.h"
+#include "multi_capture.h"
+#include "photo_index.h"
+#include "../common/hal.h"
+#include "../common/perf_stats.h"
+
+// Options, set by main() from the command line
+extern HalSession g_hal;
+extern std::string g_replay_trace;
+extern std::string g_capture_source;       // --source; empty for camera 0
+extern std::string g_photos_dir;           // --photos-dir; empty for <exe dir>/photos
+extern bool g_mjpeg_passthrough;           // --mjpeg
+extern std::string g_status_name;          // --status-name
+extern ChangeGateOptions g_change_gate_options;
+extern std::string g_device_list;          // --devices
+extern MultiCaptureOptions g_multi_options;
+
+extern std::mutex g_camera_mutex;
+extern std::atomic<bool> g_app_running;
+extern std::atomic<bool> g_hidden_mode;
+extern std::vector<int> g_jpeg_params;
+
+// Serve mode: replies go to g_reply_out under g_reply_mutex, everything else to stderr
+extern std::atomic<bool> g_serve_mode;
+extern std::ostream* g_reply_out;
+extern std::mutex g_reply_mutex;
+extern std::chrono::steady_clock::time_point g_serve_started;
+extern std::mutex g_stats_mutex;
+extern std::map<std::string, LatencyStats> g_command_stats;
+extern std::vector<std::string>* g_saved_files;   // bench collects its photos to delete them
+
+// While alive, std::cout goes to stderr and emit_line() to the real stdout
+class ServeOutput {
+public:
+    ServeOutput() : replies_(std::cout.rdbuf()), saved_(std::cout.rdbuf())
+    {
+        std::cout.rdbuf(std::cerr.rdbuf());
+        g_reply_out = &replies_;
+    }
+    ~ServeOutput()
+    {
+        g_reply_out = &std::cout;
+        std::cout.rdbuf(saved_);
+    }
+
+private:
+    std::ostream replies_;
+    std::streambuf* saved_;
+};
+
+// Helpers
+void ensure_dir(const std::string& dir);
+unsigned long long tick_count_ms();
+bool write_file(const std::string& path, const std::vector<uchar>& data);
+uint64_t unix_time_ms();
+double ms_since(const std::chrono::steady_clock::time_point& start);
+std::string exe_directory();
+PhotoIndex& photo_index();
+bool file_source();
+void emit_line(const std::string& line);
+
+// Camera and photos
+bool init_camera();
+void release_camera_locked();
+void display_camera_info();
+bool validate_frame(const cv::Mat& captured, double& totalMean, double& totalVariance);
+cv::Mat enhance_frame(const cv::Mat& frame);
+void capture_and_save_photo();
+
+// Grabber
+void start_grabber();
+void stop_grabber();
+bool wait_fresh_frame(uint64_t& seq, int timeout_ms, cv::Mat& frame,
+                      std::chrono::steady_clock::time_point* grabbed_at = nullptr);
+
+// Burst capture
+const int kMaxBurstFrames = 120;
+
+struct BurstOptions {
+    int frames = 10;
+    BurstKeep keep = BurstKeep::kBest;
+    bool enhance = true;
+    int encoders = 0;               // 0: по числу ядер
+    bool inlineEncode = false;      // для сравнения в burst_bench: кодировать прямо в цикле захвата
+    bool index = true;              // заносить снимки в индекс фото (bench их потом удаляет)
+};
+
+struct BurstResult {
+    bool ok = false;
+    std::string error;
+    int frames = 0;
+    int encoders = 0;
+    double fps = 0.0;               // achieved over the burst
+    double sourceFps = 0.0;         // what the camera reports
+    int dropped = 0;                // frame periods with no frame, from the intervals
+    int outOfPlace = 0;             // reads that did not land in the arena
+    uint64_t arenaAllocations = 0;  // arena buffers allocated for this burst
+    size_t arenaBytes = 0;
+    LatencyStats intervals;
+    double captureMs = 0.0;
+    double scoreMs = 0.0;
+    double encodeMs = 0.0;
+    int best = -1;
+    std::vector<double> scores;
+    std::vector<std::string> files;
+};
+
+extern std::mutex g_burst_mutex;    // one burst at a time: the arena is shared
+bool capture_burst_locked(HalCapture& camera, bool pace, const BurstOptions& options,
+                          const std::string& prefix, BurstResult& result);
+void encode_burst(const BurstOptions& options, const std::string& prefix, BurstResult& result);
+BurstResult capture_burst(const BurstOptions& options);
+bool parse_burst_args(const std::vector<std::string>& args, BurstOptions& options, std::string& error);
+
+// Periodic capture
+void start_hidden_mode(int interval_ms = 5000, bool hide_console = true);
+void stop_hidden_mode();
+
+// Live preview and serve
+void start_live(int max_side);
+void stop_live();
+std::string live_json();
+std::string serve_stats_json();
+std::string handle_serve_line(const std::string& line, bool& quit);
+void shutdown_serve();
+int run_serve();
+
+// Status block reader and multi-device capture
+int run_status(int interval_ms);
+MultiCaptureOptions multi_capture_options();
+int run_multi();
+
+#endif // CAMERA_APP_H
@@ -0,0 +1,162 @@
+// Scene-change gate for lab4 periodic capture
+#include "change_gate.h"
+
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const int kHashSide = 32;
+// In orthonormal DCT units: a cosine of 1 grey level across the thumbnail is 16
+const float kPHashMargin = 4.0f;
+
+// Downscaled first: converting 32x32 pixels to gray is nothing, a full frame is not
+cv::Mat gray_thumbnail(const cv::Mat& frame, int width, int height)
+{
+    cv::Mat small;
+    cv::resize(frame, small, cv::Size(width, height), 0, 0, cv::INTER_AREA);
+    if (small.channels() == 3) {
+        cv::cvtColor(small, small, cv::COLOR_BGR2GRAY);
+    } else if (small.channels() == 4) {
+        cv::cvtColor(small, small, cv::COLOR_BGRA2GRAY);
+    }
+    return small;
+}
+
+uint64_t difference_hash(const cv::Mat& thumb)
+{
+    cv::Mat reduced;
+    cv::resize(thumb, reduced, cv::Size(9, 8), 0, 0, cv::INTER_AREA);
+    uint64_t hash = 0;
+    for (int y = 0; y < 8; y++) {
+        const uchar* row = reduced.ptr<uchar>(y);
+        for (int x = 0; x < 8; x++) {
+            hash = (hash << 1) | (row[x] < row[x + 1] ? 1u : 0u);
+        }
+    }
+    return hash;
+}
+
+uint64_t perceptual_hash(const cv::Mat& thumb)
+{
+    cv::Mat pixels, freq;
+    thumb.convertTo(pixels, CV_32F);
+    cv::dct(pixels, freq);
+    float coeffs[64];
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            coeffs[y * 8 + x] = freq.at<float>(y, x);
+        }
+    }
+    // The DC term is the mean brightness, not structure
+    std::vector<float> ac(coeffs + 1, coeffs + 64);
+    std::nth_element(ac.begin(), ac.begin() + ac.size() / 2, ac.end());
+    // A flat or symmetric scene leaves many coefficients next to zero, where
+    // noise alone would flip them around the median; they only count as set
+    // once they clear it by a margin
+    float threshold = ac[ac.size() / 2] + kPHashMargin;
+    uint64_t hash = 0;
+    for (int i = 0; i < 64; i++) {
+        hash = (hash << 1) | (coeffs[i] > threshold ? 1u : 0u);
+    }
+    return hash;
+}
+
+} // namespace
+
+bool ParseFrameHashKind(const std::string& name, FrameHashKind& kind)
+{
+    if (name == "d" || name == "dhash") {
+        kind = FrameHashKind::kDHash;
+        return true;
+    }
+    if (name == "p" || name == "phash") {
+        kind = FrameHashKind::kPHash;
+        return true;
+    }
+    return false;
+}
+
+const char* FrameHashName(FrameHashKind kind)
+{
+    return kind == FrameHashKind::kDHash ? "dhash" : "phash";
+}
+
+uint64_t FrameHash(const cv::Mat& frame, FrameHashKind kind)
+{
+    if (frame.empty()) {
+        return 0;
+    }
+    cv::Mat thumb = gray_thumbnail(frame, kHashSide, kHashSide);
+    return kind == FrameHashKind::kDHash ? difference_hash(thumb) : perceptual_hash(thumb);
+}
+
+int HammingDistance(uint64_t a, uint64_t b)
+{
+    uint64_t x = a ^ b;
+    int bits = 0;
+    while (x) {
+        x &= x - 1;
+        bits++;
+    }
+    return bits;
+}
+
+ChangeGate::ChangeGate(const ChangeGateOptions& options) : options_(options)
+{
+}
+
+ChangeGate::Decision ChangeGate::check(uint64_t hash, int64_t nowMs)
+{
+    Decision decision;
+    if (!haveReference_) {
+        lastDistance_ = 64;
+        decision = kFirst;
+    } else {
+        // Against the last saved frame, so a slow drift adds up until it shows
+        lastDistance_ = HammingDistance(hash, reference_);
+        if (lastDistance_ >= options_.threshold) {
+            decision = kChanged;
+        } else if (nowMs - referenceMs_ >= options_.heartbeatMs) {
+            decision = kHeartbeat;
+        } else {
+            skipped_++;
+            return kSkip;
+        }
+    }
+    if (decision == kHeartbeat) {
+        heartbeats_++;
+    }
+    saved_++;
+    haveReference_ = true;
+    reference_ = hash;
+    referenceMs_ = nowMs;
+    return decision;
+}
+
+ChangeGate::Decision ChangeGate::check(const cv::Mat& frame, int64_t nowMs)
+{
+    return check(FrameHash(frame, options_.hash), nowMs);
+}
+
+void ChangeGate::reset()
+{
+    haveReference_ = false;
+    lastDistance_ = 0;
+    saved_ = skipped_ = heartbeats_ = 0;
+}
+
+std::string ChangeGate::toJson() const
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "{\"threshold\":%d,\"hash\":\"%s\",\"heartbeat_ms\":%d,\"saved\":%llu,\"skipped\":%llu,"
+             "\"heartbeats\":%llu,\"last_distance\":%d}",
+             options_.threshold, FrameHashName(options_.hash), options_.heartbeatMs,
+             (unsigned long long)saved_, (unsigned long long)skipped_, (unsigned long long)heartbeats_,
+             lastDistance_);
+    return buf;
+}
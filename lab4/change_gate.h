@@ -0,0 +1,84 @@
+// Scene-change gate for lab4 periodic capture
+//
+// A periodic shot of a still scene is the same picture every time. The gate
+// keeps a 64-bit perceptual hash of the last frame that was saved and lets a
+// new frame through only when its hash differs in at least `threshold` bits,
+// or when `heartbeatMs` have passed since the last save so a still scene is
+// still confirmed now and then. Both hashes work on a 32x32 grayscale
+// downscale, which sensor noise and JPEG artefacts barely touch:
+//   dHash - sign of the horizontal gradient on a 9x8 reduction of it
+//   pHash - sign against the median of the 8x8 lowest DCT frequencies
+// pHash is the default: sensor noise flips at most 2 of its bits, even on a
+// flat wall, while a small object moving shifts 6 or more, so a threshold of
+// 4 separates them. dHash is a little cheaper, but on flat areas its bits
+// follow the noise and it can miss motion.
+#ifndef CHANGE_GATE_H
+#define CHANGE_GATE_H
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <string>
+
+enum class FrameHashKind {
+    kDHash,
+    kPHash
+};
+
+// "d"/"dhash" or "p"/"phash"; false for anything else
+bool ParseFrameHashKind(const std::string& name, FrameHashKind& kind);
+const char* FrameHashName(FrameHashKind kind);
+
+// Hash of a BGR or grayscale frame; 0 for an empty one
+uint64_t FrameHash(const cv::Mat& frame, FrameHashKind kind);
+
+int HammingDistance(uint64_t a, uint64_t b);
+
+struct ChangeGateOptions {
+    int threshold = 0;          // bits; 0 disables the gate
+    int heartbeatMs = 60000;    // longest run of skipped frames
+    FrameHashKind hash = FrameHashKind::kPHash;
+};
+
+class ChangeGate {
+public:
+    enum Decision {
+        kFirst,         // nothing saved yet
+        kChanged,
+        kHeartbeat,
+        kSkip
+    };
+
+    explicit ChangeGate(const ChangeGateOptions& options = ChangeGateOptions());
+
+    bool enabled() const { return options_.threshold > 0; }
+    const ChangeGateOptions& options() const { return options_; }
+
+    // Decides for a frame hashed at nowMs; anything but kSkip counts as saved
+    // and becomes the new reference
+    Decision check(uint64_t hash, int64_t nowMs);
+    // Hashes the frame first
+    Decision check(const cv::Mat& frame, int64_t nowMs);
+
+    void reset();
+
+    uint64_t saved() const { return saved_; }
+    uint64_t skipped() const { return skipped_; }
+    uint64_t heartbeats() const { return heartbeats_; }
+    int lastDistance() const { return lastDistance_; }
+
+    // {"threshold":..,"hash":"phash","heartbeat_ms":..,"saved":..,"skipped":..,...}
+    std::string toJson() const;
+
+private:
+    ChangeGateOptions options_;
+    bool haveReference_ = false;
+    uint64_t reference_ = 0;
+    int64_t referenceMs_ = 0;
+    int lastDistance_ = 0;
+    uint64_t saved_ = 0;
+    uint64_t skipped_ = 0;
+    uint64_t heartbeats_ = 0;
+};
+
+#endif // CHANGE_GATE_H
@@ -0,0 +1,202 @@
+// Capture timing analyzer for lab4
+#include "frame_timing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace {
+
+const size_t kPeriodSamples = 64;
+const size_t kJitterSamples = 1024;
+// Intervals needed before a gap can be told apart from the normal period
+const size_t kMinPeriodSamples = 8;
+
+double percentile(std::vector<double> values, double p)
+{
+    if (values.empty()) {
+        return 0.0;
+    }
+    size_t k = std::min(values.size() - 1, (size_t)(p / 100.0 * (double)values.size()));
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
+
+} // namespace
+
+bool FrameStampRing::push(const FrameStamp& stamp)
+{
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= kCapacity) {
+        overruns_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    slots_[head % kCapacity] = stamp;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+size_t FrameStampRing::drain(std::vector<FrameStamp>& out)
+{
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    for (uint64_t i = tail; i < head; i++) {
+        out.push_back(slots_[i % kCapacity]);
+    }
+    tail_.store(head, std::memory_order_release);
+    return (size_t)(head - tail);
+}
+
+const std::vector<double>& FrameTimingAnalyzer::HistogramEdgesMs()
+{
+    static const std::vector<double> edges = { 5, 10, 15, 20, 25, 30, 35, 40, 50, 67, 100, 200, 500, 1000 };
+    return edges;
+}
+
+void FrameTimingAnalyzer::reset(double nominalFps)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    batch_.clear();
+    ring_.drain(batch_);
+    batch_.clear();
+    uint64_t overruns = stats_.overruns;
+    stats_ = FrameTimingStats();
+    stats_.nominalFps = nominalFps;
+    stats_.overruns = overruns;
+    haveLast_ = false;
+    backendUsable_ = true;
+    periodKnown_ = false;
+    intervals_.clear();
+    recentHostNs_.clear();
+    jitter_.clear();
+    jitterSeen_ = 0;
+}
+
+void FrameTimingAnalyzer::consume(const FrameStamp& stamp)
+{
+    stats_.frames++;
+    recentHostNs_.push_back(stamp.hostNs);
+    while (recentHostNs_.size() > 2 && stamp.hostNs - recentHostNs_.front() > kFpsWindowSec * 1000000000LL) {
+        recentHostNs_.pop_front();
+    }
+    if (!haveLast_) {
+        last_ = stamp;
+        haveLast_ = true;
+        return;
+    }
+
+    double dt = (stamp.hostNs - last_.hostNs) / 1e6;
+    bool backend = false;
+    if (backendUsable_ && stamp.backendMs >= 0.0 && last_.backendMs >= 0.0) {
+        if (stamp.backendMs > last_.backendMs) {
+            dt = stamp.backendMs - last_.backendMs;
+            backend = true;
+        } else if (stamp.backendMs < last_.backendMs) {
+            // A file source rewound: no interval across the jump
+            last_ = stamp;
+            return;
+        } else {
+            // A position that doesn't move is not a clock
+            backendUsable_ = false;
+        }
+    }
+    last_ = stamp;
+    stats_.backendClock = backend;
+    if (dt <= 0.0) {
+        return;
+    }
+
+    const std::vector<double>& edges = HistogramEdgesMs();
+    stats_.histogram.resize(edges.size() + 1);
+    stats_.histogram[std::lower_bound(edges.begin(), edges.end(), dt) - edges.begin()]++;
+
+    if (!periodKnown_) {
+        intervals_.push_back(dt);
+        if (intervals_.size() < kMinPeriodSamples) {
+            return;
+        }
+        // The first intervals came before the period was known: judge them now.
+        // The lower quartile, not the median: a source that loses every other
+        // frame has as many gaps as periods in its first few intervals
+        std::deque<double> early;
+        early.swap(intervals_);
+        double period = percentile(std::vector<double>(early.begin(), early.end()), 25);
+        periodKnown_ = true;
+        for (double interval : early) {
+            classify(interval, period);
+        }
+        return;
+    }
+    classify(dt, percentile(std::vector<double>(intervals_.begin(), intervals_.end()), 50));
+}
+
+void FrameTimingAnalyzer::classify(double dt, double period)
+{
+    stats_.periodMs = period;
+    double periods = std::max(1.0, std::floor(dt / period + 0.5));
+    if (periods >= 2.0) {
+        stats_.dropped += (uint64_t)periods - 1;
+        stats_.dropEvents++;
+    }
+    double jitter = std::fabs(dt - periods * period);
+    stats_.jitterMaxMs = std::max(stats_.jitterMaxMs, jitter);
+    if (jitter_.size() < kJitterSamples) {
+        jitter_.push_back(jitter);
+    } else {
+        jitter_[jitterSeen_ % kJitterSamples] = jitter;
+    }
+    jitterSeen_++;
+    // A gap is not the period: keep it out of the median
+    if (periods >= 2.0) {
+        return;
+    }
+    intervals_.push_back(dt);
+    if (intervals_.size() > kPeriodSamples) {
+        intervals_.pop_front();
+    }
+}
+
+FrameTimingStats FrameTimingAnalyzer::stats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    batch_.clear();
+    ring_.drain(batch_);
+    for (const FrameStamp& stamp : batch_) {
+        consume(stamp);
+    }
+    stats_.overruns = ring_.overruns();
+    if (recentHostNs_.size() >= 2) {
+        double span = (recentHostNs_.back() - recentHostNs_.front()) / 1e9;
+        stats_.fps = span > 0.0 ? (recentHostNs_.size() - 1) / span : 0.0;
+    }
+    stats_.jitterP50Ms = percentile(jitter_, 50);
+    stats_.jitterP95Ms = percentile(jitter_, 95);
+    stats_.jitterP99Ms = percentile(jitter_, 99);
+    stats_.histogram.resize(HistogramEdgesMs().size() + 1);
+    return stats_;
+}
+
+std::string FrameTimingAnalyzer::json()
+{
+    FrameTimingStats s = stats();
+    std::ostringstream os;
+    os.setf(std::ios::fixed);
+    os.precision(2);
+    os << "{\"frames\":" << s.frames << ",\"fps\":" << s.fps << ",\"nominal_fps\":" << s.nominalFps
+       << ",\"period_ms\":" << s.periodMs << ",\"dropped\":" << s.dropped << ",\"drop_events\":" << s.dropEvents
+       << ",\"clock\":\"" << (s.backendClock ? "backend" : "host") << "\""
+       << ",\"jitter_ms\":{\"p50\":" << s.jitterP50Ms << ",\"p95\":" << s.jitterP95Ms << ",\"p99\":" << s.jitterP99Ms
+       << ",\"max\":" << s.jitterMaxMs << "},\"histogram\":[";
+    const std::vector<double>& edges = HistogramEdgesMs();
+    for (size_t i = 0; i < s.histogram.size(); i++) {
+        os << (i ? "," : "") << "{\"le_ms\":";
+        if (i < edges.size()) {
+            os << edges[i];
+        } else {
+            os << "null";
+        }
+        os << ",\"count\":" << s.histogram[i] << "}";
+    }
+    os << "],\"ring_overruns\":" << s.overruns << "}";
+    return os.str();
+}
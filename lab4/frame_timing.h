@@ -0,0 +1,103 @@
+// Capture timing analyzer for lab4
+//
+// The grabber stamps every frame it gets with a steady-clock time and the
+// backend's own timestamp (CAP_PROP_POS_MSEC: the V4L2 buffer time, the
+// Media Foundation sample time, a file's position) and pushes the pair into
+// a single-producer ring. The push is two relaxed loads, a slot write and a
+// release store: no lock, no allocation, and a full ring drops the stamp and
+// counts it instead of waiting. Whoever asks for the numbers (info, the
+// metrics record) drains the ring under the analyzer's own mutex, which the
+// grabber never takes.
+//
+// Intervals come from the backend timestamps while they increase, and from
+// the host clock otherwise. The frame period is the median of the last 64
+// intervals, so a gap of k periods means k - 1 frames that never arrived,
+// and jitter is how far an interval lands from the nearest whole number of
+// periods. Actual fps is measured over the last few seconds of frames. A
+// source that steadily loses every other frame has no gaps to see; it shows
+// up as fps well below nominal_fps instead.
+#ifndef FRAME_TIMING_H
+#define FRAME_TIMING_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct FrameStamp {
+    int64_t hostNs = 0;         // steady clock
+    double backendMs = -1.0;    // CAP_PROP_POS_MSEC; negative when the backend has none
+};
+
+// Lock-free ring for exactly one producer and one consumer at a time
+class FrameStampRing {
+public:
+    static const size_t kCapacity = 4096;
+
+    // Producer; false (and counted) when the consumer is kCapacity behind
+    bool push(const FrameStamp& stamp);
+    // Consumer; appends everything pushed so far
+    size_t drain(std::vector<FrameStamp>& out);
+    uint64_t overruns() const { return overruns_.load(std::memory_order_relaxed); }
+
+private:
+    std::array<FrameStamp, kCapacity> slots_;
+    std::atomic<uint64_t> head_{ 0 };   // written by the producer
+    std::atomic<uint64_t> tail_{ 0 };   // written by the consumer
+    std::atomic<uint64_t> overruns_{ 0 };
+};
+
+struct FrameTimingStats {
+    uint64_t frames = 0;
+    double fps = 0.0;               // over the last kFpsWindowSec
+    double nominalFps = 0.0;        // what the backend claims (CAP_PROP_FPS)
+    double periodMs = 0.0;          // median interval
+    uint64_t dropped = 0;           // inferred from gaps
+    uint64_t dropEvents = 0;        // gaps of two periods or more
+    bool backendClock = false;      // intervals from backend timestamps
+    double jitterP50Ms = 0.0;       // |interval - k * period|
+    double jitterP95Ms = 0.0;
+    double jitterP99Ms = 0.0;
+    double jitterMaxMs = 0.0;
+    std::vector<uint64_t> histogram;    // interval counts, kHistogramEdgesMs buckets
+    uint64_t overruns = 0;
+};
+
+class FrameTimingAnalyzer {
+public:
+    static const int kFpsWindowSec = 5;
+    // Upper bucket edges of the interval histogram; the last bucket is open
+    static const std::vector<double>& HistogramEdgesMs();
+
+    // Grabber thread, once per frame
+    void record(int64_t hostNs, double backendMs) { ring_.push(FrameStamp{ hostNs, backendMs }); }
+
+    // Forgets everything, e.g. after the camera was reopened
+    void reset(double nominalFps);
+
+    FrameTimingStats stats();
+    // {"frames":...,"fps":...,"jitter_ms":{...},"histogram":[...],...}
+    std::string json();
+
+private:
+    void consume(const FrameStamp& stamp);
+    void classify(double intervalMs, double periodMs);
+
+    FrameStampRing ring_;
+    std::mutex mutex_;
+    std::vector<FrameStamp> batch_;
+    FrameTimingStats stats_;
+    FrameStamp last_;
+    bool haveLast_ = false;
+    bool backendUsable_ = true;
+    bool periodKnown_ = false;
+    std::deque<double> intervals_;      // recent raw intervals, for the period
+    std::deque<int64_t> recentHostNs_;  // for fps
+    std::vector<double> jitter_;        // bounded sample for the percentiles
+    uint64_t jitterSeen_ = 0;
+};
+
+#endif // FRAME_TIMING_H
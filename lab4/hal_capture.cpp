@@ -0,0 +1,205 @@
+// Camera channel of the HAL for lab4
+#include "hal_capture.h"
+
+#include <opencv2/imgcodecs.hpp>
+
+#include "mjpeg_passthrough.h"
+
+namespace {
+
+enum FrameKind {
+    kDecodedFrame = 0,
+    kRawJpegFrame = 1
+};
+
+const std::vector<int> kTraceJpegParams{ cv::IMWRITE_JPEG_QUALITY, 95 };
+
+} // namespace
+
+void EncodeCameraSample(HalEncoder& e, const CameraSample& sample)
+{
+    e.i64(sample.width);
+    e.i64(sample.height);
+    e.f64(sample.fps);
+    if (IsJpegBuffer(sample.frame)) {
+        e.u64(kRawJpegFrame);
+        e.bytes(sample.frame.ptr(), sample.frame.total());
+        return;
+    }
+    std::vector<uchar> jpeg;
+    if (!sample.frame.empty()) {
+        cv::imencode(".jpg", sample.frame, jpeg, kTraceJpegParams);
+    }
+    e.u64(kDecodedFrame);
+    e.bytes(jpeg.data(), jpeg.size());
+}
+
+bool DecodeCameraSample(HalDecoder& d, CameraSample& sample)
+{
+    sample.width = (int)d.i64();
+    sample.height = (int)d.i64();
+    sample.fps = d.f64();
+    uint64_t kind = d.u64();
+    std::string data = d.str();
+    if (!d.ok() || data.empty()) {
+        return false;
+    }
+    cv::Mat buffer(1, (int)data.size(), CV_8UC1, &data[0]);
+    sample.frame = kind == kRawJpegFrame ? buffer.clone() : cv::imdecode(buffer, cv::IMREAD_COLOR);
+    return !sample.frame.empty();
+}
+
+HalCapture::HalCapture(HalSession& hal)
+    : hal_(hal), device_(*this)
+{
+}
+
+bool HalCapture::DeviceFrames::read(CameraSample& out)
+{
+    cv::Mat frame;
+    if (!owner_.deviceRead(frame) || frame.empty()) {
+        return false;
+    }
+    out.frame = frame;
+    out.width = (int)owner_.deviceGet(cv::CAP_PROP_FRAME_WIDTH);
+    out.height = (int)owner_.deviceGet(cv::CAP_PROP_FRAME_HEIGHT);
+    out.fps = owner_.deviceGet(cv::CAP_PROP_FPS);
+    return true;
+}
+
+bool HalCapture::deviceRead(cv::OutputArray image)
+{
+    return plugin_ ? plugin_->read(image) : cv::VideoCapture::read(image);
+}
+
+double HalCapture::deviceGet(int propId) const
+{
+    return plugin_ ? plugin_->get(propId) : cv::VideoCapture::get(propId);
+}
+
+bool HalCapture::openReplay()
+{
+    // Reopening continues where the previous capture stopped reading the trace
+    if (!frames_) {
+        frames_ = hal_.source<CameraSample>(nullptr, EncodeCameraSample, DecodeCameraSample);
+    }
+    prefetched_ = frames_->read(current_);
+    replayOpen_ = prefetched_;
+    return replayOpen_;
+}
+
+bool HalCapture::open(const cv::String& filename, int apiPreference)
+{
+    if (hal_.replaying()) {
+        return openReplay();
+    }
+    if (IsSyntheticSource(filename)) {
+        cv::VideoCapture::release();
+        plugin_.reset(new PluginCapture(SyntheticCameraPlugin()));
+        if (!plugin_->open(filename)) {
+            plugin_.reset();
+            return false;
+        }
+        return true;
+    }
+    plugin_.reset();
+    return cv::VideoCapture::open(filename, apiPreference);
+}
+
+bool HalCapture::open(int index, int apiPreference)
+{
+    if (hal_.replaying()) {
+        return openReplay();
+    }
+    plugin_.reset();
+    return cv::VideoCapture::open(index, apiPreference);
+}
+
+bool HalCapture::isOpened() const
+{
+    if (hal_.replaying()) {
+        return replayOpen_;
+    }
+    return plugin_ ? plugin_->isOpened() : cv::VideoCapture::isOpened();
+}
+
+void HalCapture::release()
+{
+    replayOpen_ = false;
+    prefetched_ = false;
+    plugin_.reset();
+    cv::VideoCapture::release();
+}
+
+bool HalCapture::read(cv::OutputArray image)
+{
+    if (!hal_.replaying()) {
+        if (!hal_.recording()) {
+            return deviceRead(image);
+        }
+        if (!frames_) {
+            frames_ = hal_.source<CameraSample>(&device_, EncodeCameraSample, DecodeCameraSample);
+        }
+        CameraSample sample;
+        if (!frames_->read(sample)) {
+            image.release();
+            return false;
+        }
+        sample.frame.copyTo(image);
+        return true;
+    }
+
+    if (!replayOpen_) {
+        image.release();
+        return false;
+    }
+    if (prefetched_) {
+        prefetched_ = false;
+    } else if (!frames_->read(current_)) {
+        // End of the trace: the camera is gone, like an unplugged device
+        replayOpen_ = false;
+        image.release();
+        return false;
+    }
+    // Raw buffers are handed out as they are only when the caller asked for them
+    if (IsJpegBuffer(current_.frame) && !rawRequested_) {
+        image.assign(cv::imdecode(current_.frame, cv::IMREAD_COLOR));
+    } else {
+        current_.frame.copyTo(image);
+    }
+    return true;
+}
+
+bool HalCapture::set(int propId, double value)
+{
+    if (!hal_.replaying()) {
+        return plugin_ ? plugin_->set(propId, value) : cv::VideoCapture::set(propId, value);
+    }
+    // Only the raw-buffer switch means something for a trace, and only for a raw one
+    if (propId == cv::CAP_PROP_FORMAT || propId == cv::CAP_PROP_CONVERT_RGB) {
+        rawRequested_ = propId == cv::CAP_PROP_FORMAT ? value < 0 : value == 0;
+        return rawRequested_ && IsJpegBuffer(current_.frame);
+    }
+    return false;
+}
+
+double HalCapture::get(int propId) const
+{
+    if (!hal_.replaying()) {
+        return deviceGet(propId);
+    }
+    switch (propId) {
+    case cv::CAP_PROP_FRAME_WIDTH: return current_.width;
+    case cv::CAP_PROP_FRAME_HEIGHT: return current_.height;
+    case cv::CAP_PROP_FPS: return current_.fps;
+    default: return 0.0;
+    }
+}
+
+std::string HalCapture::backendName() const
+{
+    if (hal_.replaying()) {
+        return "replay";
+    }
+    return plugin_ ? std::string("synthetic") : cv::VideoCapture::getBackendName();
+}
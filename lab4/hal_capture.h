@@ -0,0 +1,76 @@
+// Camera channel of the HAL for lab4
+//
+// HalCapture is a cv::VideoCapture whose frames go through a HalSession: live
+// it is a plain capture, with --record every frame it reads is appended to
+// the trace, with --replay it opens no device and hands out the recorded
+// frames on the session's virtual clock. A raw MJPEG buffer (--mjpeg) is
+// stored as it is, a decoded frame as a quality-95 JPEG; each record also
+// carries the frame size and nominal fps so get() answers like the camera.
+// A "synthetic:..." file name opens the synthetic camera plugin instead of
+// an OpenCV backend; it records and replays like any other device.
+#ifndef HAL_CAPTURE_H
+#define HAL_CAPTURE_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+#include <memory>
+
+#include "plugin_capture.h"
+#include "../common/hal.h"
+
+struct CameraSample {
+    cv::Mat frame;      // decoded image or 1xN raw JPEG buffer
+    int width = 0;
+    int height = 0;
+    double fps = 0.0;
+};
+
+void EncodeCameraSample(HalEncoder& e, const CameraSample& sample);
+bool DecodeCameraSample(HalDecoder& d, CameraSample& sample);
+
+class HalCapture : public cv::VideoCapture {
+public:
+    explicit HalCapture(HalSession& hal);
+
+    using cv::VideoCapture::open;
+    bool open(const cv::String& filename, int apiPreference) override;
+    bool open(int index, int apiPreference) override;
+    bool isOpened() const override;
+    void release() override;
+    bool read(cv::OutputArray image) override;
+    bool set(int propId, double value) override;
+    double get(int propId) const override;
+
+    // "replay" while a trace is played, "synthetic" for the plugin camera,
+    // otherwise the OpenCV backend name
+    std::string backendName() const;
+
+private:
+    // Frames straight from the device, for the recorder to wrap
+    class DeviceFrames : public HalSource<CameraSample> {
+    public:
+        explicit DeviceFrames(HalCapture& owner) : owner_(owner) {}
+        bool read(CameraSample& out) override;
+
+    private:
+        HalCapture& owner_;
+    };
+
+    bool openReplay();
+    // The live device: the synthetic plugin when one is open, else OpenCV
+    bool deviceRead(cv::OutputArray image);
+    double deviceGet(int propId) const;
+
+    HalSession& hal_;
+    std::unique_ptr<PluginCapture> plugin_;
+    DeviceFrames device_;
+    HalSource<CameraSample>* frames_ = nullptr;
+    // Replay state: the sample get() describes and one read ahead at open
+    CameraSample current_;
+    bool prefetched_ = false;
+    bool replayOpen_ = false;
+    bool rawRequested_ = false;
+};
+
+#endif // HAL_CAPTURE_H
@@ -0,0 +1,211 @@
+// Adaptive live preview for lab4
+#include "live_preview.h"
+
+#include "mjpeg_passthrough.h"
+#include "photo_index.h"
+
+#include <opencv2/imgcodecs.hpp>
+
+#include <algorithm>
+#include <sstream>
+
+namespace {
+
+// Good periods needed before stepping up
+const int kGoodPeriodsToRaise = 3;
+// Share of the consumer's drain rate the next level may need
+const double kDrainHeadroom = 0.6;
+
+} // namespace
+
+const std::vector<LivePreviewLevel>& LivePreviewRate::Levels()
+{
+    static const std::vector<LivePreviewLevel> levels = {
+        { 1280, 80, 30 }, { 960, 75, 30 }, { 640, 70, 30 }, { 640, 60, 20 },
+        { 480, 55, 15 }, { 320, 50, 10 }, { 320, 40, 5 },
+    };
+    return levels;
+}
+
+LivePreviewRate::LivePreviewRate(const LivePreviewOptions& options)
+    : options_(options)
+{
+}
+
+void LivePreviewRate::reset(double nowSec, double sourceFps, int sourceSide)
+{
+    sourceFps_ = sourceFps > 0 && sourceFps <= 1000 ? sourceFps : 30.0;
+    sourceSide_ = sourceSide;
+    inFlight_.clear();
+    period_ = Period();
+    last_ = Period();
+    goodPeriods_ = 0;
+    drainBytesPerSec_ = 0.0;
+    totalSent_ = totalStalled_ = totalLost_ = levelChanges_ = 0;
+    level_ = 0;
+    nextDueSec_ = nowSec;
+    periodStartSec_ = nowSec;
+}
+
+LivePreviewLevel LivePreviewRate::level() const
+{
+    return levelAt(level_);
+}
+
+LivePreviewLevel LivePreviewRate::levelAt(int index) const
+{
+    LivePreviewLevel level = Levels()[index];
+    level.side = std::min(level.side, options_.maxSide);
+    if (sourceSide_ > 0) {
+        level.side = std::min(level.side, sourceSide_);
+    }
+    level.fps = std::min(level.fps, sourceFps_);
+    return level;
+}
+
+void LivePreviewRate::setLevel(int level, double nowSec)
+{
+    level = std::max(0, std::min(level, (int)Levels().size() - 1));
+    if (level == level_) {
+        return;
+    }
+    level_ = level;
+    levelChanges_++;
+    goodPeriods_ = 0;
+    nextDueSec_ = nowSec;
+}
+
+void LivePreviewRate::expire(double nowSec)
+{
+    while (!inFlight_.empty() && nowSec - inFlight_.front().sentSec > options_.ackTimeoutSec) {
+        inFlight_.pop_front();
+        period_.lost++;
+        totalLost_++;
+    }
+}
+
+bool LivePreviewRate::admit(double nowSec)
+{
+    if (nowSec - periodStartSec_ >= options_.evalSec) {
+        evaluate(nowSec);
+    }
+    // Frames arrive with their own jitter: half a source interval of slack
+    double slack = 0.5 / sourceFps_;
+    if (nowSec + slack < nextDueSec_) {
+        return false;
+    }
+    double interval = 1.0 / level().fps;
+    nextDueSec_ = std::max(nextDueSec_ + interval, nowSec - interval);
+    period_.due++;
+    expire(nowSec);
+    if ((int)inFlight_.size() >= options_.inFlight) {
+        period_.stalled++;
+        totalStalled_++;
+        return false;
+    }
+    return true;
+}
+
+void LivePreviewRate::sent(uint64_t seq, size_t bytes, double encodeMs, double nowSec)
+{
+    inFlight_.push_back(InFlight{ seq, nowSec, bytes });
+    period_.sent++;
+    period_.bytesSent += bytes;
+    period_.encodeMs += encodeMs;
+    totalSent_++;
+}
+
+void LivePreviewRate::acked(uint64_t seq, double nowSec)
+{
+    while (!inFlight_.empty() && inFlight_.front().seq <= seq) {
+        period_.acks++;
+        period_.ackSec += nowSec - inFlight_.front().sentSec;
+        period_.bytesAcked += inFlight_.front().bytes;
+        inFlight_.pop_front();
+    }
+}
+
+void LivePreviewRate::evaluate(double nowSec)
+{
+    Period p = period_;
+    period_ = Period();
+    periodStartSec_ = nowSec;
+    if (p.due == 0) {
+        return;     // no frames from the grabber: nothing to judge
+    }
+    last_ = p;
+
+    LivePreviewLevel current = level();
+    double interval = 1.0 / current.fps;
+    double ackMean = p.acks ? p.ackSec / p.acks : 0.0;
+    double encodeMean = p.sent ? p.encodeMs / 1000.0 / p.sent : 0.0;
+    if (p.acks && p.ackSec > 0.0) {
+        // Bytes the consumer takes per second of its own time: queueing in the
+        // window only makes this lower, so it errs on the safe side
+        double drain = p.bytesAcked / p.ackSec;
+        drainBytesPerSec_ = drainBytesPerSec_ == 0.0 ? drain : drainBytesPerSec_ * 0.5 + drain * 0.5;
+    }
+
+    bool congested = p.stalled * 5 > p.due || p.lost > 0 || ackMean > 2 * interval || encodeMean > 0.8 * interval;
+    if (congested) {
+        // Mostly stalled: the consumer is far behind, take two steps
+        setLevel(level_ + (p.stalled * 2 > p.due ? 2 : 1), nowSec);
+        return;
+    }
+    if (level_ == 0 || p.stalled > 0 || p.acks == 0 || ackMean > interval || encodeMean > 0.5 * interval) {
+        goodPeriods_ = 0;
+        return;
+    }
+    if (++goodPeriods_ < kGoodPeriodsToRaise) {
+        return;
+    }
+    // Bytes per second the next level up would need, from what this one sends
+    LivePreviewLevel next = levelAt(level_ - 1);
+    double bytesPerFrame = p.sent ? (double)p.bytesSent / p.sent : 0.0;
+    double scale = (double)next.side / current.side;
+    double needed = bytesPerFrame * scale * scale * next.fps;
+    if (needed <= drainBytesPerSec_ * kDrainHeadroom) {
+        setLevel(level_ - 1, nowSec);
+    } else {
+        goodPeriods_ = 0;
+    }
+}
+
+std::string LivePreviewRate::json() const
+{
+    LivePreviewLevel current = level();
+    std::ostringstream os;
+    os << "{\"level\":" << level_ << ",\"side\":" << current.side << ",\"quality\":" << current.quality
+       << ",\"fps\":" << current.fps << ",\"in_flight\":" << inFlight_.size() << ",\"sent\":" << totalSent_
+       << ",\"stalled\":" << totalStalled_ << ",\"lost\":" << totalLost_ << ",\"level_changes\":" << levelChanges_
+       << ",\"drain_kbps\":" << (int)(drainBytesPerSec_ * 8 / 1000)
+       << ",\"ack_ms\":" << (last_.acks ? last_.ackSec * 1000.0 / last_.acks : 0.0)
+       << ",\"encode_ms\":" << (last_.sent ? last_.encodeMs / last_.sent : 0.0) << "}";
+    return os.str();
+}
+
+bool EncodeLivePreview(const cv::Mat& frame, const LivePreviewLevel& level, bool top, LivePreviewFrame& out)
+{
+    out.passthrough = false;
+    cv::Mat pixels;
+    if (IsJpegBuffer(frame)) {
+        const unsigned char* data = frame.ptr<unsigned char>();
+        int width = 0, height = 0;
+        if (top && ReadJpegSize(data, frame.total(), width, height) && std::max(width, height) <= level.side) {
+            out.jpeg = CompleteMjpegFrame(data, frame.total());
+            out.width = width;
+            out.height = height;
+            out.passthrough = true;
+            return true;
+        }
+        pixels = DecodePreviewPixels(frame, level.side);
+    } else {
+        pixels = FitPreview(frame, level.side);
+    }
+    if (pixels.empty()) {
+        return false;
+    }
+    out.width = pixels.cols;
+    out.height = pixels.rows;
+    return cv::imencode(".jpg", pixels, out.jpeg, { cv::IMWRITE_JPEG_QUALITY, level.quality });
+}
@@ -0,0 +1,117 @@
+// Adaptive live preview for lab4
+//
+// In serve mode the backend owns the camera, so the UI gets its live view
+// from the backend instead of opening the device a second time. The preview
+// is made from the frames the grabber already has (the same ones capture
+// uses): a BGR frame is downscaled and encoded, an MJPEG buffer is decoded
+// once at 1/2 or 1/4 scale inside the IDCT, or forwarded untouched when it
+// already fits the top level.
+//
+// Every frame is sent as a "live" record on stdout and the consumer acks it
+// once it has been shown ("live_ack <seq>", cumulative). At most inFlight
+// frames may be unacked; a frame that comes while the window is full is
+// skipped, never queued, so a slow consumer sees a lower frame rate and not
+// a growing delay. Once per evalSec the rate control looks at how the
+// consumer kept up and moves one step along a ladder of (size, quality,
+// fps) levels: down as soon as frames stall on the window, acks take longer
+// than two frame intervals or encoding eats most of the interval; up after
+// three good periods in a row, and only when the consumer's measured drain
+// rate has room for the bigger frames.
+#ifndef LIVE_PREVIEW_H
+#define LIVE_PREVIEW_H
+
+#include <opencv2/core.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+struct LivePreviewLevel {
+    int side;           // long side, pixels
+    int quality;        // JPEG quality
+    double fps;
+};
+
+struct LivePreviewOptions {
+    int maxSide = 1280;
+    int inFlight = 2;           // frames sent and not acked yet
+    double evalSec = 1.0;
+    double ackTimeoutSec = 2.0; // an older unacked frame is taken as lost
+};
+
+class LivePreviewRate {
+public:
+    // Best first
+    static const std::vector<LivePreviewLevel>& Levels();
+
+    explicit LivePreviewRate(const LivePreviewOptions& options = LivePreviewOptions());
+
+    // Starts over at the top level
+    void reset(double nowSec, double sourceFps, int sourceSide);
+
+    // A new grabbed frame: true if it is to be sent now
+    bool admit(double nowSec);
+    void sent(uint64_t seq, size_t bytes, double encodeMs, double nowSec);
+    // Acknowledges seq and everything sent before it
+    void acked(uint64_t seq, double nowSec);
+
+    // Current level, clamped to the source and maxSide
+    LivePreviewLevel level() const;
+    int levelIndex() const { return level_; }
+
+    // {"level":..,"side":..,"quality":..,"fps":..,"sent":..,"stalled":..,...}
+    std::string json() const;
+
+private:
+    struct InFlight {
+        uint64_t seq;
+        double sentSec;
+        size_t bytes;
+    };
+    struct Period {
+        int due = 0;            // frames the fps pacing wanted to send
+        int stalled = 0;        // of those, skipped on a full window
+        int sent = 0;
+        int acks = 0;
+        int lost = 0;
+        double ackSec = 0.0;    // summed send -> ack time
+        double encodeMs = 0.0;
+        size_t bytesSent = 0;
+        size_t bytesAcked = 0;
+    };
+
+    LivePreviewLevel levelAt(int index) const;
+    void expire(double nowSec);
+    void evaluate(double nowSec);
+    void setLevel(int level, double nowSec);
+
+    LivePreviewOptions options_;
+    double sourceFps_ = 30.0;
+    int sourceSide_ = 0;
+    int level_ = 0;
+    double nextDueSec_ = 0.0;
+    double periodStartSec_ = 0.0;
+    int goodPeriods_ = 0;
+    std::deque<InFlight> inFlight_;
+    Period period_;
+    Period last_;               // the last evaluated period, for json()
+    double drainBytesPerSec_ = 0.0;
+    uint64_t totalSent_ = 0;
+    uint64_t totalStalled_ = 0;
+    uint64_t totalLost_ = 0;
+    uint64_t levelChanges_ = 0;
+};
+
+struct LivePreviewFrame {
+    std::vector<unsigned char> jpeg;
+    int width = 0;
+    int height = 0;
+    bool passthrough = false;   // the camera's own MJPEG buffer
+};
+
+// Makes the preview of a grabbed frame at the given level
+bool EncodeLivePreview(const cv::Mat& frame, const LivePreviewLevel& level, bool top, LivePreviewFrame& out);
+
+#endif // LIVE_PREVIEW_H
@@ -0,0 +1,147 @@
+// MJPEG passthrough helpers for lab4
+#include "mjpeg_passthrough.h"
+
+#include <cstdio>
+
+namespace {
+
+// DHT segment with the four standard tables (ITU T.81 K.3): DC/AC luminance
+// and DC/AC chrominance; the same bytes FFmpeg and libjpeg fall back to.
+const unsigned char kStandardDht[] = {
+    0xFF, 0xC4, 0x01, 0xA2,
+    // DC luminance
+    0x00,
+    0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B,
+    // DC chrominance
+    0x01,
+    0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B,
+    // AC luminance
+    0x10,
+    0x00, 0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03, 0x05, 0x05, 0x04, 0x04, 0x00, 0x00, 0x01, 0x7D,
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+    0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+    0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+    0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA,
+    // AC chrominance
+    0x11,
+    0x00, 0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04, 0x07, 0x05, 0x04, 0x04, 0x00, 0x01, 0x02, 0x77,
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+    0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+    0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+    0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+    0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+    0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA,
+};
+
+// Marker walk over the header segments. Calls visit(marker, offset, segmentLength)
+// for each segment up to and including SOS; returns the offset of SOS or 0.
+template <typename Visit>
+size_t WalkJpegHeader(const unsigned char* data, size_t size, Visit visit)
+{
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) return 0;
+
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) return 0;
+        size_t markerPos = pos;
+        while (pos < size && data[pos] == 0xFF) ++pos;  // fill bytes
+        if (pos >= size) return 0;
+        unsigned char marker = data[pos++];
+
+        // Standalone markers carry no length
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) continue;
+        if (pos + 2 > size) return 0;
+        size_t length = ((size_t)data[pos] << 8) | data[pos + 1];
+        if (length < 2 || pos + length > size) return 0;
+
+        visit(marker, pos, length);
+        if (marker == 0xDA) return markerPos;
+        pos += length;
+    }
+    return 0;
+}
+
+} // namespace
+
+bool IsJpegBuffer(const cv::Mat& frame)
+{
+    return !frame.empty() && frame.rows == 1 && frame.type() == CV_8UC1 && frame.cols >= 4 &&
+           frame.isContinuous() && frame.data[0] == 0xFF && frame.data[1] == 0xD8;
+}
+
+bool ReadJpegSize(const unsigned char* data, size_t size, int& width, int& height)
+{
+    bool found = false;
+    WalkJpegHeader(data, size, [&](unsigned char marker, size_t pos, size_t length) {
+        // SOF0..SOF15 except DHT (C4), JPG (C8) and DAC (CC)
+        bool sof = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (sof && !found && length >= 7) {
+            height = (data[pos + 3] << 8) | data[pos + 4];
+            width = (data[pos + 5] << 8) | data[pos + 6];
+            found = true;
+        }
+    });
+    return found;
+}
+
+bool JpegHasHuffmanTables(const unsigned char* data, size_t size)
+{
+    bool found = false;
+    WalkJpegHeader(data, size, [&](unsigned char marker, size_t, size_t) {
+        if (marker == 0xC4) found = true;
+    });
+    return found;
+}
+
+std::vector<unsigned char> CompleteMjpegFrame(const unsigned char* data, size_t size)
+{
+    bool hasDht = false;
+    size_t sos = WalkJpegHeader(data, size, [&](unsigned char marker, size_t, size_t) {
+        if (marker == 0xC4) hasDht = true;
+    });
+
+    std::vector<unsigned char> out;
+    if (hasDht || sos == 0) {
+        out.assign(data, data + size);
+        return out;
+    }
+    out.reserve(size + sizeof(kStandardDht));
+    out.insert(out.end(), data, data + sos);
+    out.insert(out.end(), kStandardDht, kStandardDht + sizeof(kStandardDht));
+    out.insert(out.end(), data + sos, data + size);
+    return out;
+}
+
+bool WriteJpegBuffer(const std::string& path, const cv::Mat& frame)
+{
+    if (!IsJpegBuffer(frame)) return false;
+
+    const unsigned char* data = frame.ptr<unsigned char>();
+    size_t size = frame.total();
+    std::vector<unsigned char> completed;
+    if (!JpegHasHuffmanTables(data, size)) {
+        completed = CompleteMjpegFrame(data, size);
+        data = completed.data();
+        size = completed.size();
+    }
+
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) return false;
+    bool ok = fwrite(data, 1, size, f) == size;
+    ok = (fclose(f) == 0) && ok;
+    return ok;
+}
@@ -0,0 +1,34 @@
+// MJPEG passthrough helpers for lab4
+//
+// With raw retrieval (CAP_PROP_FORMAT=-1 / CAP_PROP_CONVERT_RGB=0) a camera
+// delivering MJPG hands out the compressed buffer as a 1xN CV_8U Mat. Those
+// buffers can be written to disk as they are, except that many webcams drop
+// the Huffman tables (DHT) and rely on the decoder using the standard ones
+// from ITU T.81 Annex K; those tables are put back before the file is written
+// so every viewer can open it.
+#ifndef MJPEG_PASSTHROUGH_H
+#define MJPEG_PASSTHROUGH_H
+
+#include <opencv2/core.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// True for a single-row CV_8U buffer starting with the JPEG SOI marker
+bool IsJpegBuffer(const cv::Mat& frame);
+
+// Frame size from the SOF header, without decoding
+bool ReadJpegSize(const unsigned char* data, size_t size, int& width, int& height);
+
+// True if a DHT segment precedes the first scan
+bool JpegHasHuffmanTables(const unsigned char* data, size_t size);
+
+// Copy of the buffer with the standard Huffman tables inserted before the
+// first scan when the stream has none; otherwise an unchanged copy
+std::vector<unsigned char> CompleteMjpegFrame(const unsigned char* data, size_t size);
+
+// Writes the compressed frame (tables completed if needed); false on I/O error
+bool WriteJpegBuffer(const std::string& path, const cv::Mat& frame);
+
+#endif // MJPEG_PASSTHROUGH_H
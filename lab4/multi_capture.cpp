@@ -0,0 +1,554 @@
+// Concurrent multi-camera capture for lab4
+#include "multi_capture.h"
+#include "plugin_capture.h"
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double ms_between(const Clock::time_point& from, const Clock::time_point& to)
+{
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+// Sleeps until the next frame of a fixed-rate source is due. A source that
+// fell behind by more than a frame restarts its schedule instead of bursting.
+class FramePacer {
+public:
+    void start(double fps)
+    {
+        interval_ = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / (fps > 0 ? fps : 30.0)));
+        next_ = Clock::now();
+    }
+
+    void wait()
+    {
+        Clock::time_point now = Clock::now();
+        if (next_ > now) {
+            std::this_thread::sleep_until(next_);
+        } else if (now - next_ > interval_) {
+            next_ = now;
+        }
+        next_ += interval_;
+    }
+
+private:
+    Clock::duration interval_{};
+    Clock::time_point next_;
+};
+
+// Camera by index: the device paces itself
+class CameraFrameSource : public FrameSource {
+public:
+    CameraFrameSource(int index, int width, int height, int fps)
+        : index_(index), width_(width), height_(height), fps_(fps) {}
+
+    bool open() override
+    {
+        if (!capture_.open(index_)) {
+            return false;
+        }
+        capture_.set(cv::CAP_PROP_FRAME_WIDTH, width_);
+        capture_.set(cv::CAP_PROP_FRAME_HEIGHT, height_);
+        capture_.set(cv::CAP_PROP_FPS, fps_);
+        width_ = (int)capture_.get(cv::CAP_PROP_FRAME_WIDTH);
+        height_ = (int)capture_.get(cv::CAP_PROP_FRAME_HEIGHT);
+        double fps = capture_.get(cv::CAP_PROP_FPS);
+        if (fps > 0) {
+            fps_ = fps;
+        }
+        return true;
+    }
+
+    bool read(cv::Mat& frame) override { return capture_.read(frame) && !frame.empty(); }
+    int width() const override { return width_; }
+    int height() const override { return height_; }
+    double fps() const override { return fps_; }
+
+private:
+    cv::VideoCapture capture_;
+    int index_;
+    int width_;
+    int height_;
+    double fps_;
+};
+
+// Video file played in a loop at its nominal frame rate
+class FileFrameSource : public FrameSource {
+public:
+    explicit FileFrameSource(const std::string& path) : path_(path) {}
+
+    bool open() override
+    {
+        if (!capture_.open(path_)) {
+            return false;
+        }
+        width_ = (int)capture_.get(cv::CAP_PROP_FRAME_WIDTH);
+        height_ = (int)capture_.get(cv::CAP_PROP_FRAME_HEIGHT);
+        fps_ = capture_.get(cv::CAP_PROP_FPS);
+        if (fps_ <= 0) {
+            fps_ = 30.0;
+        }
+        pacer_.start(fps_);
+        return true;
+    }
+
+    bool read(cv::Mat& frame) override
+    {
+        pacer_.wait();
+        if (capture_.read(frame) && !frame.empty()) {
+            return true;
+        }
+        capture_.set(cv::CAP_PROP_POS_FRAMES, 0);
+        return capture_.read(frame) && !frame.empty();
+    }
+
+    int width() const override { return width_; }
+    int height() const override { return height_; }
+    double fps() const override { return fps_; }
+
+private:
+    cv::VideoCapture capture_;
+    std::string path_;
+    FramePacer pacer_;
+    int width_ = 0;
+    int height_ = 0;
+    double fps_ = 30.0;
+};
+
+// Generated frames from the synthetic camera plugin, the same generator the
+// single-camera path opens; the plugin paces itself like a device
+class SyntheticFrameSource : public FrameSource {
+public:
+    explicit SyntheticFrameSource(const std::string& spec) : spec_(spec), capture_(SyntheticCameraPlugin()) {}
+
+    bool open() override
+    {
+        if (!capture_.open(spec_)) {
+            return false;
+        }
+        width_ = (int)capture_.get(cv::CAP_PROP_FRAME_WIDTH);
+        height_ = (int)capture_.get(cv::CAP_PROP_FRAME_HEIGHT);
+        fps_ = capture_.get(cv::CAP_PROP_FPS);
+        return true;
+    }
+
+    bool read(cv::Mat& frame) override { return capture_.read(frame) && !frame.empty(); }
+    int width() const override { return width_; }
+    int height() const override { return height_; }
+    double fps() const override { return fps_; }
+
+private:
+    std::string spec_;
+    PluginCapture capture_;
+    int width_ = 0;
+    int height_ = 0;
+    double fps_ = 0.0;
+};
+
+bool is_number(const std::string& text)
+{
+    return !text.empty() && text.find_first_not_of("0123456789") == std::string::npos;
+}
+
+} // namespace
+
+std::unique_ptr<FrameSource> MakeFrameSource(const std::string& spec, int width, int height, int fps)
+{
+    if (IsSyntheticSource(spec)) {
+        // A bare "synthetic" gets the size and rate the caller asked for
+        std::string full = spec == "synthetic"
+            ? "synthetic:" + std::to_string(width) + "x" + std::to_string(height) + "@" + std::to_string(fps)
+            : spec;
+        return std::unique_ptr<FrameSource>(new SyntheticFrameSource(full));
+    }
+    if (is_number(spec)) {
+        return std::unique_ptr<FrameSource>(new CameraFrameSource(atoi(spec.c_str()), width, height, fps));
+    }
+    if (spec.empty()) {
+        return nullptr;
+    }
+    return std::unique_ptr<FrameSource>(new FileFrameSource(spec));
+}
+
+std::vector<std::string> SplitDeviceSpecs(const std::string& list)
+{
+    std::vector<std::string> specs;
+    std::stringstream ss(list);
+    std::string spec;
+    while (std::getline(ss, spec, ',')) {
+        if (!spec.empty()) {
+            specs.push_back(spec);
+        }
+    }
+    return specs;
+}
+
+EncoderPool::EncoderPool(int workers)
+{
+    if (workers < 1) {
+        workers = 1;
+    }
+    for (int i = 0; i < workers; i++) {
+        queues_.push_back(std::unique_ptr<Queue>(new Queue));
+    }
+    for (int i = 0; i < workers; i++) {
+        threads_.emplace_back(&EncoderPool::run, this, i);
+    }
+}
+
+EncoderPool::~EncoderPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (size_t i = 0; i < threads_.size(); i++) {
+        threads_[i].join();
+    }
+}
+
+void EncoderPool::submit(int home, Job job)
+{
+    Queue& q = *queues_[(size_t)home % queues_.size()];
+    {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.jobs.push_back(std::move(job));
+    }
+    pending_++;
+    // A worker between its last look and wait() holds sleep_mutex_, so taking
+    // it here means the notification cannot fall into that gap
+    { std::lock_guard<std::mutex> lock(sleep_mutex_); }
+    wake_.notify_one();
+}
+
+bool EncoderPool::take(int self, Job& job)
+{
+    // Own queue from the front, in submission order
+    {
+        Queue& own = *queues_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = std::move(own.jobs.front());
+            own.jobs.pop_front();
+            pending_--;
+            return true;
+        }
+    }
+    // Otherwise steal the newest job of another worker
+    size_t n = queues_.size();
+    for (size_t k = 1; k < n; k++) {
+        Queue& victim = *queues_[(self + k) % n];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = std::move(victim.jobs.back());
+            victim.jobs.pop_back();
+            pending_--;
+            stolen_++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void EncoderPool::run(int self)
+{
+    for (;;) {
+        Job job;
+        if (take(self, job)) {
+            job();
+            executed_++;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        if (stopping_ && pending_ == 0) {
+            return;
+        }
+        wake_.wait(lock, [this] { return pending_ > 0 || stopping_; });
+    }
+}
+
+CaptureDevice::CaptureDevice(int id, const std::string& spec, std::unique_ptr<FrameSource> source)
+    : id_(id), spec_(spec), source_(std::move(source))
+{
+}
+
+void CaptureDevice::push(Slot& slot)
+{
+    std::lock_guard<std::mutex> lock(ringMutex_);
+    if (size_ == ring_.size()) {
+        Slot& oldest = ring_[head_];
+        // A dropped capture request moves on to the next frame
+        if (oldest.requested) {
+            captureRequests_++;
+        }
+        oldest.frame.release();
+        head_ = (head_ + 1) % ring_.size();
+        size_--;
+        drops_++;
+    }
+    ring_[(head_ + size_) % ring_.size()] = slot;
+    size_++;
+}
+
+bool CaptureDevice::pop(Slot& slot)
+{
+    std::lock_guard<std::mutex> lock(ringMutex_);
+    if (size_ == 0) {
+        return false;
+    }
+    Slot& oldest = ring_[head_];
+    slot = oldest;
+    oldest.frame.release();
+    head_ = (head_ + 1) % ring_.size();
+    size_--;
+    return true;
+}
+
+double CaptureDevice::latencyPercentile(double p) const
+{
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    return latency_.percentile(p);
+}
+
+std::string CaptureDevice::metricsJson() const
+{
+    size_t queued = 0;
+    {
+        std::lock_guard<std::mutex> lock(ringMutex_);
+        queued = size_;
+    }
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    double seconds = ms_between(started_, Clock::now()) / 1000.0;
+    std::ostringstream os;
+    os << "{\"id\":" << id_ << ",\"source\":\"" << JsonEscape(spec_) << "\""
+       << ",\"width\":" << source_->width() << ",\"height\":" << source_->height()
+       << ",\"grabbed\":" << grabbed_.load() << ",\"grab_fps\":" << (grabIntervalMs_ > 0 ? 1000.0 / grabIntervalMs_ : 0.0)
+       << ",\"encoded\":" << encoded_.load()
+       << ",\"encode_fps\":" << (seconds > 0 ? encoded_.load() / seconds : 0.0)
+       << ",\"drops\":" << drops_.load() << ",\"failures\":" << failures_.load()
+       << ",\"queued\":" << queued << ",\"in_flight\":" << inFlight_.load() << ",\"quota\":" << quota_
+       << ",\"latency\":" << latency_.toJson() << ",\"encode\":" << encodeMs_.toJson() << "}";
+    return os.str();
+}
+
+MultiCapture::MultiCapture(const MultiCaptureOptions& options) : options_(options)
+{
+    if (options_.ringSize < 1) {
+        options_.ringSize = 1;
+    }
+}
+
+MultiCapture::~MultiCapture()
+{
+    stop();
+}
+
+bool MultiCapture::open(const std::vector<std::string>& specs, std::string& err)
+{
+    if (specs.empty()) {
+        err = "no capture devices";
+        return false;
+    }
+    std::vector<std::unique_ptr<CaptureDevice>> devices;
+    for (size_t i = 0; i < specs.size(); i++) {
+        std::unique_ptr<FrameSource> source = MakeFrameSource(specs[i], options_.width, options_.height, options_.fps);
+        if (!source) {
+            err = "bad device spec: " + specs[i];
+            return false;
+        }
+        if (!source->open()) {
+            err = "cannot open device: " + specs[i];
+            return false;
+        }
+        devices.push_back(std::unique_ptr<CaptureDevice>(new CaptureDevice((int)i, specs[i], std::move(source))));
+    }
+
+    int workers = options_.encoders > 0 ? options_.encoders : (int)std::thread::hardware_concurrency();
+    pool_.reset(new EncoderPool(workers > 0 ? workers : 1));
+    // Fair share: twice the pool split evenly, so every worker has a frame
+    // of each device within reach without one device queueing them all
+    int n = (int)devices.size();
+    int quota = options_.quota > 0 ? options_.quota : std::max(1, (2 * pool_->workers() + n - 1) / n);
+    for (size_t i = 0; i < devices.size(); i++) {
+        devices[i]->quota_ = quota;
+        devices[i]->ring_.resize((size_t)options_.ringSize);
+    }
+    devices_.swap(devices);
+    return true;
+}
+
+void MultiCapture::start()
+{
+    if (started_) {
+        return;
+    }
+    started_ = true;
+    Clock::time_point now = Clock::now();
+    for (size_t i = 0; i < devices_.size(); i++) {
+        CaptureDevice& dev = *devices_[i];
+        dev.started_ = dev.lastGrab_ = now;
+        dev.running_ = true;
+        dev.grabber_ = std::thread(&MultiCapture::grabLoop, this, std::ref(dev));
+    }
+}
+
+void MultiCapture::stop()
+{
+    if (!started_) {
+        return;
+    }
+    started_ = false;
+    for (size_t i = 0; i < devices_.size(); i++) {
+        devices_[i]->running_ = false;
+    }
+    for (size_t i = 0; i < devices_.size(); i++) {
+        if (devices_[i]->grabber_.joinable()) {
+            devices_[i]->grabber_.join();
+        }
+    }
+    // Let the encoders work through what the rings still hold. pump() counts
+    // a frame in flight before popping it and a job gives the count back only
+    // after encoding, so an empty ring with nothing in flight means the device
+    // is done. The pump() a finished job runs next finds the ring empty; the
+    // pool is joined before the devices go away.
+    for (size_t i = 0; i < devices_.size(); i++) {
+        CaptureDevice& dev = *devices_[i];
+        for (;;) {
+            {
+                std::lock_guard<std::mutex> lock(dev.ringMutex_);
+                if (dev.size_ == 0 && dev.inFlight_ == 0) {
+                    break;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+bool MultiCapture::requestCapture(int device)
+{
+    if (device >= (int)devices_.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < devices_.size(); i++) {
+        if (device < 0 || (int)i == device) {
+            devices_[i]->captureRequests_++;
+        }
+    }
+    return true;
+}
+
+void MultiCapture::grabLoop(CaptureDevice& dev)
+{
+    uint64_t seq = 0;
+    int every = options_.encodeEvery;
+    while (dev.running_) {
+        cv::Mat frame;
+        if (!dev.source_->read(frame)) {
+            dev.failures_++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        Clock::time_point now = Clock::now();
+        seq++;
+        dev.grabbed_++;
+        {
+            std::lock_guard<std::mutex> lock(dev.statsMutex_);
+            double interval = ms_between(dev.lastGrab_, now);
+            dev.grabIntervalMs_ = dev.grabIntervalMs_ > 0 ? dev.grabIntervalMs_ * 0.9 + interval * 0.1 : interval;
+            dev.lastGrab_ = now;
+        }
+
+        int want = dev.captureRequests_.load();
+        while (want > 0 && !dev.captureRequests_.compare_exchange_weak(want, want - 1)) {
+        }
+        bool requested = want > 0;
+        if (!requested && (every <= 0 || seq % (uint64_t)every != 0)) {
+            continue;
+        }
+        CaptureDevice::Slot slot;
+        slot.frame = frame;
+        slot.seq = seq;
+        slot.requested = requested;
+        slot.grabbedAt = now;
+        dev.push(slot);
+        pump(dev);
+    }
+}
+
+void MultiCapture::pump(CaptureDevice& dev)
+{
+    for (;;) {
+        int cur = dev.inFlight_.load();
+        do {
+            if (cur >= dev.quota_) {
+                return;
+            }
+        } while (!dev.inFlight_.compare_exchange_weak(cur, cur + 1));
+
+        std::shared_ptr<CaptureDevice::Slot> slot = std::make_shared<CaptureDevice::Slot>();
+        if (!dev.pop(*slot)) {
+            dev.inFlight_--;
+            return;
+        }
+        CaptureDevice* device = &dev;
+        pool_->submit(dev.id_, [this, device, slot] {
+            encode(*device, *slot);
+            slot->frame.release();
+            device->inFlight_--;
+            pump(*device);
+        });
+    }
+}
+
+void MultiCapture::encode(CaptureDevice& dev, CaptureDevice::Slot& slot)
+{
+    Clock::time_point start = Clock::now();
+    cv::Mat image = options_.enhance ? options_.enhance(slot.frame) : slot.frame;
+    EncodedFrame out;
+    if (image.empty() || !cv::imencode(".jpg", image, out.jpeg, options_.jpegParams)) {
+        dev.failures_++;
+        return;
+    }
+    Clock::time_point done = Clock::now();
+    out.device = dev.id_;
+    out.seq = slot.seq;
+    out.width = image.cols;
+    out.height = image.rows;
+    out.requested = slot.requested;
+    out.latencyMs = ms_between(slot.grabbedAt, done);
+    {
+        std::lock_guard<std::mutex> lock(dev.statsMutex_);
+        dev.latency_.add(out.latencyMs);
+        dev.encodeMs_.add(ms_between(start, done));
+    }
+    dev.encoded_++;
+    if (options_.sink) {
+        options_.sink(out);
+    }
+}
+
+std::string MultiCapture::metricsJson() const
+{
+    std::ostringstream os;
+    os << "{\"encoders\":" << (pool_ ? pool_->workers() : 0)
+       << ",\"pending\":" << (pool_ ? pool_->pending() : 0)
+       << ",\"executed\":" << (pool_ ? pool_->executed() : 0)
+       << ",\"stolen\":" << (pool_ ? pool_->stolen() : 0) << ",\"devices\":[";
+    for (size_t i = 0; i < devices_.size(); i++) {
+        os << (i ? "," : "") << devices_[i]->metricsJson();
+    }
+    os << "]}";
+    return os.str();
+}
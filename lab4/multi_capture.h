@@ -0,0 +1,197 @@
+// Concurrent multi-camera capture for lab4
+//
+// Every CaptureDevice has its own source, grabber thread and a small ring of
+// frames waiting to be encoded; when the encoders fall behind the oldest
+// waiting frame is overwritten and counted as a drop, so a slow pool never
+// stalls a grabber. Enhancement and JPEG encoding run on one EncoderPool
+// shared by all devices: each worker has its own queue (a device always
+// submits to the same one) and idle workers steal from the others. A device
+// may have at most `quota` frames queued or being encoded, so a
+// high-resolution camera cannot fill the pool while the others wait.
+//
+// Source specs: a camera index ("0"), a video file (looped at its nominal
+// fps) or "synthetic[:WxH[@fps]][:option...]" for frames from the synthetic
+// camera plugin (synthetic_camera_plugin.cpp).
+#ifndef MULTI_CAPTURE_H
+#define MULTI_CAPTURE_H
+
+#include <opencv2/core.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "serve_protocol.h"
+
+// Where a device gets its frames from
+class FrameSource {
+public:
+    virtual ~FrameSource() {}
+    virtual bool open() = 0;
+    // Blocks until the next frame is due; false when the source is gone
+    virtual bool read(cv::Mat& frame) = 0;
+    virtual int width() const = 0;
+    virtual int height() const = 0;
+    virtual double fps() const = 0;
+};
+
+// nullptr for a malformed spec; the source is not opened yet
+std::unique_ptr<FrameSource> MakeFrameSource(const std::string& spec, int width, int height, int fps);
+
+// Splits "a,b,c" into device specs
+std::vector<std::string> SplitDeviceSpecs(const std::string& list);
+
+class EncoderPool {
+public:
+    typedef std::function<void()> Job;
+
+    explicit EncoderPool(int workers);
+    ~EncoderPool();    // runs the queued jobs, then joins
+
+    // Queues the job on worker home % workers()
+    void submit(int home, Job job);
+
+    int workers() const { return (int)queues_.size(); }
+    size_t pending() const { return pending_.load(); }
+    uint64_t executed() const { return executed_.load(); }
+    uint64_t stolen() const { return stolen_.load(); }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    void run(int self);
+    bool take(int self, Job& job);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    std::atomic<size_t> pending_{ 0 };
+    std::atomic<uint64_t> executed_{ 0 };
+    std::atomic<uint64_t> stolen_{ 0 };
+    std::atomic<bool> stopping_{ false };
+};
+
+struct EncodedFrame {
+    int device = 0;
+    uint64_t seq = 0;
+    int width = 0;
+    int height = 0;
+    bool requested = false;     // a capture command asked for this frame
+    double latencyMs = 0.0;     // grab to encoded
+    std::vector<uchar> jpeg;
+};
+
+struct MultiCaptureOptions {
+    int width = 1280;           // requested from cameras and synthetic default
+    int height = 720;
+    int fps = 30;
+    int encoders = 0;           // 0 = one per hardware thread
+    int quota = 0;              // in-flight frames per device, 0 = fair share of the pool
+    int ringSize = 4;
+    int encodeEvery = 0;        // encode every N-th grabbed frame, 0 = only on request
+    std::vector<int> jpegParams;
+    std::function<cv::Mat(const cv::Mat&)> enhance;     // empty = no enhancement
+    std::function<void(const EncodedFrame&)> sink;      // called on an encoder thread
+};
+
+class CaptureDevice {
+public:
+    CaptureDevice(int id, const std::string& spec, std::unique_ptr<FrameSource> source);
+
+    int id() const { return id_; }
+    const std::string& spec() const { return spec_; }
+    int width() const { return source_->width(); }
+    int height() const { return source_->height(); }
+    uint64_t grabbed() const { return grabbed_.load(); }
+    uint64_t drops() const { return drops_.load(); }
+    uint64_t encoded() const { return encoded_.load(); }
+    double latencyPercentile(double p) const;
+
+    // {"id":..,"source":..,"grabbed":..,"grab_fps":..,"drops":..,"encoded":..,...}
+    std::string metricsJson() const;
+
+private:
+    friend class MultiCapture;
+
+    struct Slot {
+        cv::Mat frame;
+        uint64_t seq = 0;
+        bool requested = false;
+        std::chrono::steady_clock::time_point grabbedAt;
+    };
+
+    // Ring of frames waiting for an encoder; a full ring drops its oldest
+    void push(Slot& slot);
+    bool pop(Slot& slot);
+
+    int id_;
+    std::string spec_;
+    std::unique_ptr<FrameSource> source_;
+    std::thread grabber_;
+    int quota_ = 1;
+
+    mutable std::mutex ringMutex_;
+    std::vector<Slot> ring_;
+    size_t head_ = 0;
+    size_t size_ = 0;
+
+    std::atomic<int> inFlight_{ 0 };
+    std::atomic<int> captureRequests_{ 0 };
+    std::atomic<bool> running_{ false };
+    std::atomic<uint64_t> grabbed_{ 0 };
+    std::atomic<uint64_t> drops_{ 0 };
+    std::atomic<uint64_t> encoded_{ 0 };
+    std::atomic<uint64_t> failures_{ 0 };
+
+    mutable std::mutex statsMutex_;
+    double grabIntervalMs_ = 0.0;   // moving average between frames
+    std::chrono::steady_clock::time_point lastGrab_;
+    std::chrono::steady_clock::time_point started_;
+    LatencyStats latency_;      // grab to encoded
+    LatencyStats encodeMs_;     // enhancement + imencode
+};
+
+class MultiCapture {
+public:
+    explicit MultiCapture(const MultiCaptureOptions& options);
+    ~MultiCapture();
+
+    // Opens every source; on failure err names the spec and nothing runs
+    bool open(const std::vector<std::string>& specs, std::string& err);
+    void start();
+    void stop();    // joins grabbers, then lets the pool finish queued frames
+
+    // Encodes the next frame of one device (-1 = all); false for an unknown id
+    bool requestCapture(int device);
+
+    size_t size() const { return devices_.size(); }
+    int encoders() const { return pool_ ? pool_->workers() : 0; }
+    const CaptureDevice& device(size_t i) const { return *devices_[i]; }
+
+    // {"encoders":..,"pending":..,"stolen":..,"devices":[...]}
+    std::string metricsJson() const;
+
+private:
+    void grabLoop(CaptureDevice& dev);
+    void pump(CaptureDevice& dev);
+    void encode(CaptureDevice& dev, CaptureDevice::Slot& slot);
+
+    MultiCaptureOptions options_;
+    std::vector<std::unique_ptr<CaptureDevice>> devices_;
+    std::unique_ptr<EncoderPool> pool_;
+    bool started_ = false;
+};
+
+#endif // MULTI_CAPTURE_H
@@ -273,6 +273,11 @@ public:
         FORMAT_XML  = (1<<3), //!< flag, XML format
         FORMAT_YAML = (2<<3), //!< flag, YAML format
         FORMAT_JSON = (3<<3), //!< flag, JSON format
+        FORMAT_BINARY = (4<<3), /**< flag, binary format with raw, aligned Mat payloads; read back through
+                                     a memory mapping, so matrices are not copied (not usable with MEMORY).
+                                     A matrix node has the same children as in the text formats except
+                                     "data": its elements are only reachable through FileNode::mat() or
+                                     operator >> */
 
         BASE64      = 64,     //!< flag, write rawdata in Base64 by default. (consider using WRITE_BASE64)
         WRITE_BASE64 = BASE64 | WRITE, //!< flag, enable both WRITE and BASE64
@@ -306,7 +311,8 @@ public:
      before opening the file.
      @param filename Name of the file to open or the text string to read the data from.
      Extension of the file (.xml, .yml/.yaml or .json) determines its format (XML, YAML or JSON
-     respectively). Also you can append .gz to work with compressed files, for example myHugeMatrix.xml.gz. If both
+     respectively); .cvbin selects the binary format (FileStorage::FORMAT_BINARY), which can be neither
+     compressed nor appended to. Also you can append .gz to work with compressed files, for example myHugeMatrix.xml.gz. If both
      FileStorage::WRITE and FileStorage::MEMORY flags are specified, source is used just to specify
      the output file format (e.g. mydata.xml, .yml etc.). A file name can also contain parameters.
      You can use this format, "*?base64" (e.g. "file.json?base64" (case sensitive)), as an alternative to
@@ -0,0 +1,82 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#ifndef OPENCV_CORE_UTILS_ARENA_HPP
+#define OPENCV_CORE_UTILS_ARENA_HPP
+
+#include "opencv2/core/mat.hpp"
+
+namespace cv {
+
+/** @brief Serves the calling thread's Mat allocations from a bump arena while the object lives.
+
+Per-frame pipelines allocate and free the same full-frame temporaries on every iteration.
+Inside a ScopedArena, Mat buffers of the calling thread are carved out of a per-thread arena
+instead of fastMalloc(), and the whole arena is reset in O(1) when the outermost scope ends.
+The arena's pages stay mapped between iterations, so a steady loop stops touching the system
+allocator and stops page-faulting after the first frame. When an iteration needed more than
+one chunk, the next one gets a single chunk of the combined size.
+
+@code
+    for (;;)
+    {
+        cv::ScopedArena arena;
+        cap >> frame;
+        cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);   // gray is declared outside: see below
+        ...
+    }
+@endcode
+
+Only allocations made by the constructing thread while it is inside the scope come from the
+arena; other threads, and the thread outside any scope, use the previous default allocator.
+A Mat that outlives the scope (assigned to an outer variable, returned, handed to another
+thread) stays valid: its chunk is not reused and is freed when the last such Mat is released.
+That is correct but defeats the reset, so keep the results that must survive in Mats that were
+allocated outside the scope. Nested scopes on one thread share the outermost one's arena.
+
+The first ScopedArena installs the arena allocator as Mat::setDefaultAllocator(); it passes
+everything it doesn't serve to the allocator that was the default before.
+*/
+class CV_EXPORTS ScopedArena
+{
+public:
+    enum Flags
+    {
+        DEFAULT = 0,
+        /** Back chunks with huge pages: MAP_HUGETLB when the system has them reserved,
+        transparent huge pages (madvise) otherwise. Linux only, ignored elsewhere. */
+        HUGE_PAGES = 1
+    };
+
+    /** @param flags a combination of ScopedArena::Flags; only the outermost scope's flags count
+    @param reserve bytes to have in the arena's first chunk, 0 for the default
+    (OPENCV_ARENA_CHUNK_SIZE, 8 MiB) */
+    explicit ScopedArena(int flags = DEFAULT, size_t reserve = 0);
+    ~ScopedArena();
+
+    /** Arena usage of the calling thread */
+    struct Stats
+    {
+        size_t reservedBytes;   //!< chunks held by the arena
+        size_t usedBytes;       //!< handed out since the last reset
+        size_t peakBytes;       //!< most bytes used within one scope
+        uint64_t allocations;   //!< buffers served from the arena
+        uint64_t resets;        //!< outermost scopes that ended
+        uint64_t chunks;        //!< chunks allocated, including regrowth
+        uint64_t escaped;       //!< chunks left to live Mats when a scope ended
+        bool hugePages;         //!< the current chunk has MAP_HUGETLB pages (transparent ones are not reported)
+    };
+    static Stats stats();
+
+    /** The allocator behind ScopedArena; allocations outside any scope go to the previous default */
+    static MatAllocator* getAllocator();
+
+private:
+    ScopedArena(const ScopedArena&);
+    ScopedArena& operator=(const ScopedArena&);
+};
+
+} // namespace
+
+#endif // OPENCV_CORE_UTILS_ARENA_HPP
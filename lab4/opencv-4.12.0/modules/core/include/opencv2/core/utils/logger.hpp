@@ -83,6 +83,39 @@ CV_EXPORTS void replaceWriteLogMessageEx(WriteLogMessageExFuncType f);
 
 } // namespace
 
+/** Counters of the asynchronous log writer, see startAsyncLogging() */
+struct AsyncLoggingStats
+{
+    uint64 queued;          //!< messages accepted into the queue
+    uint64 written;         //!< messages handed to the output by the writer thread
+    uint64 dropped;         //!< messages lost because the queue was full
+    uint64 rateLimited;     //!< messages suppressed by the per call site limit
+};
+
+/** @brief Moves log output off the calling threads.
+
+Installs a writeLogMessageEx replacement (see internal::replaceWriteLogMessageEx) that copies the
+message into a bounded lock-free queue and returns. A background thread writes the queued
+messages in the usual format, with the thread ID and timestamp of the original call, to the
+writeLogMessage replacement if there is one, or to stdout/stderr. A writeLogMessageEx replacement
+installed before this call keeps receiving the messages from the writer thread.
+
+A full queue drops the message and counts it. Each call site (file and line) may log at most
+maxPerSecondPerSite messages per second; the rest are counted, and the next message that gets
+through says how many were suppressed. FATAL messages are written synchronously.
+
+@param queueSize queue capacity in messages, rounded up to a power of two
+@param maxPerSecondPerSite per call site limit, 0 for none
+@return false if asynchronous logging is already running or threads are not supported
+*/
+CV_EXPORTS bool startAsyncLogging(size_t queueSize = 4096, int maxPerSecondPerSite = 20);
+
+/** @brief Writes out the queued messages and restores the previous writeLogMessageEx */
+CV_EXPORTS void stopAsyncLogging();
+
+/** Counters since the last startAsyncLogging() */
+CV_EXPORTS AsyncLoggingStats getAsyncLoggingStats();
+
 struct LogTagAuto
     : public LogTag
 {
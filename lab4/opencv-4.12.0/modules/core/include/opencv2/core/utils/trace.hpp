@@ -32,6 +32,38 @@ namespace trace {
 //! Macro to trace argument value (expanded version)
 #define CV_TRACE_ARG_VALUE(arg_id, arg_name, value)
 
+//! Result of a trace event export session
+struct TraceEventExportStats
+{
+    uint64 events;      //!< events written to the file
+    uint64 dropped;     //!< events lost because a thread's buffer was full
+    uint64 bytes;       //!< size of the file
+};
+
+/** @brief Starts writing trace regions to a Chrome trace-event JSON file.
+
+The file opens in chrome://tracing and https://ui.perfetto.dev. Every traced region becomes a
+complete ("X") event on its thread, and every parallel_for_() stripe becomes an event on the
+worker thread that ran it. Regions are traced as configured by OPENCV_TRACE_DEPTH_OPENCV and
+OPENCV_TRACE_MAX_CHILDREN*; application regions come from CV_TRACE_FUNCTION()/CV_TRACE_REGION().
+
+Threads record into their own lock-free buffers (OPENCV_TRACE_EVENTS_BUFFER events each, 16384
+by default) and a background thread writes them out every OPENCV_TRACE_FLUSH_MS (100 ms).
+Setting OPENCV_TRACE=1 with OPENCV_TRACE_FORMAT=chrome exports the whole run to
+<OPENCV_TRACE_LOCATION>.json instead of the text trace.
+
+@param filename output file, overwritten
+@return false if an export is already running, the file can't be created, or tracing is not
+compiled in (OPENCV_TRACE)
+*/
+CV_EXPORTS bool startTraceEventExport(const char* filename);
+
+/** @brief Finishes the export started by startTraceEventExport() and closes the file.
+
+Events of regions that are still open are not written.
+*/
+CV_EXPORTS TraceEventExportStats stopTraceEventExport();
+
 //! @cond IGNORED
 #define CV_TRACE_NS cv::utils::trace
 
@@ -351,6 +351,11 @@ void parallelForSetRootRegion(const Region& rootRegion, const TraceManagerThread
 void parallelForAttachNestedRegion(const Region& rootRegion);
 void parallelForFinalize(const Region& rootRegion);
 
+//! A trace event export is running (startTraceEventExport())
+bool traceEventsActive();
+//! Records a parallel_for_() stripe that ran on the calling thread from beginTimestamp until now
+void traceEventStripe(int64 beginTimestamp, int rangeStart, int rangeEnd);
+
 
 
 
@@ -0,0 +1,78 @@
+#include "perf_precomp.hpp"
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <fstream>
+#endif
+
+namespace opencv_test
+{
+using namespace perf;
+
+// Opening a storage and reading a Mat out of it: YAML, YAML with base64 data and the binary
+// format (FORMAT_BINARY), whose matrices are used in place in the mapped file. The access
+// touches every element, so the binary case pays its page faults inside the measurement.
+// On Linux the growth of the resident set over one open and access is recorded as well.
+typedef tuple<cv::Size, MatType, std::string> Size_MatType_Ext_t;
+typedef TestBaseWithParam<Size_MatType_Ext_t> Size_MatType_Ext;
+
+#define MAT_SIZES      ::perf::szVGA, ::perf::sz1080p/*, ::perf::sz2160p*/
+#define MAT_TYPES      CV_8UC3, CV_32FC1
+#define STORAGE_EXTS   std::string(".yml"), std::string(".yml?base64"), std::string(".cvbin")
+
+#if defined(__linux__)
+static long residentKb()
+{
+    long pages = 0, resident = 0;
+    std::ifstream statm("/proc/self/statm");
+    statm >> pages >> resident;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+#endif
+
+PERF_TEST_P(Size_MatType_Ext, fs_open_access,
+            testing::Combine(testing::Values(MAT_SIZES),
+                             testing::Values(MAT_TYPES),
+                             testing::Values(STORAGE_EXTS))
+             )
+{
+    Size size = get<0>(GetParam());
+    int  type = get<1>(GetParam());
+    std::string ext = get<2>(GetParam());
+
+    Mat src(size, type);
+    Mat dst;
+    Scalar s;
+    declare.in(src, WARMUP_RNG);
+
+    bool base64 = ext.find("?base64") != std::string::npos;
+    cv::String file_name = cv::tempfile(base64 ? ".yml" : ext.c_str());
+    {
+        FileStorage fs(file_name, cv::FileStorage::WRITE | (base64 ? cv::FileStorage::BASE64 : 0));
+        fs << "test_mat" << src;
+    }
+
+#if defined(__linux__)
+    long rss0 = residentKb();
+    {
+        FileStorage fs(file_name, cv::FileStorage::READ);
+        fs["test_mat"] >> dst;
+        s = sum(dst);
+        RecordProperty("rss_kb_delta", (int)(residentKb() - rss0));
+    }
+    dst.release();
+#endif
+
+    TEST_CYCLE_MULTIRUN(2)
+    {
+        FileStorage fs(file_name, cv::FileStorage::READ);
+        fs["test_mat"] >> dst;
+        s = sum(dst);
+    }
+
+    ASSERT_EQ(0, cvtest::norm(src, dst, NORM_INF));
+    remove(file_name.c_str());
+    SANITY_CHECK_NOTHING();
+}
+
+} // namespace
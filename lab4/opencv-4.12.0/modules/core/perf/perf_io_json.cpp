@@ -0,0 +1,57 @@
+#include "perf_precomp.hpp"
+
+namespace opencv_test
+{
+using namespace perf;
+
+// Reading a Mat back from a JSON file: the per-line parser against the whole-buffer one
+// (OPENCV_PERSISTENCE_FAST_JSON). 1080p is 30-50 MB of text depending on the type.
+typedef tuple<cv::Size, MatType, bool> Size_MatType_Fast_t;
+typedef TestBaseWithParam<Size_MatType_Fast_t> Size_MatType_Fast;
+
+#define MAT_SIZES      ::perf::szVGA, ::perf::sz1080p/*, ::perf::sz2160p*/
+#define MAT_TYPES      CV_8UC3, CV_32FC1, CV_64FC1
+
+static void setFastJSONParser(bool enable)
+{
+#ifdef _WIN32
+    _putenv_s("OPENCV_PERSISTENCE_FAST_JSON", enable ? "1" : "0");
+#else
+    setenv("OPENCV_PERSISTENCE_FAST_JSON", enable ? "1" : "0", 1);
+#endif
+}
+
+PERF_TEST_P(Size_MatType_Fast, fs_json_read,
+            testing::Combine(testing::Values(MAT_SIZES),
+                             testing::Values(MAT_TYPES),
+                             testing::Bool())
+             )
+{
+    Size size = get<0>(GetParam());
+    int  type = get<1>(GetParam());
+    bool fast = get<2>(GetParam());
+
+    Mat src(size, type);
+    Mat dst;
+    declare.in(src, WARMUP_RNG);
+
+    cv::String file_name = cv::tempfile(".json");
+    {
+        FileStorage fs(file_name, cv::FileStorage::WRITE);
+        fs << "test_mat" << src;
+    }
+
+    setFastJSONParser(fast);
+    TEST_CYCLE_MULTIRUN(2)
+    {
+        FileStorage fs(file_name, cv::FileStorage::READ);
+        fs["test_mat"] >> dst;
+    }
+    setFastJSONParser(true);
+
+    ASSERT_EQ(0, cvtest::norm(src, dst, NORM_INF));
+    remove(file_name.c_str());
+    SANITY_CHECK_NOTHING();
+}
+
+} // namespace
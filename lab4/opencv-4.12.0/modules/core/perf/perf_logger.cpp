@@ -0,0 +1,104 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "perf_precomp.hpp"
+#include "opencv2/core/utils/logger.hpp"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace opencv_test
+{
+using namespace perf;
+
+// Cost of one CV_LOG_WARNING() on the calling thread, like a capture backend warning
+// on every frame. Synchronous logging formats and writes to stderr right there; the
+// asynchronous writer only copies the message into its queue. On Linux stderr goes to
+// a file for the duration, so the numbers don't depend on the terminal.
+// Parameters: asynchronous writer, per call site limit (0 for none)
+#if defined(__linux__)
+// Points stderr at a temporary file until destroyed, so a failed ASSERT that
+// returns early still gives the terminal back
+class StderrToFile
+{
+public:
+    StderrToFile() : path_(cv::tempfile(".log")), saved_(-1)
+    {
+        fflush(stderr);
+        std::cerr.flush();
+        const int fd = open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        if (fd < 0)
+            return;
+        saved_ = dup(2);
+        dup2(fd, 2);
+        close(fd);
+    }
+    ~StderrToFile()
+    {
+        if (saved_ >= 0)
+        {
+            fflush(stderr);
+            std::cerr.flush();
+            dup2(saved_, 2);
+            close(saved_);
+        }
+        std::remove(path_.c_str());
+    }
+    bool redirected() const { return saved_ >= 0; }
+
+private:
+    StderrToFile(const StderrToFile&);
+    StderrToFile& operator=(const StderrToFile&);
+
+    std::string path_;
+    int saved_;
+};
+#endif
+
+typedef tuple<bool, int> Async_Limit_t;
+typedef perf::TestBaseWithParam<Async_Limit_t> Async_Limit;
+
+PERF_TEST_P(Async_Limit, log_warning,
+            testing::Combine(
+                testing::Bool(),
+                testing::Values(0, 20)
+                )
+            )
+{
+    const bool async = get<0>(GetParam());
+    const int limit = get<1>(GetParam());
+    if (!async && limit)
+        throw SkipTestException("The limit applies to the asynchronous writer only");
+
+#if defined(__linux__)
+    StderrToFile log;
+    ASSERT_TRUE(log.redirected());
+#endif
+    if (async)
+    {
+        ASSERT_TRUE(cv::utils::logging::startAsyncLogging(1 << 16, limit));
+    }
+
+    const int calls = 1000;
+    int frame = 0;
+    TEST_CYCLE()
+    {
+        for (int i = 0; i < calls; i++)
+            CV_LOG_WARNING(NULL, "capture: frame " << frame++ << " arrived late");
+    }
+
+    cv::utils::logging::AsyncLoggingStats stats = cv::utils::logging::getAsyncLoggingStats();
+    if (async)
+        cv::utils::logging::stopAsyncLogging();
+    if (async)
+    {
+        RecordProperty("dropped", cv::format("%llu", (unsigned long long)stats.dropped));
+        RecordProperty("rate_limited", cv::format("%llu", (unsigned long long)stats.rateLimited));
+    }
+    SANITY_CHECK_NOTHING();
+}
+
+} // namespace
@@ -0,0 +1,71 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "perf_precomp.hpp"
+#include "opencv2/core/parallel/parallel_backend.hpp"
+
+#include <thread>
+
+namespace opencv_test
+{
+using namespace perf;
+
+// Several threads calling parallel_for_() at the same time, like per-camera
+// encode threads of a capture process. The builtin pool runs them one after
+// another; WORKSTEALING runs them side by side.
+// Parameters: WORKSTEALING instead of the default backend, number of callers
+typedef tuple<bool, int> Backend_Callers_t;
+typedef perf::TestBaseWithParam<Backend_Callers_t> Backend_Callers;
+
+PERF_TEST_P(Backend_Callers, parallel_for_concurrent,
+            testing::Combine(
+                testing::Bool(),
+                testing::Values(1, 2, 4, 8, 16)
+                )
+            )
+{
+    const bool workstealing = get<0>(GetParam());
+    const int callers = get<1>(GetParam());
+    ASSERT_TRUE(cv::parallel::setParallelForBackend(workstealing ? "WORKSTEALING" : ""));
+
+    // 720p frames, one per caller, a row-wise body with some arithmetic per pixel
+    std::vector<Mat> src(callers), dst(callers);
+    for (int c = 0; c < callers; c++)
+    {
+        src[c].create(720, 1280, CV_32FC1);
+        randu(src[c], 0.f, 1.f);
+        dst[c].create(src[c].size(), CV_32FC1);
+    }
+    auto work = [&](int c) {
+        const Mat& s = src[c];
+        Mat& d = dst[c];
+        parallel_for_(Range(0, s.rows), [&](const Range& r) {
+            for (int y = r.start; y < r.end; y++)
+            {
+                const float* sp = s.ptr<float>(y);
+                float* dp = d.ptr<float>(y);
+                for (int x = 0; x < s.cols; x++)
+                    dp[x] = std::sqrt(sp[x]) * std::exp(-sp[x]);
+            }
+        });
+    };
+
+    const int jobsPerCaller = 4;
+    TEST_CYCLE()
+    {
+        std::vector<std::thread> threads;
+        for (int c = 0; c < callers; c++)
+            threads.push_back(std::thread([&work, c] {
+                for (int j = 0; j < jobsPerCaller; j++)
+                    work(c);
+            }));
+        for (size_t i = 0; i < threads.size(); i++)
+            threads[i].join();
+    }
+
+    cv::parallel::setParallelForBackend("");
+    SANITY_CHECK_NOTHING();
+}
+
+} // namespace
@@ -0,0 +1,348 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "precomp.hpp"
+#include "opencv2/core/utils/arena.hpp"
+
+#include <opencv2/core/utils/configuration.private.hpp>
+
+#include <atomic>
+#include <mutex>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace cv {
+
+namespace {
+
+// In front of every buffer; keeps the data CV_MALLOC_ALIGN aligned
+const size_t ARENA_HEADER_SIZE = 64;
+const size_t ARENA_HUGE_PAGE_SIZE = (size_t)2 << 20;
+
+static size_t getArenaChunkSize()
+{
+    static size_t value = utils::getConfigurationParameterSizeT("OPENCV_ARENA_CHUNK_SIZE", (size_t)8 << 20);
+    return value;
+}
+
+enum ChunkMapping { CHUNK_MALLOC, CHUNK_MMAP, CHUNK_HUGETLB };
+
+struct ArenaChunk
+{
+    uchar* base;
+    size_t size;
+    size_t used;                // owner thread only
+    std::atomic<size_t> refs;   // live buffers, plus one while the arena holds the chunk
+    ChunkMapping mapping;
+};
+
+struct ThreadArena;
+
+struct ArenaHeader
+{
+    ArenaChunk* chunk;
+    ThreadArena* owner;
+    size_t size;                // bytes taken from the chunk, header included
+};
+
+static ArenaChunk* allocateChunk(size_t size, bool hugePages)
+{
+    ArenaChunk* c = new ArenaChunk;
+    c->used = 0;
+    c->refs = 1;
+    c->base = NULL;
+    c->mapping = CHUNK_MALLOC;
+#if defined(__linux__) && defined(MAP_ANONYMOUS)
+    if (hugePages)
+    {
+        size = alignSize(size, ARENA_HUGE_PAGE_SIZE);
+        void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        // Only works with pages reserved in /proc/sys/vm/nr_hugepages
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED)
+            c->mapping = CHUNK_HUGETLB;
+#endif
+        if (p == MAP_FAILED)
+        {
+            p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+            {
+                delete c;
+                CV_Error_(Error::StsNoMem, ("Failed to map %llu bytes for the arena", (unsigned long long)size));
+            }
+#ifdef MADV_HUGEPAGE
+            madvise(p, size, MADV_HUGEPAGE);
+#endif
+            c->mapping = CHUNK_MMAP;
+        }
+        c->base = (uchar*)p;
+    }
+#else
+    CV_UNUSED(hugePages);
+#endif
+    if (!c->base)
+    {
+        try
+        {
+            c->base = (uchar*)fastMalloc(size);
+        }
+        catch (...)
+        {
+            delete c;
+            throw;
+        }
+    }
+    c->size = size;
+    return c;
+}
+
+static void freeChunk(ArenaChunk* c)
+{
+#if defined(__linux__) && defined(MAP_ANONYMOUS)
+    if (c->mapping != CHUNK_MALLOC)
+        munmap(c->base, c->size);
+    else
+#endif
+        fastFree(c->base);
+    delete c;
+}
+
+static void releaseChunk(ArenaChunk* c)
+{
+    if (c->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        freeChunk(c);
+}
+
+struct ThreadArena
+{
+    ThreadArena() : depth(0), flags(0), reserve(0), scopePeak(0)
+    {
+        memset(&stats, 0, sizeof(stats));
+    }
+
+    ~ThreadArena()
+    {
+        for (size_t i = 0; i < chunks.size(); i++)
+            releaseChunk(chunks[i]);
+    }
+
+    bool hugePages() const { return (flags & ScopedArena::HUGE_PAGES) != 0; }
+
+    void enter(int flags_, size_t reserve_)
+    {
+        if (depth++ > 0)
+            return;
+        if ((flags_ & ScopedArena::HUGE_PAGES) != (flags & ScopedArena::HUGE_PAGES))
+        {
+            // The chunks have the other backing: start over
+            flags = flags_;
+            dropChunks();
+        }
+        flags = flags_;
+        reserve = std::max(reserve, reserve_);
+        scopePeak = 0;
+    }
+
+    void leave()
+    {
+        CV_Assert(depth > 0);
+        if (--depth > 0)
+            return;
+        stats.resets++;
+        stats.usedBytes = 0;
+
+        // A chunk with live buffers can't be reused: leave it to them
+        std::vector<ArenaChunk*> reusable;
+        for (size_t i = 0; i < chunks.size(); i++)
+        {
+            ArenaChunk* c = chunks[i];
+            if (c->refs.load(std::memory_order_acquire) == 1)
+            {
+                reusable.push_back(c);
+            }
+            else
+            {
+                stats.escaped++;
+                stats.reservedBytes -= c->size;
+                releaseChunk(c);
+            }
+        }
+        chunks.swap(reusable);
+        if (chunks.size() > 1)
+        {
+            // The iteration didn't fit one chunk: the next one gets a chunk of its peak size
+            dropChunks();
+            reserve = std::max(reserve, scopePeak);
+        }
+        for (size_t i = 0; i < chunks.size(); i++)
+            chunks[i]->used = 0;
+    }
+
+    void dropChunks()
+    {
+        for (size_t i = 0; i < chunks.size(); i++)
+        {
+            stats.reservedBytes -= chunks[i]->size;
+            releaseChunk(chunks[i]);
+        }
+        chunks.clear();
+    }
+
+    uchar* allocate(size_t size)
+    {
+        size_t need = alignSize(size, CV_MALLOC_ALIGN) + ARENA_HEADER_SIZE;
+        ArenaChunk* c = chunks.empty() ? NULL : chunks.back();
+        if (!c || c->used + need > c->size)
+        {
+            size_t chunkSize = c ? c->size * 2 : std::max(reserve, getArenaChunkSize());
+            c = allocateChunk(std::max(need, chunkSize), hugePages());
+            chunks.push_back(c);
+            stats.chunks++;
+            stats.reservedBytes += c->size;
+        }
+        stats.hugePages = c->mapping == CHUNK_HUGETLB;
+        uchar* p = c->base + c->used;
+        c->used += need;
+        c->refs.fetch_add(1, std::memory_order_relaxed);
+        ArenaHeader* h = (ArenaHeader*)p;
+        h->chunk = c;
+        h->owner = this;
+        h->size = need;
+        stats.allocations++;
+        stats.usedBytes += need;
+        scopePeak = std::max(scopePeak, stats.usedBytes);
+        stats.peakBytes = std::max(stats.peakBytes, scopePeak);
+        return p + ARENA_HEADER_SIZE;
+    }
+
+    // Any thread
+    static void deallocate(uchar* data);
+
+    int depth;
+    int flags;
+    size_t reserve;                     // size of the next first chunk
+    size_t scopePeak;                   // most bytes used in the current outermost scope
+    std::vector<ArenaChunk*> chunks;    // the last one is being filled
+    ScopedArena::Stats stats;
+};
+
+static thread_local ThreadArena g_threadArena;
+
+void ThreadArena::deallocate(uchar* data)
+{
+    ArenaHeader* h = (ArenaHeader*)(data - ARENA_HEADER_SIZE);
+    ArenaChunk* c = h->chunk;
+    ThreadArena& self = g_threadArena;
+    if (h->owner == &self && self.depth > 0 && !self.chunks.empty() && self.chunks.back() == c
+        && (uchar*)h + h->size == c->base + c->used)
+    {
+        // The newest buffer of the owner's scope: give the space back right away,
+        // so create/release loops inside one scope don't grow the arena
+        c->used -= h->size;
+        self.stats.usedBytes -= h->size;
+    }
+    releaseChunk(c);
+}
+
+class ArenaMatAllocator CV_FINAL : public MatAllocator
+{
+public:
+    ArenaMatAllocator() : fallback_(NULL) {}
+
+    void install()
+    {
+        if (Mat::getDefaultAllocator() == this)
+            return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        MatAllocator* current = Mat::getDefaultAllocator();
+        if (current == this)
+            return;
+        fallback_.store(current, std::memory_order_release);
+        Mat::setDefaultAllocator(this);
+    }
+
+    UMatData* allocate(int dims, const int* sizes, int type,
+                       void* data0, size_t* step, AccessFlag flags, UMatUsageFlags usageFlags) const CV_OVERRIDE
+    {
+        ThreadArena& arena = g_threadArena;
+        if (data0 || arena.depth == 0)
+            return fallback()->allocate(dims, sizes, type, data0, step, flags, usageFlags);
+
+        size_t total = CV_ELEM_SIZE(type);
+        for( int i = dims-1; i >= 0; i-- )
+        {
+            if( step )
+                step[i] = total;
+            total *= sizes[i];
+        }
+        uchar* data = arena.allocate(total);
+        UMatData* u = new UMatData(this);
+        u->data = u->origdata = data;
+        u->size = total;
+        return u;
+    }
+
+    bool allocate(UMatData* u, AccessFlag /*accessFlags*/, UMatUsageFlags /*usageFlags*/) const CV_OVERRIDE
+    {
+        return u != NULL;
+    }
+
+    void deallocate(UMatData* u) const CV_OVERRIDE
+    {
+        if(!u)
+            return;
+
+        CV_Assert(u->urefcount == 0);
+        CV_Assert(u->refcount == 0);
+        if( !(u->flags & UMatData::USER_ALLOCATED) )
+        {
+            ThreadArena::deallocate(u->origdata);
+            u->origdata = 0;
+        }
+        delete u;
+    }
+
+private:
+    MatAllocator* fallback() const
+    {
+        MatAllocator* a = fallback_.load(std::memory_order_acquire);
+        return a ? a : Mat::getStdAllocator();
+    }
+
+    std::mutex mutex_;
+    std::atomic<MatAllocator*> fallback_;  // the default before install()
+};
+
+static ArenaMatAllocator* getArenaMatAllocator()
+{
+    CV_SINGLETON_LAZY_INIT(ArenaMatAllocator, new ArenaMatAllocator())
+}
+
+} // namespace
+
+ScopedArena::ScopedArena(int flags, size_t reserve)
+{
+    getArenaMatAllocator()->install();
+    g_threadArena.enter(flags, reserve);
+}
+
+ScopedArena::~ScopedArena()
+{
+    g_threadArena.leave();
+}
+
+ScopedArena::Stats ScopedArena::stats()
+{
+    return g_threadArena.stats;
+}
+
+MatAllocator* ScopedArena::getAllocator()
+{
+    return getArenaMatAllocator();
+}
+
+} // namespace
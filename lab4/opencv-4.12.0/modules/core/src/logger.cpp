@@ -13,6 +13,14 @@
 #include <iostream>
 #include <fstream>
 #include <atomic>
+#include <memory>
+
+#ifndef OPENCV_DISABLE_THREAD_SUPPORT
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
 
 #ifdef __ANDROID__
 # include <android/log.h>
@@ -195,22 +203,14 @@ static int getShowTimestampMode()
     return (param_timestamp_enable ? 1 : 0) + (param_timestamp_ns_enable ? 2 : 0);
 }
 
-void writeLogMessage(LogLevel logLevel, const char* message)
+// The default output: one line to stdout/stderr, stamped with the thread and time of the call
+static void writeLogLine(LogLevel logLevel, const char* message, int threadID, int64 timestamp)
 {
-    WriteLogMessageFuncType userFunc = stc_userWriteLogMessageFunc.load();
-    if (userFunc && userFunc != writeLogMessage)
-    {
-        (*userFunc)(logLevel, message);
-        return;
-    }
-
-    const int threadID = cv::utils::getThreadID();
-
     std::string message_id;
     switch (getShowTimestampMode())
     {
-        case 1: message_id = cv::format("%d@%0.3f", threadID, getTimestampNS() * 1e-9); break;
-        case 1+2: message_id = cv::format("%d@%llu", threadID, (long long unsigned int)getTimestampNS()); break;
+        case 1: message_id = cv::format("%d@%0.3f", threadID, timestamp * 1e-9); break;
+        case 1+2: message_id = cv::format("%d@%llu", threadID, (long long unsigned int)timestamp); break;
         default: message_id = cv::format("%d", threadID); break;
     }
 
@@ -249,6 +249,18 @@ void writeLogMessage(LogLevel logLevel, const char* message)
     }
 }
 
+void writeLogMessage(LogLevel logLevel, const char* message)
+{
+    WriteLogMessageFuncType userFunc = stc_userWriteLogMessageFunc.load();
+    if (userFunc && userFunc != writeLogMessage)
+    {
+        (*userFunc)(logLevel, message);
+        return;
+    }
+
+    writeLogLine(logLevel, message, cv::utils::getThreadID(), getTimestampNS());
+}
+
 static const char* stripSourceFilePathPrefix(const char* file)
 {
     CV_Assert(file);
@@ -266,15 +278,8 @@ static const char* stripSourceFilePathPrefix(const char* file)
     return strip_pos;
 }
 
-void writeLogMessageEx(LogLevel logLevel, const char* tag, const char* file, int line, const char* func, const char* message)
+static std::string formatLogMessageEx(const char* tag, const char* file, int line, const char* func, const char* message)
 {
-    WriteLogMessageExFuncType userFunc = stc_userWriteLogMessageExFunc.load();
-    if (userFunc && userFunc != writeLogMessageEx)
-    {
-        (*userFunc)(logLevel, tag, file, line, func, message);
-        return;
-    }
-
     std::ostringstream strm;
     if (tag)
     {
@@ -294,7 +299,19 @@ void writeLogMessageEx(LogLevel logLevel, const char* tag, const char* file, int
         strm << func << ' ';
     }
     strm << message;
-    writeLogMessage(logLevel, strm.str().c_str());
+    return strm.str();
+}
+
+void writeLogMessageEx(LogLevel logLevel, const char* tag, const char* file, int line, const char* func, const char* message)
+{
+    WriteLogMessageExFuncType userFunc = stc_userWriteLogMessageExFunc.load();
+    if (userFunc && userFunc != writeLogMessageEx)
+    {
+        (*userFunc)(logLevel, tag, file, line, func, message);
+        return;
+    }
+
+    writeLogMessage(logLevel, formatLogMessageEx(tag, file, line, func, message).c_str());
 }
 
 void replaceWriteLogMessage(WriteLogMessageFuncType f)
@@ -315,6 +332,344 @@ void replaceWriteLogMessageEx(WriteLogMessageExFuncType f)
     stc_userWriteLogMessageExFunc.store(f);
 }
 
+#ifndef OPENCV_DISABLE_THREAD_SUPPORT
+
+/**
+ * Asynchronous log writer
+ *
+ * Producers claim a cell of a bounded MPSC queue with one CAS (D. Vyukov's sequence
+ * numbered ring), copy the message into it and return; the writer thread drains the
+ * queue in order. Messages are packed as "tag\0file\0func\0message\0" and cut to fit.
+ */
+struct AsyncLogRecord
+{
+    std::atomic<size_t> sequence;
+    LogLevel level;
+    int threadID;
+    int64 timestamp;
+    int line;
+    int suppressed;             // messages of this call site the rate limit swallowed before this one
+    unsigned char present;      // bit per non-null tag, file, func
+    char text[475];
+};
+
+// Per call site message budget; sites are told apart by (file pointer, line)
+struct AsyncLogCallSite
+{
+    std::atomic<uint64> key;
+    std::atomic<int64> second;
+    std::atomic<int> count;
+    std::atomic<int> suppressed;
+};
+
+static int getAsyncLogFlushMs()
+{
+    static int value = (int)utils::getConfigurationParameterSizeT("OPENCV_LOG_ASYNC_FLUSH_MS", 10);
+    return std::max(value, 1);
+}
+
+static size_t packLogString(char* dst, size_t pos, size_t cap, const char* s, size_t maxLength)
+{
+    size_t n = s ? strlen(s) : 0;
+    n = std::min(n, std::min(maxLength, cap - pos - 1));
+    if (n)
+        memcpy(dst + pos, s, n);
+    dst[pos + n] = 0;
+    return pos + n + 1;
+}
+
+class AsyncLogger
+{
+public:
+    enum { CALL_SITES = 1024, CALL_SITE_PROBES = 8 };
+
+    static AsyncLogger& getInstance()
+    {
+        // Not destroyed: late messages from other static destructors may still come here
+        static AsyncLogger* instance = new AsyncLogger();
+        return *instance;
+    }
+
+    bool start(size_t queueSize, int maxPerSecondPerSite)
+    {
+        std::lock_guard<std::mutex> control(controlMutex);
+        if (running.load())
+            return false;
+        size_t capacity = 2;
+        while (capacity < queueSize)
+            capacity *= 2;
+        if (capacity != mask + 1)
+        {
+            records.reset(new AsyncLogRecord[capacity]);
+            mask = capacity - 1;
+        }
+        for (size_t i = 0; i < capacity; i++)
+            records[i].sequence.store(i, std::memory_order_relaxed);
+        enqueuePos.store(0);
+        dequeuePos = 0;
+        for (int i = 0; i < CALL_SITES; i++)
+        {
+            sites[i].key.store(0, std::memory_order_relaxed);
+            sites[i].second.store(0, std::memory_order_relaxed);
+            sites[i].count.store(0, std::memory_order_relaxed);
+            sites[i].suppressed.store(0, std::memory_order_relaxed);
+        }
+        limit = maxPerSecondPerSite;
+        queued = 0;
+        written = 0;
+        dropped = 0;
+        rateLimited = 0;
+        stopping = false;
+        writer = std::thread(&AsyncLogger::writerLoop, this);
+        running = true;
+        previous = stc_userWriteLogMessageExFunc.exchange(&AsyncLogger::writeLogMessageExAsync);
+        return true;
+    }
+
+    void stop()
+    {
+        std::lock_guard<std::mutex> control(controlMutex);
+        if (!running.load())
+            return;
+        WriteLogMessageExFuncType self = &AsyncLogger::writeLogMessageExAsync;
+        stc_userWriteLogMessageExFunc.compare_exchange_strong(self, previous);  // unless replaced since
+        running = false;
+        while (inflight.load() != 0)  // callers that got here before the switch
+            std::this_thread::yield();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cond.notify_one();
+        writer.join();  // drains the queue on exit
+
+        if (dropped.load() || rateLimited.load())
+        {
+            CV_LOG_WARNING(NULL, "Async logging: " << dropped.load() << " messages dropped (queue full), "
+                    << rateLimited.load() << " suppressed by the per call site limit");
+        }
+    }
+
+    AsyncLoggingStats stats() const
+    {
+        AsyncLoggingStats s;
+        s.queued = queued.load();
+        s.written = written.load();
+        s.dropped = dropped.load();
+        s.rateLimited = rateLimited.load();
+        return s;
+    }
+
+private:
+    AsyncLogger() :
+        mask((size_t)-1), enqueuePos(0), dequeuePos(0), limit(0), queued(0), written(0), dropped(0), rateLimited(0),
+        running(false), inflight(0), previous(NULL), stopping(false)
+    {}
+
+    static void writeLogMessageExAsync(LogLevel logLevel, const char* tag, const char* file, int line, const char* func, const char* message)
+    {
+        AsyncLogger& self = getInstance();
+        self.inflight.fetch_add(1);
+        if (!self.running.load(std::memory_order_acquire))
+        {
+            // stopAsyncLogging() is switching the output back
+            self.inflight.fetch_sub(1);
+            writeLogMessageEx(logLevel, tag, file, line, func, message);
+            return;
+        }
+        const int64 timestamp = getTimestampNS();
+        if (logLevel <= LOG_LEVEL_FATAL)
+            self.output(logLevel, tag, file, line, func, message, cv::utils::getThreadID(), timestamp, 0);
+        else
+            self.enqueue(logLevel, tag, file, line, func, message, timestamp);
+        self.inflight.fetch_sub(1);
+    }
+
+    // -1 if the call site is over its budget, otherwise how many of its messages were suppressed
+    int admit(const char* file, int line, int64 timestamp)
+    {
+        if (limit <= 0)
+            return 0;
+        uint64 key = ((uint64)(size_t)file * 0x9E3779B97F4A7C15ull) ^ (uint64)(unsigned)line;
+        if (key == 0)
+            key = 1;
+        AsyncLogCallSite* site = NULL;
+        for (int i = 0; i < CALL_SITE_PROBES && !site; i++)
+        {
+            AsyncLogCallSite& s = sites[(size_t)((key >> 32) + i) & (CALL_SITES - 1)];
+            uint64 current = s.key.load(std::memory_order_acquire);
+            if (current == 0 && s.key.compare_exchange_strong(current, key))
+                current = key;
+            if (current == key)
+                site = &s;
+        }
+        if (!site)
+            return 0;  // table is full: no limit for this one
+        const int64 second = timestamp / 1000000000;
+        int64 windowSecond = site->second.load(std::memory_order_relaxed);
+        if (windowSecond != second && site->second.compare_exchange_strong(windowSecond, second))
+            site->count.store(0, std::memory_order_relaxed);
+        if (site->count.fetch_add(1, std::memory_order_relaxed) >= limit)
+        {
+            site->suppressed.fetch_add(1, std::memory_order_relaxed);
+            rateLimited.fetch_add(1, std::memory_order_relaxed);
+            return -1;
+        }
+        return site->suppressed.exchange(0, std::memory_order_relaxed);
+    }
+
+    void enqueue(LogLevel logLevel, const char* tag, const char* file, int line, const char* func, const char* message, int64 timestamp)
+    {
+        const int suppressed = admit(file, line, timestamp);
+        if (suppressed < 0)
+            return;
+
+        AsyncLogRecord* r = NULL;
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            AsyncLogRecord& cell = records[pos & mask];
+            const size_t seq = cell.sequence.load(std::memory_order_acquire);
+            const ptrdiff_t dif = (ptrdiff_t)seq - (ptrdiff_t)pos;
+            if (dif == 0)
+            {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    r = &cell;
+                    break;
+                }
+            }
+            else if (dif < 0)
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            else
+            {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        r->level = logLevel;
+        r->threadID = cv::utils::getThreadID();
+        r->timestamp = timestamp;
+        r->line = line;
+        r->suppressed = suppressed;
+        r->present = (tag ? 1 : 0) | (file ? 2 : 0) | (func ? 4 : 0);
+        const size_t cap = sizeof(r->text);
+        size_t p = packLogString(r->text, 0, cap, tag, 63);
+        p = packLogString(r->text, p, cap, file ? stripSourceFilePathPrefix(file) : NULL, 95);
+        p = packLogString(r->text, p, cap, func, 63);
+        const size_t length = message ? strlen(message) : 0;
+        packLogString(r->text, p, cap, message, cap);
+        if (length > cap - p - 1)
+            memcpy(r->text + cap - 4, "...", 3);
+        r->sequence.store(pos + 1, std::memory_order_release);
+        queued.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void output(LogLevel logLevel, const char* tag, const char* file, int line, const char* func, const char* message,
+                int threadID, int64 timestamp, int suppressed)
+    {
+        std::string withNote;
+        if (suppressed > 0)
+        {
+            withNote = cv::format("(%d similar messages suppressed) %s", suppressed, message);
+            message = withNote.c_str();
+        }
+        if (previous)
+        {
+            previous(logLevel, tag, file, line, func, message);
+            return;
+        }
+        const std::string body = formatLogMessageEx(tag, file, line, func, message);
+        WriteLogMessageFuncType userFunc = stc_userWriteLogMessageFunc.load();
+        if (userFunc && userFunc != writeLogMessage)
+            (*userFunc)(logLevel, body.c_str());
+        else
+            writeLogLine(logLevel, body.c_str(), threadID, timestamp);
+    }
+
+    void drain()
+    {
+        for (;;)
+        {
+            AsyncLogRecord& r = records[dequeuePos & mask];
+            if (r.sequence.load(std::memory_order_acquire) != dequeuePos + 1)
+                break;
+            const char* tag = r.text;
+            const char* file = tag + strlen(tag) + 1;
+            const char* func = file + strlen(file) + 1;
+            const char* message = func + strlen(func) + 1;
+            output(r.level, (r.present & 1) ? tag : NULL, (r.present & 2) ? file : NULL, r.line,
+                   (r.present & 4) ? func : NULL, message, r.threadID, r.timestamp, r.suppressed);
+            r.sequence.store(dequeuePos + mask + 1, std::memory_order_release);
+            dequeuePos++;
+            written.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void writerLoop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            bool last = stopping;
+            lock.unlock();
+            drain();
+            lock.lock();
+            if (last)
+                break;
+            cond.wait_for(lock, std::chrono::milliseconds(getAsyncLogFlushMs()), [this] { return stopping; });
+        }
+    }
+
+    std::unique_ptr<AsyncLogRecord[]> records;
+    size_t mask;
+    std::atomic<size_t> enqueuePos;
+    size_t dequeuePos;                  // writer thread
+    AsyncLogCallSite sites[CALL_SITES];
+    int limit;
+    std::atomic<uint64> queued, written, dropped, rateLimited;
+
+    std::atomic<bool> running;
+    std::atomic<int> inflight;          // producers inside writeLogMessageExAsync()
+    WriteLogMessageExFuncType previous; // writeLogMessageEx replacement before start()
+    std::mutex controlMutex;            // start() / stop()
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool stopping;
+    std::thread writer;
+};
+
+#endif // OPENCV_DISABLE_THREAD_SUPPORT
+
 } // namespace
 
+bool startAsyncLogging(size_t queueSize, int maxPerSecondPerSite)
+{
+#ifndef OPENCV_DISABLE_THREAD_SUPPORT
+    return internal::AsyncLogger::getInstance().start(queueSize, maxPerSecondPerSite);
+#else
+    CV_UNUSED(queueSize); CV_UNUSED(maxPerSecondPerSite);
+    return false;
+#endif
+}
+
+void stopAsyncLogging()
+{
+#ifndef OPENCV_DISABLE_THREAD_SUPPORT
+    internal::AsyncLogger::getInstance().stop();
+#endif
+}
+
+AsyncLoggingStats getAsyncLoggingStats()
+{
+#ifndef OPENCV_DISABLE_THREAD_SUPPORT
+    return internal::AsyncLogger::getInstance().stats();
+#else
+    return AsyncLoggingStats();
+#endif
+}
+
 }}} // namespace
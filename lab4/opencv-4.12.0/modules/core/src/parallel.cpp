@@ -353,6 +353,7 @@ namespace {
 #ifdef OPENCV_TRACE
             CV_TRACE_ARG_VALUE(range_start, "range.start", (int64)r.start);
             CV_TRACE_ARG_VALUE(range_end, "range.end", (int64)r.end);
+            const int64 stripeBegin = CV_TRACE_NS::details::traceEventsActive() ? cv::getTimestampNS() : 0;
 #endif
 
             try
@@ -379,6 +380,11 @@ namespace {
             }
 #endif
 
+#ifdef OPENCV_TRACE
+            if (stripeBegin)
+                CV_TRACE_NS::details::traceEventStripe(stripeBegin, r.start, r.end);
+#endif
+
             if (!ctx.is_rng_used && !(cv::theRNG() == ctx.rng))
                 ctx.is_rng_used = true;
         }
@@ -517,6 +523,13 @@ void parallel_for_(const cv::Range& range, const cv::ParallelLoopBody& body, dou
     if (range.empty())
         return;
 
+    if (cv::parallel::isConcurrentParallelForAPI(cv::parallel::getCurrentParallelForAPI().get()))
+    {
+        // the backend schedules concurrent and nested calls itself
+        parallel_for_impl(range, body, nstripes);
+        return;
+    }
+
     static std::atomic<bool> flagNestedParallelFor(false);
     bool isNotNestedRegion = !flagNestedParallelFor.load();
     if (isNotNestedRegion)
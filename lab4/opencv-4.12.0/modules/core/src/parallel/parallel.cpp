@@ -60,6 +60,10 @@ std::shared_ptr<ParallelForAPI> createParallelForAPI()
             }
             isKnown = true;
         }
+        else if (info.optIn)
+        {
+            continue;
+        }
         try
         {
             CV_LOG_DEBUG(NULL, "core(parallel): trying backend: " << info.name << " (priority=" << info.priority << ")");
@@ -22,8 +22,14 @@ std::shared_ptr<cv::parallel::ParallelForAPI> createParallelBackendTBB();
 std::shared_ptr<cv::parallel::ParallelForAPI> createParallelBackendOpenMP();
 #endif
 
+std::shared_ptr<cv::parallel::ParallelForAPI> createParallelBackendWorkStealing();
+
 #endif  // BUILD_PLUGIN
 
+/** True when the backend runs concurrent and nested parallel_for_() calls itself,
+ * so they don't have to be serialized in front of it. */
+bool isConcurrentParallelForAPI(const ParallelForAPI* api);
+
 }}  // namespace
 
 #endif // OPENCV_CORE_SRC_PARALLEL_PARALLEL_HPP
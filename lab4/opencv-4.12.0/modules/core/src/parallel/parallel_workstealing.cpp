@@ -0,0 +1,433 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+// Work-stealing parallel_for_ backend.
+//
+// Unlike the builtin thread pool, which runs one job at a time, this backend
+// lets any number of threads call parallel_for_() at once and lets a body call
+// it again (nested). Every thread taking part (workers and callers) owns a
+// small deque of stripe ranges: the owner pushes and pops at the bottom,
+// idle threads steal the oldest (largest) range from the top.
+//
+// A caller runs its own job: while some worker is idle it hands out the upper
+// half of its range through its deque, otherwise it keeps the range and runs
+// it in big batches, so the stripe size follows the load. A nested call from
+// a worker is the same: the worker becomes the owner of the inner job and
+// waits for it by helping with it, no thread is ever added or blocked on a
+// foreign job, so nesting can't oversubscribe the CPU.
+//
+// getThreadNum() is the worker index (1..N) inside workers and 0 in any
+// calling thread; with concurrent callers several threads may report 0.
+
+#include "../precomp.hpp"
+
+#include "parallel.hpp"
+
+#include <opencv2/core/utils/configuration.private.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cv { namespace parallel {
+
+namespace {
+
+// Spin iterations (yields) of a thread out of work before it sleeps
+static const int WS_SPIN_COUNT = (int)utils::getConfigurationParameterSizeT("OPENCV_PARALLEL_WORKSTEALING_SPIN", 200);
+
+// Deques and threads that can take part at once (workers and callers)
+const int kMaxSlots = 256;
+// Ranges one deque can hold; a full deque just stops splitting
+const int kDequeCapacity = 64;
+
+struct Job
+{
+    Job(ParallelForAPI::FN_parallel_for_body_cb_t body_, void* data_, int tasks)
+        : body(body_), data(data_), pending(tasks), pushes(0), ownerSleeping(false), finished(false)
+    {}
+
+    ParallelForAPI::FN_parallel_for_body_cb_t body;
+    void* data;
+    std::atomic<int> pending;       // stripes not done yet
+    std::atomic<unsigned> pushes;   // ranges of this job handed out so far
+    std::atomic<bool> ownerSleeping;
+    std::mutex mutex;
+    std::condition_variable done;
+    bool finished;                  // under mutex: the owner may return
+};
+
+struct Item
+{
+    Job* job;
+    int begin, end;
+};
+
+struct Slot
+{
+    Slot() : top(0), bottom(0), size(0) {}
+
+    std::mutex mutex;
+    Item items[kDequeCapacity];     // ring, [top, bottom)
+    int top, bottom;
+    std::atomic<int> size;          // read without the lock to skip empty deques
+};
+
+class WorkStealingBackend;
+
+struct ThreadState
+{
+    ThreadState() : backend(NULL), slot(-1), worker(0) {}
+    ~ThreadState();
+
+    WorkStealingBackend* backend;
+    int slot;
+    int worker;                     // 1..N in workers, 0 elsewhere
+};
+
+static thread_local ThreadState g_threadState;
+
+class WorkStealingBackend : public ParallelForAPI
+{
+public:
+    WorkStealingBackend()
+        : numWorkers_(0), slotsUsed_(0), idle_(0), epoch_(0), sleepers_(0), stop_(false)
+    {
+        setNumThreads(-1);
+    }
+
+    ~WorkStealingBackend() CV_OVERRIDE
+    {
+        stopWorkers();
+        if (g_threadState.backend == this)
+            g_threadState.backend = NULL;
+    }
+
+    void parallel_for(int tasks, FN_parallel_for_body_cb_t body_callback, void* callback_data) CV_OVERRIDE
+    {
+        if (tasks <= 0)
+            return;
+        int self = attach();
+        if (self < 0 || tasks == 1)
+        {
+            body_callback(0, tasks, callback_data);
+            return;
+        }
+
+        Job job(body_callback, callback_data, tasks);
+        run(self, Item{ &job, 0, tasks });
+        // Help with what is left; a hungry owner makes the others split for it
+        idle_++;
+        for (int spin = 0; job.pending.load(std::memory_order_acquire) > 0; )
+        {
+            unsigned pushes = job.pushes.load();
+            Item item;
+            if (popOwn(self, &job, item) || stealFrom(self, &job, item))
+            {
+                idle_--;
+                run(self, item);
+                idle_++;
+                spin = 0;
+            }
+            else if (spin < WS_SPIN_COUNT)
+            {
+                spin++;
+                std::this_thread::yield();
+            }
+            else
+            {
+                // The rest is running elsewhere: sleep until it is done or split again
+                idle_--;
+                std::unique_lock<std::mutex> lock(job.mutex);
+                job.ownerSleeping = true;
+                job.done.wait(lock, [&] { return job.finished || job.pushes.load() != pushes; });
+                job.ownerSleeping = false;
+                idle_++;
+                spin = 0;
+            }
+        }
+        idle_--;
+        // The last stripe's thread may still be notifying
+        std::unique_lock<std::mutex> lock(job.mutex);
+        job.done.wait(lock, [&] { return job.finished; });
+    }
+
+    int getThreadNum() const CV_OVERRIDE
+    {
+        return g_threadState.backend == this ? g_threadState.worker : 0;
+    }
+
+    int getNumThreads() const CV_OVERRIDE
+    {
+        return numWorkers_ + 1;
+    }
+
+    int setNumThreads(int nThreads) CV_OVERRIDE
+    {
+        std::lock_guard<std::mutex> lock(configMutex_);
+        int old = numWorkers_ + 1;
+        int workers = (nThreads > 0 ? nThreads : cv::getNumberOfCPUs()) - 1;
+        workers = std::max(0, std::min(workers, kMaxSlots / 2));
+        if (workers == numWorkers_ && (int)workers_.size() == workers)
+            return old;
+        stopWorkers();
+        stop_ = false;
+        numWorkers_ = workers;
+        for (int i = 0; i < workers; i++)
+        {
+            idle_++;
+            workers_.push_back(std::thread(&WorkStealingBackend::workerLoop, this, i + 1));
+        }
+        return old;
+    }
+
+    const char* getName() const CV_OVERRIDE
+    {
+        return "workstealing";
+    }
+
+    void releaseSlot(int slot)
+    {
+        std::lock_guard<std::mutex> lock(slotMutex_);
+        freeSlots_.push_back(slot);
+    }
+
+private:
+    // Slot of the calling thread, -1 when all are taken
+    int attach()
+    {
+        ThreadState& ts = g_threadState;
+        if (ts.backend == this)
+            return ts.slot;
+        if (ts.backend)
+            ts.backend->releaseSlot(ts.slot);
+        ts.backend = NULL;
+        ts.slot = acquireSlot();
+        if (ts.slot < 0)
+            return -1;
+        ts.backend = this;
+        ts.worker = 0;
+        return ts.slot;
+    }
+
+    int acquireSlot()
+    {
+        std::lock_guard<std::mutex> lock(slotMutex_);
+        if (!freeSlots_.empty())
+        {
+            int slot = freeSlots_.back();
+            freeSlots_.pop_back();
+            return slot;
+        }
+        int used = slotsUsed_.load(std::memory_order_relaxed);
+        if (used >= kMaxSlots)
+            return -1;
+        slotsUsed_.store(used + 1, std::memory_order_release);
+        return used;
+    }
+
+    bool push(int self, const Item& item)
+    {
+        Slot& s = slots_[self];
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            if (s.bottom - s.top >= kDequeCapacity)
+                return false;
+            s.items[s.bottom % kDequeCapacity] = item;
+            s.bottom++;
+            s.size.store(s.bottom - s.top, std::memory_order_release);
+        }
+        item.job->pushes.fetch_add(1);
+        if (item.job->ownerSleeping.load())
+        {
+            std::lock_guard<std::mutex> lock(item.job->mutex);
+            item.job->done.notify_all();
+        }
+        epoch_.fetch_add(1);
+        if (sleepers_.load() > 0)
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            wakeup_.notify_one();
+        }
+        return true;
+    }
+
+    // Newest range of the own deque; of the given job only when job != NULL
+    bool popOwn(int self, const Job* job, Item& item)
+    {
+        Slot& s = slots_[self];
+        if (s.size.load(std::memory_order_acquire) == 0)
+            return false;
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (s.bottom == s.top)
+            return false;
+        const Item& last = s.items[(s.bottom - 1) % kDequeCapacity];
+        if (job && last.job != job)
+            return false;
+        item = last;
+        s.bottom--;
+        s.size.store(s.bottom - s.top, std::memory_order_release);
+        return true;
+    }
+
+    // Oldest range of another deque; of the given job only when job != NULL
+    bool stealFrom(int self, const Job* job, Item& item)
+    {
+        int used = slotsUsed_.load(std::memory_order_acquire);
+        for (int k = 1; k < used; k++)
+        {
+            Slot& s = slots_[(self + k) % used];
+            if (s.size.load(std::memory_order_acquire) == 0)
+                continue;
+            std::lock_guard<std::mutex> lock(s.mutex);
+            for (int i = s.top; i < s.bottom; i++)
+            {
+                Item& candidate = s.items[i % kDequeCapacity];
+                if (job && candidate.job != job)
+                    continue;
+                item = candidate;
+                // Keep the ring dense: move the older ones up by one
+                for (int j = i; j > s.top; j--)
+                    s.items[j % kDequeCapacity] = s.items[(j - 1) % kDequeCapacity];
+                s.top++;
+                s.size.store(s.bottom - s.top, std::memory_order_release);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(int self, Item item)
+    {
+        Job& job = *item.job;
+        int begin = item.begin, end = item.end;
+        while (begin < end)
+        {
+            // Hand out the upper half while workers wait for something to do
+            int idle = idle_.load(std::memory_order_relaxed);
+            while (end - begin > 1 && slots_[self].size.load(std::memory_order_relaxed) < idle)
+            {
+                int mid = begin + (end - begin) / 2;
+                if (!push(self, Item{ &job, mid, end }))
+                    break;
+                end = mid;
+            }
+            // Nobody is hungry: big batches, but leave something to split later
+            int n = idle > 0 ? 1 : std::max(1, (end - begin) / 4);
+            job.body(begin, begin + n, job.data);
+            begin += n;
+            finish(job, n);
+        }
+    }
+
+    void finish(Job& job, int stripes)
+    {
+        if (job.pending.fetch_sub(stripes, std::memory_order_acq_rel) == stripes)
+        {
+            std::lock_guard<std::mutex> lock(job.mutex);
+            job.finished = true;
+            job.done.notify_all();
+        }
+    }
+
+    void workerLoop(int index)
+    {
+        ThreadState& ts = g_threadState;
+        ts.slot = acquireSlot();
+        if (ts.slot < 0)
+        {
+            idle_--;
+            return;
+        }
+        ts.backend = this;
+        ts.worker = index;
+        int self = ts.slot;
+        for (;;)
+        {
+            unsigned epoch = epoch_.load();
+            Item item;
+            if (popOwn(self, NULL, item) || stealFrom(self, NULL, item))
+            {
+                idle_--;
+                run(self, item);
+                idle_++;
+                continue;
+            }
+            if (stop_.load())
+                break;
+            bool moved = false;
+            for (int spin = 0; spin < WS_SPIN_COUNT && !moved; spin++)
+            {
+                std::this_thread::yield();
+                moved = epoch_.load() != epoch;
+            }
+            if (moved)
+                continue;
+            std::unique_lock<std::mutex> lock(sleepMutex_);
+            sleepers_++;
+            wakeup_.wait(lock, [&] { return epoch_.load() != epoch || stop_.load(); });
+            sleepers_--;
+        }
+        idle_--;
+        ts.backend = NULL;
+        releaseSlot(self);
+    }
+
+    void stopWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            stop_ = true;
+            wakeup_.notify_all();
+        }
+        for (size_t i = 0; i < workers_.size(); i++)
+            workers_[i].join();
+        workers_.clear();
+    }
+
+    Slot slots_[kMaxSlots];
+    int numWorkers_;
+    std::vector<std::thread> workers_;
+    std::mutex configMutex_;
+
+    std::mutex slotMutex_;
+    std::vector<int> freeSlots_;
+    std::atomic<int> slotsUsed_;    // high-water mark, thieves scan [0, slotsUsed_)
+
+    std::atomic<int> idle_;         // workers with nothing to run, owners waiting for theirs
+    std::atomic<unsigned> epoch_;   // bumped by every push
+    std::atomic<int> sleepers_;
+    std::atomic<bool> stop_;
+    std::mutex sleepMutex_;
+    std::condition_variable wakeup_;
+};
+
+ThreadState::~ThreadState()
+{
+    if (backend && slot >= 0)
+        backend->releaseSlot(slot);
+}
+
+static
+std::shared_ptr<WorkStealingBackend>& getInstance()
+{
+    static std::shared_ptr<WorkStealingBackend> g_instance = std::make_shared<WorkStealingBackend>();
+    return g_instance;
+}
+
+}  // namespace
+
+std::shared_ptr<cv::parallel::ParallelForAPI> createParallelBackendWorkStealing()
+{
+    return getInstance();
+}
+
+bool isConcurrentParallelForAPI(const ParallelForAPI* api)
+{
+    return api && dynamic_cast<const WorkStealingBackend*>(api) != NULL;
+}
+
+}}  // namespace
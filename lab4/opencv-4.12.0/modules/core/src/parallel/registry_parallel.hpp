@@ -16,6 +16,7 @@ struct ParallelBackendInfo
                       // >10000 - prioritized list (OPENCV_PARALLEL_PRIORITY_LIST)
     std::string name;
     std::shared_ptr<IParallelBackendFactory> backendFactory;
+    bool optIn;       // taken only when requested by name or given a priority explicitly
 };
 
 const std::vector<ParallelBackendInfo>& getParallelBackendsInfo();
@@ -13,7 +13,7 @@ namespace cv { namespace parallel {
 #if OPENCV_HAVE_FILESYSTEM_SUPPORT && defined(PARALLEL_ENABLE_PLUGINS)
 #define DECLARE_DYNAMIC_BACKEND(name) \
 ParallelBackendInfo { \
-    1000, name, createPluginParallelBackendFactory(name) \
+    1000, name, createPluginParallelBackendFactory(name), false \
 },
 #else
 #define DECLARE_DYNAMIC_BACKEND(name) /* nothing */
@@ -21,7 +21,14 @@ ParallelBackendInfo { \
 
 #define DECLARE_STATIC_BACKEND(name, createBackendAPI) \
 ParallelBackendInfo { \
-    1000, name, std::make_shared<cv::parallel::StaticBackendFactory>([=] () -> std::shared_ptr<cv::parallel::ParallelForAPI> { return createBackendAPI(); }) \
+    1000, name, std::make_shared<cv::parallel::StaticBackendFactory>([=] () -> std::shared_ptr<cv::parallel::ParallelForAPI> { return createBackendAPI(); }), false \
+},
+
+// Never picked by default: OPENCV_PARALLEL_BACKEND=<name>, setParallelForBackend(<name>),
+// OPENCV_PARALLEL_PRIORITY_<name> or OPENCV_PARALLEL_PRIORITY_LIST select it
+#define DECLARE_STATIC_OPT_IN_BACKEND(name, createBackendAPI) \
+ParallelBackendInfo { \
+    1000, name, std::make_shared<cv::parallel::StaticBackendFactory>([=] () -> std::shared_ptr<cv::parallel::ParallelForAPI> { return createBackendAPI(); }), true \
 },
 
 static
@@ -41,6 +48,8 @@ std::vector<ParallelBackendInfo>& getBuiltinParallelBackendsInfo()
 #elif defined(PARALLEL_ENABLE_PLUGINS)
         DECLARE_DYNAMIC_BACKEND("OPENMP")  // TODO Intel OpenMP?
 #endif
+
+        DECLARE_STATIC_OPT_IN_BACKEND("WORKSTEALING", createParallelBackendWorkStealing)
     };
     return g_backends;
 }
@@ -78,11 +87,17 @@ protected:
             ParallelBackendInfo& info = enabledBackends[enabled];
             if (enabled != i)
                 info = enabledBackends[i];
-            size_t param_priority = utils::getConfigurationParameterSizeT(cv::format("OPENCV_PARALLEL_PRIORITY_%s", info.name.c_str()).c_str(), (size_t)info.priority);
+            size_t param_priority = utils::getConfigurationParameterSizeT(cv::format("OPENCV_PARALLEL_PRIORITY_%s", info.name.c_str()).c_str(), info.optIn ? 0 : (size_t)info.priority);
             CV_Assert(param_priority == (size_t)(int)param_priority); // overflow check
             if (param_priority > 0)
             {
                 info.priority = (int)param_priority;
+                info.optIn = false;
+                enabled++;
+            }
+            else if (info.optIn)
+            {
+                info.priority = 1;  // stays available by name
                 enabled++;
             }
             else
@@ -127,6 +142,7 @@ protected:
                 if (name == info.name)
                 {
                     info.priority = priority;
+                    info.optIn = false;
                     CV_LOG_DEBUG(NULL, "core(parallel): New backend priority: '" << name << "' => " << info.priority);
                     found = true;
                     hasChanges = true;
@@ -136,7 +152,7 @@ protected:
             if (!found)
             {
                 CV_LOG_INFO(NULL, "core(parallel): Adding parallel backend (plugin): '" << name << "'");
-                enabledBackends.push_back(ParallelBackendInfo{priority, name, createPluginParallelBackendFactory(name)});
+                enabledBackends.push_back(ParallelBackendInfo{priority, name, createPluginParallelBackendFactory(name), false});
                 hasChanges = true;
             }
         }
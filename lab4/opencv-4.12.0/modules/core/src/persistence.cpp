@@ -10,6 +10,7 @@
 #include <iterator>
 
 #include <opencv2/core/utils/logger.hpp>
+#include <opencv2/core/utils/configuration.private.hpp>
 
 namespace cv
 {
@@ -452,6 +453,9 @@ void FileStorage::Impl::init() {
 
     filename.clear();
     lineno = 0;
+
+    mapping.release();
+    mapped_mats.clear();
 }
 
 FileStorage::Impl::Impl(FileStorage *_fs) {
@@ -476,6 +480,8 @@ void FileStorage::Impl::release(String *out) {
                 puts("</opencv_storage>\n");
             else if (fmt == FileStorage::FORMAT_JSON)
                 puts("}\n");
+            else if (fmt == FileStorage::FORMAT_BINARY)
+                getEmitter().endWriteStruct(write_stack.back());
         }
         if (mem_mode && out) {
             *out = cv::String(outbuf.begin(), outbuf.end());
@@ -544,6 +550,19 @@ bool FileStorage::Impl::open(const char *filename_or_buf, int _flags, const char
 
     flags = _flags;
 
+    // the binary format has to be known before the file is opened
+    bool binary = false;
+    if (write_mode) {
+        int format = _flags & FileStorage::FORMAT_MASK;
+        const char *dot_pos = strrchr(filename.c_str(), '.');
+        binary = format == FileStorage::FORMAT_BINARY ||
+                 (format == FileStorage::FORMAT_AUTO && dot_pos && fs::strcasecmp(dot_pos, ".cvbin") == 0);
+        if (binary && (mem_mode || append))
+            CV_Error(cv::Error::StsNotImplemented, "The binary file storage can only be written to a new file");
+        if (binary && dot_pos && fs::strcasecmp(dot_pos, ".gz") == 0)
+            CV_Error(cv::Error::StsNotImplemented, "There is no compressed binary file storage support");
+    }
+
     if (!mem_mode) {
         char *dot_pos = strrchr((char *) filename.c_str(), '.');
         char compression = '\0';
@@ -560,7 +579,7 @@ bool FileStorage::Impl::open(const char *filename_or_buf, int _flags, const char
         }
 
         if (!isGZ) {
-            file = fopen(filename.c_str(), !write_mode ? "rt" : !append ? "wt" : "a+t");
+            file = fopen(filename.c_str(), !write_mode ? "rt" : binary ? "wb" : !append ? "wt" : "a+t");
             if (!file)
             {
                 CV_LOG_ERROR(NULL, "Can't open file: '" << filename << "' in " << (!write_mode ? "read" : !append ? "write" : "append") << " mode");
@@ -607,7 +626,8 @@ bool FileStorage::Impl::open(const char *filename_or_buf, int _flags, const char
             if (fs::strcasecmp(dot_pos, ".gz") == 0 && dot_pos2 != NULL) {
                 dot_pos = dot_pos2;
             }
-            fmt = (fs::strcasecmp(dot_pos, ".xml") == 0 || fs::strcasecmp(dot_pos, ".xml.gz") == 0)
+            fmt = binary ? FileStorage::FORMAT_BINARY
+                  : (fs::strcasecmp(dot_pos, ".xml") == 0 || fs::strcasecmp(dot_pos, ".xml.gz") == 0)
                   ? FileStorage::FORMAT_XML
                   : (fs::strcasecmp(dot_pos, ".json") == 0 || fs::strcasecmp(dot_pos, ".json.gz") == 0)
                     ? FileStorage::FORMAT_JSON
@@ -632,7 +652,7 @@ bool FileStorage::Impl::open(const char *filename_or_buf, int _flags, const char
         buffer.reserve(buf_size + 1024);
         buffer.resize(buf_size);
         bufofs = 0;
-        is_using_base64 = write_base64;
+        is_using_base64 = write_base64 && !binary;
         state_of_writing_base64 = FileStorage_API::Base64State::Uncertain;
 
         if (fmt == FileStorage::FORMAT_XML) {
@@ -695,6 +715,8 @@ bool FileStorage::Impl::open(const char *filename_or_buf, int _flags, const char
                 puts("...\n---\n");
 
             emitter_do_not_use_direct_dereference = createYAMLEmitter(this);
+        } else if (fmt == FileStorage::FORMAT_BINARY) {
+            emitter_do_not_use_direct_dereference = createBinaryEmitter(this);
         } else {
             CV_Assert(fmt == FileStorage::FORMAT_JSON);
             if (!append)
@@ -743,7 +765,9 @@ bool FileStorage::Impl::open(const char *filename_or_buf, int _flags, const char
         char *bufPtr = cv_skip_BOM(buf);
         size_t bufOffset = bufPtr - buf;
 
-        if (strncmp(bufPtr, yaml_signature, strlen(yaml_signature)) == 0)
+        if (!mem_mode && strncmp(buf, binaryStorageSignature, strlen(binaryStorageSignature)) == 0)
+            fmt = FileStorage::FORMAT_BINARY;
+        else if (strncmp(bufPtr, yaml_signature, strlen(yaml_signature)) == 0)
             fmt = FileStorage::FORMAT_YAML;
         else if (strncmp(bufPtr, json_signature, strlen(json_signature)) == 0)
             fmt = FileStorage::FORMAT_JSON;
@@ -758,6 +782,10 @@ bool FileStorage::Impl::open(const char *filename_or_buf, int _flags, const char
         strbufpos = bufOffset;
         bufofs = 0;
 
+        // JSON from a MEMORY string or a plain file is parsed from one piece of memory
+        bool parseWholeJSON = fmt == FileStorage::FORMAT_JSON && (mem_mode || file) &&
+                              utils::getConfigurationParameterBool("OPENCV_PERSISTENCE_FAST_JSON", true);
+
         try {
             char *ptr = bufferStart();
             ptr[0] = ptr[1] = ptr[2] = '\0';
@@ -784,8 +812,9 @@ bool FileStorage::Impl::open(const char *filename_or_buf, int _flags, const char
                     parser_do_not_use_direct_dereference = Ptr<FileStorageParser>();
             }
 
-            if (!parser_do_not_use_direct_dereference.empty()) {
-                ok = getParser().parse(ptr);
+            if (fmt == FileStorage::FORMAT_BINARY || !parser_do_not_use_direct_dereference.empty()) {
+                ok = fmt == FileStorage::FORMAT_BINARY ? parseBinaryInput() :
+                     parseWholeJSON ? parseJSONInput(bufOffset) : getParser().parse(ptr);
                 if (ok) {
                     finalizeCollection(root_nodes);
 
@@ -922,6 +951,22 @@ void FileStorage::Impl::setEof() {
     dummy_eof = true;
 }
 
+void FileStorage::Impl::putBytes(const void *data, size_t len) {
+    CV_Assert(write_mode);
+    if (mem_mode)
+        std::copy((const char *) data, (const char *) data + len, std::back_inserter(outbuf));
+    else if (file) {
+        if (fwrite(data, 1, len, file) != len)
+            CV_Error_(cv::Error::StsError, ("Can't write to file '%s'", filename.c_str()));
+    }
+#if USE_ZLIB
+    else if (gzfile)
+        gzwrite(gzfile, data, (unsigned) len);
+#endif
+    else
+        CV_Error(cv::Error::StsError, "The storage is not opened");
+}
+
 void FileStorage::Impl::closeFile() {
     if (file)
         fclose(file);
@@ -1116,6 +1161,9 @@ void FileStorage::Impl::writeRawData(const std::string &dt, const void *_data, s
         switch_to_Base64_state(FileStorage_API::Base64State::NotUse);
     }
 
+    if (getEmitter().writeRawData(dt.c_str(), _data, len))
+        return;
+
     size_t elemSize = fs::calcStructSize(dt.c_str(), 0);
     CV_Assert(elemSize);
     CV_Assert(len % elemSize == 0);
@@ -1647,6 +1695,30 @@ void FileStorage::Impl::finalizeCollection(FileNode &collection) {
     writeInt(ptr, (int) rawSize);
 }
 
+void FileStorage::Impl::addScalarNodes(FileNode &seq, const uchar *types, const Cv64suf *values, size_t count) {
+    CV_Assert(seq.isSeq());
+    CV_Assert(count < (size_t) INT_MAX);
+
+    FileNode node(fs_ext, fs_data_ptrs.size() - 1, freeSpaceOfs);
+    uchar *ptr = reserveNodeSpace(node, count * 9);
+    for (size_t i = 0; i < count; i++, ptr += 9) {
+        ptr[0] = types[i];
+        if (types[i] == FileNode::INT)
+            writeInt(ptr + 1, values[i].i);
+        else
+            writeReal(ptr + 1, values[i].f);
+    }
+
+    uchar *cp = seq.ptr();
+    if (seq.isNamed())
+        cp += 4;
+    writeInt(cp + 5, readInt(cp + 5) + (int) count);
+}
+
+void FileStorage::Impl::setLineNumber(int _lineno) {
+    lineno = _lineno;
+}
+
 void FileStorage::Impl::normalizeNodeOfs(size_t &blockIdx, size_t &ofs) const {
     while (ofs >= fs_data_blksz[blockIdx]) {
         if (blockIdx == fs_data_blksz.size() - 1) {
@@ -1882,6 +1954,20 @@ char *FileStorage::Impl::parseBase64(char *ptr, int indent, FileNode &collection
     return base64decoder.getPtr();
 }
 
+bool FileStorage::Impl::parseJSONInput(size_t ofs) {
+    if (mem_mode)
+        return parseJSONBuffer(this, strbuf + ofs, strbuf + strbufsize);
+
+    CV_Assert(file);
+    // the document is parsed in one pass and its strings are copied out, so the mapping
+    // (or the copy where the file can not be mapped) only has to live through the parse
+    Ptr<FileStorageMapping> document = mapStorageFile(file, filename, true);
+    if (document->size <= ofs)
+        return false;
+    const char* begin = (const char*)document->data;
+    return parseJSONBuffer(this, begin + ofs, begin + document->size);
+}
+
 void FileStorage::Impl::parseError(const char *func_name, const std::string &err_msg, const char *source_file,
                                    int source_line) {
     std::string msg = format("%s(%d): %s", filename.c_str(), lineno, err_msg.c_str());
@@ -2623,6 +2709,39 @@ FileNodeIterator& FileNodeIterator::operator += (int _ofs)
     return *this;
 }
 
+// Converts up to n consecutive unnamed INT/REAL nodes (tag + 8 bytes each), as the loop in
+// FileNodeIterator::readRaw() does; stops at the first other node
+template <typename T>
+static size_t readPlainNodes(const uchar* p, size_t n, T* data)
+{
+    size_t k = 0;
+    for( ; k < n; k++, p += 9 )
+    {
+        if( *p == FileNode::INT )
+            data[k] = saturate_cast<T>(sizeof(T) == 8 ? readLong(p + 1) : (int64_t)readInt(p + 1));
+        else if( *p == FileNode::REAL )
+            data[k] = saturate_cast<T>(readReal(p + 1));
+        else
+            break;
+    }
+    return k;
+}
+
+static size_t readPlainNodes(int elem_type, const uchar* p, size_t n, uchar* data)
+{
+    switch( elem_type )
+    {
+    case CV_8U: return readPlainNodes(p, n, (uchar*)data);
+    case CV_8S: return readPlainNodes(p, n, (schar*)data);
+    case CV_16U: return readPlainNodes(p, n, (ushort*)data);
+    case CV_16S: return readPlainNodes(p, n, (short*)data);
+    case CV_32S: return readPlainNodes(p, n, (int*)data);
+    case CV_32F: return readPlainNodes(p, n, (float*)data);
+    case CV_64F: return readPlainNodes(p, n, (double*)data);
+    default: return 0;
+    }
+}
+
 FileNodeIterator& FileNodeIterator::readRaw( const String& fmt, void* _data0, size_t maxsz)
 {
     if( fs && idx < nodeNElems )
@@ -2635,6 +2754,47 @@ FileNodeIterator& FileNodeIterator::readRaw( const String& fmt, void* _data0, si
         CV_Assert( maxsz % esz == 0 );
         maxsz /= esz;
 
+        if( fmt_pair_count == 1 && fmt_pairs[1] <= CV_64F )
+        {
+            // one element type and no padding: the data is a flat array, filled from
+            // the node storage a run of unnamed numbers at a time
+            int elem_type0 = fmt_pairs[1];
+            size_t elem_size = CV_ELEM_SIZE(elem_type0);
+            size_t n = maxsz * fmt_pairs[0];
+            while( n > 0 && idx < nodeNElems )
+            {
+                size_t run = std::min(std::min(n, nodeNElems - idx), (blockSize - ofs) / 9);
+                size_t k = readPlainNodes(elem_type0, fs->fs_data_ptrs[blockIdx] + ofs, run, data0);
+                if( k > 0 )
+                {
+                    idx += k;
+                    ofs += k * 9;
+                    n -= k;
+                    data0 += k * elem_size;
+                    if( ofs >= blockSize )
+                    {
+                        fs->normalizeNodeOfs(blockIdx, ofs);
+                        blockSize = fs->fs_data_blksz[blockIdx];
+                    }
+                    continue;
+                }
+
+                // a named number (map element) or not a number at all
+                FileNode node = *(*this);
+                if( !node.isInt() && !node.isReal() )
+                    CV_Error( Error::StsError, "readRawData can only be used to read plain sequences of numbers" );
+                const uchar* p = node.ptr();
+                uchar plain[9];
+                plain[0] = (uchar)node.type();
+                memcpy(plain + 1, p + 1 + (*p & FileNode::NAMED ? 4 : 0), 8);
+                readPlainNodes(elem_type0, plain, 1, data0);
+                ++(*this);
+                n--;
+                data0 += elem_size;
+            }
+            maxsz = 0;
+        }
+
         for( ; maxsz > 0; maxsz--, data0 += esz )
         {
             size_t offset = 0;
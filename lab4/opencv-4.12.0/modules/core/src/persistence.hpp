@@ -138,6 +138,7 @@ public:
     virtual FileStorage* getFS() = 0;
 
     virtual void puts( const char* str ) = 0;
+    virtual void putBytes( const void* data, size_t len ) = 0;
     virtual char* gets() = 0;
     virtual bool eof() = 0;
     virtual void setEof() = 0;
@@ -158,7 +159,10 @@ public:
     virtual FileNode addNode( FileNode& collection, const std::string& key,
                                int type, const void* value=0, int len=-1 ) = 0;
     virtual void finalizeCollection( FileNode& collection ) = 0;
+    //! appends count unnamed INT/REAL elements to the sequence in one go; values hold int64_t or double
+    virtual void addScalarNodes( FileNode& seq, const uchar* types, const Cv64suf* values, size_t count ) = 0;
     virtual double strtod(char* ptr, char** endptr) = 0;
+    virtual void setLineNumber( int lineno ) = 0;
 
     virtual char* parseBase64(char* ptr, int indent, FileNode& collection) = 0;
     CV_NORETURN
@@ -199,6 +203,13 @@ public:
     virtual void writeScalar(const char* key, const char* value) = 0;
     virtual void writeComment(const char* comment, bool eol_comment) = 0;
     virtual void startNextStream() = 0;
+    //! writes len bytes in the dt format as elements of the current sequence in one piece;
+    //! returns false if the emitter has no such encoding and the elements must be written one by one
+    virtual bool writeRawData(const char* dt, const void* data, size_t len)
+    {
+        CV_UNUSED(dt); CV_UNUSED(data); CV_UNUSED(len);
+        return false;
+    }
 };
 
 class FileStorageParser
@@ -212,11 +223,39 @@ public:
 Ptr<FileStorageEmitter> createXMLEmitter(FileStorage_API* fs);
 Ptr<FileStorageEmitter> createYAMLEmitter(FileStorage_API* fs);
 Ptr<FileStorageEmitter> createJSONEmitter(FileStorage_API* fs);
+Ptr<FileStorageEmitter> createBinaryEmitter(FileStorage_API* fs);
 
 Ptr<FileStorageParser> createXMLParser(FileStorage_API* fs);
 Ptr<FileStorageParser> createYAMLParser(FileStorage_API* fs);
 Ptr<FileStorageParser> createJSONParser(FileStorage_API* fs);
 
+//! Parses a whole JSON document held in memory, [begin, end), with a structural index instead of gets()
+bool parseJSONBuffer(FileStorage_API* fs, const char* begin, const char* end);
+
+//! The signature a binary storage (FileStorage::FORMAT_BINARY) starts with
+extern const char binaryStorageSignature[9];
+
+//! A whole storage file, mapped copy-on-write where the platform allows it and read into memory otherwise.
+//! The Mats of a binary storage point into it and share it.
+class FileStorageMapping
+{
+public:
+    FileStorageMapping() : data(0), size(0), mapped(false) {}
+    ~FileStorageMapping();
+
+    uchar* data;
+    size_t size;
+    bool mapped;
+    std::vector<uchar> copy;    // the file contents when it could not be mapped
+};
+
+//! Maps the storage opened as file, or reads it by name if it can not be mapped;
+//! sequential hints that it will be read once from start to end
+Ptr<FileStorageMapping> mapStorageFile(FILE* file, const std::string& filename, bool sequential = false);
+
+//! Returns a header onto the mapped payload if the node is a matrix of a binary storage
+bool readMappedMat(const FileNode& node, Mat& m);
+
 }
 
 #endif // SRC_PERSISTENCE_HPP
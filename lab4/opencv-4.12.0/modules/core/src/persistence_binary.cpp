@@ -0,0 +1,656 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html
+
+#include "precomp.hpp"
+#include "persistence.hpp"
+#include "persistence_impl.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#include <io.h>
+#undef small
+#undef min
+#undef max
+#endif
+
+/*
+ Layout of a binary file storage (FileStorage::FORMAT_BINARY). Numbers are stored in the byte order
+ of the machine that wrote the file, which is recorded in the header:
+
+ - 64-byte header: the signature "CVFSBIN1", u32 byte order mark 0x01020304, u32 header size;
+ - raw data (FileStorage::writeRaw(), e.g. the elements of a Mat), every run starting at a 64-byte
+   boundary, so matrices can be used in place once the file is mapped;
+ - the index, which is the node tree in pre-order, one record per node:
+     u8 type: FileNode::INT, REAL, STRING, SEQ, MAP or BINARY_RAW
+     u32 length + name                          (elements of a map only)
+     INT: i64 | REAL: f64 | STRING: u32 length + bytes
+     SEQ, MAP: u32 length + type name, u32 number of records that follow
+     BINARY_RAW: u32 length + format, u64 offset, u64 size (elements of a sequence only);
+ - 32-byte footer: u64 index offset, u64 index size, u64 reserved, the signature "CVFSIDX1".
+
+ When the file is read, the "data" sequence of a matrix is not turned into nodes: the matrix node keeps
+ its other children (rows, cols or sizes, dt) and its elements are mapped by readMappedMat().
+*/
+
+namespace cv
+{
+
+const char binaryStorageSignature[9] = "CVFSBIN1";
+
+enum
+{
+    BINARY_RAW = 7,             // record of a run of raw data, see BinaryEmitter::writeRawData()
+    BINARY_HEADER_SIZE = 64,
+    BINARY_FOOTER_SIZE = 32,
+    BINARY_PAYLOAD_ALIGN = 64
+};
+
+static const uint32_t binaryByteOrderMark = 0x01020304;
+static const char binaryIndexSignature[9] = "CVFSIDX1";
+
+class BinaryEmitter : public FileStorageEmitter
+{
+public:
+    BinaryEmitter(FileStorage_API* _fs) : fs(_fs), pos(0), finished(false)
+    {
+        uchar header[BINARY_HEADER_SIZE] = {0};
+        uint32_t headerSize = BINARY_HEADER_SIZE;
+        memcpy(header, binaryStorageSignature, 8);
+        memcpy(header + 8, &binaryByteOrderMark, 4);
+        memcpy(header + 12, &headerSize, 4);
+        putBytes(header, sizeof(header));
+
+        // the top-level map; it is closed by FileStorage::release()
+        index.push_back((uchar)FileNode::MAP);
+        putString("");
+        stack.push_back(Collection(true, index.size()));
+        putValue((uint32_t)0);
+    }
+    virtual ~BinaryEmitter() {}
+
+    FStructData startWriteStruct(const FStructData& /*parent*/, const char* key,
+                                 int struct_flags, const char* type_name=0)
+    {
+        int type = struct_flags & FileNode::TYPE_MASK;
+        beginRecord(type, key);
+        putString(type_name ? type_name : "");
+        stack.push_back(Collection(type == FileNode::MAP, index.size()));
+        putValue((uint32_t)0);
+        return FStructData(type_name ? type_name : "", struct_flags, 0);
+    }
+
+    void endWriteStruct(const FStructData& /*current_struct*/)
+    {
+        CV_Assert(!stack.empty());
+        if (finished)
+            return;
+        const Collection& c = stack.back();
+        memcpy(&index[c.countOfs], &c.count, sizeof(c.count));
+        if (stack.size() > 1)
+            stack.pop_back();
+        else
+            writeIndex();
+    }
+
+    void write(const char* key, int value)
+    {
+        write(key, (int64_t)value);
+    }
+
+    void write(const char* key, int64_t value)
+    {
+        beginRecord(FileNode::INT, key);
+        putValue(value);
+    }
+
+    void write(const char* key, double value)
+    {
+        beginRecord(FileNode::REAL, key);
+        putValue(value);
+    }
+
+    void write(const char* key, const char* str, bool /*quote*/)
+    {
+        beginRecord(FileNode::STRING, key);
+        putString(str);
+    }
+
+    void writeScalar(const char* key, const char* data)
+    {
+        // the text form of a number, as produced for the text formats
+        char* endptr = 0;
+        int64_t ival = strtoll(data, &endptr, 10);
+        if (*data && !*endptr)
+        {
+            write(key, ival);
+            return;
+        }
+        double fval = strtod(data, &endptr);
+        if (*data && !*endptr)
+            write(key, fval);
+        else
+            write(key, data, false);
+    }
+
+    void writeComment(const char* /*comment*/, bool /*eol_comment*/)
+    {
+    }
+
+    void startNextStream()
+    {
+        // nothing to do: a binary storage never reports a non-empty stream, so all the data goes to one
+    }
+
+    bool writeRawData(const char* dt, const void* data, size_t len)
+    {
+        int elemSize = fs::calcStructSize(dt, 0);
+        CV_Assert(elemSize > 0 && len % elemSize == 0);
+        if (!len)
+            return true;
+        if (!data)
+            CV_Error(cv::Error::StsNullPtr, "Null data pointer");
+
+        Collection& c = stack.back();
+        if (c.rawSizeOfs && c.rawEnd == pos && c.rawFormat == dt)
+        {
+            // continues the previous run, e.g. the next row of a Mat
+            uint64_t size;
+            memcpy(&size, &index[c.rawSizeOfs], sizeof(size));
+            size += len;
+            memcpy(&index[c.rawSizeOfs], &size, sizeof(size));
+        }
+        else
+        {
+            static const uchar zeros[BINARY_PAYLOAD_ALIGN] = {0};
+            beginRecord(BINARY_RAW, 0);
+            putBytes(zeros, (size_t)(BINARY_PAYLOAD_ALIGN - pos % BINARY_PAYLOAD_ALIGN) % BINARY_PAYLOAD_ALIGN);
+            putString(dt);
+            putValue(pos);
+            c.rawSizeOfs = index.size();
+            c.rawFormat = dt;
+            putValue((uint64_t)len);
+        }
+        putBytes(data, len);
+        c.rawEnd = pos;
+        return true;
+    }
+
+protected:
+    struct Collection
+    {
+        Collection(bool _isMap, size_t _countOfs)
+            : isMap(_isMap), countOfs(_countOfs), count(0), rawSizeOfs(0), rawEnd(0) {}
+
+        bool isMap;
+        size_t countOfs;
+        uint32_t count;
+        size_t rawSizeOfs;      // where the size of the last raw run is in the index, 0 if it is not the last record
+        uint64_t rawEnd;
+        std::string rawFormat;
+    };
+
+    void beginRecord(int type, const char* key)
+    {
+        if (finished)
+            CV_Error(cv::Error::StsError, "The binary storage has already been finished");
+        if (key && key[0] == '\0')
+            key = 0;
+
+        Collection& c = stack.back();
+        if (c.isMap != (key != 0))
+            CV_Error( cv::Error::StsBadArg, "An attempt to add element without a key to a map, "
+                     "or add element with key to sequence" );
+        index.push_back((uchar)type);
+        if (key)
+            putString(key);
+        c.count++;
+        c.rawSizeOfs = 0;
+    }
+
+    template<typename T> void putValue(T value)
+    {
+        const uchar* p = (const uchar*)&value;
+        index.insert(index.end(), p, p + sizeof(value));
+    }
+
+    void putString(const char* str)
+    {
+        size_t len = strlen(str);
+        CV_Assert(len < (size_t)UINT_MAX);
+        putValue((uint32_t)len);
+        index.insert(index.end(), str, str + len);
+    }
+
+    void putBytes(const void* data, size_t len)
+    {
+        fs->putBytes(data, len);
+        pos += len;
+    }
+
+    void writeIndex()
+    {
+        uint64_t indexOfs = pos, indexSize = index.size();
+        putBytes(&index[0], index.size());
+
+        uchar footer[BINARY_FOOTER_SIZE] = {0};
+        memcpy(footer, &indexOfs, 8);
+        memcpy(footer + 8, &indexSize, 8);
+        memcpy(footer + 24, binaryIndexSignature, 8);
+        putBytes(footer, sizeof(footer));
+        finished = true;
+    }
+
+    FileStorage_API* fs;
+    uint64_t pos;               // bytes written so far
+    bool finished;
+    std::vector<uchar> index;
+    std::vector<Collection> stack;
+};
+
+Ptr<FileStorageEmitter> createBinaryEmitter(FileStorage_API* fs)
+{
+    return makePtr<BinaryEmitter>(fs);
+}
+
+FileStorageMapping::~FileStorageMapping()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    if (mapped)
+        munmap(data, size);
+#elif defined(_WIN32)
+    if (mapped)
+        UnmapViewOfFile(data);
+#endif
+}
+
+Ptr<FileStorageMapping> mapStorageFile(FILE* file, const std::string& filename, bool sequential)
+{
+    Ptr<FileStorageMapping> m = makePtr<FileStorageMapping>();
+#if defined(__unix__) || defined(__APPLE__)
+    struct stat st;
+    int fd = fileno(file);
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        // a private writable mapping: the Mats pointing into it can be modified without touching the file,
+        // and only the pages that are actually accessed are read
+        void* data = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+        {
+#ifdef MADV_SEQUENTIAL
+            if (sequential)
+                madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+            m->data = (uchar*)data;
+            m->size = (size_t)st.st_size;
+            m->mapped = true;
+            return m;
+        }
+    }
+#elif defined(_WIN32)
+    HANDLE fh = (HANDLE)_get_osfhandle(_fileno(file));
+    LARGE_INTEGER fileSize;
+    if (fh != INVALID_HANDLE_VALUE && GetFileType(fh) == FILE_TYPE_DISK &&
+        GetFileSizeEx(fh, &fileSize) && fileSize.QuadPart > 0 && (uint64)fileSize.QuadPart <= (uint64)SIZE_MAX)
+    {
+        // the same as MAP_PRIVATE above: FILE_MAP_COPY makes the pages written to private to this process
+        HANDLE section = CreateFileMappingW(fh, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+        if (section)
+        {
+            void* data = MapViewOfFile(section, FILE_MAP_COPY, 0, 0, 0);
+            CloseHandle(section);   // the view keeps the section alive
+            if (data)
+            {
+                m->data = (uchar*)data;
+                m->size = (size_t)fileSize.QuadPart;
+                m->mapped = true;
+                return m;
+            }
+        }
+    }
+#else
+    CV_UNUSED(file);
+#endif
+    CV_UNUSED(sequential);
+    // no mapping: read the whole file
+    FILE* f = fopen(filename.c_str(), "rb");
+    if (!f)
+        CV_Error_(cv::Error::StsError, ("Can't open file: '%s'", filename.c_str()));
+    size_t size = 0;
+    for (;;)
+    {
+        m->copy.resize(std::max(m->copy.size() * 2, (size_t)1 << 16));
+        size += fread(&m->copy[size], 1, m->copy.size() - size, f);
+        if (size < m->copy.size())
+            break;
+    }
+    fclose(f);
+    m->copy.resize(size);
+    m->data = size ? &m->copy[0] : 0;
+    m->size = size;
+    return m;
+}
+
+class BinaryIndexParser
+{
+public:
+    BinaryIndexParser(FileStorage::Impl* _fs, const uchar* index, size_t indexSize, size_t _payloadEnd)
+        : fs(_fs), ptr(index), end(index + indexSize), payloadEnd(_payloadEnd)
+    {
+    }
+
+    void parse()
+    {
+        FileNode root_collection(fs->getFS(), 0, 0);
+        if (ptr < end)
+            parseRecord(root_collection, false);
+        if (ptr != end)
+            parseError("unexpected data after the top-level node");
+    }
+
+protected:
+    void parseRecord(FileNode& collection, bool inMap)
+    {
+        int type = getValue<uchar>();
+        std::string name;
+        if (inMap)
+            name = getString();
+
+        switch (type)
+        {
+        case FileNode::INT:
+        {
+            int64_t ival = getValue<int64_t>();
+            fs->addNode(collection, name, FileNode::INT, &ival, -1);
+            break;
+        }
+        case FileNode::REAL:
+        {
+            double fval = getValue<double>();
+            fs->addNode(collection, name, FileNode::REAL, &fval, -1);
+            break;
+        }
+        case FileNode::STRING:
+        {
+            std::string str = getString();
+            fs->addNode(collection, name, FileNode::STRING, str.c_str(), (int)str.size());
+            break;
+        }
+        case FileNode::SEQ:
+        case FileNode::MAP:
+        {
+            std::string type_name = getString();
+            uint32_t count = getValue<uint32_t>();
+            FileNode node = fs->addNode(collection, name, FileNode::NONE, 0, -1);
+            fs->convertToCollection(type, node);
+
+            bool isMat = type == FileNode::MAP &&
+                         (type_name == "opencv-matrix" || type_name == "opencv-nd-matrix");
+            for (uint32_t i = 0; i < count; i++)
+            {
+                if (isMat && parseMatData(node))
+                    continue;
+                parseRecord(node, type == FileNode::MAP);
+            }
+            fs->finalizeCollection(node);
+            break;
+        }
+        case BINARY_RAW:
+            if (inMap)
+                parseError("raw data in a map");
+            parseRawData(collection);
+            break;
+        default:
+            parseError(cv::format("unknown node type %d", type));
+        }
+    }
+
+    // A matrix keeps its elements in the file: instead of a "data" sequence of numbers
+    // the position of the payload is remembered, see readMappedMat()
+    bool parseMatData(FileNode& mat)
+    {
+        const uchar* ptr0 = ptr;
+        if (getValue<uchar>() == FileNode::SEQ && getString() == "data")
+        {
+            getString();
+            if (getValue<uint32_t>() == 1 && getValue<uchar>() == BINARY_RAW)
+            {
+                std::string dt = getString();
+                uint64_t ofs = getValue<uint64_t>(), size = getValue<uint64_t>();
+                int fmt_pairs[CV_FS_MAX_FMT_PAIRS*2];
+                if (fs::decodeFormat(dt.c_str(), fmt_pairs, CV_FS_MAX_FMT_PAIRS) == 1)
+                {
+                    checkPayload(ofs, size);
+                    size_t blockIdx = mat.blockIdx, nodeOfs = mat.ofs;
+                    fs->normalizeNodeOfs(blockIdx, nodeOfs);
+                    fs->mapped_mats[std::make_pair(blockIdx, nodeOfs)] = std::make_pair((size_t)ofs, (size_t)size);
+                    return true;
+                }
+            }
+        }
+        ptr = ptr0;
+        return false;
+    }
+
+    void parseRawData(FileNode& seq)
+    {
+        std::string dt = getString();
+        uint64_t ofs = getValue<uint64_t>(), size = getValue<uint64_t>();
+        checkPayload(ofs, size);
+
+        int fmt_pairs[CV_FS_MAX_FMT_PAIRS*2];
+        int fmt_pair_count = fs::decodeFormat(dt.c_str(), fmt_pairs, CV_FS_MAX_FMT_PAIRS);
+        size_t elemSize = fs::calcStructSize(dt.c_str(), 0);
+        if (!elemSize || size % elemSize != 0)
+            parseError("the size of raw data does not match its format");
+
+        const uchar* data0 = fs->mapping->data + ofs;
+        for (size_t n = (size_t)(size / elemSize); n--; data0 += elemSize)
+        {
+            int offset = 0;
+            for (int k = 0; k < fmt_pair_count; k++)
+            {
+                int count = fmt_pairs[k*2], elem_type = fmt_pairs[k*2+1];
+                offset = cvAlign(offset, CV_ELEM_SIZE(elem_type));
+                const uchar* data = data0 + offset;
+                for (int i = 0; i < count; i++, data += CV_ELEM_SIZE(elem_type))
+                    addValue(elem_type, data);
+                offset = (int)(data - data0);
+            }
+        }
+        if (!types.empty())
+            fs->addScalarNodes(seq, &types[0], &values[0], types.size());
+        types.clear();
+        values.clear();
+    }
+
+    void addValue(int elem_type, const uchar* data)
+    {
+        Cv64suf v;
+        uchar type = FileNode::INT;
+        switch (elem_type)
+        {
+        case CV_8U: v.i = *data; break;
+        case CV_8S: v.i = *(const schar*)data; break;
+        case CV_16U: v.i = *(const ushort*)data; break;
+        case CV_16S: v.i = *(const short*)data; break;
+        case CV_32S: v.i = *(const int*)data; break;
+        case CV_32F: v.f = *(const float*)data; type = FileNode::REAL; break;
+        case CV_64F: v.f = *(const double*)data; type = FileNode::REAL; break;
+        case CV_16F: v.f = (float)*(const hfloat*)data; type = FileNode::REAL; break;
+        default:
+            parseError("unsupported type of raw data");
+        }
+        types.push_back(type);
+        values.push_back(v);
+    }
+
+    void checkPayload(uint64_t ofs, uint64_t size)
+    {
+        if (ofs < BINARY_HEADER_SIZE || ofs > payloadEnd || size > payloadEnd - ofs)
+            parseError("raw data outside of the file");
+    }
+
+    template<typename T> T getValue()
+    {
+        need(sizeof(T));
+        T value;
+        memcpy(&value, ptr, sizeof(T));
+        ptr += sizeof(T);
+        return value;
+    }
+
+    std::string getString()
+    {
+        uint32_t len = getValue<uint32_t>();
+        need(len);
+        std::string str((const char*)ptr, len);
+        ptr += len;
+        return str;
+    }
+
+    void need(size_t n)
+    {
+        if ((size_t)(end - ptr) < n)
+            parseError("the index is truncated");
+    }
+
+    void parseError(const std::string& msg)
+    {
+        CV_Error_(cv::Error::StsParseError, ("'%s': invalid binary file storage: %s",
+                  fs->filename.c_str(), msg.c_str()));
+    }
+
+    FileStorage::Impl* fs;
+    const uchar* ptr;
+    const uchar* end;
+    uint64_t payloadEnd;
+
+    std::vector<uchar> types;
+    std::vector<Cv64suf> values;
+};
+
+bool FileStorage::Impl::parseBinaryInput()
+{
+    CV_Assert(file);
+    mapping = mapStorageFile(file, filename);
+    const uchar* data = mapping->data;
+    size_t size = mapping->size;
+
+    uint32_t byteOrderMark = 0;
+    if (size < BINARY_HEADER_SIZE + BINARY_FOOTER_SIZE || memcmp(data, binaryStorageSignature, 8) != 0)
+        CV_Error_(cv::Error::StsParseError, ("'%s': invalid binary file storage", filename.c_str()));
+    memcpy(&byteOrderMark, data + 8, 4);
+    if (byteOrderMark != binaryByteOrderMark)
+        CV_Error_(cv::Error::StsNotImplemented, ("'%s': the binary file storage has been written with "
+                  "a different byte order", filename.c_str()));
+
+    const uchar* footer = data + size - BINARY_FOOTER_SIZE;
+    uint64_t indexOfs, indexSize;
+    if (memcmp(footer + 24, binaryIndexSignature, 8) != 0)
+        CV_Error_(cv::Error::StsParseError, ("'%s': the binary file storage has no index, "
+                  "it may not have been released after writing", filename.c_str()));
+    memcpy(&indexOfs, footer, 8);
+    memcpy(&indexSize, footer + 8, 8);
+    size_t payloadEnd = size - BINARY_FOOTER_SIZE;
+    if (indexOfs < BINARY_HEADER_SIZE || indexOfs > payloadEnd || indexSize > payloadEnd - indexOfs)
+        CV_Error_(cv::Error::StsParseError, ("'%s': invalid binary file storage index", filename.c_str()));
+
+    BinaryIndexParser parser(this, data + indexOfs, (size_t)indexSize, (size_t)indexOfs);
+    parser.parse();
+    return true;
+}
+
+class MappedMatAllocator CV_FINAL : public MatAllocator
+{
+public:
+    UMatData* allocate(int dims, const int* sizes, int type,
+                       void* data0, size_t* step, AccessFlag flags, UMatUsageFlags usageFlags) const CV_OVERRIDE
+    {
+        return Mat::getStdAllocator()->allocate(dims, sizes, type, data0, step, flags, usageFlags);
+    }
+
+    bool allocate(UMatData* u, AccessFlag /*accessFlags*/, UMatUsageFlags /*usageFlags*/) const CV_OVERRIDE
+    {
+        return u != NULL;
+    }
+
+    void deallocate(UMatData* u) const CV_OVERRIDE
+    {
+        if(!u)
+            return;
+
+        CV_Assert(u->urefcount == 0);
+        CV_Assert(u->refcount == 0);
+        delete (Ptr<FileStorageMapping>*)u->userdata;
+        delete u;
+    }
+};
+
+static MappedMatAllocator* getMappedMatAllocator()
+{
+    CV_SINGLETON_LAZY_INIT(MappedMatAllocator, new MappedMatAllocator())
+}
+
+bool readMappedMat(const FileNode& node, Mat& m)
+{
+    FileStorage::Impl* fs = node.fs;
+    if (!fs || fs->mapped_mats.empty() || !node.isMap())
+        return false;
+
+    size_t blockIdx = node.blockIdx, ofs = node.ofs;
+    fs->normalizeNodeOfs(blockIdx, ofs);
+    std::map<std::pair<size_t, size_t>, std::pair<size_t, size_t> >::const_iterator it =
+        fs->mapped_mats.find(std::make_pair(blockIdx, ofs));
+    if (it == fs->mapped_mats.end())
+        return false;
+
+    std::string dt;
+    int rows, dims = 2, sizes[CV_MAX_DIM] = {0};
+
+    read(node["dt"], dt, std::string());
+    CV_Assert(!dt.empty());
+    int elem_type = fs::decodeSimpleFormat(dt.c_str());
+
+    read(node["rows"], rows, -1);
+    if (rows >= 0)
+    {
+        sizes[0] = rows;
+        read(node["cols"], sizes[1], -1);
+    }
+    else
+    {
+        FileNode sizes_node = node["sizes"];
+        dims = (int)sizes_node.size();
+        CV_Assert(0 < dims && dims <= CV_MAX_DIM);
+        sizes_node.readRaw("i", sizes, dims*sizeof(sizes[0]));
+    }
+
+    size_t total = CV_ELEM_SIZE(elem_type);
+    for (int i = 0; i < dims; i++)
+    {
+        CV_Assert(sizes[i] >= 0);
+        total *= (size_t)sizes[i];
+    }
+    if (total != it->second.second)
+        CV_Error_(cv::Error::StsParseError, ("'%s': the matrix size does not match its data", fs->filename.c_str()));
+
+    // the header keeps the mapping alive, so the Mat outlives the storage
+    uchar* data = fs->mapping->data + it->second.first;
+    UMatData* u = new UMatData(getMappedMatAllocator());
+    u->data = u->origdata = data;
+    u->size = total;
+    u->userdata = new Ptr<FileStorageMapping>(fs->mapping);
+
+    Mat header(dims, sizes, elem_type, data);
+    header.u = u;
+    u->refcount = 1;
+    m = header;
+    return true;
+}
+
+}
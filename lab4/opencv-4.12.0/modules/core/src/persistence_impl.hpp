@@ -9,6 +9,7 @@
 #include "persistence_base64_encoding.hpp"
 #include <unordered_map>
 #include <iterator>
+#include <map>
 
 
 namespace cv
@@ -37,6 +38,8 @@ public:
 
     void puts( const char* str );
 
+    void putBytes( const void* data, size_t len );
+
     char* getsFromFile( char* buf, int count );
 
     char* gets( size_t maxCount );
@@ -131,6 +134,10 @@ public:
 
     void finalizeCollection( FileNode& collection );
 
+    void addScalarNodes( FileNode& seq, const uchar* types, const Cv64suf* values, size_t count );
+
+    void setLineNumber( int lineno );
+
     void normalizeNodeOfs(size_t& blockIdx, size_t& ofs) const;
 
     Base64State get_state_of_writing_base64();
@@ -175,6 +182,10 @@ public:
 
     char* parseBase64(char* ptr, int indent, FileNode& collection);
 
+    bool parseJSONInput( size_t ofs );
+
+    bool parseBinaryInput();
+
     void parseError( const char* func_name, const std::string& err_msg, const char* source_file, int source_line );
 
     const uchar* getNodePtr(size_t blockIdx, size_t ofs) const;
@@ -239,6 +250,11 @@ public:
     str_hash_t str_hash;
     std::vector<char> str_hash_data;
 
+    // binary storage being read: the mapped file and the matrix payloads (offset, size) in it,
+    // keyed by the (blockIdx, ofs) of their matrix nodes
+    Ptr<FileStorageMapping> mapping;
+    std::map<std::pair<size_t, size_t>, std::pair<size_t, size_t> > mapped_mats;
+
     std::vector<char> strbufv;
     char* strbuf;
     size_t strbufsize;
@@ -790,6 +790,616 @@ public:
     char buf[CV_FS_MAX_LEN+1024];
 };
 
+/*
+ * Reading a whole document held in memory (a mapped file or a MEMORY string).
+ *
+ * Stage 1 finds the structural characters - { } [ ] : , the opening quote of each string
+ * and the first character of each other scalar - 64 bytes at a time: the quote, backslash,
+ * bracket and whitespace masks come from vector compares, the in-string mask is the prefix
+ * XOR of the unescaped quotes. Blocks with comments go through a byte-by-byte scanner.
+ * Stage 2 walks the positions and builds the same nodes as JSONParser, without the
+ * per-line gets() and with the numbers of a sequence appended to it in bulk.
+ */
+class JSONFastParser
+{
+public:
+    JSONFastParser(FileStorage_API* _fs, const char* _begin, const char* _end)
+        : fs(_fs), begin(_begin), end(_end), scanPos(_begin), cur(0),
+          inString(false), escaped(false), inScalar(false), comment(NO_COMMENT)
+    {
+    }
+
+    bool parse()
+    {
+        const char* ptr = next();
+        if( !ptr )
+            return false;
+
+        FileNode root_collection(fs->getFS(), 0, 0);
+
+        if( *ptr == '{' )
+        {
+            FileNode root_node = fs->addNode(root_collection, std::string(), FileNode::MAP);
+            parseMap( ptr, root_node );
+        }
+        else if ( *ptr == '[' )
+        {
+            FileNode root_node = fs->addNode(root_collection, std::string(), FileNode::SEQ);
+            parseSeq( ptr, root_node );
+        }
+        else
+        {
+            parseError( ptr, "left-brace of top level is missing" );
+        }
+
+        return true;
+    }
+
+protected:
+    enum { NO_COMMENT = 0, LINE_COMMENT = 1, BLOCK_COMMENT = 2 };
+    // input bytes indexed per refill; bounds the index for large files
+    enum { INDEX_CHUNK = 1 << 16 };
+    // numbers collected before they are appended to their sequence
+    enum { MAX_PENDING_SCALARS = 1 << 16 };
+
+    void parseError( const char* ptr, const char* msg )
+    {
+        fs->setLineNumber( 1 + (int)std::count(begin, std::min(ptr, end), '\n') );
+        CV_PARSE_ERROR_CPP( msg );
+    }
+
+    /****************************** stage 1 ******************************/
+
+    static inline bool isSpace( char c ) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+    static inline bool isOp( char c ) { return c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ','; }
+
+    static inline uint64 prefixXor( uint64 x )
+    {
+        x ^= x << 1;
+        x ^= x << 2;
+        x ^= x << 4;
+        x ^= x << 8;
+        x ^= x << 16;
+        x ^= x << 32;
+        return x;
+    }
+
+    void addStructurals( const char* base, uint64 bits )
+    {
+        for( unsigned lo = (unsigned)bits; lo != 0; lo &= lo - 1 )
+            index.push_back( base + trailingZeros32(lo) );
+        for( unsigned hi = (unsigned)(bits >> 32); hi != 0; hi &= hi - 1 )
+            index.push_back( base + 32 + trailingZeros32(hi) );
+    }
+
+#if CV_SIMD128
+    // Indexes the 64 bytes at scanPos. Returns false, leaving the state as is,
+    // if the block has a '/' outside of strings: comments are left to scanBytes()
+    bool scanBlock()
+    {
+        const uchar* p = (const uchar*)scanPos;
+        const v_uint8x16 vquote = v_setall_u8('"'), vbslash = v_setall_u8('\\'), vslash = v_setall_u8('/');
+        const v_uint8x16 vlbrace = v_setall_u8('{'), vrbrace = v_setall_u8('}'), vcase = v_setall_u8(0x20);
+        const v_uint8x16 vcolon = v_setall_u8(':'), vcomma = v_setall_u8(',');
+        const v_uint8x16 vspace = v_setall_u8(' '), vtab = v_setall_u8('\t'), vlf = v_setall_u8('\n'), vcr = v_setall_u8('\r');
+        uint64 quote = 0, bslash = 0, slash = 0, op = 0, space = 0;
+
+        for( int k = 0; k < 4; k++ )
+        {
+            v_uint8x16 v = v_load(p + k*16);
+            // '[' | 0x20 == '{', ']' | 0x20 == '}'
+            v_uint8x16 vl = v_or(v, vcase);
+            int shift = k*16;
+            quote |= (uint64)(unsigned)v_signmask(v_eq(v, vquote)) << shift;
+            bslash |= (uint64)(unsigned)v_signmask(v_eq(v, vbslash)) << shift;
+            slash |= (uint64)(unsigned)v_signmask(v_eq(v, vslash)) << shift;
+            op |= (uint64)(unsigned)v_signmask(v_or(v_or(v_eq(vl, vlbrace), v_eq(vl, vrbrace)),
+                                                    v_or(v_eq(v, vcolon), v_eq(v, vcomma)))) << shift;
+            space |= (uint64)(unsigned)v_signmask(v_or(v_or(v_eq(v, vspace), v_eq(v, vtab)),
+                                                       v_or(v_eq(v, vlf), v_eq(v, vcr)))) << shift;
+        }
+
+        // escaped characters: backslashes are rare, so walk them one by one
+        uint64 escapedMask = 0;
+        bool esc = escaped;
+        if( bslash || esc )
+        {
+            for( int i = 0; i < 64; i++ )
+            {
+                if( esc )
+                {
+                    escapedMask |= (uint64)1 << i;
+                    esc = false;
+                }
+                else if( (bslash >> i) & 1 )
+                    esc = true;
+            }
+        }
+
+        quote &= ~escapedMask;
+        uint64 str = prefixXor(quote) ^ (inString ? ~(uint64)0 : 0);   // opening quote and contents
+        if( slash & ~str )
+            return false;
+
+        uint64 scalar = ~(op | space | quote | str);
+        uint64 scalarStart = scalar & ~((scalar << 1) | (inScalar ? 1 : 0));
+        addStructurals( scanPos, (op & ~str) | (quote & str) | scalarStart );
+
+        inString = (str >> 63) != 0;
+        inScalar = (scalar >> 63) != 0;
+        escaped = esc;
+        scanPos += 64;
+        return true;
+    }
+#endif
+
+    // Indexes byte by byte up to limit (or one byte beyond it)
+    void scanBytes( const char* limit )
+    {
+        const char* p = scanPos;
+        for( ; p < limit; p++ )
+        {
+            char c = *p;
+            if( comment == LINE_COMMENT )
+            {
+                if( c == '\n' || c == '\r' )
+                    comment = NO_COMMENT;
+            }
+            else if( comment == BLOCK_COMMENT )
+            {
+                if( c == '*' && p + 1 < end && p[1] == '/' )
+                {
+                    comment = NO_COMMENT;
+                    p++;
+                }
+            }
+            else if( inString )
+            {
+                if( escaped )
+                    escaped = false;
+                else if( c == '\\' )
+                    escaped = true;
+                else if( c == '"' )
+                    inString = false;
+            }
+            else if( c == '"' )
+            {
+                index.push_back( p );
+                inString = true;
+                inScalar = false;
+            }
+            else if( isOp(c) )
+            {
+                index.push_back( p );
+                inScalar = false;
+            }
+            else if( isSpace(c) )
+            {
+                inScalar = false;
+            }
+            else if( c == '/' && p + 1 < end && (p[1] == '/' || p[1] == '*') )
+            {
+                comment = p[1] == '/' ? LINE_COMMENT : BLOCK_COMMENT;
+                inScalar = false;
+                p++;
+            }
+            else
+            {
+                if( !inScalar )
+                    index.push_back( p );
+                inScalar = true;
+            }
+        }
+        scanPos = p;
+    }
+
+    void indexMore()
+    {
+        index.clear();
+        cur = 0;
+        const char* chunkEnd = scanPos + std::min((size_t)(end - scanPos), (size_t)INDEX_CHUNK);
+        while( scanPos < end && (index.empty() || scanPos < chunkEnd) )
+        {
+#if CV_SIMD128
+            if( comment == NO_COMMENT && end - scanPos >= 64 && scanBlock() )
+                continue;
+#endif
+            scanBytes( std::min(scanPos + 64, end) );
+        }
+        if( scanPos >= end && index.empty() && inString )
+            parseError( end, "'\"' - right-quote of string is missing" );
+    }
+
+    // next structural character, 0 at the end of input
+    inline const char* next()
+    {
+        if( cur >= index.size() )
+        {
+            if( scanPos >= end )
+                return 0;
+            indexMore();
+            if( index.empty() )
+                return 0;
+        }
+        return index[cur++];
+    }
+
+    /****************************** stage 2 ******************************/
+
+    // a scalar can be followed by a space, a structural character or a comment
+    inline void checkScalarEnd( const char* ptr )
+    {
+        if( ptr < end && !isSpace(*ptr) && !isOp(*ptr) && *ptr != '"' && *ptr != '/' )
+            parseError( ptr, "Unexpected character" );
+    }
+
+    static inline bool isEightDigits( const char* ptr, uint64& v )
+    {
+        const uchar* p = (const uchar*)ptr;
+        v = (uint64)p[0] | ((uint64)p[1] << 8) | ((uint64)p[2] << 16) | ((uint64)p[3] << 24) |
+            ((uint64)p[4] << 32) | ((uint64)p[5] << 40) | ((uint64)p[6] << 48) | ((uint64)p[7] << 56);
+        return (((v & CV_BIG_UINT(0xF0F0F0F0F0F0F0F0)) |
+                 (((v + CV_BIG_UINT(0x0606060606060606)) & CV_BIG_UINT(0xF0F0F0F0F0F0F0F0)) >> 4)) ==
+                CV_BIG_UINT(0x3333333333333333));
+    }
+
+    static inline uint64 eightDigitsValue( uint64 v )
+    {
+        // SWAR: pairs, then quads, then the 8-digit number
+        v -= CV_BIG_UINT(0x3030303030303030);
+        v = (v * 10) + (v >> 8);
+        v = (((v & CV_BIG_UINT(0x000000FF000000FF)) * CV_BIG_UINT(0x000F424000000064)) +
+             (((v >> 16) & CV_BIG_UINT(0x000000FF000000FF)) * CV_BIG_UINT(0x0000271000000001))) >> 32;
+        return v & 0xFFFFFFFF;
+    }
+
+    // Accumulates the digits at ptr into mant. ndigits counts the significant ones (maybe a few more
+    // after an 8-digit step); past 19 they are no longer accumulated and the value needs strtod()
+    inline const char* parseDigits( const char* ptr, uint64& mant, int& ndigits, int& nread )
+    {
+        uint64 v;
+        while( end - ptr >= 8 && ndigits <= 11 && isEightDigits(ptr, v) )
+        {
+            mant = mant * 100000000 + eightDigitsValue(v);
+            if( mant || ndigits )
+                ndigits += 8;
+            ptr += 8;
+            nread += 8;
+        }
+        for( ; ptr < end && cv_isdigit(*ptr); ptr++, nread++ )
+        {
+            if( ndigits < 19 )
+                mant = mant * 10 + (*ptr - '0');
+            if( mant || ndigits )
+                ndigits++;
+        }
+        return ptr;
+    }
+
+    // Parses the number at ptr into an INT or REAL value. Exactly representable cases are
+    // converted here (Clinger's fast path); the rest go through a copy to fs->strtod()/strtoll()
+    const char* parseNumber( const char* ptr, uchar& type, Cv64suf& value )
+    {
+        static const double pow10[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+        const char* beg = ptr;
+        bool neg = false;
+        if( *ptr == '-' || *ptr == '+' )
+        {
+            neg = *ptr == '-';
+            ptr++;
+        }
+
+        uint64 mant = 0;
+        int ndigits = 0, nint = 0, nfrac = 0;
+        const char* intBeg = ptr;
+        ptr = parseDigits( ptr, mant, ndigits, nint );
+
+        bool fast = ndigits <= 19;
+        if( ptr < end && (*ptr == '.' || *ptr == 'e' || *ptr == 'E') )
+        {
+            int exp10 = 0;
+            if( *ptr == '.' )
+            {
+                ptr = parseDigits( ptr + 1, mant, ndigits, nfrac );
+                fast = fast && ndigits <= 19;
+                exp10 = -nfrac;
+            }
+            if( ptr < end && (*ptr == 'e' || *ptr == 'E') )
+            {
+                const char* e = ptr + 1;
+                bool eneg = false;
+                if( e < end && (*e == '-' || *e == '+') )
+                    eneg = *e++ == '-';
+                int ev = 0;
+                const char* ebeg = e;
+                for( ; e < end && cv_isdigit(*e); e++ )
+                    ev = std::min(ev * 10 + (*e - '0'), 100000);
+                fast = fast && e > ebeg;
+                exp10 += eneg ? -ev : ev;
+                ptr = e;
+            }
+            fast = fast && nint + nfrac > 0 && mant <= (CV_BIG_UINT(1) << 53) &&
+                   -22 <= exp10 && exp10 <= 22 && (ptr >= end || !cv_isalpha(*ptr));
+#if !defined(FLT_EVAL_METHOD) || FLT_EVAL_METHOD != 0
+            fast = false;   // the multiplication below must round once, in double
+#endif
+            if( fast )
+            {
+                double d = (double)mant;
+                d = exp10 < 0 ? d / pow10[-exp10] : d * pow10[exp10];
+                value.f = neg ? -d : d;
+            }
+            else
+            {
+                char token[128];
+                const char* tokenEnd = beg;
+                while( tokenEnd < end && !isSpace(*tokenEnd) && !isOp(*tokenEnd) && *tokenEnd != '"' && *tokenEnd != '/' )
+                    tokenEnd++;
+                size_t len = (size_t)(tokenEnd - beg);
+                if( len >= sizeof(token) )
+                    parseError( beg, "Invalid numeric value (inconsistent explicit type specification?)" );
+                memcpy( token, beg, len );
+                token[len] = '\0';
+                char* endptr = token;
+                value.f = fs->strtod( token, &endptr );
+                ptr = beg + (endptr - token);
+            }
+            type = FileNode::REAL;
+        }
+        else
+        {
+            // strtoll(.., 0) reads "0x1F" and "017" as hex and octal, so only plain decimals stay here
+            if( nint > 0 && nint <= 18 && (nint == 1 || *intBeg != '0') && (ptr >= end || !cv_isalnum(*ptr)) )
+                value.i = neg ? -(int64)mant : (int64)mant;
+            else
+            {
+                char token[128];
+                size_t len = std::min((size_t)(end - beg), sizeof(token) - 1);
+                memcpy( token, beg, len );
+                token[len] = '\0';
+                char* endptr = token;
+                value.i = strtoll( token, &endptr, 0 );
+                ptr = beg + (endptr - token);
+            }
+            type = FileNode::INT;
+        }
+
+        if( ptr <= beg )
+            parseError( beg, "Invalid numeric value (inconsistent explicit type specification?)" );
+        checkScalarEnd( ptr );
+        return ptr;
+    }
+
+    void parseString( const char* ptr, FileNode& node )
+    {
+        const char* beg = ptr + 1;
+        if( end - beg >= 8 && memcmp( beg, "$base64$", 8 ) == 0 )
+        {
+            // parseBase64() reads up to the closing quote, which must be there
+            if( !memchr( beg, '"', end - beg ) )
+                parseError( beg, "'\"' - right-quote of string is missing" );
+            char* eptr = fs->parseBase64( (char*)beg + 8, 0, node );
+            if( *eptr != '"' )
+                parseError( eptr, "'\"' - right-quote of string is missing" );
+            return;
+        }
+
+        int i = 0;
+        for( ptr = beg; ; ptr++ )
+        {
+            if( ptr >= end || *ptr == '\0' || *ptr == '\n' || *ptr == '\r' )
+                parseError( ptr, "'\"' - right-quote of string is missing" );
+            if( *ptr == '"' )
+                break;
+            if( *ptr != '\\' )
+                continue;
+
+            int sz = (int)(ptr - beg);
+            if( i + sz + 1 >= CV_FS_MAX_LEN )
+                parseError( ptr, "string is too long" );
+            memcpy( buf + i, beg, sz );
+            i += sz;
+            ptr++;
+            switch( ptr < end ? *ptr : '\0' )
+            {
+            case '\\':
+            case '\"':
+            case '\'': buf[i++] = *ptr; break;
+            case 'n' : buf[i++] = '\n'; break;
+            case 'r' : buf[i++] = '\r'; break;
+            case 't' : buf[i++] = '\t'; break;
+            case 'b' : buf[i++] = '\b'; break;
+            case 'f' : buf[i++] = '\f'; break;
+            case 'u' : parseError( ptr, "'\\uXXXX' currently not supported" ); break;
+            default  : parseError( ptr, "Invalid escape character" );
+            }
+            beg = ptr + 1;
+        }
+
+        int sz = (int)(ptr - beg);
+        if( i == 0 )
+        {
+            if( sz >= CV_FS_MAX_LEN )
+                parseError( ptr, "string is too long" );
+            node.setValue( FileNode::STRING, beg, sz );
+            return;
+        }
+        if( i + sz >= CV_FS_MAX_LEN )
+            parseError( ptr, "string is too long" );
+        memcpy( buf + i, beg, sz );
+        node.setValue( FileNode::STRING, buf, i + sz );
+    }
+
+    void parseLiteral( const char* ptr, FileNode& node )
+    {
+        const char* beg = ptr;
+        for( ; ptr < end && cv_isalpha(*ptr) && ptr - beg <= 6; ptr++ )
+            ;
+        size_t len = (size_t)(ptr - beg);
+
+        if( len == 4 && memcmp( beg, "null", 4 ) == 0 )
+        {
+            parseError( beg, "Value 'null' is not supported by this parser" );
+        }
+        else if( (len == 4 && memcmp( beg, "true", 4 ) == 0) ||
+                 (len == 5 && memcmp( beg, "false", 5 ) == 0) )
+        {
+            int64_t ival = *beg == 't' ? 1 : 0;
+            node.setValue( FileNode::INT, &ival );
+        }
+        else
+        {
+            parseError( beg, "Unrecognized value" );
+        }
+        checkScalarEnd( ptr );
+    }
+
+    static inline bool isNumberStart( char c )
+    {
+        return cv_isdigit(c) || c == '-' || c == '+' || c == '.';
+    }
+
+    void parseValue( const char* ptr, FileNode& node )
+    {
+        if( !ptr )
+            parseError( end, "Unexpected End-Of-File" );
+
+        if( *ptr == '[' )
+            parseSeq( ptr, node );
+        else if( *ptr == '{' )
+            parseMap( ptr, node );
+        else if( *ptr == '"' )
+            parseString( ptr, node );
+        else if( isNumberStart(*ptr) )
+        {
+            uchar type = 0;
+            Cv64suf value;
+            parseNumber( ptr, type, value );
+            if( type == FileNode::INT )
+                node.setValue( FileNode::INT, &value.i );
+            else
+                node.setValue( FileNode::REAL, &value.f );
+        }
+        else
+            parseLiteral( ptr, node );
+    }
+
+    void flushScalars( FileNode& node )
+    {
+        if( !types.empty() )
+            fs->addScalarNodes( node, &types[0], &values[0], types.size() );
+        types.clear();
+        values.clear();
+    }
+
+    void parseSeq( const char* ptr, FileNode& node )
+    {
+        fs->convertToCollection( FileNode::SEQ, node );
+
+        // numbers are collected until something else is added to the sequence; the enclosing
+        // sequences have flushed theirs before this one started
+        for( ;; )
+        {
+            ptr = next();
+            if( !ptr )
+                parseError( end, "']' - right-brace of seq is missing" );
+
+            if( *ptr != ']' )
+            {
+                if( isNumberStart(*ptr) )
+                {
+                    types.push_back( 0 );
+                    values.push_back( Cv64suf() );
+                    parseNumber( ptr, types.back(), values.back() );
+                    if( types.size() >= MAX_PENDING_SCALARS )
+                        flushScalars( node );
+                }
+                else
+                {
+                    flushScalars( node );
+                    FileNode child = fs->addNode( node, std::string(), FileNode::NONE );
+                    parseValue( ptr, child );
+                }
+
+                ptr = next();
+                if( !ptr )
+                    parseError( end, "']' - right-brace of seq is missing" );
+            }
+
+            if( *ptr == ',' )
+                continue;
+            else if( *ptr == ']' )
+                break;
+            else
+                parseError( ptr, "Unexpected character" );
+        }
+
+        flushScalars( node );
+        fs->finalizeCollection( node );
+    }
+
+    void parseMap( const char* ptr, FileNode& node )
+    {
+        fs->convertToCollection( FileNode::MAP, node );
+
+        for( ;; )
+        {
+            ptr = next();
+            if( !ptr )
+                parseError( end, "'}' - right-brace of map is missing" );
+
+            if( *ptr == '"' )
+            {
+                const char* beg = ptr + 1;
+                for( ptr = beg; ptr < end && cv_isprint(*ptr) && *ptr != '"'; ptr++ )
+                    ;
+                if( ptr >= end || *ptr != '"' )
+                    parseError( ptr, "Key must end with \'\"\'" );
+                if( ptr == beg )
+                    parseError( ptr, "Key is empty" );
+                FileNode child = fs->addNode( node, std::string(beg, (size_t)(ptr - beg)), FileNode::NONE );
+
+                ptr = next();
+                if( !ptr || *ptr != ':' )
+                    parseError( ptr ? ptr : end, "Missing \':\' between key and value" );
+                parseValue( next(), child );
+
+                ptr = next();
+                if( !ptr )
+                    parseError( end, "'}' - right-brace of map is missing" );
+            }
+
+            if( *ptr == ',' )
+                continue;
+            else if( *ptr == '}' )
+                break;
+            else
+                parseError( ptr, "Unexpected character" );
+        }
+
+        fs->finalizeCollection( node );
+    }
+
+    FileStorage_API* fs;
+    const char* begin;
+    const char* end;
+
+    // stage 1 state
+    const char* scanPos;
+    std::vector<const char*> index;
+    size_t cur;
+    bool inString, escaped, inScalar;
+    int comment;
+
+    // numbers not yet appended to their sequences
+    std::vector<uchar> types;
+    std::vector<Cv64suf> values;
+    char buf[CV_FS_MAX_LEN+1024];
+};
+
 Ptr<FileStorageEmitter> createJSONEmitter(FileStorage_API* fs)
 {
     return makePtr<JSONEmitter>(fs);
@@ -800,4 +1410,10 @@ Ptr<FileStorageParser> createJSONParser(FileStorage_API* fs)
     return makePtr<JSONParser>(fs);
 }
 
+bool parseJSONBuffer(FileStorage_API* fs, const char* begin, const char* end)
+{
+    JSONFastParser parser(fs, begin, end);
+    return parser.parse();
+}
+
 }
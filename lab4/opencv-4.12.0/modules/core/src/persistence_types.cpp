@@ -121,6 +121,10 @@ void read(const FileNode& node, Mat& m, const Mat& default_mat)
         return;
     }
 
+    // matrices of a binary storage are used in place
+    if( readMappedMat(node, m) )
+        return;
+
     std::string dt;
     int rows, cols, elem_type;
 
@@ -11,10 +11,19 @@
 #include <opencv2/core/opencl/ocl_defs.hpp>
 
 #include <cstdarg> // va_start
+#include <cstdio>
 
 #include <sstream>
 #include <ostream>
 #include <fstream>
+#include <atomic>
+
+#ifndef OPENCV_DISABLE_THREAD_SUPPORT
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
 
 #if 0
 #define CV_LOG(...) CV_LOG_INFO(NULL, __VA_ARGS__)
@@ -80,6 +89,13 @@ static const cv::String& getParameterTraceLocation()
     return param_traceLocation;
 }
 
+// "txt" (default) or "chrome"
+static const cv::String& getParameterTraceFormat()
+{
+    static cv::String param_traceFormat = utils::getConfigurationParameterString("OPENCV_TRACE_FORMAT", "txt");
+    return param_traceFormat;
+}
+
 #ifdef HAVE_OPENCL
 static bool param_synchronizeOpenCL = utils::getConfigurationParameterBool("OPENCV_TRACE_SYNC_OPENCL", false);
 #endif
@@ -191,6 +207,290 @@ public:
 };
 
 
+/**
+ * Chrome trace-event export
+ *
+ * Each thread appends fixed-size records to its own single-producer ring, so recording takes
+ * no lock. The flusher thread drains the rings and writes them as complete ("X") events.
+ * A full ring drops the record and counts it.
+ */
+enum TraceEventKind
+{
+    TRACE_EVENT_FUNCTION_OPENCV = 0,
+    TRACE_EVENT_FUNCTION_APP,
+    TRACE_EVENT_REGION,             // CV_TRACE_REGION()
+    TRACE_EVENT_STRIPE
+};
+
+struct TraceEvent
+{
+    const char* name;           // static storage: location name
+    int64 beginTimestamp;
+    int64 duration;
+    int64 arg0;
+    int64 arg1;
+    int threadID;
+    int kind;
+};
+
+class TraceEventBuffer
+{
+public:
+    explicit TraceEventBuffer(size_t capacity) :
+        events(capacity), mask(capacity - 1), head(0), tail(0), dropped(0), released(false)
+    {
+        CV_DbgAssert((capacity & mask) == 0);
+    }
+
+    // owner thread
+    void push(const TraceEvent& e)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) > mask)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        events[h & mask] = e;
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    std::vector<TraceEvent> events;
+    const size_t mask;
+    std::atomic<size_t> head;       // written by the owner thread
+    std::atomic<size_t> tail;       // written by the flusher
+    std::atomic<uint64> dropped;
+    std::atomic<bool> released;     // the owner thread has exited
+};
+
+static std::atomic<bool> g_traceEventsActive(false);
+
+#ifndef OPENCV_DISABLE_THREAD_SUPPORT
+
+static size_t getParameterTraceEventsBuffer()
+{
+    static size_t value = utils::getConfigurationParameterSizeT("OPENCV_TRACE_EVENTS_BUFFER", 16384);
+    size_t capacity = 64;
+    while (capacity < value)
+        capacity *= 2;
+    return capacity;
+}
+
+static int getParameterTraceFlushMs()
+{
+    static int value = (int)utils::getConfigurationParameterSizeT("OPENCV_TRACE_FLUSH_MS", 100);
+    return std::max(value, 1);
+}
+
+class TraceEventExporter
+{
+public:
+    TraceEventExporter() : out(NULL), stopping(false), sessionStart(0), written(0) {}
+
+    bool start(const std::string& filename)
+    {
+        std::lock_guard<std::mutex> control(controlMutex);
+        if (out)
+            return false;
+        FILE* f = fopen(filename.c_str(), "wb");
+        if (!f)
+        {
+            CV_LOG_WARNING(NULL, "Trace: can't create " << filename);
+            return false;
+        }
+        out = f;
+        fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+              "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"OpenCV\"}}", out);
+        written = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            // drop what was recorded after the previous session ended
+            for (size_t i = 0; i < buffers.size(); i++)
+                buffers[i]->dropped.exchange(0);
+            stopping = false;
+        }
+        sessionStart = getTimestampNS();
+        flusher = std::thread(&TraceEventExporter::flusherLoop, this);
+        g_traceEventsActive.store(true, std::memory_order_release);
+        return true;
+    }
+
+    TraceEventExportStats stop()
+    {
+        TraceEventExportStats stats = TraceEventExportStats();
+        std::lock_guard<std::mutex> control(controlMutex);
+        if (!out)
+            return stats;
+        g_traceEventsActive.store(false, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cond.notify_one();
+        flusher.join();  // drains everything on exit
+
+        stats.events = written;
+        for (size_t i = 0; i < buffers.size(); i++)
+            stats.dropped += buffers[i]->dropped.exchange(0);
+        fprintf(out, "\n],\"otherData\":{\"dropped_events\":\"%llu\"}}\n", (unsigned long long)stats.dropped);
+        stats.bytes = (uint64)ftell(out);
+        fclose(out);
+        out = NULL;
+        if (stats.dropped)
+            CV_LOG_WARNING(NULL, "Trace: " << stats.dropped << " events dropped, increase OPENCV_TRACE_EVENTS_BUFFER");
+        return stats;
+    }
+
+    // Calling thread's buffer, registered on first use
+    static void push(const TraceEvent& e)
+    {
+        TraceEventBuffer* buffer = threadBuffer.buffer;
+        if (!buffer)
+            buffer = threadBuffer.buffer = getInstance().registerThread();
+        buffer->push(e);
+    }
+
+    static TraceEventExporter& getInstance()
+    {
+        // Not destroyed: threads may still hold buffers at exit
+        static TraceEventExporter* instance = new TraceEventExporter();
+        return *instance;
+    }
+
+private:
+    struct ThreadBuffer
+    {
+        TraceEventBuffer* buffer;
+        ThreadBuffer() : buffer(NULL) {}
+        ~ThreadBuffer()
+        {
+            if (buffer)
+                buffer->released.store(true, std::memory_order_release);
+            buffer = NULL;
+        }
+    };
+    static thread_local ThreadBuffer threadBuffer;
+
+    TraceEventBuffer* registerThread()
+    {
+        TraceEventBuffer* buffer = new TraceEventBuffer(getParameterTraceEventsBuffer());
+        std::lock_guard<std::mutex> lock(mutex);
+        buffers.push_back(buffer);
+        return buffer;
+    }
+
+    void flusherLoop()
+    {
+        std::vector<TraceEventBuffer*> pending;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            bool last = stopping;
+            pending = buffers;
+            lock.unlock();
+            for (size_t i = 0; i < pending.size(); i++)
+                drain(*pending[i]);
+            fflush(out);
+            lock.lock();
+
+            // buffers of exited threads go away once drained
+            for (size_t i = 0; i < buffers.size();)
+            {
+                TraceEventBuffer* b = buffers[i];
+                if (b->released.load(std::memory_order_acquire) &&
+                    b->tail.load(std::memory_order_relaxed) == b->head.load(std::memory_order_acquire))
+                {
+                    delete b;
+                    buffers[i] = buffers.back();
+                    buffers.pop_back();
+                }
+                else
+                    i++;
+            }
+            if (last)
+                break;
+            cond.wait_for(lock, std::chrono::milliseconds(getParameterTraceFlushMs()), [this] { return stopping; });
+        }
+    }
+
+    void drain(TraceEventBuffer& b)
+    {
+        size_t t = b.tail.load(std::memory_order_relaxed);
+        const size_t h = b.head.load(std::memory_order_acquire);
+        for (; t != h; t++)
+        {
+            const TraceEvent& e = b.events[t & b.mask];
+            if (e.beginTimestamp >= sessionStart)  // older ones are leftovers of a previous session
+                write(e);
+        }
+        b.tail.store(h, std::memory_order_release);
+    }
+
+    void write(const TraceEvent& e)
+    {
+        static const char* const categories[] = { "opencv", "app", "region", "parallel_for" };
+        fputs(",\n{\"name\":\"", out);
+        for (const char* c = e.name; *c; c++)
+        {
+            if (*c == '"' || *c == '\\')
+                fputc('\\', out);
+            if ((unsigned char)*c >= 0x20)
+                fputc(*c, out);
+        }
+        fprintf(out, "\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                categories[e.kind], e.threadID,
+                (e.beginTimestamp - sessionStart) * 1e-3, e.duration * 1e-3);
+        if (e.kind == TRACE_EVENT_STRIPE)
+            fprintf(out, ",\"args\":{\"start\":%lld,\"end\":%lld}}", (long long)e.arg0, (long long)e.arg1);
+        else if (e.arg0)
+            fprintf(out, ",\"args\":{\"skipped\":%lld}}", (long long)e.arg0);
+        else
+            fputc('}', out);
+        written++;
+    }
+
+    std::mutex controlMutex;        // start() / stop()
+    std::mutex mutex;               // buffers, stopping
+    std::condition_variable cond;
+    std::vector<TraceEventBuffer*> buffers;
+    std::thread flusher;
+    FILE* out;
+    bool stopping;
+    int64 sessionStart;
+    uint64 written;                 // flusher thread
+};
+
+thread_local TraceEventExporter::ThreadBuffer TraceEventExporter::threadBuffer;
+
+static inline void pushTraceEvent(const TraceEvent& e)
+{
+    TraceEventExporter::push(e);
+}
+
+#else // OPENCV_DISABLE_THREAD_SUPPORT
+
+static inline void pushTraceEvent(const TraceEvent&) {}
+
+#endif
+
+bool traceEventsActive()
+{
+    return g_traceEventsActive.load(std::memory_order_relaxed);
+}
+
+void traceEventStripe(int64 beginTimestamp, int rangeStart, int rangeEnd)
+{
+    TraceEvent e;
+    e.name = "parallel_for stripe";
+    e.beginTimestamp = beginTimestamp;
+    e.duration = getTimestampNS() - beginTimestamp;
+    e.arg0 = rangeStart;
+    e.arg1 = rangeEnd;
+    e.threadID = cv::utils::getThreadID();
+    e.kind = TRACE_EVENT_STRIPE;
+    pushTraceEvent(e);
+}
+
 #ifdef OPENCV_WITH_ITT
 static __itt_domain* domain = NULL;
 
@@ -374,6 +674,19 @@ void Region::Impl::leaveRegion(TraceManagerThreadLocal& ctx)
         msg.formatRegionLeave(region, result);
         s->put(msg);
     }
+    if (traceEventsActive())
+    {
+        TraceEvent e;
+        e.name = location.name;
+        e.beginTimestamp = beginTimestamp;
+        e.duration = endTimestamp - beginTimestamp;
+        e.arg0 = result.currentSkippedRegions;
+        e.arg1 = 0;
+        e.threadID = threadID;
+        e.kind = (location.flags & REGION_FLAG_FUNCTION) == 0 ? TRACE_EVENT_REGION :
+                 (location.flags & REGION_FLAG_APP_CODE) ? TRACE_EVENT_FUNCTION_APP : TRACE_EVENT_FUNCTION_OPENCV;
+        pushTraceEvent(e);
+    }
 
     if (location.flags & REGION_FLAG_FUNCTION)
     {
@@ -691,7 +1004,7 @@ void Region::destroy()
         pImpl->leaveRegion(ctx);
         pImpl->release();
         pImpl = NULL;
-        DEBUG_ONLY(implFlags &= ~REGION_FLAG__ACTIVE);
+        implFlags &= ~REGION_FLAG__ACTIVE;
     }
     else
     {
@@ -703,7 +1016,8 @@ void Region::destroy()
         CV_DbgAssert(ctx.stackTopRegion() == this);
         ctx.stackPop();
         ctx.stat_status.checkResetSkipMode(currentDepth);
-        DEBUG_ONLY(implFlags &= ~REGION_FLAG__NEED_STACK_POP);
+        // always: ~Region() checks it in applications built without NDEBUG
+        implFlags &= ~REGION_FLAG__NEED_STACK_POP;
     }
     CV_LOG_CTX_STAT(NULL, _spaces(currentDepth*4) << "===> " << ctx.stat << ' ' << ctx.stat_status);
 }
@@ -830,7 +1144,8 @@ TraceStorage* TraceManagerThreadLocal::getStorage() const
 
 
 
-static bool activated = false;
+static std::atomic<bool> activated(false);
+static bool activatedByConfig = false;  // OPENCV_TRACE or ITT, as opposed to startTraceEventExport()
 static bool isInitialized = false;
 
 TraceManager::TraceManager()
@@ -841,10 +1156,25 @@ TraceManager::TraceManager()
     CV_LOG("TraceManager ctor: " << (void*)this);
 
     CV_LOG("TraceManager configure()");
-    activated = getParameterTraceEnable();
+    bool enable = getParameterTraceEnable();
 
-    if (activated)
-        trace_storage.reset(new SyncTraceStorage(std::string(getParameterTraceLocation()) + ".txt"));
+    if (enable)
+    {
+        const cv::String& format = getParameterTraceFormat();
+        if (format == "chrome" || format == "json")
+        {
+#ifndef OPENCV_DISABLE_THREAD_SUPPORT
+            TraceEventExporter::getInstance().start(std::string(getParameterTraceLocation()) + ".json");
+#endif
+        }
+        else
+        {
+            if (format != "txt")
+                CV_LOG_WARNING(NULL, "Trace: unknown OPENCV_TRACE_FORMAT=" << format << ", using txt");
+            trace_storage.reset(new SyncTraceStorage(std::string(getParameterTraceLocation()) + ".txt"));
+        }
+    }
+    activated = enable;
 
 #ifdef OPENCV_WITH_ITT
     if (isITTEnabled())
@@ -853,6 +1183,7 @@ TraceManager::TraceManager()
         __itt_region_begin(domain, __itt_null, __itt_null, __itt_string_handle_create("OpenCVTrace"));
     }
 #endif
+    activatedByConfig = activated;
 }
 TraceManager::~TraceManager()
 {
@@ -864,6 +1195,9 @@ TraceManager::~TraceManager()
         __itt_region_end(domain, __itt_null);
     }
 #endif
+#ifndef OPENCV_DISABLE_THREAD_SUPPORT
+    TraceEventExporter::getInstance().stop();
+#endif
 
     std::vector<TraceManagerThreadLocal*> threads_ctx;
     tls.gather(threads_ctx);
@@ -908,7 +1242,7 @@ bool TraceManager::isActivated()
         CV_UNUSED(m); // TODO
     }
 
-    return activated;
+    return activated.load(std::memory_order_relaxed);
 }
 
 
@@ -1143,3 +1477,45 @@ void traceArg(const TraceArg&, double) {};
 #endif
 
 }}}} // namespace
+
+namespace cv {
+namespace utils {
+namespace trace {
+
+#if defined(OPENCV_TRACE) && !defined(OPENCV_DISABLE_THREAD_SUPPORT)
+
+bool startTraceEventExport(const char* filename)
+{
+    CV_Assert(filename);
+    if (cv::__termination)
+        return false;
+    (void)details::getTraceManager();  // configured first: OPENCV_TRACE_FORMAT may have started an export
+    if (!details::TraceEventExporter::getInstance().start(filename))
+        return false;
+    details::activated = true;
+    return true;
+}
+
+TraceEventExportStats stopTraceEventExport()
+{
+    TraceEventExportStats stats = details::TraceEventExporter::getInstance().stop();
+    if (!cv::__termination)
+        details::activated = details::activatedByConfig;
+    return stats;
+}
+
+#else
+
+bool startTraceEventExport(const char*)
+{
+    return false;
+}
+
+TraceEventExportStats stopTraceEventExport()
+{
+    return TraceEventExportStats();
+}
+
+#endif
+
+}}} // namespace
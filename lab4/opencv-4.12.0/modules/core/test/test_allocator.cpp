@@ -2,6 +2,9 @@
 // It is subject to the license terms in the LICENSE file found in the top-level directory
 // of this distribution and at http://opencv.org/license.html.
 #include "test_precomp.hpp"
+#include "opencv2/core/utils/arena.hpp"
+
+#include <thread>
 
 namespace opencv_test { namespace {
 
@@ -141,4 +144,125 @@ TEST_F(AllocatorTest, DummyAllocator)
     EXPECT_EQ(2, DummyAllocator::deallocations);
 }
 
+struct ScopedArenaTest : public testing::Test {
+    void TearDown() override {
+        cv::Mat::setDefaultAllocator(cv::Mat::getStdAllocator());
+    }
+};
+
+TEST_F(ScopedArenaTest, reuses_memory_across_scopes)
+{
+    uint64_t chunks = cv::ScopedArena::stats().chunks;
+    const uchar* first[3] = {};
+    for (int iter = 0; iter < 3; iter++)
+    {
+        cv::ScopedArena arena;
+        cv::Mat a(480, 640, CV_8UC3, cv::Scalar::all(1)), b, c;
+        cv::add(a, a, b);
+        cv::multiply(b, a, c);
+        EXPECT_EQ(cv::ScopedArena::getAllocator(), c.allocator);
+        EXPECT_EQ(2, c.at<cv::Vec3b>(479, 639)[2]);
+        if (iter == 0)
+        {
+            first[0] = a.data; first[1] = b.data; first[2] = c.data;
+        }
+        else
+        {
+            // same buffers every iteration: nothing new is allocated
+            EXPECT_EQ(first[0], a.data);
+            EXPECT_EQ(first[1], b.data);
+            EXPECT_EQ(first[2], c.data);
+        }
+        EXPECT_EQ(0u, (size_t)c.data % CV_MALLOC_ALIGN);
+    }
+    cv::ScopedArena::Stats st = cv::ScopedArena::stats();
+    EXPECT_EQ(0u, st.usedBytes);
+    EXPECT_GE(st.peakBytes, (size_t)480 * 640 * 3 * 3);
+    EXPECT_LE(st.chunks, chunks + 1);
+
+    // Outside of any scope the previous default allocator is used
+    uint64_t allocations = st.allocations;
+    cv::Mat outside(100, 100, CV_8UC1);
+    EXPECT_EQ(allocations, cv::ScopedArena::stats().allocations);
+}
+
+TEST_F(ScopedArenaTest, escaped_mat_stays_valid)
+{
+    uint64_t escaped = cv::ScopedArena::stats().escaped;
+    cv::Mat kept;
+    {
+        cv::ScopedArena arena;
+        cv::Mat tmp(64, 64, CV_8UC1, cv::Scalar::all(7));
+        kept = tmp;
+    }
+    EXPECT_EQ(escaped + 1, cv::ScopedArena::stats().escaped);
+    {
+        cv::ScopedArena arena;
+        cv::Mat other(64, 64, CV_8UC1, cv::Scalar::all(0));
+        EXPECT_NE(kept.data, other.data);
+    }
+    EXPECT_EQ(64 * 64 * 7, (int)cv::sum(kept)[0]);
+}
+
+TEST_F(ScopedArenaTest, grows_to_one_chunk)
+{
+    // The arena is per thread and keeps its merged chunk: a fresh thread starts from
+    // nothing, so the test does not depend on the earlier ones or on --gtest_repeat
+    cv::ScopedArena::Stats before = {}, after = {};
+    uint64_t chunksAfterReuse = 0;
+    std::thread t([&] {
+        before = cv::ScopedArena::stats();
+        for (int iter = 0; iter < 3; iter++)
+        {
+            cv::ScopedArena arena(cv::ScopedArena::DEFAULT, 1 << 20);
+            std::vector<cv::Mat> frames;
+            for (int i = 0; i < 4; i++)
+                frames.push_back(cv::Mat(1080, 1920, CV_8UC3, cv::Scalar::all(i)));
+        }
+        after = cv::ScopedArena::stats();
+        {
+            cv::ScopedArena arena;
+            cv::Mat big(1080, 1920, CV_8UC3);
+        }
+        chunksAfterReuse = cv::ScopedArena::stats().chunks;
+    });
+    t.join();
+    // the first iteration takes several chunks, the second one a single merged one,
+    // the third one nothing new
+    EXPECT_EQ(0u, before.chunks);
+    EXPECT_GE(after.chunks, 2u);
+    EXPECT_GE(after.reservedBytes, (size_t)4 * 1080 * 1920 * 3);
+    EXPECT_EQ(after.chunks, chunksAfterReuse);
+}
+
+TEST_F(ScopedArenaTest, other_threads_are_not_affected)
+{
+    cv::ScopedArena arena;
+    uint64_t otherAllocations = 1;
+    std::thread t([&] {
+        cv::Mat m(100, 100, CV_8UC1, cv::Scalar::all(3));
+        otherAllocations = cv::ScopedArena::stats().allocations;
+    });
+    t.join();
+    EXPECT_EQ(0u, otherAllocations);
+
+    // a Mat from this arena may be released by another thread
+    cv::Mat shared(100, 100, CV_8UC1, cv::Scalar::all(5));
+    std::thread t2([&] { shared.release(); });
+    t2.join();
+}
+
+TEST_F(ScopedArenaTest, huge_pages)
+{
+    {
+        cv::ScopedArena arena(cv::ScopedArena::HUGE_PAGES);
+        cv::Mat m(720, 1280, CV_8UC3, cv::Scalar::all(9));
+        EXPECT_EQ(9, m.at<cv::Vec3b>(719, 1279)[1]);
+    }
+    // back to regular chunks
+    cv::ScopedArena arena;
+    cv::Mat m(720, 1280, CV_8UC3, cv::Scalar::all(1));
+    EXPECT_FALSE(cv::ScopedArena::stats().hugePages);
+}
+
 }} // namespace
@@ -2065,6 +2065,318 @@ void testExactMat(const Mat& src, const char* ext)
     }
 }
 
+static void setFastJSONParser(bool enable)
+{
+#ifdef _WIN32
+    _putenv_s("OPENCV_PERSISTENCE_FAST_JSON", enable ? "1" : "0");
+#else
+    setenv("OPENCV_PERSISTENCE_FAST_JSON", enable ? "1" : "0", 1);
+#endif
+}
+
+static void expectSameNodes(const FileNode& a, const FileNode& b)
+{
+    ASSERT_EQ(a.type(), b.type());
+    ASSERT_EQ(a.isNamed(), b.isNamed());
+    if (a.isNamed())
+    {
+        EXPECT_EQ(a.name(), b.name());
+    }
+    if (a.isInt())
+    {
+        EXPECT_EQ((int64_t)a, (int64_t)b);
+    }
+    else if (a.isReal())
+    {
+        double x = a, y = b;
+        if (cvIsNaN(x))
+        {
+            EXPECT_TRUE(cvIsNaN(y));
+        }
+        else
+        {
+            EXPECT_EQ(x, y);
+        }
+    }
+    else if (a.isString())
+    {
+        EXPECT_EQ(a.string(), b.string());
+    }
+    else if (a.isSeq() || a.isMap())
+    {
+        ASSERT_EQ(a.size(), b.size());
+        FileNodeIterator ia = a.begin(), ib = b.begin();
+        for (size_t i = 0; i < a.size(); i++, ++ia, ++ib)
+            expectSameNodes(*ia, *ib);
+    }
+}
+
+TEST(Core_InputOutput, FileStorage_json_fast_parser)
+{
+    RNG& rng = theRNG();
+    Mat m8u(17, 23, CV_8UC3), m16s(40, 3, CV_16SC1), m32f(300, 300, CV_32FC1), m64f(31, 7, CV_64FC2);
+    rng.fill(m8u, RNG::UNIFORM, 0, 256);
+    rng.fill(m16s, RNG::UNIFORM, -32768, 32768);
+    rng.fill(m32f, RNG::UNIFORM, -1e6, 1e6);
+    rng.fill(m64f, RNG::NORMAL, 0, 1e-3);
+
+    std::vector<std::string> docs;
+    for (int flags = FileStorage::WRITE; flags <= FileStorage::WRITE_BASE64; flags += FileStorage::WRITE_BASE64 - FileStorage::WRITE)
+    {
+        FileStorage fs(".json", flags | FileStorage::MEMORY);
+        fs << "m8u" << m8u << "m16s" << m16s << "m32f" << m32f << "m64f" << m64f;
+        fs << "ints" << std::vector<int>{ 0, -1, 65536, INT_MAX, INT_MIN };
+        fs << "nested" << "{" << "name" << "line\n\t\"quoted\" \\" << "seq" << "[" << 1 << 2.5 << "x" << "[:" << 3 << "]" << "]" << "}";
+        fs << "long" << (int64_t)INT64_MIN;
+        docs.push_back(fs.releaseAndGetString());
+    }
+    docs.push_back(
+        "{ /* comment with \"quote */\n"
+        "  \"hex\": 0x1F, \"oct\": 017, \"plus\": +5, \"exp\": 1.5e-3, \"dot\": 3., \"frac\": .25,\n"
+        "  \"digits\": 0.12345678901234567890123, \"inf\": -.Inf, \"nan\": .Nan,\n"
+        "  // line comment with [brackets]\n"
+        "  \"url\": \"http://example.com/*not a comment*/\", \"empty\": \"\", \"yes\": true, \"no\": false,\n"
+        "  \"seq\": [1, [], {}, {\"k\": [-6, 7.0e2,],}, \"s\",],\n"
+        "}\n");
+
+    for (size_t i = 0; i < docs.size(); i++)
+    {
+        SCOPED_TRACE(cv::format("doc %d", (int)i));
+        const std::string fileName = cv::tempfile(".json");
+        {
+            std::ofstream f(fileName.c_str(), std::ios::binary);
+            f << docs[i];
+        }
+
+        setFastJSONParser(false);
+        FileStorage legacy(docs[i], FileStorage::READ | FileStorage::MEMORY);
+        setFastJSONParser(true);
+        FileStorage fromMemory(docs[i], FileStorage::READ | FileStorage::MEMORY);
+        FileStorage fromFile(fileName, FileStorage::READ);
+        ASSERT_TRUE(fromFile.isOpened());
+
+        expectSameNodes(legacy.root(), fromMemory.root());
+        expectSameNodes(legacy.root(), fromFile.root());
+
+        if (i < 2)
+        {
+            Mat m;
+            fromFile["m8u"] >> m;
+            EXPECT_EQ(0, cvtest::norm(m8u, m, NORM_INF));
+            fromFile["m16s"] >> m;
+            EXPECT_EQ(0, cvtest::norm(m16s, m, NORM_INF));
+            fromFile["m32f"] >> m;
+            EXPECT_EQ(0, cvtest::norm(m32f, m, NORM_INF));
+            fromFile["m64f"] >> m;
+            EXPECT_EQ(0, cvtest::norm(m64f, m, NORM_INF));
+            EXPECT_EQ("line\n\t\"quoted\" \\", fromFile["nested"]["name"].string());
+            EXPECT_EQ(INT64_MIN, (int64_t)fromFile["long"]);
+        }
+        else
+        {
+            EXPECT_EQ(31, (int)fromFile["hex"]);
+            EXPECT_EQ(15, (int)fromFile["oct"]);
+            EXPECT_EQ(0.25, (double)fromFile["frac"]);
+            EXPECT_EQ(0.12345678901234567890123, (double)fromFile["digits"]);
+            EXPECT_EQ("http://example.com/*not a comment*/", fromFile["url"].string());
+            EXPECT_EQ(5u, fromFile["seq"].size());
+            EXPECT_EQ(700.0, (double)fromFile["seq"][3]["k"][1]);
+        }
+        EXPECT_EQ(0, remove(fileName.c_str()));
+    }
+}
+
+TEST(Core_InputOutput, FileStorage_json_fast_parser_errors)
+{
+    const char* docs[] = {
+        "{ \"a\": \"no right quote }",
+        "{ \"a\" 1 }",
+        "{ \"a\": tru }",
+        "{ \"a\": 1x }",
+        "{ \"a\": [1, 2 }",
+        "{ \"a\": null }",
+        "{ \"a\": 1 \"b\": 2 }",
+        "{ \"a\": \"\\u0041\" }",
+        "{ \"a\": [1, 2,",
+        "{ \"\": 1 }",
+    };
+    for (size_t i = 0; i < sizeof(docs) / sizeof(docs[0]); i++)
+    {
+        SCOPED_TRACE(docs[i]);
+        for (int fast = 0; fast < 2; fast++)
+        {
+            setFastJSONParser(fast != 0);
+            EXPECT_THROW(FileStorage(docs[i], FileStorage::READ | FileStorage::MEMORY), cv::Exception);
+        }
+    }
+    setFastJSONParser(true);
+}
+
+TEST(Core_InputOutput, FileStorage_binary)
+{
+    RNG& rng = theRNG();
+    Mat m8u(17, 23, CV_8UC3), m16s(40, 3, CV_16SC1), m32f(300, 300, CV_32FC1), m64f(31, 7, CV_64FC2);
+    rng.fill(m8u, RNG::UNIFORM, 0, 256);
+    rng.fill(m16s, RNG::UNIFORM, -32768, 32768);
+    rng.fill(m32f, RNG::UNIFORM, -1e6, 1e6);
+    rng.fill(m64f, RNG::NORMAL, 0, 1e-3);
+    const int sizes[] = { 4, 5, 6 };
+    Mat nd(3, sizes, CV_32SC2);
+    rng.fill(nd, RNG::UNIFORM, INT_MIN, INT_MAX);
+    Mat roi = m32f(Rect(10, 20, 50, 40));
+    std::vector<Point2f> points{ Point2f(1.5f, -2.f), Point2f(0.f, 1e10f) };
+
+    const std::string fileName = cv::tempfile(".cvbin");
+    {
+        FileStorage fs(fileName, FileStorage::WRITE);
+        ASSERT_EQ(FileStorage::FORMAT_BINARY, fs.getFormat());
+        fs << "m8u" << m8u << "m16s" << m16s << "m32f" << m32f << "m64f" << m64f << "nd" << nd << "roi" << roi;
+        fs << "empty" << Mat();
+        fs << "ints" << std::vector<int>{ 0, -1, 65536, INT_MAX, INT_MIN };
+        fs << "points" << points;
+        fs << "nested" << "{" << "name" << "line\n\t\"quoted\"" << "seq" << "[" << 1 << 2.5 << "x" << "[:" << 3 << "]" << "]" << "}";
+        fs << "long" << (int64_t)INT64_MIN;
+    }
+
+    FileStorage fs(fileName, FileStorage::READ);
+    ASSERT_TRUE(fs.isOpened());
+    EXPECT_EQ(FileStorage::FORMAT_BINARY, fs.getFormat());
+    Mat m;
+    fs["m8u"] >> m;
+    EXPECT_EQ(0, cvtest::norm(m8u, m, NORM_INF));
+    fs["m16s"] >> m;
+    EXPECT_EQ(0, cvtest::norm(m16s, m, NORM_INF));
+    fs["m32f"] >> m;
+    EXPECT_EQ(0, cvtest::norm(m32f, m, NORM_INF));
+    fs["m64f"] >> m;
+    EXPECT_EQ(0, cvtest::norm(m64f, m, NORM_INF));
+    fs["nd"] >> m;
+    ASSERT_EQ(nd.size, m.size);
+    EXPECT_EQ(0, cvtest::norm(nd, m, NORM_INF));
+    fs["roi"] >> m;
+    EXPECT_EQ(0, cvtest::norm(roi, m, NORM_INF));
+    fs["empty"] >> m;
+    EXPECT_TRUE(m.empty());
+    EXPECT_EQ(23, (int)fs["m8u"]["cols"]);
+    EXPECT_EQ("3u", fs["m8u"]["dt"].string());
+
+    std::vector<int> ints;
+    fs["ints"] >> ints;
+    EXPECT_EQ((std::vector<int>{ 0, -1, 65536, INT_MAX, INT_MIN }), ints);
+    std::vector<Point2f> points2;
+    fs["points"] >> points2;
+    EXPECT_EQ(points, points2);
+    ASSERT_EQ(4u, fs["points"].size());
+    EXPECT_EQ(1e10f, (float)fs["points"][3]);
+    EXPECT_EQ("line\n\t\"quoted\"", fs["nested"]["name"].string());
+    EXPECT_EQ(2.5, (double)fs["nested"]["seq"][1]);
+    EXPECT_EQ("x", fs["nested"]["seq"][2].string());
+    EXPECT_EQ(3, (int)fs["nested"]["seq"][3][0]);
+    EXPECT_EQ(INT64_MIN, (int64_t)fs["long"]);
+
+    // matrices point into the mapped file, are aligned and outlive the storage
+    Mat a = fs["m32f"].mat(), b = fs["m32f"].mat();
+    EXPECT_EQ(a.data, b.data);
+    EXPECT_EQ(0u, (size_t)a.data % 64);
+    fs.release();
+    EXPECT_EQ(0, cvtest::norm(m32f, a, NORM_INF));
+    a.setTo(Scalar::all(0));
+    EXPECT_EQ(0, cvtest::norm(b, NORM_INF));
+
+    // changes to the Mats do not go to the file
+    fs.open(fileName, FileStorage::READ);
+    fs["m32f"] >> m;
+    EXPECT_EQ(0, cvtest::norm(m32f, m, NORM_INF));
+    fs.release();
+    EXPECT_EQ(0, remove(fileName.c_str()));
+}
+
+TEST(Core_InputOutput, FileStorage_binary_mat_node)
+{
+    Mat m(3, 4, CV_32FC2);
+    theRNG().fill(m, RNG::UNIFORM, -10, 10);
+    const int sizes[] = { 2, 3, 4 };
+    Mat nd(3, sizes, CV_16UC1, Scalar(7));
+
+    const char* const exts[] = { ".yml", ".cvbin" };
+    for (size_t i = 0; i < sizeof(exts) / sizeof(exts[0]); i++)
+    {
+        SCOPED_TRACE(exts[i]);
+        const std::string fileName = cv::tempfile(exts[i]);
+        {
+            FileStorage fs(fileName, FileStorage::WRITE);
+            fs << "m" << m << "nd" << nd;
+        }
+        FileStorage fs(fileName, FileStorage::READ);
+        ASSERT_TRUE(fs.isOpened());
+        const bool binary = fs.getFormat() == FileStorage::FORMAT_BINARY;
+        FileNode node = fs["m"];
+        EXPECT_EQ(3, (int)node["rows"]);
+        EXPECT_EQ(4, (int)node["cols"]);
+        EXPECT_EQ("2f", node["dt"].string());
+        EXPECT_EQ(4, (int)fs["nd"]["sizes"][2]);
+        EXPECT_EQ("w", fs["nd"]["dt"].string());
+
+        // the binary format keeps the elements in the file instead of a "data" sequence
+        std::vector<String> keys = node.keys();
+        EXPECT_EQ(binary ? 3u : 4u, keys.size());
+        if (binary)
+        {
+            EXPECT_TRUE(node["data"].empty());
+            EXPECT_TRUE(fs["nd"]["data"].empty());
+        }
+        else
+        {
+            ASSERT_TRUE(node["data"].isSeq());
+            EXPECT_EQ(m.total() * m.channels(), node["data"].size());
+            EXPECT_EQ(m.at<Vec2f>(1, 2)[1], (float)node["data"][(1 * 4 + 2) * 2 + 1]);
+        }
+
+        // either way the matrix reads back the same
+        Mat m2, nd2;
+        node >> m2;
+        fs["nd"] >> nd2;
+        EXPECT_EQ(0, cvtest::norm(m, m2, NORM_INF));
+        EXPECT_EQ(0, cvtest::norm(nd, nd2, NORM_INF));
+        fs.release();
+        EXPECT_EQ(0, remove(fileName.c_str()));
+    }
+}
+
+TEST(Core_InputOutput, FileStorage_binary_errors)
+{
+    EXPECT_THROW(FileStorage(".cvbin", FileStorage::WRITE | FileStorage::MEMORY), cv::Exception);
+    EXPECT_THROW(FileStorage(cv::tempfile(".cvbin.gz"), FileStorage::WRITE | FileStorage::FORMAT_BINARY), cv::Exception);
+
+    const std::string fileName = cv::tempfile(".cvbin");
+    {
+        FileStorage fs(fileName, FileStorage::WRITE);
+        fs << "m" << Mat::eye(10, 10, CV_8U);
+    }
+    EXPECT_THROW(FileStorage(fileName, FileStorage::APPEND), cv::Exception);
+
+    std::string contents;
+    {
+        std::ifstream f(fileName.c_str(), std::ios::binary);
+        contents.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    }
+    ASSERT_GT(contents.size(), 96u);
+    const std::string broken[] = {
+        contents.substr(0, contents.size() - 1),        // no footer
+        contents.substr(0, 64) + contents.substr(contents.size() - 32),     // index outside of the file
+    };
+    for (size_t i = 0; i < sizeof(broken) / sizeof(broken[0]); i++)
+    {
+        SCOPED_TRACE(cv::format("broken %d", (int)i));
+        {
+            std::ofstream f(fileName.c_str(), std::ios::binary);
+            f << broken[i];
+        }
+        EXPECT_THROW(FileStorage(fileName, FileStorage::READ), cv::Exception);
+    }
+    EXPECT_EQ(0, remove(fileName.c_str()));
+}
+
 typedef testing::TestWithParam<const char*> FileStorage_exact_type;
 TEST_P(FileStorage_exact_type, empty_mat)
 {
@@ -2081,7 +2393,7 @@ TEST_P(FileStorage_exact_type, long_int)
 }
 
 INSTANTIATE_TEST_CASE_P(Core_InputOutput,
-    FileStorage_exact_type, Values(".yml", ".xml", ".json")
+    FileStorage_exact_type, Values(".yml", ".xml", ".json", ".cvbin")
 );
 
 }} // namespace
@@ -4,6 +4,7 @@
 
 #include "test_precomp.hpp"
 #include <atomic>
+#include <thread>
 #include <opencv2/core/utils/logger.hpp>
 
 namespace opencv_test {
@@ -112,4 +113,104 @@ TEST(Core_Logger_Replace, WriteLogMessageExReplaceRestore)
     EXPECT_NE(flags & 2048u, 0u);
 }
 
+std::atomic<int>& getAsyncLineCounter()
+{
+    static std::atomic<int> counter(0);
+    return counter;
+}
+
+void countingWriteLogMessage(LogLevel, const char* message)
+{
+    if (strstr(message, "async-test"))
+        getAsyncLineCounter().fetch_add(1);
+}
+
+TEST(Core_Logger_Async, EveryMessageWrittenOrCounted)
+{
+    replaceWriteLogMessage(countingWriteLogMessage);
+    getAsyncLineCounter() = 0;
+    if (!startAsyncLogging(64, 0))
+    {
+        replaceWriteLogMessage(nullptr);
+        throw SkipTestException("Threads are not supported");
+    }
+    EXPECT_FALSE(startAsyncLogging());  // already running
+
+    const int threads = 4, perThread = 2000;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++)
+        workers.push_back(std::thread([] {
+            for (int i = 0; i < perThread; i++)
+                writeLogMessageEx(LOG_LEVEL_WARNING, "tag", "file", 1000, "func", "async-test message");
+        }));
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+    stopAsyncLogging();
+    replaceWriteLogMessage(nullptr);
+
+    AsyncLoggingStats stats = getAsyncLoggingStats();
+    EXPECT_EQ((uint64)(threads * perThread), stats.queued + stats.dropped);
+    EXPECT_EQ(stats.queued, stats.written);
+    EXPECT_EQ((int)stats.written, getAsyncLineCounter().load());
+    EXPECT_EQ(0u, stats.rateLimited);
+}
+
+struct AsyncCapture
+{
+    std::atomic<int> siteA, siteB;
+    std::string lastLong;
+    std::thread::id writer;
+};
+
+AsyncCapture& getAsyncCapture()
+{
+    static AsyncCapture capture;
+    return capture;
+}
+
+void capturingWriteLogMessageEx(LogLevel, const char*, const char*, int line, const char*, const char* message)
+{
+    AsyncCapture& c = getAsyncCapture();
+    if (line == 1001)
+        c.siteA++;
+    else if (line == 1002)
+        c.siteB++;
+    else if (line == 1003)
+        c.lastLong = message;
+    else
+        return;  // e.g. the summary of stopAsyncLogging()
+    c.writer = std::this_thread::get_id();
+}
+
+TEST(Core_Logger_Async, RateLimitPerCallSite)
+{
+    AsyncCapture& c = getAsyncCapture();
+    c.siteA = 0;
+    c.siteB = 0;
+    replaceWriteLogMessageEx(capturingWriteLogMessageEx);  // receives the messages from the writer thread
+    if (!startAsyncLogging(4096, 5))
+    {
+        replaceWriteLogMessageEx(nullptr);
+        throw SkipTestException("Threads are not supported");
+    }
+    for (int i = 0; i < 100; i++)
+        writeLogMessageEx(LOG_LEVEL_WARNING, "tag", "file", 1001, "func", "site A");
+    for (int i = 0; i < 3; i++)
+        writeLogMessageEx(LOG_LEVEL_WARNING, "tag", "file", 1002, "func", "site B");
+    const std::string longMessage(2000, 'x');
+    writeLogMessageEx(LOG_LEVEL_WARNING, "tag", "file", 1003, "func", longMessage.c_str());
+    stopAsyncLogging();
+    replaceWriteLogMessageEx(nullptr);
+
+    AsyncLoggingStats stats = getAsyncLoggingStats();
+    EXPECT_EQ(3, c.siteB.load());
+    EXPECT_GE(c.siteA.load(), 5);
+    EXPECT_LE(c.siteA.load(), 10);  // the loop may straddle a second
+    EXPECT_EQ((uint64)(100 - c.siteA.load()), stats.rateLimited);
+    EXPECT_NE(std::this_thread::get_id(), c.writer);
+    ASSERT_GT(c.lastLong.size(), 100u);
+    EXPECT_LT(c.lastLong.size(), longMessage.size());
+    EXPECT_EQ("...", c.lastLong.substr(c.lastLong.size() - 3));
+}
+
 }} // namespace
\ No newline at end of file
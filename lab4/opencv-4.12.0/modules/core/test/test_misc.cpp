@@ -7,7 +7,9 @@
 #include "opencv2/core/utils/logger.hpp"
 
 #include <opencv2/core/utils/fp_control_utils.hpp>
+#include "opencv2/core/parallel/parallel_backend.hpp"
 
+#include <atomic>
 #include <chrono>
 #include <thread>
 
@@ -304,6 +306,111 @@ TEST(Core_Parallel, propagate_fp_denormals_ignore_hint)
     }
 }
 
+class WorkStealingBackendScope
+{
+public:
+    // a few workers even on a single core machine, so that there is something to steal
+    WorkStealingBackendScope() : threads(cv::getNumThreads())
+    {
+        ok = cv::parallel::setParallelForBackend("WORKSTEALING");
+        cv::setNumThreads(4);
+    }
+    ~WorkStealingBackendScope()
+    {
+        cv::setNumThreads(threads);
+        cv::parallel::setParallelForBackend("");
+    }
+    int threads;
+    bool ok;
+};
+
+class CountingParallelLoopBody : public cv::ParallelLoopBody
+{
+public:
+    CountingParallelLoopBody(std::vector<std::atomic<int> >& hits, int inner)
+        : hits_(hits), inner_(inner) {}
+    void operator()(const cv::Range& r) const
+    {
+        for (int i = r.start; i < r.end; i++)
+        {
+            if (inner_ > 0)
+            {
+                std::vector<std::atomic<int> >& hits = hits_;
+                int base = i * inner_;
+                parallel_for_(cv::Range(0, inner_), [&](const cv::Range& ir) {
+                    for (int k = ir.start; k < ir.end; k++)
+                        hits[base + k]++;
+                });
+            }
+            else
+            {
+                hits_[i]++;
+            }
+        }
+    }
+protected:
+    std::vector<std::atomic<int> >& hits_;
+    int inner_;
+};
+
+TEST(Core_Parallel, workstealing_concurrent_callers)
+{
+    WorkStealingBackendScope scope;
+    ASSERT_TRUE(scope.ok);
+    const int callers = 8, n = 5000;
+    std::vector<std::vector<std::atomic<int> > > hits(callers);
+    std::vector<std::thread> threads;
+    for (int c = 0; c < callers; c++)
+    {
+        hits[c] = std::vector<std::atomic<int> >(n);
+        threads.push_back(std::thread([&hits, c] {
+            for (int rep = 0; rep < 10; rep++)
+                parallel_for_(cv::Range(0, n), CountingParallelLoopBody(hits[c], 0));
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    for (int c = 0; c < callers; c++)
+        for (int i = 0; i < n; i++)
+            ASSERT_EQ(10, hits[c][i].load()) << "caller=" << c << " i=" << i;
+}
+
+TEST(Core_Parallel, workstealing_nested)
+{
+    WorkStealingBackendScope scope;
+    ASSERT_TRUE(scope.ok);
+    const int outer = 64, inner = 300;
+    std::vector<std::atomic<int> > hits(outer * inner);
+    parallel_for_(cv::Range(0, outer), CountingParallelLoopBody(hits, inner));
+    for (int i = 0; i < outer * inner; i++)
+        ASSERT_EQ(1, hits[i].load()) << "i=" << i;
+}
+
+TEST(Core_Parallel, workstealing_propagate_exceptions)
+{
+    WorkStealingBackendScope scope;
+    ASSERT_TRUE(scope.ok);
+    std::vector<std::thread> threads;
+    std::atomic<int> thrown(0);
+    for (int c = 0; c < 4; c++)
+    {
+        threads.push_back(std::thread([&thrown, c] {
+            Mat dst(1000, 100, CV_8SC1, Scalar::all(0));
+            try
+            {
+                parallel_for_(cv::Range(0, dst.rows), ThrowErrorParallelLoopBody(dst, (c & 1) ? dst.rows / 2 : -1));
+            }
+            catch (const cv::Exception&)
+            {
+                thrown++;
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    EXPECT_EQ(2, thrown.load());
+}
+
 TEST(Core_Version, consistency)
 {
     // this test verifies that OpenCV version loaded in runtime
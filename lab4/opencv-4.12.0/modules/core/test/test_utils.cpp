@@ -9,6 +9,10 @@
 #include "opencv2/core/utils/buffer_area.private.hpp"
 
 #include "opencv2/core/utils/filesystem.private.hpp"
+#include "opencv2/core/utils/trace.hpp"
+
+#include <atomic>
+#include <fstream>
 
 #ifndef OPENCV_DISABLE_THREAD_SUPPORT
 #include "test_utils_tls.impl.hpp"
@@ -494,5 +498,65 @@ TEST_P(BufferArea, bad)
 
 INSTANTIATE_TEST_CASE_P(/**/, BufferArea, testing::Values(true, false));
 
+TEST(Core_Trace, event_export)
+{
+    const std::string path = cv::tempfile(".json");
+    if (!cv::utils::trace::startTraceEventExport(path.c_str()))
+        throw SkipTestException("Trace support is not built in (OPENCV_TRACE)");
+    EXPECT_FALSE(cv::utils::trace::startTraceEventExport(path.c_str()));  // already running
+
+    const int prevThreads = getNumThreads();
+    setNumThreads(4);
+    std::atomic<int> rows(0);
+    {
+        CV_TRACE_REGION("export_outer");
+        for (int i = 0; i < 3; i++)
+        {
+            CV_TRACE_REGION("export_iteration");
+            parallel_for_(Range(0, 64), [&](const Range& r) { rows += r.size(); }, 8);
+        }
+    }
+    cv::utils::trace::TraceEventExportStats stats = cv::utils::trace::stopTraceEventExport();
+    setNumThreads(prevThreads);
+    ASSERT_EQ(3 * 64, rows.load());
+    EXPECT_EQ(0u, stats.dropped);
+
+    std::ifstream f(path.c_str(), std::ios::binary);
+    std::string json((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    f.close();
+    std::remove(path.c_str());
+    EXPECT_EQ((size_t)stats.bytes, json.size());
+    ASSERT_EQ(0u, json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+    ASSERT_EQ(json.size() - 2, json.rfind("}\n"));
+
+    int events = 0, outer = 0, iterations = 0, stripes = 0, stripeRows = 0;
+    std::istringstream lines(json);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        if (line.find("\"ph\":\"X\"") == std::string::npos)
+            continue;
+        events++;
+        outer += line.find("\"name\":\"export_outer\"") != std::string::npos;
+        iterations += line.find("\"name\":\"export_iteration\"") != std::string::npos;
+        size_t args = line.find("\"args\":{\"start\":");
+        if (line.find("\"name\":\"parallel_for stripe\"") != std::string::npos && args != std::string::npos)
+        {
+            int start = -1, end = -1;
+            ASSERT_EQ(2, sscanf(line.c_str() + args, "\"args\":{\"start\":%d,\"end\":%d}", &start, &end)) << line;
+            stripes++;
+            stripeRows += end - start;
+        }
+    }
+    EXPECT_EQ((int)stats.events, events);
+    EXPECT_EQ(1, outer);
+    EXPECT_EQ(3, iterations);
+    EXPECT_GE(stripes, 3);
+    EXPECT_EQ(3 * 64, stripeRows);  // every stripe once, from whichever thread ran it
+
+    cv::utils::trace::TraceEventExportStats idle = cv::utils::trace::stopTraceEventExport();
+    EXPECT_EQ(0u, idle.events);
+}
+
 
 }} // namespace
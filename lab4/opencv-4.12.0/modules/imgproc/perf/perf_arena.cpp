@@ -0,0 +1,109 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#include "perf_precomp.hpp"
+#include "opencv2/core/utils/arena.hpp"
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#include <unistd.h>
+#include <fstream>
+#endif
+
+namespace opencv_test {
+
+// A per-frame validate/enhance chain whose temporaries live for one iteration,
+// with the default allocator and inside a cv::ScopedArena. On Linux the minor
+// page faults per frame and the resident set are recorded as test properties.
+typedef tuple<Size, bool> Size_Arena_t;
+typedef perf::TestBaseWithParam<Size_Arena_t> Size_Arena;
+
+static void frameChain(const Mat& frame, Mat& out)
+{
+    Mat gray, blurred, edges, hsv, small, mask;
+    cvtColor(frame, gray, COLOR_BGR2GRAY);
+    GaussianBlur(gray, blurred, Size(5, 5), 0);
+    Canny(blurred, edges, 50, 150);
+    cvtColor(frame, hsv, COLOR_BGR2HSV);
+    inRange(hsv, Scalar(0, 0, 40), Scalar(180, 255, 220), mask);
+    resize(frame, small, Size(), 0.5, 0.5, INTER_AREA);
+    std::vector<Mat> planes;
+    split(small, planes);
+    for (size_t i = 0; i < planes.size(); i++)
+        equalizeHist(planes[i], planes[i]);
+    merge(planes, small);
+    out.at<double>(0) = sum(edges)[0] + sum(mask)[0] + sum(small)[0];
+}
+
+#if defined(__linux__)
+static long minorFaults()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+static long residentKb()
+{
+    long pages = 0, resident = 0;
+    std::ifstream statm("/proc/self/statm");
+    statm >> pages >> resident;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+#endif
+
+PERF_TEST_P(Size_Arena, frame_chain,
+            testing::Combine(
+                testing::Values(szVGA, sz720p, sz1080p),
+                testing::Bool()
+                )
+            )
+{
+    const Size sz = get<0>(GetParam());
+    const bool useArena = get<1>(GetParam());
+
+    Mat frame(sz, CV_8UC3), out(1, 1, CV_64F);
+    declare.in(frame, WARMUP_RNG);
+
+    // warm up both allocators
+    for (int i = 0; i < 3; i++)
+    {
+        if (useArena)
+        {
+            ScopedArena arena;
+            frameChain(frame, out);
+        }
+        else
+        {
+            frameChain(frame, out);
+        }
+    }
+
+#if defined(__linux__)
+    long faults = minorFaults();
+    int frames = 0;
+#endif
+    PERF_SAMPLE_BEGIN();
+        if (useArena)
+        {
+            ScopedArena arena;
+            frameChain(frame, out);
+        }
+        else
+        {
+            frameChain(frame, out);
+        }
+#if defined(__linux__)
+        frames++;
+#endif
+    PERF_SAMPLE_END();
+
+#if defined(__linux__)
+    RecordProperty("minor_faults_per_frame", cv::format("%.1f", (double)(minorFaults() - faults) / std::max(frames, 1)));
+    RecordProperty("rss_kb", (int)residentKb());
+#endif
+    Mat::setDefaultAllocator(Mat::getStdAllocator());
+    SANITY_CHECK_NOTHING();
+}
+
+} // namespace
@@ -76,6 +76,10 @@ protected:
     uint32_t         m_frame_width;
     uint32_t         m_frame_height;
     double           m_fps;
+
+    //raw mode (CAP_PROP_FORMAT == -1): retrieve returns the compressed
+    //frame as a 1xN CV_8UC1 Mat instead of decoding it
+    bool             m_raw_mode;
 };
 
 uint64_t MotionJpegCapture::getFramePos() const
@@ -106,6 +110,19 @@ bool MotionJpegCapture::setProperty(int property, double value)
             return true;
         }
     }
+    else if(property == CAP_PROP_FORMAT)
+    {
+        if(cvRound(value) == -1 || cvRound(value) == CV_8UC3)
+        {
+            m_raw_mode = cvRound(value) == -1;
+            return true;
+        }
+    }
+    else if(property == CAP_PROP_CONVERT_RGB)
+    {
+        m_raw_mode = value == 0;
+        return true;
+    }
 
     return false;
 }
@@ -131,7 +148,9 @@ double MotionJpegCapture::getProperty(int property) const
         case CAP_PROP_FRAME_COUNT:
             return (double)m_mjpeg_frames.size();
         case CAP_PROP_FORMAT:
-            return 0;
+            return m_raw_mode ? -1 : 0;
+        case CAP_PROP_CONVERT_RGB:
+            return m_raw_mode ? 0 : 1;
         default:
             return 0;
     }
@@ -164,6 +183,12 @@ bool MotionJpegCapture::retrieveFrame(int, OutputArray output_frame)
     {
         std::vector<char> data = m_avi_container->readFrame(m_frame_iterator);
 
+        if(m_raw_mode)
+        {
+            Mat(1, (int)data.size(), CV_8UC1, data.data()).copyTo(output_frame);
+            return !data.empty();
+        }
+
         if(data.size())
         {
             m_current_frame = imdecode(data, IMREAD_ANYDEPTH | IMREAD_COLOR | IMREAD_IGNORE_ORIENTATION);
@@ -183,6 +208,7 @@ MotionJpegCapture::~MotionJpegCapture()
 }
 
 MotionJpegCapture::MotionJpegCapture(const String& filename)
+    : m_raw_mode(false)
 {
     m_avi_container = makePtr<AVIReadContainer>();
     m_avi_container->initStream(filename);
@@ -1908,6 +1908,17 @@ bool CvCaptureCAM_V4L::setProperty( int property_id, double _value )
             convert_rgb = false;
             return true;
         }
+    case cv::CAP_PROP_FORMAT:
+        // -1 selects raw retrieval like CAP_PROP_CONVERT_RGB=0: MJPEG buffers are returned undecoded
+        if (value == -1) {
+            convert_rgb = false;
+            return true;
+        }
+        if (value == CV_8UC3) {
+            convert_rgb = convertableToRgb();
+            return convert_rgb;
+        }
+        return false;
     case cv::CAP_PROP_FOURCC:
     {
         __u32 new_palette = static_cast<__u32>(_value);
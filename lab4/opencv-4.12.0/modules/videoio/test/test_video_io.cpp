@@ -588,6 +588,54 @@ TEST(Videoio, exceptions)
     EXPECT_THROW(cap.open("this_does_not_exist.avi", CAP_OPENCV_MJPEG), Exception);
 }
 
+TEST(Videoio, mjpeg_raw_read)
+{
+    const std::string video_file = cv::tempfile("mjpeg_raw.avi");
+    const Size frame_size(320, 240);
+    const int frame_count = 5;
+    {
+        VideoWriter writer(video_file, CAP_OPENCV_MJPEG, VideoWriter::fourcc('M', 'J', 'P', 'G'), 30, frame_size);
+        ASSERT_TRUE(writer.isOpened());
+        for (int i = 0; i < frame_count; i++)
+        {
+            Mat frame(frame_size, CV_8UC3, Scalar::all(0));
+            rectangle(frame, Rect(i * 20, 40, 80, 80), Scalar(0, 255, 0), FILLED);
+            writer << frame;
+        }
+    }
+
+    VideoCapture decoded(video_file, CAP_OPENCV_MJPEG);
+    VideoCapture raw(video_file, CAP_OPENCV_MJPEG, {CAP_PROP_FORMAT, -1});
+    ASSERT_TRUE(decoded.isOpened());
+    ASSERT_TRUE(raw.isOpened());
+    EXPECT_EQ(-1, raw.get(CAP_PROP_FORMAT));
+    EXPECT_EQ(0, raw.get(CAP_PROP_CONVERT_RGB));
+
+    Mat frame, buffer;
+    for (int i = 0; i < frame_count; i++)
+    {
+        ASSERT_TRUE(decoded.read(frame));
+        ASSERT_TRUE(raw.read(buffer));
+        ASSERT_EQ(1, buffer.rows);
+        ASSERT_EQ(CV_8UC1, buffer.type());
+        ASSERT_GT(buffer.cols, 2);
+        EXPECT_EQ(0xFF, buffer.at<uchar>(0, 0));
+        EXPECT_EQ(0xD8, buffer.at<uchar>(0, 1));
+        // the raw buffer is exactly what the decoding path decodes
+        EXPECT_EQ(0, cvtest::norm(imdecode(buffer, IMREAD_COLOR), frame, NORM_INF)) << i;
+    }
+    EXPECT_FALSE(raw.read(buffer));
+
+    // switching back re-enables decoding
+    ASSERT_TRUE(raw.set(CAP_PROP_POS_FRAMES, 0));
+    ASSERT_TRUE(raw.set(CAP_PROP_FORMAT, CV_8UC3));
+    ASSERT_TRUE(raw.read(frame));
+    EXPECT_EQ(frame_size, frame.size());
+    EXPECT_EQ(CV_8UC3, frame.type());
+
+    EXPECT_EQ(0, remove(video_file.c_str()));
+}
+
 
 typedef Videoio_Writer Videoio_Writer_bad_fourcc;
 
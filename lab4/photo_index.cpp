@@ -0,0 +1,446 @@
+// Index and preview cache of the lab4 photos directory
+#include "photo_index.h"
+
+#include "burst_capture.h"
+#include "mjpeg_passthrough.h"
+#include "serve_protocol.h"
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+const char kIndexFile[] = "photo_index.tsv";
+const char kPreviewDir[] = "previews";
+// SOF sits right after the quantisation and Huffman tables
+const size_t kHeaderBytes = 64 * 1024;
+
+struct FileInfo {
+    std::string name;
+    uint64_t bytes;
+    int64_t mtimeMs;
+};
+
+bool is_jpeg_name(const std::string& name)
+{
+    if (name.size() < 5) {
+        return false;
+    }
+    std::string ext = name.substr(name.size() - 4);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".jpg" || (ext == "jpeg" && name[name.size() - 5] == '.');
+}
+
+std::string base_name(const std::string& path)
+{
+    size_t slash = path.find_last_of("\\/");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+void make_dir(const std::string& dir)
+{
+#ifdef _WIN32
+    _mkdir(dir.c_str());
+#else
+    mkdir(dir.c_str(), 0755);
+#endif
+}
+
+bool stat_file(const std::string& path, uint64_t& bytes, int64_t& mtimeMs)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data)) {
+        return false;
+    }
+    bytes = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    uint64_t ticks = ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+    mtimeMs = (int64_t)(ticks / 10000) - 11644473600000LL;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    bytes = (uint64_t)st.st_size;
+    mtimeMs = (int64_t)st.st_mtim.tv_sec * 1000 + st.st_mtim.tv_nsec / 1000000;
+#endif
+    return true;
+}
+
+// *.jpg files directly in dir
+std::vector<FileInfo> scan_photos(const std::string& dir)
+{
+    std::vector<FileInfo> files;
+#ifdef _WIN32
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA((dir + "\\*").c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE) {
+        return files;
+    }
+    do {
+        if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || !is_jpeg_name(data.cFileName)) {
+            continue;
+        }
+        FileInfo info;
+        info.name = data.cFileName;
+        info.bytes = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+        uint64_t ticks = ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+        info.mtimeMs = (int64_t)(ticks / 10000) - 11644473600000LL;
+        files.push_back(info);
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+#else
+    DIR* d = opendir(dir.c_str());
+    if (!d) {
+        return files;
+    }
+    while (struct dirent* e = readdir(d)) {
+        if (e->d_type == DT_DIR || !is_jpeg_name(e->d_name)) {
+            continue;
+        }
+        FileInfo info;
+        info.name = e->d_name;
+        if (stat_file(dir + "/" + info.name, info.bytes, info.mtimeMs)) {
+            files.push_back(info);
+        }
+    }
+    closedir(d);
+#endif
+    return files;
+}
+
+std::vector<unsigned char> read_bytes(const std::string& path, size_t limit)
+{
+    std::vector<unsigned char> data;
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return data;
+    }
+    unsigned char buf[64 * 1024];
+    size_t n;
+    while (data.size() < limit && (n = fread(buf, 1, std::min(sizeof(buf), limit - data.size()), f)) > 0) {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+    return data;
+}
+
+void write_line(FILE* f, const PhotoEntry& entry)
+{
+    fprintf(f, "%s\t%lld\t%llu\t%d\t%d\t%.3f\n", entry.name.c_str(), (long long)entry.unixMs,
+            (unsigned long long)entry.bytes, entry.width, entry.height, entry.score);
+}
+
+// name \t unixMs \t bytes \t width \t height \t score; a torn last line is skipped
+bool parse_line(const std::string& line, PhotoEntry& entry)
+{
+    size_t tab = line.find('\t');
+    if (tab == 0 || tab == std::string::npos) {
+        return false;
+    }
+    entry.name.assign(line, 0, tab);
+    const char* p = line.c_str() + tab;
+    char* end = nullptr;
+    entry.unixMs = strtoll(p, &end, 10);
+    entry.bytes = strtoull(end, &end, 10);
+    entry.width = (int)strtol(end, &end, 10);
+    entry.height = (int)strtol(end, &end, 10);
+    const char* last = end;
+    entry.score = strtod(last, &end);
+    return end != last;
+}
+
+} // namespace
+
+cv::Mat FitPreview(const cv::Mat& pixels, int side)
+{
+    int longest = std::max(pixels.cols, pixels.rows);
+    if (pixels.empty() || longest <= side) {
+        return pixels;
+    }
+    double scale = (double)side / longest;
+    cv::Mat fitted;
+    cv::resize(pixels, fitted, cv::Size(std::max(1, (int)(pixels.cols * scale + 0.5)),
+                                        std::max(1, (int)(pixels.rows * scale + 0.5))), 0, 0, cv::INTER_AREA);
+    return fitted;
+}
+
+cv::Mat DecodePreviewPixels(const cv::Mat& jpeg, int side)
+{
+    int width = 0, height = 0;
+    int flag = cv::IMREAD_COLOR;
+    if (ReadJpegSize(jpeg.ptr<unsigned char>(), jpeg.total(), width, height)) {
+        int longest = std::max(width, height);
+        if (longest >= side * 8) {
+            flag = cv::IMREAD_REDUCED_COLOR_8;
+        } else if (longest >= side * 4) {
+            flag = cv::IMREAD_REDUCED_COLOR_4;
+        } else if (longest >= side * 2) {
+            flag = cv::IMREAD_REDUCED_COLOR_2;
+        }
+    }
+    return FitPreview(cv::imdecode(jpeg, flag), side);
+}
+
+cv::Mat LoadPreviewPixels(const std::string& path, int side)
+{
+    std::vector<unsigned char> data = read_bytes(path, (size_t)-1);
+    if (data.empty()) {
+        return cv::Mat();
+    }
+    return DecodePreviewPixels(cv::Mat(1, (int)data.size(), CV_8UC1, data.data()), side);
+}
+
+bool PhotoIndex::open(const std::string& dir, std::string& error)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    dir_ = dir;
+    entries_.clear();
+    byName_.clear();
+    make_dir(dir_);
+    make_dir(dir_ + "/" + kPreviewDir);
+
+    std::ifstream in(indexPath().c_str());
+    if (!in) {
+        // First run on this directory: index what is already there
+        open_ = true;
+        std::vector<FileInfo> files = scan_photos(dir_);
+        std::sort(files.begin(), files.end(), [](const FileInfo& a, const FileInfo& b) {
+            return a.mtimeMs != b.mtimeMs ? a.mtimeMs < b.mtimeMs : a.name < b.name;
+        });
+        for (size_t i = 0; i < files.size(); i++) {
+            PhotoEntry entry;
+            entry.name = files[i].name;
+            entry.unixMs = files[i].mtimeMs;
+            entry.bytes = files[i].bytes;
+            std::vector<unsigned char> header = read_bytes(dir_ + "/" + entry.name, kHeaderBytes);
+            ReadJpegSize(header.data(), header.size(), entry.width, entry.height);
+            put(entry);
+        }
+        if (!writeAll()) {
+            error = "cannot write " + indexPath();
+            open_ = false;
+            return false;
+        }
+        return true;
+    }
+
+    std::string line;
+    while (std::getline(in, line)) {
+        PhotoEntry entry;
+        if (parse_line(line, entry)) {
+            put(entry);
+        }
+    }
+    open_ = true;
+    return true;
+}
+
+bool PhotoIndex::isOpen() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return open_;
+}
+
+bool PhotoIndex::add(const std::string& path, const cv::Mat& frame, int64_t unixMs)
+{
+    PhotoEntry entry;
+    entry.name = base_name(path);
+    entry.unixMs = unixMs;
+    int64_t mtime = 0;
+    stat_file(path, entry.bytes, mtime);
+
+    cv::Mat pixels;
+    if (IsJpegBuffer(frame)) {
+        ReadJpegSize(frame.ptr<unsigned char>(), frame.total(), entry.width, entry.height);
+        pixels = DecodePreviewPixels(frame, kPreviewSide);
+    } else {
+        entry.width = frame.cols;
+        entry.height = frame.rows;
+        pixels = FitPreview(frame, kPreviewSide);
+    }
+    // The preview is made outside the lock: saves from several threads only
+    // serialise on the index line
+    if (pixels.empty() || !makePreview(pixels, entry.name, entry.score)) {
+        entry.score = -1.0;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_) {
+        return false;
+    }
+    put(entry);
+    return append(entry);
+}
+
+size_t PhotoIndex::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+std::vector<PhotoEntry> PhotoIndex::list(size_t offset, size_t limit) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<PhotoEntry> page;
+    for (size_t i = offset; i < entries_.size() && page.size() < limit; i++) {
+        page.push_back(entries_[entries_.size() - 1 - i]);
+    }
+    return page;
+}
+
+bool PhotoIndex::find(const std::string& name, PhotoEntry& entry) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unordered_map<std::string, size_t>::const_iterator it = byName_.find(name);
+    if (it == byName_.end()) {
+        return false;
+    }
+    entry = entries_[it->second];
+    return true;
+}
+
+bool PhotoIndex::preview(const std::string& name, std::string& path, bool& generated, std::string& error)
+{
+    generated = false;
+    PhotoEntry entry;
+    if (!find(name, entry)) {
+        error = "unknown photo";
+        return false;
+    }
+    path = previewPath(name);
+    uint64_t bytes = 0;
+    int64_t mtime = 0;
+    if (entry.score >= 0.0 && stat_file(path, bytes, mtime)) {
+        return true;
+    }
+
+    cv::Mat pixels = LoadPreviewPixels(dir_ + "/" + name, kPreviewSide);
+    if (pixels.empty()) {
+        error = "cannot decode " + name;
+        return false;
+    }
+    if (!makePreview(pixels, name, entry.score)) {
+        error = "cannot write " + path;
+        return false;
+    }
+    generated = true;
+    std::lock_guard<std::mutex> lock(mutex_);
+    put(entry);
+    append(entry);
+    return true;
+}
+
+size_t PhotoIndex::rebuild()
+{
+    std::vector<FileInfo> files = scan_photos(dir_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<PhotoEntry> entries;
+    for (size_t i = 0; i < files.size(); i++) {
+        std::unordered_map<std::string, size_t>::const_iterator it = byName_.find(files[i].name);
+        if (it != byName_.end() && entries_[it->second].bytes == files[i].bytes) {
+            entries.push_back(entries_[it->second]);
+            continue;
+        }
+        PhotoEntry entry;
+        entry.name = files[i].name;
+        entry.unixMs = files[i].mtimeMs;
+        entry.bytes = files[i].bytes;
+        std::vector<unsigned char> header = read_bytes(dir_ + "/" + entry.name, kHeaderBytes);
+        ReadJpegSize(header.data(), header.size(), entry.width, entry.height);
+        entries.push_back(entry);
+    }
+    std::sort(entries.begin(), entries.end(), [](const PhotoEntry& a, const PhotoEntry& b) {
+        return a.unixMs != b.unixMs ? a.unixMs < b.unixMs : a.name < b.name;
+    });
+    entries_.clear();
+    byName_.clear();
+    for (size_t i = 0; i < entries.size(); i++) {
+        put(entries[i]);
+    }
+    writeAll();
+    return entries_.size();
+}
+
+std::string PhotoIndex::EntryJson(const PhotoEntry& entry)
+{
+    std::ostringstream os;
+    os << "{\"name\":\"" << JsonEscape(entry.name) << "\",\"unix_ms\":" << entry.unixMs
+       << ",\"bytes\":" << entry.bytes << ",\"width\":" << entry.width << ",\"height\":" << entry.height
+       << ",\"score\":" << entry.score << "}";
+    return os.str();
+}
+
+std::string PhotoIndex::previewPath(const std::string& name) const
+{
+    return dir_ + "/" + kPreviewDir + "/" + name;
+}
+
+std::string PhotoIndex::indexPath() const
+{
+    return dir_ + "/" + kIndexFile;
+}
+
+void PhotoIndex::put(const PhotoEntry& entry)
+{
+    std::unordered_map<std::string, size_t>::iterator it = byName_.find(entry.name);
+    if (it != byName_.end()) {
+        entries_[it->second] = entry;
+        return;
+    }
+    byName_[entry.name] = entries_.size();
+    entries_.push_back(entry);
+}
+
+bool PhotoIndex::append(const PhotoEntry& entry)
+{
+    FILE* f = fopen(indexPath().c_str(), "ab");
+    if (!f) {
+        return false;
+    }
+    write_line(f, entry);
+    return fclose(f) == 0;
+}
+
+bool PhotoIndex::writeAll()
+{
+    // Written aside and renamed over, so a crash leaves the old index
+    std::string tmp = indexPath() + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) {
+        return false;
+    }
+    for (size_t i = 0; i < entries_.size(); i++) {
+        write_line(f, entries_[i]);
+    }
+    if (fclose(f) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return MoveFileExA(tmp.c_str(), indexPath().c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return std::rename(tmp.c_str(), indexPath().c_str()) == 0;
+#endif
+}
+
+bool PhotoIndex::makePreview(const cv::Mat& pixels, const std::string& name, double& score)
+{
+    score = SharpnessScore(pixels);
+    static const std::vector<int> params{ cv::IMWRITE_JPEG_QUALITY, 80 };
+    return cv::imwrite(previewPath(name), pixels, params);
+}
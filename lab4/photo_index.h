@@ -0,0 +1,90 @@
+// Index and preview cache of the lab4 photos directory
+//
+// photo_index.tsv in the photos directory is an append-only log with one
+// line per photo: name, save time, bytes, width, height and a sharpness
+// score. A later line for the same name replaces the earlier one, and
+// rebuild() rewrites the file compacted. Listing reads the index held in
+// memory, so the directory is scanned only when there is no index yet or on
+// an explicit rebuild.
+//
+// Previews are JPEGs at most kPreviewSide pixels on the long side, in
+// previews/ under the photos directory. A photo saved through add() gets its
+// preview right away, downscaled with INTER_AREA from the frame that was just
+// encoded (or, for an MJPEG buffer, decoded at 1/4 or 1/8 inside the IDCT).
+// Photos the index only found on disk get theirs on first request, with the
+// same reduced decode from the file.
+#ifndef PHOTO_INDEX_H
+#define PHOTO_INDEX_H
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct PhotoEntry {
+    std::string name;       // file name inside the photos directory
+    int64_t unixMs = 0;     // save time, or the file's mtime for a scanned photo
+    uint64_t bytes = 0;
+    int width = 0;
+    int height = 0;
+    double score = -1.0;    // variance of the Laplacian of the preview; -1 until it exists
+};
+
+class PhotoIndex {
+public:
+    static const int kPreviewSide = 320;
+
+    // Loads dir/photo_index.tsv, or scans dir for *.jpg when there is none
+    // and writes the index from that
+    bool open(const std::string& dir, std::string& error);
+    bool isOpen() const;
+
+    // Records a photo that was just written to path and makes its preview.
+    // frame is what was encoded (BGR) or the MJPEG buffer that was written.
+    bool add(const std::string& path, const cv::Mat& frame, int64_t unixMs);
+
+    size_t size() const;
+    // Newest first
+    std::vector<PhotoEntry> list(size_t offset, size_t limit) const;
+    bool find(const std::string& name, PhotoEntry& entry) const;
+
+    // Path of the photo's preview, made from the file if it has none yet;
+    // generated is set when it had to be made
+    bool preview(const std::string& name, std::string& path, bool& generated, std::string& error);
+
+    // Rescans the directory: new files are added, entries whose file is gone
+    // are dropped, and the index file is rewritten. Returns the entry count.
+    size_t rebuild();
+
+    static std::string EntryJson(const PhotoEntry& entry);
+
+private:
+    std::string previewPath(const std::string& name) const;
+    std::string indexPath() const;
+    // Callers hold mutex_
+    void put(const PhotoEntry& entry);
+    bool append(const PhotoEntry& entry);
+    bool writeAll();
+    bool makePreview(const cv::Mat& pixels, const std::string& name, double& score);
+
+    mutable std::mutex mutex_;
+    std::string dir_;
+    bool open_ = false;
+    std::vector<PhotoEntry> entries_;                   // in save order
+    std::unordered_map<std::string, size_t> byName_;    // name -> entries_ index
+};
+
+// Reads a photo at a reduced scale: the largest 1/2^k decode (k up to 3)
+// whose long side still covers side pixels, then INTER_AREA down to it
+cv::Mat LoadPreviewPixels(const std::string& path, int side);
+
+// The same reduced decode for a JPEG held in memory (an MJPEG buffer)
+cv::Mat DecodePreviewPixels(const cv::Mat& jpeg, int side);
+
+// Downscales pixels with INTER_AREA so the long side is at most side
+cv::Mat FitPreview(const cv::Mat& pixels, int side);
+
+#endif // PHOTO_INDEX_H
@@ -0,0 +1,116 @@
+// Host side of OpenCV videoio capture plugins for lab4
+#include "plugin_capture.h"
+
+// Entry point exported by synthetic_camera_plugin.cpp
+extern "C" const OpenCV_VideoIO_Capture_Plugin_API* CV_API_CALL opencv_videoio_capture_plugin_init_v1(
+        int requested_abi_version, int requested_api_version, void* reserved);
+
+namespace {
+
+CvResult CV_API_CALL copy_frame(int stream_idx, unsigned const char* data, int step,
+                                int width, int height, int type, void* userdata)
+{
+    (void)stream_idx;
+    const cv::_OutputArray* out = (const cv::_OutputArray*)userdata;
+    if (!data || width <= 0 || height <= 0) {
+        return CV_ERROR_FAIL;
+    }
+    cv::Mat(height, width, type, const_cast<unsigned char*>(data), (size_t)step).copyTo(*out);
+    return CV_ERROR_OK;
+}
+
+} // namespace
+
+bool IsSyntheticSource(const std::string& spec)
+{
+    return spec.compare(0, 9, "synthetic") == 0 && (spec.size() == 9 || spec[9] == ':');
+}
+
+const OpenCV_VideoIO_Capture_Plugin_API* SyntheticCameraPlugin()
+{
+    // Newest API first, as videoio's loader asks
+    for (int version = CAPTURE_API_VERSION; version >= 0; version--) {
+        const OpenCV_VideoIO_Capture_Plugin_API* api =
+            opencv_videoio_capture_plugin_init_v1(CAPTURE_ABI_VERSION, version, NULL);
+        if (api) {
+            return api;
+        }
+    }
+    return NULL;
+}
+
+PluginCapture::PluginCapture(const OpenCV_VideoIO_Capture_Plugin_API* api) : api_(api)
+{
+}
+
+PluginCapture::~PluginCapture()
+{
+    release();
+}
+
+bool PluginCapture::open(const std::string& filename)
+{
+    release();
+    if (!api_) {
+        return false;
+    }
+    CvPluginCapture handle = NULL;
+    CvResult result = api_->api_header.api_version >= 1 && api_->v1.Capture_open_with_params
+        ? api_->v1.Capture_open_with_params(filename.c_str(), 0, NULL, 0, &handle)
+        : api_->v0.Capture_open(filename.c_str(), 0, &handle);
+    if (result != CV_ERROR_OK || !handle) {
+        return false;
+    }
+    handle_ = handle;
+    return true;
+}
+
+void PluginCapture::release()
+{
+    if (handle_) {
+        api_->v0.Capture_release(handle_);
+        handle_ = NULL;
+    }
+}
+
+bool PluginCapture::grab()
+{
+    return handle_ && api_->v0.Capture_grab(handle_) == CV_ERROR_OK;
+}
+
+bool PluginCapture::retrieve(cv::OutputArray image)
+{
+    if (!handle_ || api_->v0.Capture_retreive(handle_, 0, copy_frame, (void*)&image) != CV_ERROR_OK) {
+        image.release();
+        return false;
+    }
+    return true;
+}
+
+bool PluginCapture::read(cv::OutputArray image)
+{
+    if (!grab()) {
+        image.release();
+        return false;
+    }
+    return retrieve(image);
+}
+
+bool PluginCapture::set(int propId, double value)
+{
+    return handle_ && api_->v0.Capture_setProperty(handle_, propId, value) == CV_ERROR_OK;
+}
+
+double PluginCapture::get(int propId) const
+{
+    double value = 0.0;
+    if (!handle_ || api_->v0.Capture_getProperty(handle_, propId, &value) != CV_ERROR_OK) {
+        return 0.0;
+    }
+    return value;
+}
+
+std::string PluginCapture::description() const
+{
+    return api_ && api_->api_header.api_description ? api_->api_header.api_description : "";
+}
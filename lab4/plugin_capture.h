@@ -0,0 +1,50 @@
+// Host side of OpenCV videoio capture plugins for lab4
+//
+// PluginCapture drives a capture plugin through the function table of
+// plugin_capture_api.hpp (open, grab, retrieve with a callback, properties),
+// the way videoio's own PluginBackend does. The only plugin lab4 has is the
+// synthetic camera in synthetic_camera_plugin.cpp, linked into the program.
+#ifndef PLUGIN_CAPTURE_H
+#define PLUGIN_CAPTURE_H
+
+#include <opencv2/core.hpp>
+
+#include <string>
+
+#include "opencv-4.12.0/modules/videoio/src/plugin_capture_api.hpp"
+
+// True for "synthetic" and "synthetic:..." source specs
+bool IsSyntheticSource(const std::string& spec);
+
+// Table of the linked-in synthetic camera plugin
+const OpenCV_VideoIO_Capture_Plugin_API* SyntheticCameraPlugin();
+
+class PluginCapture {
+public:
+    explicit PluginCapture(const OpenCV_VideoIO_Capture_Plugin_API* api);
+    ~PluginCapture();
+
+    bool open(const std::string& filename);
+    bool isOpened() const { return handle_ != NULL; }
+    void release();
+
+    bool grab();
+    // Copies the grabbed frame out of the plugin's buffer
+    bool retrieve(cv::OutputArray image);
+    bool read(cv::OutputArray image);
+
+    bool set(int propId, double value);
+    double get(int propId) const;
+
+    // The plugin's own description, e.g. "lab4 synthetic camera capture plugin"
+    std::string description() const;
+
+private:
+    PluginCapture(const PluginCapture&);
+    PluginCapture& operator=(const PluginCapture&);
+
+    const OpenCV_VideoIO_Capture_Plugin_API* api_;
+    CvPluginCapture handle_ = NULL;
+};
+
+#endif // PLUGIN_CAPTURE_H
@@ -0,0 +1,108 @@
+// Line protocol of the lab4 "serve" mode
+#include "serve_protocol.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+// Commands of serve and multi; a line that starts with one of them carries no id
+static const char* const kServeCommands[] = {
+    "ping", "info", "capture", "burst", "photos", "preview", "live", "live_ack",
+    "reindex", "start_periodic", "stop_periodic", "stats", "reopen", "quit",
+};
+
+static bool IsServeCommand(const std::string& token) {
+    for (const char* cmd : kServeCommands) {
+        if (token == cmd) return true;
+    }
+    return false;
+}
+
+bool ParseServeRequest(const std::string& line, ServeRequest& req) {
+    std::istringstream ss(line);
+    std::vector<std::string> tokens;
+    std::string token;
+    while (ss >> token) tokens.push_back(token);
+    if (tokens.empty()) return false;
+
+    req = ServeRequest();
+    size_t first = tokens.size() > 1 && !IsServeCommand(tokens[0]) ? 1 : 0;
+    if (first) req.id = tokens[0];
+    req.cmd = tokens[first];
+    req.args.assign(tokens.begin() + first + 1, tokens.end());
+    return true;
+}
+
+std::string JsonEscape(const std::string& text) {
+    std::string out;
+    out.reserve(text.size() + 8);
+    for (unsigned char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += (char)c;
+                }
+        }
+    }
+    return out;
+}
+
+static std::string ReplyHead(const ServeRequest& req, bool ok, double ms) {
+    char timing[32];
+    snprintf(timing, sizeof(timing), "%.3f", ms);
+    std::string head = "{\"id\":";
+    head += req.id.empty() ? std::string("null") : "\"" + JsonEscape(req.id) + "\"";
+    head += ",\"cmd\":\"" + JsonEscape(req.cmd) + "\"";
+    head += ok ? ",\"ok\":true" : ",\"ok\":false";
+    head += ",\"ms\":";
+    head += timing;
+    return head;
+}
+
+std::string FormatServeReply(const ServeRequest& req, double ms, const std::string& result) {
+    return ReplyHead(req, true, ms) + ",\"result\":" + (result.empty() ? std::string("null") : result) + "}";
+}
+
+std::string FormatServeError(const ServeRequest& req, double ms, const std::string& error) {
+    return ReplyHead(req, false, ms) + ",\"error\":\"" + JsonEscape(error) + "\"}";
+}
+
+LatencyStats::LatencyStats(size_t window) : window_(window ? window : 1) {
+    samples_.reserve(window_);
+}
+
+void LatencyStats::add(double ms) {
+    if (samples_.size() < window_) {
+        samples_.push_back(ms);
+    } else {
+        samples_[next_] = ms;
+        next_ = (next_ + 1) % window_;
+    }
+    ++count_;
+    max_ = std::max(max_, ms);
+}
+
+double LatencyStats::percentile(double p) const {
+    if (samples_.empty()) return 0.0;
+    std::vector<double> sorted(samples_);
+    size_t rank = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+    rank = std::min(rank, sorted.size() - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+std::string LatencyStats::toJson() const {
+    char buf[160];
+    snprintf(buf, sizeof(buf), "{\"count\":%llu,\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"max_ms\":%.3f}",
+             (unsigned long long)count_, percentile(50), percentile(99), max_);
+    return buf;
+}
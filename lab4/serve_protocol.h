@@ -0,0 +1,59 @@
+// Line protocol of the lab4 "serve" mode
+//
+// Every request is one line: "<id> <command> [args...]". The id is echoed
+// back so a client can keep several requests in flight; a line that starts
+// with a command name ("capture raw") is a command without an id, so ids
+// must not be command names. Every reply is one JSON object per line:
+//   {"id":"7","cmd":"info","ok":true,"ms":0.41,"result":{...}}
+//   {"id":"8","cmd":"nope","ok":false,"ms":0.01,"error":"unknown command"}
+// Unsolicited records (periodic photos) carry "event" instead of "id".
+// The one binary record is the live preview: after the line
+//   {"event":"live","seq":12,"width":640,"height":360,...,"bytes":23817}
+// come exactly "bytes" bytes of JPEG and a newline. "<id> live_ack <seq>" gets
+// no reply.
+#ifndef SERVE_PROTOCOL_H
+#define SERVE_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ServeRequest {
+    std::string id;                  // empty when the client sent no id
+    std::string cmd;
+    std::vector<std::string> args;
+};
+
+// Splits a request line on whitespace and tells the id from the command; false for an empty line
+bool ParseServeRequest(const std::string& line, ServeRequest& req);
+
+std::string JsonEscape(const std::string& text);
+
+// result must be a JSON value (object, number...); error is plain text
+std::string FormatServeReply(const ServeRequest& req, double ms, const std::string& result);
+std::string FormatServeError(const ServeRequest& req, double ms, const std::string& error);
+
+// Request latencies of one command. Percentiles come from the most recent
+// samples so a long-running server reflects its current behaviour.
+class LatencyStats {
+public:
+    explicit LatencyStats(size_t window = 4096);
+
+    void add(double ms);
+    uint64_t count() const { return count_; }
+    double max() const { return max_; }
+    double percentile(double p) const;
+
+    // {"count":..,"p50_ms":..,"p99_ms":..,"max_ms":..}
+    std::string toJson() const;
+
+private:
+    size_t window_;
+    std::vector<double> samples_;    // ring of the last window_ samples
+    size_t next_ = 0;
+    uint64_t count_ = 0;
+    double max_ = 0.0;
+};
+
+#endif // SERVE_PROTOCOL_H
@@ -0,0 +1,353 @@
+// Shared-memory status block of lab4
+#include "status_block.h"
+#include "serve_protocol.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <thread>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const size_t kBlockSize = sizeof(StatusBlockHeader) + sizeof(Lab4Status);
+
+uint64_t UnixMs()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+uint32_t CurrentPid()
+{
+#ifdef _WIN32
+    return (uint32_t)GetCurrentProcessId();
+#else
+    return (uint32_t)getpid();
+#endif
+}
+
+bool ProcessAlive(uint32_t pid)
+{
+#ifdef _WIN32
+    HANDLE h = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)pid);
+    if (!h) return GetLastError() == ERROR_ACCESS_DENIED;
+    bool alive = WaitForSingleObject(h, 0) == WAIT_TIMEOUT;
+    CloseHandle(h);
+    return alive;
+#else
+    return kill((pid_t)pid, 0) == 0 || errno == EPERM;
+#endif
+}
+
+// Names held by the writers of this process: they all share one pid, so the
+// pid in the header cannot tell them apart
+std::mutex g_heldMutex;
+std::set<std::string> g_held;
+
+// Maps the block; creates it when writable is set. Returns the base address or nullptr.
+void* MapBlock(const std::string& name, bool writable, void*& mapping, bool* created = nullptr)
+{
+    mapping = nullptr;
+    if (created) *created = false;
+#ifdef _WIN32
+    HANDLE h;
+    if (writable) {
+        h = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)kBlockSize, name.c_str());
+        if (h && created) *created = GetLastError() != ERROR_ALREADY_EXISTS;
+    } else {
+        h = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+    }
+    if (!h) return nullptr;
+    void* base = MapViewOfFile(h, writable ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, kBlockSize);
+    if (!base) {
+        CloseHandle(h);
+        return nullptr;
+    }
+    mapping = h;
+    return base;
+#else
+    int fd;
+    if (writable) {
+        // O_EXCL tells a fresh block apart from one left by a previous run
+        fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd >= 0) {
+            if (created) *created = true;
+        } else if (errno == EEXIST) {
+            fd = shm_open(name.c_str(), O_RDWR, 0);
+        }
+    } else {
+        fd = shm_open(name.c_str(), O_RDONLY, 0);
+    }
+    if (fd < 0) return nullptr;
+    if (writable && ftruncate(fd, (off_t)kBlockSize) != 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    if (!writable) {
+        // A block left by another layout version may be shorter than ours
+        off_t size = lseek(fd, 0, SEEK_END);
+        if (size < (off_t)kBlockSize) {
+            ::close(fd);
+            return nullptr;
+        }
+    }
+    void* base = mmap(nullptr, kBlockSize, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);  // the mapping keeps the object alive
+    return base == MAP_FAILED ? nullptr : base;
+#endif
+}
+
+void UnmapBlock(const void* base, void* mapping)
+{
+    if (!base) return;
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+    if (mapping) CloseHandle((HANDLE)mapping);
+#else
+    (void)mapping;
+    munmap(const_cast<void*>(base), kBlockSize);
+#endif
+}
+
+inline void CpuRelax()
+{
+#if defined(_MSC_VER)
+    YieldProcessor();
+#elif defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
+std::string FieldString(const char* field, size_t size)
+{
+    return std::string(field, strnlen(field, size));
+}
+
+} // namespace
+
+std::string DefaultStatusBlockName()
+{
+#ifdef _WIN32
+    return "Local\\HadesHub_Lab4_Status";
+#else
+    return "/hadeshub_lab4_status";
+#endif
+}
+
+void CopyStatusString(char* dst, size_t dstSize, const std::string& src)
+{
+    size_t n = src.size() < dstSize - 1 ? src.size() : dstSize - 1;
+    memcpy(dst, src.data(), n);
+    memset(dst + n, 0, dstSize - n);
+}
+
+std::string StatusToJson(const Lab4Status& s)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    out << "{\"updated_unix_ms\":" << s.updatedUnixMs
+        << ",\"camera_open\":" << ((s.flags & kStatusCameraOpen) ? "true" : "false")
+        << ",\"serve\":" << ((s.flags & kStatusServe) ? "true" : "false")
+        << ",\"periodic\":" << ((s.flags & kStatusPeriodic) ? "true" : "false")
+        << ",\"periodic_interval_ms\":" << s.periodicIntervalMs
+        << ",\"passthrough\":" << ((s.flags & kStatusPassthrough) ? "true" : "false")
+        << ",\"simulated\":" << ((s.flags & kStatusSimulated) ? "true" : "false")
+        << ",\"backend\":\"" << JsonEscape(FieldString(s.backend, sizeof(s.backend))) << "\""
+        << ",\"source\":\"" << JsonEscape(FieldString(s.source, sizeof(s.source))) << "\""
+        << ",\"width\":" << s.width
+        << ",\"height\":" << s.height
+        << ",\"nominal_fps\":" << s.nominalFps
+        << ",\"fps\":" << s.fps
+        << ",\"brightness\":" << s.brightness
+        << ",\"contrast\":" << s.contrast
+        << ",\"saturation\":" << s.saturation
+        << ",\"frames_grabbed\":" << s.framesGrabbed
+        << ",\"grab_failures\":" << s.grabFailures
+        << ",\"photos_saved\":" << s.photosSaved
+        << ",\"periodic_photos\":" << s.periodicPhotos
+        << ",\"last_capture_unix_ms\":" << s.lastCaptureUnixMs
+        << ",\"last_capture_file\":\"" << JsonEscape(FieldString(s.lastCaptureFile, sizeof(s.lastCaptureFile))) << "\"}";
+    return out.str();
+}
+
+// ---------------------------------------------------------------------------
+
+StatusBlockWriter::StatusBlockWriter()
+{
+    memset(&shadow_, 0, sizeof(shadow_));
+}
+
+StatusBlockWriter::~StatusBlockWriter()
+{
+    close();
+}
+
+bool StatusBlockWriter::open(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (header_) return true;
+    {
+        std::lock_guard<std::mutex> held(g_heldMutex);
+        if (!g_held.insert(name).second) return false;
+    }
+
+    bool created = false;
+    void* base = MapBlock(name, true, mapping_, &created);
+    StatusBlockHeader* header = static_cast<StatusBlockHeader*>(base);
+
+    // Two writers would interleave their sequence counters and readers could
+    // accept torn copies, so the block is claimed first: a zero pid (fresh or
+    // released) or a dead writer's pid is swapped for ours, a live one is not.
+    uint32_t self = CurrentPid();
+    uint32_t owner = header ? header->writerPid.load(std::memory_order_acquire) : 0;
+    while (header) {
+        if (owner != 0 && owner != self && ProcessAlive(owner)) {
+            UnmapBlock(base, mapping_);
+            mapping_ = nullptr;
+            header = nullptr;
+            break;
+        }
+        if (header->writerPid.compare_exchange_weak(owner, self, std::memory_order_acq_rel)) break;
+    }
+    if (!header) {
+        // The name is someone else's, so it is never unlinked here
+        std::lock_guard<std::mutex> held(g_heldMutex);
+        g_held.erase(name);
+        return false;
+    }
+
+    header_ = header;
+    data_ = reinterpret_cast<Lab4Status*>(static_cast<char*>(base) + sizeof(StatusBlockHeader));
+    name_ = name;
+    created_ = created;
+
+    // Readers check the magic last, so they never accept a half-initialized header.
+    // A block left behind by a previous run keeps its counter running forward.
+    header_->magic = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+    uint32_t seq = header_->seq.load(std::memory_order_relaxed) | 1;
+    header_->seq.store(seq, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->version = kStatusVersion;
+    header_->size = (uint32_t)kBlockSize;
+    header_->reserved = 0;
+    shadow_.updatedUnixMs = UnixMs();
+    memcpy(data_, &shadow_, sizeof(shadow_));
+    header_->seq.store(seq + 1, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = kStatusMagic;
+    return true;
+}
+
+void StatusBlockWriter::close()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!header_) return;
+    // Hands the block to the next writer without a liveness check
+    uint32_t self = CurrentPid();
+    header_->writerPid.compare_exchange_strong(self, 0, std::memory_order_acq_rel);
+    UnmapBlock(header_, mapping_);
+    {
+        std::lock_guard<std::mutex> held(g_heldMutex);
+        g_held.erase(name_);
+    }
+#ifndef _WIN32
+    // Windows drops the mapping with its last handle; POSIX keeps it until unlinked.
+    // A block this writer only took over is left for whoever created it.
+    if (created_) shm_unlink(name_.c_str());
+#endif
+    created_ = false;
+    header_ = nullptr;
+    data_ = nullptr;
+    mapping_ = nullptr;
+}
+
+void StatusBlockWriter::update(const std::function<void(Lab4Status&)>& fn)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!header_) return;
+
+    // The callback runs on the private copy, so the odd window covers only the memcpy
+    fn(shadow_);
+    shadow_.updatedUnixMs = UnixMs();
+
+    uint32_t seq = header_->seq.load(std::memory_order_relaxed);
+    header_->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(data_, &shadow_, sizeof(shadow_));
+    header_->seq.store(seq + 2, std::memory_order_release);
+}
+
+// ---------------------------------------------------------------------------
+
+StatusBlockReader::~StatusBlockReader()
+{
+    close();
+}
+
+bool StatusBlockReader::open(const std::string& name)
+{
+    if (header_) return true;
+
+    void* base = MapBlock(name, false, mapping_);
+    if (!base) return false;
+
+    const StatusBlockHeader* header = static_cast<const StatusBlockHeader*>(base);
+    if (header->magic != kStatusMagic || header->version != kStatusVersion || header->size != kBlockSize) {
+        UnmapBlock(base, mapping_);
+        mapping_ = nullptr;
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    header_ = header;
+    data_ = reinterpret_cast<const Lab4Status*>(static_cast<const char*>(base) + sizeof(StatusBlockHeader));
+    return true;
+}
+
+void StatusBlockReader::close()
+{
+    if (!header_) return;
+    UnmapBlock(header_, mapping_);
+    header_ = nullptr;
+    data_ = nullptr;
+    mapping_ = nullptr;
+}
+
+bool StatusBlockReader::snapshot(Lab4Status& out, unsigned maxAttempts, unsigned* retries) const
+{
+    if (retries) *retries = 0;
+    if (!header_) return false;
+
+    for (unsigned attempt = 0; attempt < maxAttempts; ++attempt) {
+        uint32_t before = header_->seq.load(std::memory_order_acquire);
+        if ((before & 1) == 0) {
+            memcpy(&out, data_, sizeof(out));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (header_->seq.load(std::memory_order_relaxed) == before) return true;
+        }
+        if (retries) ++*retries;
+        // The writer may be descheduled inside its window; stop burning its CPU
+        if ((attempt & 63) == 63) {
+            std::this_thread::yield();
+        } else {
+            CpuRelax();
+        }
+    }
+    return false;
+}
+
+uint32_t StatusBlockReader::writerPid() const
+{
+    return header_ ? header_->writerPid.load(std::memory_order_relaxed) : 0;
+}
@@ -0,0 +1,124 @@
+// Shared-memory status block of lab4
+//
+// lab4 publishes its live state in a small named mapping ("/hadeshub_lab4_status"
+// via shm_open on POSIX, "Local\HadesHub_Lab4_Status" via CreateFileMapping on
+// Windows). A single writer updates it under a sequence lock: the counter is odd
+// while an update is in progress, so a reader copies the struct and keeps the
+// copy only if the counter was even and unchanged around the copy. Readers never
+// block the writer and take no locks or syscalls per snapshot.
+#ifndef STATUS_BLOCK_H
+#define STATUS_BLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "the sequence counter is shared between processes and must be lock-free");
+
+enum Lab4StatusFlags {
+    kStatusCameraOpen  = 1 << 0,
+    kStatusServe       = 1 << 1,
+    kStatusPeriodic    = 1 << 2,   // periodic (hidden mode) capture running
+    kStatusPassthrough = 1 << 3,   // MJPEG buffers saved without re-encoding
+    kStatusSimulated   = 1 << 4    // file-backed source instead of a camera
+};
+
+// Fixed layout shared by every reader: sized integer types only, no pointers
+struct Lab4Status {
+    uint64_t updatedUnixMs;
+    uint64_t lastCaptureUnixMs;
+    uint64_t framesGrabbed;
+    uint64_t grabFailures;
+    uint64_t photosSaved;
+    uint64_t periodicPhotos;
+    double fps;                  // measured by the grabber
+    double nominalFps;           // CAP_PROP_FPS
+    double brightness;
+    double contrast;
+    double saturation;
+    int32_t width;
+    int32_t height;
+    uint32_t flags;              // Lab4StatusFlags
+    int32_t periodicIntervalMs;
+    char backend[32];
+    char source[128];
+    char lastCaptureFile[256];
+};
+
+struct StatusBlockHeader {
+    uint32_t magic;              // kStatusMagic once the writer has initialized the block
+    uint32_t version;
+    uint32_t size;               // sizeof(StatusBlockHeader) + sizeof(Lab4Status)
+    std::atomic<uint32_t> writerPid;   // owner of the block; 0 once it has closed it
+    std::atomic<uint32_t> seq;
+    uint32_t reserved;
+};
+
+const uint32_t kStatusMagic = 0x5453344C;  // "L4ST"
+const uint32_t kStatusVersion = 1;
+
+std::string DefaultStatusBlockName();
+
+// Bounded copy into one of the fixed char fields, always NUL-terminated
+void CopyStatusString(char* dst, size_t dstSize, const std::string& src);
+
+// {"updated_unix_ms":..,"camera_open":..,"width":..,...}
+std::string StatusToJson(const Lab4Status& status);
+
+class StatusBlockWriter {
+public:
+    StatusBlockWriter();
+    ~StatusBlockWriter();
+    StatusBlockWriter(const StatusBlockWriter&) = delete;
+    StatusBlockWriter& operator=(const StatusBlockWriter&) = delete;
+
+    // Creates the named block, or takes over one whose writer has closed it or
+    // died, and publishes an empty status. Fails while another writer, in this
+    // process or a live other one, holds the block. close() removes the name
+    // only if this writer created it.
+    bool open(const std::string& name = DefaultStatusBlockName());
+    void close();
+    bool isOpen() const { return header_ != nullptr; }
+
+    // Applies fn to the writer's copy of the status and publishes the result;
+    // callers on different threads are serialized. No-op while closed.
+    void update(const std::function<void(Lab4Status&)>& fn);
+
+private:
+    std::mutex mutex_;
+    Lab4Status shadow_;
+    StatusBlockHeader* header_ = nullptr;
+    Lab4Status* data_ = nullptr;
+    std::string name_;
+    void* mapping_ = nullptr;    // Windows mapping handle
+    bool created_ = false;       // the block did not exist before open()
+};
+
+class StatusBlockReader {
+public:
+    StatusBlockReader() = default;
+    ~StatusBlockReader();
+    StatusBlockReader(const StatusBlockReader&) = delete;
+    StatusBlockReader& operator=(const StatusBlockReader&) = delete;
+
+    // Maps an existing block read-only; false if it does not exist or has a different layout
+    bool open(const std::string& name = DefaultStatusBlockName());
+    void close();
+    bool isOpen() const { return header_ != nullptr; }
+
+    // Consistent copy of the status; retries while an update is in flight and
+    // gives up after maxAttempts. retries (optional) receives the number of
+    // discarded copies.
+    bool snapshot(Lab4Status& out, unsigned maxAttempts = 100000, unsigned* retries = nullptr) const;
+
+    uint32_t writerPid() const;
+
+private:
+    const StatusBlockHeader* header_ = nullptr;
+    const Lab4Status* data_ = nullptr;
+    void* mapping_ = nullptr;
+};
+
+#endif // STATUS_BLOCK_H
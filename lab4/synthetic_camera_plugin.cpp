@@ -0,0 +1,412 @@
+// Synthetic camera for lab4, written as an OpenCV videoio capture plugin
+//
+// The capture entry points are the ones plugin_capture_api.hpp defines, so
+// this file builds unchanged into an opencv_videoio_* plugin module. OpenCV
+// only loads plugins for backends its registry knows by id, though, so lab4
+// links it in and drives the same function table itself (plugin_capture.h).
+//
+// Source spec: "synthetic[:WxH[@fps]][:option...]" with options
+//   noise=<sigma>     gaussian sensor noise, grey levels (default 4)
+//   ramp=<levels>     brightness swings +-levels over ramp_period frames
+//   ramp_period=<n>   (default 300)
+//   pattern=bar|checker|flat   moving pattern (default bar)
+//   speed=<px>        pattern movement per frame (default 4)
+//   mjpg              frames are JPEG; raw buffers with CAP_PROP_FORMAT=-1
+//                     or CAP_PROP_CONVERT_RGB=0, decoded otherwise
+//   frames=<n>        end of stream after n frames (default endless)
+//   nopace            hand out frames as fast as they are asked for
+//   drop=<n>          every n-th frame is lost, as if the device dropped it
+//   jitter=<ms>       a paced frame is handed out up to ms late (uniform);
+//                     its timestamp stays on schedule
+// Frame i carries the timestamp i * 1000 / fps ms exactly (CAP_PROP_POS_MSEC)
+// and is the same on every run. A paced reader that falls behind skips
+// frames the way a camera drops them, so gaps show up in the frame index.
+#define BUILD_PLUGIN 1
+#define CAPTURE_ABI_VERSION 1
+#define CAPTURE_API_VERSION 2
+#include "opencv-4.12.0/modules/videoio/src/plugin_capture_api.hpp"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Not an OpenCV VideoCaptureAPIs value: ("S" << 8) | "Y"
+const int kSyntheticCaptureId = 0x5359;
+
+struct SyntheticSpec {
+    int width = 640;
+    int height = 480;
+    double fps = 30.0;
+    double noise = 4.0;
+    double ramp = 0.0;
+    int rampPeriod = 300;
+    std::string pattern = "bar";
+    int speed = 4;
+    bool mjpg = false;
+    long long frames = -1;
+    bool pace = true;
+    int drop = 0;
+    double jitterMs = 0.0;
+};
+
+bool parse_spec(const char* text, SyntheticSpec& spec)
+{
+    std::string s(text ? text : "");
+    if (s.compare(0, 9, "synthetic") != 0 || (s.size() > 9 && s[9] != ':')) {
+        return false;
+    }
+    size_t pos = 9;
+    bool first = true;
+    while (pos < s.size()) {
+        size_t end = s.find(':', pos + 1);
+        std::string item = s.substr(pos + 1, end == std::string::npos ? std::string::npos : end - pos - 1);
+        pos = end == std::string::npos ? s.size() : end;
+        if (item.empty()) {
+            continue;
+        }
+        int w = 0, h = 0;
+        double fps = 0;
+        char tail = 0;
+        if (first && sscanf(item.c_str(), "%dx%d%c", &w, &h, &tail) >= 2) {
+            if (w <= 0 || h <= 0 || (tail && tail != '@')) {
+                return false;
+            }
+            spec.width = w;
+            spec.height = h;
+            if (tail == '@') {
+                if (sscanf(item.c_str(), "%dx%d@%lf", &w, &h, &fps) != 3 || fps <= 0) {
+                    return false;
+                }
+                spec.fps = fps;
+            }
+            first = false;
+            continue;
+        }
+        first = false;
+        size_t eq = item.find('=');
+        std::string key = item.substr(0, eq);
+        std::string value = eq == std::string::npos ? std::string() : item.substr(eq + 1);
+        if (key == "noise") spec.noise = atof(value.c_str());
+        else if (key == "ramp") spec.ramp = atof(value.c_str());
+        else if (key == "ramp_period") spec.rampPeriod = std::max(1, atoi(value.c_str()));
+        else if (key == "pattern" && (value == "bar" || value == "checker" || value == "flat")) spec.pattern = value;
+        else if (key == "speed") spec.speed = atoi(value.c_str());
+        else if (key == "mjpg") spec.mjpg = true;
+        else if (key == "frames") spec.frames = atoll(value.c_str());
+        else if (key == "nopace") spec.pace = false;
+        else if (key == "drop") spec.drop = std::max(0, atoi(value.c_str()));
+        else if (key == "jitter") spec.jitterMs = std::max(0.0, atof(value.c_str()));
+        else return false;
+    }
+    return true;
+}
+
+class SyntheticCamera {
+public:
+    explicit SyntheticCamera(const SyntheticSpec& spec) : spec_(spec)
+    {
+        // Everything random is made here, once: a frame is then a few
+        // saturating adds and a rectangle fill
+        base_.create(spec_.height, spec_.width, CV_8UC3);
+        for (int y = 0; y < spec_.height; y++) {
+            cv::Vec3b* row = base_.ptr<cv::Vec3b>(y);
+            for (int x = 0; x < spec_.width; x++) {
+                row[x] = cv::Vec3b((uchar)(40 + x * 150 / spec_.width), (uchar)(60 + y * 130 / spec_.height), 110);
+            }
+        }
+        cv::RNG rng(0x5359);
+        noise_.resize(spec_.noise > 0 ? 16 : 0);
+        for (size_t i = 0; i < noise_.size(); i++) {
+            noise_[i].create(spec_.height, spec_.width, CV_16SC3);
+            rng.fill(noise_[i], cv::RNG::NORMAL, cv::Scalar::all(0), cv::Scalar::all(spec_.noise));
+        }
+        interval_ = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / spec_.fps));
+        start_ = Clock::now();
+    }
+
+    bool grab()
+    {
+        for (;;) {
+            if (spec_.frames >= 0 && next_ >= spec_.frames) {
+                return false;
+            }
+            if (spec_.pace) {
+                // Like a device with a one-frame buffer: a reader that fell behind
+                // gets the current frame, the ones it missed are gone
+                Clock::time_point now = Clock::now();
+                Clock::time_point due = start_ + interval_ * next_;
+                if (now < due) {
+                    std::this_thread::sleep_until(due);
+                } else {
+                    next_ = std::max(next_, (long long)((now - start_) / interval_));
+                }
+            }
+            index_ = next_++;
+            if (spec_.drop > 0 && (index_ + 1) % spec_.drop == 0) {
+                continue;
+            }
+            break;
+        }
+        if (spec_.pace && spec_.jitterMs > 0.0) {
+            std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(jitterRng_.uniform(0.0, spec_.jitterMs)));
+        }
+        rendered_ = false;
+        return true;
+    }
+
+    // The frame grab() moved to; rendered on first use
+    const cv::Mat& frame()
+    {
+        if (!rendered_) {
+            render(index_, frame_);
+            if (spec_.mjpg) {
+                cv::imencode(".jpg", frame_, jpeg_, std::vector<int>{ cv::IMWRITE_JPEG_QUALITY, 85 });
+            }
+            rendered_ = true;
+        }
+        return frame_;
+    }
+
+    const std::vector<uchar>& jpeg()
+    {
+        frame();
+        return jpeg_;
+    }
+
+    // What a decoding backend returns: an MJPG source pays for the decode
+    const cv::Mat& pixels()
+    {
+        if (!spec_.mjpg) {
+            return frame();
+        }
+        decoded_ = cv::imdecode(jpeg(), cv::IMREAD_COLOR);
+        return decoded_;
+    }
+
+    bool raw() const { return spec_.mjpg && raw_; }
+
+    bool get(int prop, double& value) const
+    {
+        switch (prop) {
+        case cv::CAP_PROP_FRAME_WIDTH: value = spec_.width; return true;
+        case cv::CAP_PROP_FRAME_HEIGHT: value = spec_.height; return true;
+        case cv::CAP_PROP_FPS: value = spec_.fps; return true;
+        case cv::CAP_PROP_POS_FRAMES: value = (double)next_; return true;
+        case cv::CAP_PROP_POS_MSEC: value = index_ * 1000.0 / spec_.fps; return true;
+        case cv::CAP_PROP_FRAME_COUNT: value = (double)spec_.frames; return true;
+        case cv::CAP_PROP_FOURCC:
+            value = spec_.mjpg ? cv::VideoWriter::fourcc('M', 'J', 'P', 'G') : cv::VideoWriter::fourcc('B', 'G', 'R', '3');
+            return true;
+        case cv::CAP_PROP_FORMAT: value = raw() ? -1 : CV_8UC3; return true;
+        case cv::CAP_PROP_CONVERT_RGB: value = raw() ? 0 : 1; return true;
+        default: return false;
+        }
+    }
+
+    bool set(int prop, double value)
+    {
+        switch (prop) {
+        case cv::CAP_PROP_FORMAT:
+            raw_ = value < 0;
+            return spec_.mjpg || !raw_;
+        case cv::CAP_PROP_CONVERT_RGB:
+            raw_ = value == 0;
+            return spec_.mjpg || !raw_;
+        case cv::CAP_PROP_POS_FRAMES:
+            // The schedule restarts from the new position instead of bursting
+            next_ = value < 0 ? 0 : (long long)value;
+            start_ = Clock::now() - interval_ * next_;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    void render(long long i, cv::Mat& out) const
+    {
+        double offset = 0.0;
+        if (spec_.ramp != 0.0) {
+            // Triangle wave: up and down once per period
+            double phase = (double)(i % spec_.rampPeriod) / spec_.rampPeriod;
+            offset = spec_.ramp * (phase < 0.5 ? 4 * phase - 1 : 3 - 4 * phase);
+        }
+        if (noise_.empty()) {
+            cv::add(base_, cv::Scalar::all(offset), out);
+        } else {
+            cv::add(base_, noise_[(size_t)(i % (long long)noise_.size())], out, cv::noArray(), CV_8UC3);
+            if (offset != 0.0) {
+                cv::add(out, cv::Scalar::all(offset), out);
+            }
+        }
+        int w = spec_.width, h = spec_.height;
+        long long shift = i * spec_.speed;
+        if (spec_.pattern == "bar") {
+            int bar = std::max(1, w / 12);
+            int x = (int)(shift % (w + bar)) - bar;
+            cv::rectangle(out, cv::Rect(x, 0, bar, h), cv::Scalar(235, 235, 235), cv::FILLED);
+        } else if (spec_.pattern == "checker") {
+            int cell = std::max(8, w / 16);
+            int dx = (int)(shift % (2 * cell));
+            for (int y = 0; y < h; y += cell) {
+                for (int x = -2 * cell + dx; x < w; x += 2 * cell) {
+                    int cx = x + ((y / cell) % 2) * cell;
+                    cv::rectangle(out, cv::Rect(cx, y, cell, cell), cv::Scalar(20, 20, 20), cv::FILLED);
+                }
+            }
+        }
+    }
+
+    SyntheticSpec spec_;
+    cv::Mat base_;
+    std::vector<cv::Mat> noise_;
+    cv::Mat frame_;
+    cv::Mat decoded_;
+    std::vector<uchar> jpeg_;
+    bool rendered_ = false;
+    bool raw_ = false;
+    long long next_ = 0;
+    long long index_ = 0;
+    cv::RNG jitterRng_{ 0x4a49 };
+    Clock::duration interval_;
+    Clock::time_point start_;
+};
+
+CvResult CV_API_CALL cv_capture_open_with_params(const char* filename, int camera_index,
+                                                  int* params, unsigned n_params, CV_OUT CvPluginCapture* handle)
+{
+    (void)camera_index;
+    if (!handle) {
+        return CV_ERROR_FAIL;
+    }
+    *handle = NULL;
+    SyntheticSpec spec;
+    if (!parse_spec(filename, spec)) {
+        return CV_ERROR_FAIL;
+    }
+    SyntheticCamera* camera = NULL;
+    try {
+        camera = new SyntheticCamera(spec);
+        for (unsigned i = 0; params && i < n_params; i++) {
+            camera->set(params[2 * i], params[2 * i + 1]);
+        }
+    } catch (...) {
+        delete camera;
+        return CV_ERROR_FAIL;
+    }
+    *handle = (CvPluginCapture)camera;
+    return CV_ERROR_OK;
+}
+
+CvResult CV_API_CALL cv_capture_open(const char* filename, int camera_index, CV_OUT CvPluginCapture* handle)
+{
+    return cv_capture_open_with_params(filename, camera_index, NULL, 0, handle);
+}
+
+CvResult CV_API_CALL cv_capture_open_stream(void*, long long (*)(void*, char*, long long),
+                                             long long (*)(void*, long long, int), int*, unsigned,
+                                             CV_OUT CvPluginCapture* handle)
+{
+    if (handle) {
+        *handle = NULL;
+    }
+    return CV_ERROR_FAIL;
+}
+
+CvResult CV_API_CALL cv_capture_release(CvPluginCapture handle)
+{
+    delete (SyntheticCamera*)handle;
+    return CV_ERROR_OK;
+}
+
+CvResult CV_API_CALL cv_capture_get_prop(CvPluginCapture handle, int prop, CV_OUT double* val)
+{
+    if (!handle || !val) {
+        return CV_ERROR_FAIL;
+    }
+    return ((SyntheticCamera*)handle)->get(prop, *val) ? CV_ERROR_OK : CV_ERROR_FAIL;
+}
+
+CvResult CV_API_CALL cv_capture_set_prop(CvPluginCapture handle, int prop, double val)
+{
+    if (!handle) {
+        return CV_ERROR_FAIL;
+    }
+    return ((SyntheticCamera*)handle)->set(prop, val) ? CV_ERROR_OK : CV_ERROR_FAIL;
+}
+
+CvResult CV_API_CALL cv_capture_grab(CvPluginCapture handle)
+{
+    if (!handle) {
+        return CV_ERROR_FAIL;
+    }
+    return ((SyntheticCamera*)handle)->grab() ? CV_ERROR_OK : CV_ERROR_FAIL;
+}
+
+CvResult CV_API_CALL cv_capture_retrieve(CvPluginCapture handle, int stream_idx,
+                                         cv_videoio_capture_retrieve_cb_t callback, void* userdata)
+{
+    if (!handle || !callback) {
+        return CV_ERROR_FAIL;
+    }
+    try {
+        SyntheticCamera* camera = (SyntheticCamera*)handle;
+        if (camera->raw()) {
+            const std::vector<uchar>& jpeg = camera->jpeg();
+            return callback(stream_idx, jpeg.data(), (int)jpeg.size(), (int)jpeg.size(), 1, CV_8UC1, userdata);
+        }
+        const cv::Mat& frame = camera->pixels();
+        return callback(stream_idx, frame.data, (int)frame.step, frame.cols, frame.rows, frame.type(), userdata);
+    } catch (...) {
+        return CV_ERROR_FAIL;
+    }
+}
+
+const OpenCV_VideoIO_Capture_Plugin_API capture_plugin_api =
+{
+    {
+        sizeof(OpenCV_VideoIO_Capture_Plugin_API), CAPTURE_ABI_VERSION, CAPTURE_API_VERSION,
+        CV_VERSION_MAJOR, CV_VERSION_MINOR, CV_VERSION_REVISION, CV_VERSION_STATUS,
+        "lab4 synthetic camera capture plugin"
+    },
+    {
+        /*  1*/kSyntheticCaptureId,
+        /*  2*/cv_capture_open,
+        /*  3*/cv_capture_release,
+        /*  4*/cv_capture_get_prop,
+        /*  5*/cv_capture_set_prop,
+        /*  6*/cv_capture_grab,
+        /*  7*/cv_capture_retrieve,
+    },
+    {
+        /*  8*/cv_capture_open_with_params,
+    },
+    {
+        /*  9*/cv_capture_open_stream,
+    }
+};
+
+} // namespace
+
+const OpenCV_VideoIO_Capture_Plugin_API* CV_API_CALL opencv_videoio_capture_plugin_init_v1(
+        int requested_abi_version, int requested_api_version, void* /*reserved=NULL*/) CV_NOEXCEPT
+{
+    if (requested_abi_version == CAPTURE_ABI_VERSION && requested_api_version <= CAPTURE_API_VERSION) {
+        return &capture_plugin_api;
+    }
+    return NULL;
+}
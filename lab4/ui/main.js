@@ -108,6 +108,9 @@ app.whenReady().then(() => {
 });
 
 app.on('window-all-closed', () => {
+  if (cameraServer) {
+    cameraServer.stdin.write('quit\n');
+  }
   if (process.platform !== 'darwin') {
     app.quit();
   }
@@ -509,35 +512,122 @@ ipcMain.handle('save-js-photo', async (event, imageData) => {
 });
 
 
-ipcMain.handle('get-camera-info', async () => {
-  return new Promise((resolve, reject) => {
-    // Путь к исполняемому файлу C++
-    const cppExePath = path.join(__dirname, '..', 'main.exe');
+// Долгоживущий процесс "main.exe serve": камера открывается один раз и остаётся тёплой,
+// запросы идут строками "<id> <команда>", ответы - JSON-строки с тем же id
+let cameraServer = null;
+let cameraServerNextId = 1;
+const cameraServerPending = new Map();
 
-    // Запускаем C++ приложение для получения информации о камерах
-    const child = spawn(cppExePath, ['info'], { cwd: path.dirname(cppExePath) });
+function getCameraServer() {
+  if (cameraServer) {
+    return cameraServer;
+  }
 
-    let output = '';
-    let errorOutput = '';
+  const cppExePath = path.join(__dirname, '..', 'main.exe');
+  cameraServer = spawn(cppExePath, ['serve'], { cwd: path.dirname(cppExePath) });
+
+  // Вывод разбирается как байты: за записью "live" идут bytes байт JPEG и перевод строки
+  let buffered = Buffer.alloc(0);
+  cameraServer.stdout.on('data', (data) => {
+    buffered = buffered.length ? Buffer.concat([buffered, data]) : data;
+    let start = 0;
+    let newline;
+    while ((newline = buffered.indexOf(0x0a, start)) >= 0) {
+      const line = buffered.toString('utf8', start, newline).trim();
+      let next = newline + 1;
+      if (!line) {
+        start = next;
+        continue;
+      }
+      let reply = null;
+      try {
+        reply = JSON.parse(line);
+      } catch (e) {
+        console.error('Unexpected camera server output:', line);
+      }
+      if (reply && reply.event === 'live') {
+        if (buffered.length < next + reply.bytes + 1) {
+          break;  // кадр ещё не пришёл целиком
+        }
+        const jpeg = Buffer.from(buffered.subarray(next, next + reply.bytes));
+        next += reply.bytes + 1;
+        if (mainWindow) {
+          mainWindow.webContents.send('live-frame', reply, jpeg);
+        }
+      } else if (reply) {
+        const pending = reply.id && cameraServerPending.get(reply.id);
+        if (pending) {
+          cameraServerPending.delete(reply.id);
+          pending.resolve(reply);
+        }
+      }
+      start = next;
+    }
+    buffered = buffered.subarray(start);
+  });
 
-    child.stdout.on('data', (data) => {
-      output += data.toString();
-    });
+  cameraServer.stderr.on('data', (data) => {
+    console.log(`[camera server] ${data}`);
+  });
 
-    child.stderr.on('data', (data) => {
-      errorOutput += data.toString();
-    });
+  const failPending = (message) => {
+    for (const pending of cameraServerPending.values()) {
+      pending.reject(new Error(message));
+    }
+    cameraServerPending.clear();
+    cameraServer = null;
+  };
+  cameraServer.on('close', (code) => failPending(`Camera server exited with code ${code}`));
+  cameraServer.on('error', (err) => failPending(`Failed to start camera server: ${err.message}`));
 
-    child.on('close', (code) => {
-      if (code === 0) {
-        resolve(output);
-      } else {
-        resolve(`Error getting camera info: ${errorOutput || 'Unknown error'}`);
-      }
-    });
+  return cameraServer;
+}
 
-    child.on('error', (err) => {
-      reject(new Error(`Failed to get camera info: ${err.message}`));
+function cameraRequest(command, timeoutMs = 15000) {
+  return new Promise((resolve, reject) => {
+    const server = getCameraServer();
+    const id = String(cameraServerNextId++);
+    const timer = setTimeout(() => {
+      cameraServerPending.delete(id);
+      reject(new Error(`Camera server did not answer "${command}"`));
+    }, timeoutMs);
+    cameraServerPending.set(id, {
+      resolve: (reply) => { clearTimeout(timer); resolve(reply); },
+      reject: (err) => { clearTimeout(timer); reject(err); }
     });
+    server.stdin.write(`${id} ${command}\n`);
   });
-});
\ No newline at end of file
+}
+
+// Живой предпросмотр от backend: камеру держит только он, renderer не открывает её сам
+ipcMain.handle('start-live-preview', async (event, maxSide) => {
+  const reply = await cameraRequest(`live on ${maxSide || 1280}`);
+  if (!reply.ok) {
+    throw new Error(reply.error || 'Unknown error');
+  }
+  return reply.result;
+});
+
+ipcMain.handle('stop-live-preview', async () => {
+  const reply = await cameraRequest('live off');
+  return reply.result;
+});
+
+// Кадр показан: backend подстраивает размер, качество и частоту под то, как быстро их забирают
+ipcMain.on('live-frame-shown', (event, seq) => {
+  if (cameraServer) {
+    cameraServer.stdin.write(`ack live_ack ${seq}\n`);
+  }
+});
+
+ipcMain.handle('get-camera-info', async () => {
+  try {
+    const reply = await cameraRequest('info');
+    if (!reply.ok) {
+      return `Error getting camera info: ${reply.error || 'Unknown error'}`;
+    }
+    return JSON.stringify(reply.result);
+  } catch (err) {
+    throw new Error(`Failed to get camera info: ${err.message}`);
+  }
+});
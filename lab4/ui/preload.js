@@ -19,6 +19,12 @@ contextBridge.exposeInMainWorld('electronAPI', {
     // System info
     getCameraInfo: () => ipcRenderer.invoke('get-camera-info'),
 
+    // Live preview from the C++ backend
+    startLivePreview: (maxSide) => ipcRenderer.invoke('start-live-preview', maxSide),
+    stopLivePreview: () => ipcRenderer.invoke('stop-live-preview'),
+    onLiveFrame: (callback) => ipcRenderer.on('live-frame', callback),
+    liveFrameShown: (seq) => ipcRenderer.send('live-frame-shown', seq),
+
     // Hidden mode event listeners
     onStartHiddenModeCapture: (callback) => ipcRenderer.on('start-hidden-mode-capture', callback),
     onCapturePhotoInHiddenMode: (callback) => ipcRenderer.on('capture-photo-in-hidden-mode', callback),
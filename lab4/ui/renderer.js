@@ -30,6 +30,8 @@ document.addEventListener('DOMContentLoaded', function() {
     let isHiddenMode = false;
     let stream = null;
     let currentCameraId = null;
+    // True when the preview comes from the C++ backend, which then is the only one holding the camera
+    let backendPreview = false;
 
     // Get additional elements
     const refreshCameraInfoBtn = document.getElementById('refresh-camera-info');
@@ -105,7 +107,12 @@ document.addEventListener('DOMContentLoaded', function() {
                 audio: false
             };
 
-            stream = await navigator.mediaDevices.getUserMedia(constraints);
+            stream = await startBackendPreview();
+            if (stream) {
+                backendPreview = true;
+            } else {
+                stream = await navigator.mediaDevices.getUserMedia(constraints);
+            }
             webcamPreview.srcObject = stream;
 
             // Update status
@@ -142,9 +149,66 @@ document.addEventListener('DOMContentLoaded', function() {
         }, 10000);
     }
 
+    // Live preview from the C++ backend: its JPEG frames are drawn into a canvas whose
+    // stream becomes the preview's srcObject, so photo capture and hidden mode work on
+    // it the same way as on a camera stream. Every drawn frame is acked; the backend
+    // adapts size, quality and frame rate to how fast the acks come back.
+    async function startBackendPreview() {
+        if (!window.electronAPI || !window.electronAPI.startLivePreview) {
+            return null;
+        }
+        const canvas = document.createElement('canvas');
+        canvas.width = 1280;
+        canvas.height = 720;
+        const ctx = canvas.getContext('2d');
+        window.electronAPI.onLiveFrame(async (event, frame, jpeg) => {
+            try {
+                const bitmap = await createImageBitmap(new Blob([jpeg], { type: 'image/jpeg' }));
+                // The canvas keeps the largest size seen, lower levels are scaled up into it
+                if (bitmap.width > canvas.width || bitmap.height > canvas.height) {
+                    canvas.width = bitmap.width;
+                    canvas.height = bitmap.height;
+                }
+                ctx.drawImage(bitmap, 0, 0, canvas.width, canvas.height);
+                bitmap.close();
+            } catch (error) {
+                console.warn('Could not draw live frame:', error);
+            } finally {
+                window.electronAPI.liveFrameShown(frame.seq);
+            }
+        });
+        try {
+            await window.electronAPI.startLivePreview(1280);
+        } catch (error) {
+            console.warn('Backend live preview unavailable, using getUserMedia:', error);
+            return null;
+        }
+        return canvas.captureStream();
+    }
+
+    // Camera info from the backend; opening the device here would take it away from the backend
+    async function getBackendCameraInfo() {
+        const lang = localStorage.getItem('lang') || 'en';
+        const camera = JSON.parse(await window.electronAPI.getCameraInfo()).camera_info;
+        const resolutionText = lang === 'en' ? 'Current resolution:' : 'Текущее разрешение:';
+        const frameRateText = lang === 'en' ? 'Frame rate:' : 'Частота кадров:';
+        const backendText = lang === 'en' ? 'Backend:' : 'Бэкенд:';
+        let info = `<h4>${camera.name}</h4>`;
+        info += `<p><b>${resolutionText}</b> ${camera.width} x ${camera.height}</p>`;
+        info += `<p><b>${frameRateText}</b> ${Math.round(camera.timing && camera.timing.fps ? camera.timing.fps : camera.fps)} FPS</p>`;
+        info += `<p><b>${backendText}</b> ${camera.backend}</p>`;
+        webcamInfo.innerHTML = info;
+    }
+
     async function getCameraInfo() {
         try {
             const lang = localStorage.getItem('lang') || 'en';
+            // Under Electron the backend holds the camera as soon as it is asked anything, so the
+            // probing below (a getUserMedia stream per device) is only for a plain browser
+            if (window.electronAPI && window.electronAPI.getCameraInfo) {
+                await getBackendCameraInfo();
+                return;
+            }
 
             const devices = await navigator.mediaDevices.enumerateDevices();
             const videoDevices = devices.filter(device => device.kind === 'videoinput');
@@ -614,5 +678,8 @@ document.addEventListener('DOMContentLoaded', function() {
             const tracks = stream.getTracks();
             tracks.forEach(track => track.stop());
         }
+        if (backendPreview) {
+            window.electronAPI.stopLivePreview();
+        }
     });
 });
\ No newline at end of file
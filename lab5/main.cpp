@@ -17,6 +17,10 @@
 #include <algorithm>
 #include <io.h>
 
+#include "../common/perf_stats.h"
+#include "../common/hal.h"
+#include "usb_topology.h"
+
 // Define the GUIDs directly
 static const GUID GUID_DEVCLASS_DISKDRIVE = {0x4d36e967, 0xe325, 0x11ce, {0xbf, 0xc1, 0x08, 0x00, 0x2b, 0xe1, 0x03, 0x18}};
 static const GUID GUID_DEVINTERFACE_HID = {0x4d1e55b2, 0xf16f, 0x11cf, {0x88, 0xcb, 0x00, 0x11, 0x11, 0x00, 0x00, 0x30}};
@@ -41,10 +45,25 @@ std::map<std::string, USBDeviceInfo> g_connectedUSBDevices;
 std::vector<std::string> g_safeRemovalFailures;
 std::vector<std::string> g_usbEventLog;
 CRITICAL_SECTION g_usbCriticalSection;
+// Serializes stdout between the status loop and the command listener
+CRITICAL_SECTION g_outputCriticalSection;
+
+// Latency of the enumeration and eject paths; "perf" rides along every 10th status record
+PerfMetric g_perfGetConnectedUSBDevices("getConnectedUSBDevices");
+PerfMetric g_perfSafeEjectUSBDevice("safeEjectUSBDevice");
+int g_recordsSincePerf = 0;
 
 // For tracking previous state to detect changes
 std::map<std::string, USBDeviceInfo> g_previousUSBDevices;
 
+// Device lists come through the HAL: live, recorded to a trace or replayed from one
+HalSession g_hal;
+
+// Hub/port tree with link speeds, read from sysfs; --sysfs-root points it at
+// another tree (a copy taken on a Linux machine, or a fixture)
+std::string g_sysfsRoot = "/sys";
+UsbTopology* g_usbTopology = NULL;
+
 // Function to get device friendly name using SetupAPI
 std::string getDeviceFriendlyName(const std::string& devicePath) {
     // Try to get the volume information first
@@ -399,6 +418,7 @@ const device_info get_device_info(char letter) {
 
 // Function to safely eject a USB device using Windows SetupAPI
 bool safeEjectUSBDevice(const std::string& driveLetter) {
+    PerfScope perfScope(g_perfSafeEjectUSBDevice);
     try {
         // Get the drive letter character
         char letter = driveLetter[0];
@@ -674,6 +694,7 @@ DEVINST __devinst_from_string(PCSTR pszDeviceInstanceId) {
 
 // Function to get all connected USB devices (both storage and non-storage)
 std::vector<USBDeviceInfo> getConnectedUSBDevices() {
+    PerfScope perfScope(g_perfGetConnectedUSBDevices);
     std::vector<USBDeviceInfo> usbDevices;
 
     // First, get storage devices as before
@@ -856,6 +877,55 @@ std::vector<USBDeviceInfo> getConnectedUSBDevices() {
     return usbDevices;
 }
 
+// USB channel of the HAL: one snapshot is the device list of one status record
+typedef std::vector<USBDeviceInfo> USBSnapshot;
+
+class LiveUSBSource : public HalSource<USBSnapshot> {
+public:
+    bool read(USBSnapshot& out) override {
+        out = getConnectedUSBDevices();
+        return true;
+    }
+};
+
+static void encodeUSBSnapshot(HalEncoder& e, const USBSnapshot& devices) {
+    e.u64(devices.size());
+    for (const auto& d : devices) {
+        e.str(d.devicePath);
+        e.str(d.deviceName);
+        e.str(d.driveLetter);
+        e.boolean(d.isStorageDevice);
+        e.boolean(d.isMountedAsCDROM);
+        e.boolean(d.isMountedAsFlash);
+        e.str(d.volumePath);
+        e.str(d.friendlyName);
+        e.str(d.hardwareId);
+        e.str(d.deviceInstanceId);
+        e.boolean(d.isSafeToEject);
+    }
+}
+
+static bool decodeUSBSnapshot(HalDecoder& dec, USBSnapshot& devices) {
+    uint64_t count = dec.u64();
+    devices.clear();
+    for (uint64_t i = 0; i < count && dec.ok(); ++i) {
+        USBDeviceInfo d;
+        d.devicePath = dec.str();
+        d.deviceName = dec.str();
+        d.driveLetter = dec.str();
+        d.isStorageDevice = dec.boolean();
+        d.isMountedAsCDROM = dec.boolean();
+        d.isMountedAsFlash = dec.boolean();
+        d.volumePath = dec.str();
+        d.friendlyName = dec.str();
+        d.hardwareId = dec.str();
+        d.deviceInstanceId = dec.str();
+        d.isSafeToEject = dec.boolean();
+        devices.push_back(d);
+    }
+    return dec.ok();
+}
+
 // Helper function to escape JSON special characters
 std::string escapeJsonString(const std::string& input) {
     std::string output;
@@ -884,10 +954,88 @@ std::string escapeJsonString(const std::string& input) {
     return output;
 }
 
+static void appendTopologyNode(std::ostringstream& ss, const UsbTopology& topology, const std::string& name) {
+    const UsbTopologyNode& d = topology.devices().at(name);
+    ss << "{\"name\":\"" << escapeJsonString(d.name) << "\",\"port\":" << d.port
+       << ",\"vid\":\"" << escapeJsonString(d.vendorId) << "\",\"pid\":\"" << escapeJsonString(d.productId)
+       << "\",\"manufacturer\":\"" << escapeJsonString(d.manufacturer) << "\",\"product\":\"" << escapeJsonString(d.product)
+       << "\",\"version\":\"" << escapeJsonString(d.version) << "\",\"speed_mbps\":" << d.speedMbps
+       << ",\"max_speed_mbps\":" << d.maxSpeedMbps << ",\"share_mbps\":" << d.shareMbps
+       << ",\"max_power_ma\":" << d.maxPowerMa << ",\"hub\":" << (d.isHub ? "true" : "false");
+    if (d.isHub) ss << ",\"ports\":" << d.ports << ",\"downstream_power_ma\":" << d.downstreamPowerMa;
+    ss << ",\"below_capability\":" << (d.belowCapability ? "true" : "false");
+    if (d.belowCapability) {
+        ss << ",\"limited_by\":\"" << escapeJsonString(d.limitedBy) << "\",\"reason\":\"" << escapeJsonString(d.limitReason) << "\"";
+    }
+    if (d.isHub) {
+        ss << ",\"children\":[";
+        std::vector<std::string> children = topology.children(name);
+        for (size_t i = 0; i < children.size(); ++i) {
+            if (i) ss << ",";
+            appendTopologyNode(ss, topology, children[i]);
+        }
+        ss << "]";
+    }
+    ss << "}";
+}
+
+// {"buses":[{"bus":2,"controller":...,"mbps":5000,"devices":[<root hub's children, nested>]}],"below_capability":[...]}
+static std::string usbTopologyJson(const UsbTopology& topology) {
+    std::ostringstream ss;
+    ss << "{\"buses\":[";
+    std::vector<std::string> roots = topology.roots();
+    for (size_t i = 0; i < roots.size(); ++i) {
+        const UsbTopologyNode& root = topology.devices().at(roots[i]);
+        if (i) ss << ",";
+        ss << "{\"bus\":" << root.bus << ",\"controller\":\"" << escapeJsonString(root.product)
+           << "\",\"mbps\":" << root.speedMbps << ",\"power_ma\":" << root.downstreamPowerMa << ",\"devices\":[";
+        std::vector<std::string> children = topology.children(roots[i]);
+        for (size_t c = 0; c < children.size(); ++c) {
+            if (c) ss << ",";
+            appendTopologyNode(ss, topology, children[c]);
+        }
+        ss << "]}";
+    }
+    ss << "],\"below_capability\":[";
+    bool first = true;
+    for (const auto& d : topology.devices()) {
+        if (!d.second.belowCapability) continue;
+        ss << (first ? "" : ",") << "\"" << escapeJsonString(d.first) << "\"";
+        first = false;
+    }
+    ss << "]}";
+    return ss.str();
+}
+
+// Rereads the topology (only what changed) and logs devices that came up on a link
+// slower than they support. Returns the topology JSON, empty when there is no sysfs
+// tree. Callers hold g_usbCriticalSection.
+static std::string refreshUsbTopology() {
+    if (!g_usbTopology) return "";
+    std::vector<UsbTopologyChange> changes;
+    if (!g_usbTopology->refresh(&changes)) {
+        // There is no SetupAPI/CfgMgr backend: the topology exists only as a Linux sysfs tree
+        static bool reported = false;
+        if (!reported) std::cerr << "[USB Monitor] No USB topology: " << g_sysfsRoot
+                                 << "/bus/usb/devices not found (Linux sysfs only; use --sysfs-root with a copied tree)" << std::endl;
+        reported = true;
+        return "";
+    }
+    for (const auto& change : changes) {
+        auto it = g_usbTopology->devices().find(change.name);
+        if (!change.added || it == g_usbTopology->devices().end() || !it->second.belowCapability) continue;
+        const UsbTopologyNode& d = it->second;
+        std::ostringstream entry;
+        entry << "USB link below capability: " << d.product << " (" << d.name << ") at " << d.speedMbps
+              << " Mbps of " << d.maxSpeedMbps << " Mbps, " << d.limitReason << " (" << d.limitedBy << ")";
+        g_usbEventLog.push_back(entry.str());
+    }
+    return usbTopologyJson(*g_usbTopology);
+}
+
 // Function to output current USB status in JSON format
-void outputUSBStatus() {
+void outputUSBStatus(const USBSnapshot& currentDevices) {
     std::cerr << "[USB Monitor] Entering outputUSBStatus function" << std::endl;
-    std::vector<USBDeviceInfo> currentDevices = getConnectedUSBDevices();
     std::cerr << "[USB Monitor] Found " << currentDevices.size() << " current devices" << std::endl;
 
     // Create a map of current devices for easy lookup (using device instance ID for non-storage devices)
@@ -929,6 +1077,7 @@ void outputUSBStatus() {
 
     // Update previous state for next comparison
     g_previousUSBDevices = currentDeviceMap;
+    std::string topologyJson = refreshUsbTopology();
     LeaveCriticalSection(&g_usbCriticalSection);
     std::cerr << "[USB Monitor] Left critical section" << std::endl;
 
@@ -975,12 +1124,21 @@ void outputUSBStatus() {
             ss << ",";
         }
     }
-    ss << "]}";
+    ss << "]";
 
+    if (!topologyJson.empty()) ss << ",\"usb_topology\":" << topologyJson;
     LeaveCriticalSection(&g_usbCriticalSection);
 
+    if (++g_recordsSincePerf >= 10) {
+        g_recordsSincePerf = 0;
+        ss << ",\"perf\":" << PerfStatsJson();
+    }
+    ss << "}";
+
+    EnterCriticalSection(&g_outputCriticalSection);
     std::cout << ss.str() << std::endl;
     std::cout.flush();
+    LeaveCriticalSection(&g_outputCriticalSection);
     std::cerr << "[USB Monitor] Output JSON successfully" << std::endl;
 }
 
@@ -995,17 +1153,54 @@ void commandListener() {
             std::string devicePath = line.substr(12);
             std::cerr << "[USB Monitor] Received safe eject command for: " << devicePath << std::endl;
             // The device path from the UI will be the drive letter, e.g., "E:\\"
-            safeEjectUSBDevice(devicePath);
+            // A replayed trace has no device behind it to eject
+            if (g_hal.replaying()) std::cerr << "[USB Monitor] Safe eject ignored during replay" << std::endl;
+            else safeEjectUSBDevice(devicePath);
+        } else if (line == "topology") {
+            EnterCriticalSection(&g_usbCriticalSection);
+            std::string topologyJson = refreshUsbTopology();
+            LeaveCriticalSection(&g_usbCriticalSection);
+            std::string record = "{\"usb_topology\":" + (topologyJson.empty() ? std::string("null") : topologyJson) + "}";
+            EnterCriticalSection(&g_outputCriticalSection);
+            std::cout << record << std::endl;
+            std::cout.flush();
+            LeaveCriticalSection(&g_outputCriticalSection);
+        } else if (line == "stats") {
+            std::string record = "{\"perf\":" + PerfStatsJson() + "}";
+            EnterCriticalSection(&g_outputCriticalSection);
+            std::cout << record << std::endl;
+            std::cout.flush();
+            LeaveCriticalSection(&g_outputCriticalSection);
         }
     }
 }
 
-int main() {
+// Options: --record <trace> saves every device list, --replay <trace> [--replay-speed <x|max>]
+// plays one back without touching the devices and exits at its end; --sysfs-root <dir>
+// reads the USB topology from <dir>/bus/usb/devices instead of /sys
+int main(int argc, char** argv) {
+    HalOptions halOptions;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--sysfs-root" && i + 1 < argc) g_sysfsRoot = argv[++i];
+        else if (!HalParseOption(i, argc, argv, halOptions)) std::cerr << "[USB Monitor] Unknown option " << argv[i] << " (" << kHalUsage << ")" << std::endl;
+    }
+    std::string halError;
+    if (!g_hal.open(halOptions, kHalUsb, halError)) {
+        std::cerr << "[USB Monitor] " << halError << std::endl;
+        return 1;
+    }
+    LiveUSBSource liveUSB;
+    HalSource<USBSnapshot>* usb = g_hal.source<USBSnapshot>(&liveUSB, encodeUSBSnapshot, decodeUSBSnapshot);
+
     // Initialize critical section
     InitializeCriticalSection(&g_usbCriticalSection);
+    InitializeCriticalSection(&g_outputCriticalSection);
+    UsbTopology usbTopology(g_sysfsRoot);
+    g_usbTopology = &usbTopology;
 
     // Enumerate existing USB devices
-    std::vector<USBDeviceInfo> existingDevices = enumerateExistingUSBDevices();
+    std::vector<USBDeviceInfo> existingDevices;
+    if (!g_hal.replaying()) existingDevices = enumerateExistingUSBDevices();
     EnterCriticalSection(&g_usbCriticalSection);
     for (const auto& device : existingDevices) {
         std::string logEntry = "Found existing USB device: " + device.friendlyName + " at " + device.driveLetter;
@@ -1020,7 +1215,8 @@ int main() {
     listener.detach();
 
     // Output initial status
-    outputUSBStatus();
+    USBSnapshot devices;
+    if (usb->read(devices)) outputUSBStatus(devices);
 
     std::cerr << "[USB Monitor] Starting main monitoring loop..." << std::endl;
 
@@ -1028,16 +1224,18 @@ int main() {
     while (true) {
         try {
             // Output current status periodically
-            outputUSBStatus();
+            if (usb->read(devices)) outputUSBStatus(devices);
+            else if (g_hal.replaying()) break;
         } catch (...) {
             std::cerr << "[USB Monitor] Exception occurred in main loop!" << std::endl;
         }
 
-        Sleep(3000); // Update every 3 seconds
+        g_hal.clock().sleepMs(3000); // Update every 3 seconds
     }
 
-    // This code will never be reached due to infinite loop
+    std::cerr << g_hal.summary() << std::endl;
     DeleteCriticalSection(&g_usbCriticalSection);
+    DeleteCriticalSection(&g_outputCriticalSection);
 
     return 0;
-}
\ No newline at end of file
+}
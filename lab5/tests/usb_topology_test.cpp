@@ -0,0 +1,118 @@
+// USB topology against a fake /sys/bus/usb/devices tree
+#include "../usb_topology.h"
+#include "../../common/lab_test.h"
+
+static const char* const kDevices = "sys/bus/usb/devices/";
+
+static void testSpeeds() {
+    CHECK_EQ(ParseUsbSpeedMbps("480"), 480.0);
+    CHECK_EQ(ParseUsbSpeedMbps("1.5"), 1.5);
+    CHECK_EQ(ParseUsbSpeedMbps("unknown"), 0.0);
+    CHECK_EQ(UsbMaxSpeedMbps("3.20", 2, false), 20000.0);
+    CHECK_EQ(UsbMaxSpeedMbps("3.20", 1, false), 5000.0);
+    CHECK_EQ(UsbMaxSpeedMbps("2.00", 1, true), 480.0);
+    CHECK_EQ(UsbMaxSpeedMbps("2.00", 1, false), 0.0);
+}
+
+static const UsbTopologyNode& node(const UsbTopology& topology, const std::string& name) {
+    static UsbTopologyNode missing;
+    auto it = topology.devices().find(name);
+    if (it == topology.devices().end()) {
+        LabTestFail(__FILE__, __LINE__, "no device " + name);
+        return missing;
+    }
+    return it->second;
+}
+
+static void testTree() {
+    LabFixture sys("tests/fixtures/usb.tree");
+    UsbTopology topology(sys.path("sys"));
+    std::vector<UsbTopologyChange> changes;
+    CHECK(topology.refresh(&changes));
+    // Interfaces and the device without idVendor are left out
+    CHECK_EQ(topology.devices().size(), 12u);
+    CHECK_EQ(changes.size(), 12u);
+    CHECK(topology.devices().count("3-2:1.0") == 0);
+    CHECK(topology.devices().count("3-3") == 0);
+
+    std::vector<std::string> roots = topology.roots();
+    CHECK_EQ(roots.size(), 3u);
+    if (roots.size() == 3) CHECK_EQ(roots[2], "usb3");
+    std::vector<std::string> hubPorts = topology.children("2-1");
+    CHECK_EQ(hubPorts.size(), 2u);
+    if (hubPorts.size() == 2) CHECK_EQ(hubPorts[1], "2-1.2");
+    CHECK_EQ(node(topology, "2-1.2").depth, 1);
+    CHECK_EQ(node(topology, "2-1.2").port, 2);
+
+    // What holds each slow USB 3 device back
+    CHECK(node(topology, "1-1").belowCapability);
+    CHECK_EQ(node(topology, "1-1").limitedBy, "usb1");
+    CHECK_EQ(node(topology, "1-1").limitReason, "USB 2 controller");
+    CHECK_EQ(node(topology, "2-1.1").limitedBy, "2-1");
+    CHECK_EQ(node(topology, "2-1.1").limitReason, "behind a USB 2 hub");
+    // The USB 3 hub's High-Speed side (bcdUSB 2.10) is not blamed
+    CHECK_EQ(node(topology, "2-2.1").limitedBy, "2-2");
+    CHECK_EQ(node(topology, "2-2.1").limitReason, "port or cable");
+    CHECK(!node(topology, "2-1.2").belowCapability);
+    CHECK_EQ(node(topology, "3-1").maxSpeedMbps, 20000.0);
+    CHECK(!node(topology, "3-1").belowCapability);
+    CHECK(!node(topology, "3-2").belowCapability);
+
+    // Malformed attributes come out unknown and are never flagged
+    CHECK_EQ(node(topology, "3-4").speedMbps, 0.0);
+    CHECK_EQ(node(topology, "3-4").maxPowerMa, 0);
+    CHECK(!node(topology, "3-4").belowCapability);
+
+    // Max-min fair shares: the keyboard keeps its 1.5 Mb/s, the rest is split
+    CHECK_NEAR(node(topology, "2-1.2").shareMbps, 1.5, 1e-9);
+    CHECK_NEAR(node(topology, "2-1.1").shareMbps, 239.25, 1e-9);
+    CHECK_NEAR(node(topology, "2-2.1").shareMbps, 239.25, 1e-9);
+    CHECK_NEAR(node(topology, "3-2").shareMbps, 5000.0, 1e-9);
+    CHECK_NEAR(node(topology, "3-1").shareMbps, 5000.0, 1e-9);
+
+    CHECK_EQ(node(topology, "2-1").downstreamPowerMa, 996);
+    CHECK_EQ(node(topology, "usb2").downstreamPowerMa, 1992);
+}
+
+static void removeDevice(LabFixture& sys, const std::string& name) {
+    static const char* const attrs[] = {"devnum", "idVendor", "idProduct", "manufacturer", "product", "version",
+                                        "speed", "rx_lanes", "bMaxPower", "bDeviceClass", "maxchild"};
+    std::string dir = sys.path(kDevices) + name;
+    for (const char* attr : attrs) unlink((dir + "/" + attr).c_str());
+    rmdir(dir.c_str());
+}
+
+static void testIncrementalRefresh() {
+    LabFixture sys("tests/fixtures/usb.tree");
+    UsbTopology topology(sys.path("sys"));
+    topology.refresh();
+    size_t reads = topology.attributeReads();
+
+    // Unchanged: one devnum read per known device, plus the full read of the
+    // device that is still enumerating
+    std::vector<UsbTopologyChange> changes;
+    CHECK(topology.refresh(&changes));
+    CHECK(changes.empty());
+    CHECK_EQ(topology.attributeReads() - reads, 12u + 10u);
+
+    // Re-enumerated (new devnum) and unplugged devices
+    sys.write(std::string(kDevices) + "2-1.1/devnum", "7");
+    removeDevice(sys, "1-1");
+    changes.clear();
+    CHECK(topology.refresh(&changes));
+    CHECK_EQ(changes.size(), 3u);
+    CHECK_EQ(topology.devices().size(), 11u);
+    CHECK_EQ(node(topology, "2-1.1").devnum, 7);
+    CHECK_EQ(node(topology, "usb1").downstreamPowerMa, 0);
+
+    // A missing devices directory (no sysfs, as on Windows) is a failed refresh
+    UsbTopology none(sys.path("nowhere"));
+    CHECK(!none.refresh());
+}
+
+int main() {
+    testSpeeds();
+    testTree();
+    testIncrementalRefresh();
+    return LabTestResult();
+}
@@ -0,0 +1,244 @@
+// USB hub/port topology and negotiated link speed for Lab5
+#include "usb_topology.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <set>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+static std::vector<std::string> ListDirectory(const std::string& dir, bool& ok) {
+    std::vector<std::string> names;
+    ok = false;
+#ifdef _WIN32
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA((dir + "\\*").c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE) return names;
+    do {
+        if (data.cFileName[0] != '.') names.push_back(data.cFileName);
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+#else
+    DIR* d = opendir(dir.c_str());
+    if (!d) return names;
+    while (struct dirent* e = readdir(d)) {
+        if (e->d_name[0] != '.') names.push_back(e->d_name);
+    }
+    closedir(d);
+#endif
+    ok = true;
+    return names;
+}
+
+// "usb3" -> bus 3; "3-1.4.2" -> bus 3, parent "3-1.4", port 2, depth 2.
+// Interfaces ("3-1.4:1.0") and anything else return false.
+static bool ParseDeviceName(const std::string& name, UsbTopologyNode& node) {
+    if (name.compare(0, 3, "usb") == 0) {
+        char* end = nullptr;
+        long bus = strtol(name.c_str() + 3, &end, 10);
+        if (end == name.c_str() + 3 || *end || bus <= 0) return false;
+        node.bus = (int)bus;
+        return true;
+    }
+    if (name.find(':') != std::string::npos) return false;
+    size_t dash = name.find('-');
+    if (dash == std::string::npos || dash == 0) return false;
+    node.bus = atoi(name.c_str());
+    if (node.bus <= 0) return false;
+    size_t dot = name.rfind('.');
+    if (dot == std::string::npos || dot < dash) {
+        node.parent = "usb" + name.substr(0, dash);
+        node.port = atoi(name.c_str() + dash + 1);
+    } else {
+        node.parent = name.substr(0, dot);
+        node.port = atoi(name.c_str() + dot + 1);
+    }
+    node.depth = (int)std::count(name.begin() + dash, name.end(), '.');
+    return node.port > 0;
+}
+
+double ParseUsbSpeedMbps(const std::string& text) {
+    const char* s = text.c_str();
+    char* end = nullptr;
+    double v = strtod(s, &end);
+    if (end == s || v <= 0.0) return 0.0;
+    return v;
+}
+
+double UsbMaxSpeedMbps(const std::string& version, int lanes, bool isHub) {
+    double bcd = atof(version.c_str());
+    if (bcd >= 3.2 && lanes >= 2) return 20000.0;
+    if (bcd >= 3.0) return 5000.0;
+    if (bcd >= 2.0 && isHub) return 480.0;
+    return 0.0;
+}
+
+UsbTopology::UsbTopology(const std::string& sysfsRoot)
+    : dir_(sysfsRoot + "/bus/usb/devices") {
+}
+
+std::string UsbTopology::readAttr(const std::string& dir, const char* attr) {
+    ++reads_;
+    std::ifstream f((dir + "/" + attr).c_str());
+    std::string value;
+    std::getline(f, value);
+    while (!value.empty() && (value.back() == '\n' || value.back() == '\r' || value.back() == ' ')) value.pop_back();
+    size_t first = value.find_first_not_of(' ');
+    return first == std::string::npos ? std::string() : value.substr(first);
+}
+
+bool UsbTopology::readDevice(const std::string& name, UsbTopologyNode& node) {
+    std::string dir = dir_ + "/" + name;
+    node.devnum = atoi(readAttr(dir, "devnum").c_str());
+    node.vendorId = readAttr(dir, "idVendor");
+    node.productId = readAttr(dir, "idProduct");
+    node.manufacturer = readAttr(dir, "manufacturer");
+    node.product = readAttr(dir, "product");
+    node.version = readAttr(dir, "version");
+    node.speedMbps = ParseUsbSpeedMbps(readAttr(dir, "speed"));
+    std::string lanes = readAttr(dir, "rx_lanes");
+    node.lanes = lanes.empty() ? 1 : std::max(1, atoi(lanes.c_str()));
+    node.maxPowerMa = atoi(readAttr(dir, "bMaxPower").c_str());   // "500mA"
+    node.isHub = readAttr(dir, "bDeviceClass") == "09";
+    node.ports = node.isHub ? atoi(readAttr(dir, "maxchild").c_str()) : 0;
+    node.maxSpeedMbps = UsbMaxSpeedMbps(node.version, node.lanes, node.isHub);
+    return !node.vendorId.empty();
+}
+
+bool UsbTopology::refresh(std::vector<UsbTopologyChange>* changes) {
+    bool ok = false;
+    std::vector<std::string> names = ListDirectory(dir_, ok);
+    if (!ok) return false;
+
+    bool changed = false;
+    std::set<std::string> present;
+    for (const auto& name : names) {
+        UsbTopologyNode node;
+        node.name = name;
+        if (!ParseDeviceName(name, node)) continue;
+        present.insert(name);
+        auto it = devices_.find(name);
+        if (it != devices_.end()) {
+            // Same port, same enumeration: nothing to reread
+            if (atoi(readAttr(dir_ + "/" + name, "devnum").c_str()) == it->second.devnum) continue;
+            if (changes) changes->push_back(UsbTopologyChange{false, name});
+            devices_.erase(it);
+            changed = true;
+        }
+        if (!readDevice(name, node)) continue;
+        devices_[name] = node;
+        if (changes) changes->push_back(UsbTopologyChange{true, name});
+        changed = true;
+    }
+    for (auto it = devices_.begin(); it != devices_.end();) {
+        if (present.count(it->first)) {
+            ++it;
+            continue;
+        }
+        if (changes) changes->push_back(UsbTopologyChange{false, it->first});
+        it = devices_.erase(it);
+        changed = true;
+    }
+    if (changed) evaluate();
+    return true;
+}
+
+std::vector<std::string> UsbTopology::roots() const {
+    std::vector<std::pair<int, std::string> > buses;
+    for (const auto& d : devices_) {
+        if (d.second.parent.empty()) buses.push_back(std::make_pair(d.second.bus, d.first));
+    }
+    std::sort(buses.begin(), buses.end());
+    std::vector<std::string> names;
+    for (const auto& b : buses) names.push_back(b.second);
+    return names;
+}
+
+std::vector<std::string> UsbTopology::children(const std::string& name) const {
+    std::vector<std::pair<int, std::string> > ports;
+    for (const auto& d : devices_) {
+        if (d.second.parent == name) ports.push_back(std::make_pair(d.second.port, d.first));
+    }
+    std::sort(ports.begin(), ports.end());
+    std::vector<std::string> names;
+    for (const auto& p : ports) names.push_back(p.second);
+    return names;
+}
+
+static bool IsUsb2OnlyController(const UsbTopologyNode& root) {
+    return root.product.find("EHCI") != std::string::npos || root.product.find("OHCI") != std::string::npos ||
+           root.product.find("UHCI") != std::string::npos;
+}
+
+void UsbTopology::evaluate() {
+    std::map<int, std::vector<UsbTopologyNode*> > busDevices;
+    for (auto& d : devices_) {
+        UsbTopologyNode& node = d.second;
+        node.belowCapability = false;
+        node.limitedBy.clear();
+        node.limitReason.clear();
+        node.downstreamPowerMa = 0;
+        auto root = devices_.find("usb" + std::to_string(node.bus));
+        node.busMbps = root != devices_.end() ? root->second.speedMbps : 0.0;
+        node.shareMbps = 0.0;
+        if (!node.parent.empty() && !node.isHub && node.speedMbps > 0.0) busDevices[node.bus].push_back(&node);
+    }
+
+    for (auto& d : devices_) {
+        UsbTopologyNode& node = d.second;
+        if (node.parent.empty()) continue;
+
+        // Everything a hub (and the root hub for the whole bus) may have to supply
+        for (auto up = devices_.find(node.parent); up != devices_.end(); up = devices_.find(up->second.parent)) {
+            up->second.downstreamPowerMa += node.maxPowerMa;
+        }
+
+        if (node.maxSpeedMbps <= 0.0 || node.speedMbps <= 0.0 || node.speedMbps >= node.maxSpeedMbps) continue;
+        node.belowCapability = true;
+
+        // A USB 3 device that ends up on a USB 2 bus lost SuperSpeed at the first
+        // hop without it. From the controller down: a USB 2.0 hub (a USB 3 hub's
+        // High-Speed side reports bcdUSB 2.10 or later), else a USB 2 controller,
+        // else the last hop itself, the port or the cable.
+        std::vector<const UsbTopologyNode*> chain;
+        for (auto up = devices_.find(node.parent); up != devices_.end(); up = devices_.find(up->second.parent)) {
+            chain.push_back(&up->second);
+        }
+        for (size_t i = chain.size(); i-- > 0 && node.limitedBy.empty();) {
+            const UsbTopologyNode* hop = chain[i];
+            if (hop->parent.empty()) {
+                if (IsUsb2OnlyController(*hop)) {
+                    node.limitedBy = hop->name;
+                    node.limitReason = "USB 2 controller";
+                }
+            } else if (hop->speedMbps < node.maxSpeedMbps && atof(hop->version.c_str()) < 2.1) {
+                node.limitedBy = hop->name;
+                node.limitReason = "behind a USB 2 hub";
+            }
+        }
+        if (node.limitedBy.empty()) {
+            node.limitedBy = node.parent;
+            node.limitReason = "port or cable";
+        }
+    }
+
+    // Max-min fair split of each bus: slow devices keep what they can use,
+    // the rest is divided evenly among the faster ones
+    for (auto& bus : busDevices) {
+        std::vector<UsbTopologyNode*>& nodes = bus.second;
+        std::sort(nodes.begin(), nodes.end(), [](const UsbTopologyNode* a, const UsbTopologyNode* b) {
+            return a->speedMbps < b->speedMbps;
+        });
+        double remaining = nodes.empty() ? 0.0 : nodes[0]->busMbps;
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            double fair = remaining / (double)(nodes.size() - i);
+            nodes[i]->shareMbps = std::min(nodes[i]->speedMbps, fair);
+            remaining -= nodes[i]->shareMbps;
+        }
+    }
+}
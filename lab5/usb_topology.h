@@ -0,0 +1,85 @@
+// USB hub/port topology and negotiated link speed for Lab5
+//
+// Linux only: everything comes from <sysfsRoot>/bus/usb/devices. There is no
+// SetupAPI/CfgMgr backend, so on Windows the topology is only available from a
+// copied sysfs tree (--sysfs-root) and status records otherwise carry none.
+#ifndef USB_TOPOLOGY_H
+#define USB_TOPOLOGY_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+struct UsbTopologyNode {
+    std::string name;             // sysfs device name: "usb1" for a root hub, "1-1.4" behind ports
+    std::string parent;           // upstream hub, empty for a root hub
+    int bus = 0;
+    int port = 0;                 // port on the parent hub, 0 for a root hub
+    int depth = 0;                // hubs between the device and its controller
+    int devnum = 0;               // changes whenever the port is re-enumerated
+    std::string vendorId;         // "0781"
+    std::string productId;
+    std::string manufacturer;
+    std::string product;
+    std::string version;          // bcdUSB, "3.20"
+    double speedMbps = 0.0;       // negotiated (0 = unknown)
+    double maxSpeedMbps = 0.0;    // capability; 0 when the descriptors don't tell
+    int lanes = 1;                // rx_lanes of a SuperSpeedPlus link
+    int maxPowerMa = 0;           // bMaxPower of the active configuration
+    bool isHub = false;
+    int ports = 0;                // maxchild of a hub
+
+    // Filled in by UsbTopology from the rest of the tree
+    bool belowCapability = false; // negotiated below what the device supports
+    std::string limitedBy;        // hub or controller holding it back
+    std::string limitReason;
+    double busMbps = 0.0;         // link rate of the bus's root hub
+    double shareMbps = 0.0;       // max-min fair part of busMbps with every device on the bus busy
+    int downstreamPowerMa = 0;    // bMaxPower of everything behind a hub
+};
+
+struct UsbTopologyChange {
+    bool added = false;
+    std::string name;
+};
+
+// "480", "5000", "1.5" -> Mb/s (0 when unknown)
+double ParseUsbSpeedMbps(const std::string& text);
+
+// Fastest signalling a device may use, from bcdUSB and its lane count.
+// USB 3.x devices count as SuperSpeed (5 Gb/s): "3.20" is also written by
+// Gen 1 devices and the SuperSpeedPlus capability that would tell them apart
+// lives in the BOS descriptor, which sysfs doesn't export. USB 2 hubs must do
+// High-Speed; for other USB 2 and 1.x devices the capability is unknown.
+double UsbMaxSpeedMbps(const std::string& version, int lanes, bool isHub);
+
+// Tree of the devices under <sysfsRoot>/bus/usb/devices
+class UsbTopology {
+public:
+    explicit UsbTopology(const std::string& sysfsRoot);
+
+    // Relists the devices directory. Devices that appeared, or whose devnum
+    // changed because they were re-enumerated, are read in full; the rest
+    // cost one attribute read. Derived fields are recomputed only when the
+    // tree changed. Returns false if the directory cannot be listed.
+    bool refresh(std::vector<UsbTopologyChange>* changes = nullptr);
+
+    const std::map<std::string, UsbTopologyNode>& devices() const { return devices_; }
+    // Root hubs ("usbN") in bus order
+    std::vector<std::string> roots() const;
+    // Direct children in port order
+    std::vector<std::string> children(const std::string& name) const;
+    // Attribute files read since construction
+    size_t attributeReads() const { return reads_; }
+
+private:
+    bool readDevice(const std::string& name, UsbTopologyNode& node);
+    std::string readAttr(const std::string& dir, const char* attr);
+    void evaluate();
+
+    std::string dir_;
+    std::map<std::string, UsbTopologyNode> devices_;
+    size_t reads_ = 0;
+};
+
+#endif // USB_TOPOLOGY_H
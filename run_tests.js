@@ -0,0 +1,37 @@
+// Builds and runs the native fixture tests of the labs (npm test)
+//
+// Every test is a standalone program compiled with g++ the way server.js
+// builds the lab, then run from the lab directory so its fixture paths
+// (tests/fixtures/*.tree) resolve. The fixtures fake Linux sysfs/procfs trees.
+const { spawnSync } = require('child_process');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const tests = [
+    { lab: 'lab1', name: 'energy_meter_test', sources: ['tests/energy_meter_test.cpp', 'energy_meter.cpp'], flags: ['-std=c++17', '-pthread'] },
+    { lab: 'lab1', name: 'throttle_monitor_test', sources: ['tests/throttle_monitor_test.cpp', 'throttle_monitor.cpp'], flags: ['-std=c++17', '-pthread'] },
+    { lab: 'lab2', name: 'pci_link_test', sources: ['tests/pci_link_test.cpp', 'pci_link.cpp'], flags: ['-std=c++17'] },
+    { lab: 'lab2', name: 'pci_topology_test', sources: ['tests/pci_topology_test.cpp', 'pci_topology.cpp'], flags: ['-std=c++17'] },
+    { lab: 'lab2', name: 'pci_aer_test', sources: ['tests/pci_aer_test.cpp', 'pci_aer.cpp'], flags: ['-std=c++17', '-pthread'] },
+    { lab: 'lab5', name: 'usb_topology_test', sources: ['tests/usb_topology_test.cpp', 'usb_topology.cpp'], flags: ['-std=c++17'] },
+];
+
+const outDir = fs.mkdtempSync(path.join(os.tmpdir(), 'hadeshub-tests-'));
+let failed = 0;
+for (const test of tests) {
+    const labDir = path.join(__dirname, test.lab);
+    const exe = path.join(outDir, `${test.lab}_${test.name}`);
+    const build = spawnSync('g++', [...test.sources, '-O2', '-Wall', ...test.flags, '-o', exe], { cwd: labDir, stdio: 'inherit' });
+    if (build.status !== 0) {
+        console.error(`[${test.lab}] ${test.name}: build failed`);
+        failed++;
+        continue;
+    }
+    const run = spawnSync(exe, [], { cwd: labDir, stdio: 'inherit' });
+    console.log(`[${test.lab}] ${test.name}: ${run.status === 0 ? 'ok' : 'FAILED'}`);
+    if (run.status !== 0) failed++;
+}
+fs.rmSync(outDir, { recursive: true, force: true });
+console.log(failed ? `${failed} of ${tests.length} test(s) failed` : `all ${tests.length} test(s) passed`);
+process.exit(failed ? 1 : 0);
@@ -17,6 +17,56 @@ let powerMonitorProcess = null;
 let lab2Process = null;
 let lab3Process = null;
 global.lab4Process = null;
+// lab4 runs in "serve" mode: requests are "<id> <command>", replies carry the same id
+global.lab4Pending = new Map();
+let lab4NextRequestId = 1;
+// lab4 status lives in memory; webcam_status.json is only a debounced copy for external readers.
+// Live counters (frames, fps, last photo) are in lab4's shared-memory status block: "main status".
+global.lab4Status = null;
+let lab4StatusPath = null;
+let lab4StatusDirty = false;
+let lab4StatusTimer = null;
+
+function defaultLab4Status() {
+    return {
+        webcam_active: false,
+        recording: false,
+        hidden_mode: false,
+        camera_info: {
+            index: 0,
+            name: "Not initialized",
+            width: 0,
+            height: 0,
+            fps: 0,
+            sensor_type: "Unknown",
+            matrix_type: "Unknown",
+            min_illumination: 0,
+            focus_type: "Unknown",
+            video_hdr: "Not supported",
+            brightness: 0,
+            contrast: 0,
+            sharpness: 0,
+            saturation: 0,
+            is_opened: false,
+            simulated: true
+        }
+    };
+}
+
+// Writes the status file at most once a second and only when something changed
+function saveLab4Status() {
+    lab4StatusDirty = true;
+    if (lab4StatusTimer || !lab4StatusPath) return;
+    lab4StatusTimer = setTimeout(() => {
+        lab4StatusTimer = null;
+        if (!lab4StatusDirty) return;
+        lab4StatusDirty = false;
+        require('fs').writeFile(lab4StatusPath, JSON.stringify(global.lab4Status, null, 2), (e) => {
+            if (e) console.error('Error updating webcam_status.json:', e);
+        });
+    }, 1000);
+}
+
 let lab5Process = null;
 
 // Serve static files from the project root
@@ -45,16 +95,36 @@ app.post('/lab4/command', (req, res) => {
         return res.status(400).json({ error: 'Command is required' });
     }
 
+    // The live preview streams length-framed JPEG records and expects live_ack from its
+    // consumer; the line reader below can do neither, so only the Electron UI may drive it
+    const name = String(command).trim().split(/\s+/)[0];
+    if (name === 'live' || name === 'live_ack') {
+        return res.status(400).json({ error: 'The live preview is not available over HTTP', command: command });
+    }
+
     try {
-        // Send command to the process via stdin
-        global.lab4Process.stdin.write(command + '\n');
-        res.json({ success: true, command: command });
+        // Send command to the process via stdin and answer once the reply with our id arrives
+        const id = String(lab4NextRequestId++);
+        const timer = setTimeout(() => {
+            global.lab4Pending.delete(id);
+            res.status(504).json({ error: 'Lab 4 did not reply in time', command: command });
+        }, 15000);
+        global.lab4Pending.set(id, (reply) => {
+            clearTimeout(timer);
+            res.json({ success: reply.ok, command: command, result: reply.result, error: reply.error, ms: reply.ms });
+        });
+        global.lab4Process.stdin.write(`${id} ${command}\n`);
     } catch (error) {
         console.error('Error sending command to lab4 process:', error);
         res.status(500).json({ error: 'Failed to send command to lab4 process' });
     }
 });
 
+// Current lab4 status without touching the disk
+app.get('/lab4/status', (req, res) => {
+    res.json(global.lab4Status || defaultLab4Status());
+});
+
 // WebSocket connection handler
 wss.on('connection', (ws) => {
     console.log('Client connected to WebSocket');
@@ -71,10 +141,13 @@ wss.on('connection', (ws) => {
     ws.on('message', (message) => {
         try {
             const command = JSON.parse(message);
-            if (command.action && powerMonitorProcess) {
+            // {"action":"stats","lab":"3"} goes to that lab's monitor; without "lab" it is for powermonitor
+            const labProcesses = { '1': powerMonitorProcess, '2': lab2Process, '3': lab3Process, '4': global.lab4Process, '5': lab5Process };
+            const target = command.lab ? labProcesses[command.lab] : powerMonitorProcess;
+            if (command.action && target) {
                 console.log(`Received command: ${command.action}`);
                 // Write command to the stdin of the C++ process
-                powerMonitorProcess.stdin.write(`${command.action}\n`);
+                target.stdin.write(`${command.action}\n`);
             }
         } catch (e) {
             console.error('Failed to parse message or send command:', e);
@@ -116,7 +189,7 @@ async function startLab2() {
     function compileWithGpp() {
         return new Promise((resolve) => {
             // compile both main.cpp and pci_codes.cpp, then link with SetupAPI and CfgMgr
-            const gpp = spawn('g++', ['main.cpp', 'pci_codes.cpp', '-O2', '-std=c++17', '-o', 'pciscan.exe', '-lsetupapi', '-lcfgmgr32'], { cwd: lab2Dir });
+            const gpp = spawn('g++', ['main.cpp', 'pci_codes.cpp', 'pci_link.cpp', 'pci_topology.cpp', 'pci_aer.cpp', '../common/perf_stats.cpp', '../common/hal.cpp', '-O2', '-std=c++17', '-o', 'pciscan.exe', '-lsetupapi', '-lcfgmgr32'], { cwd: lab2Dir });
             gpp.stdout.on('data', d => console.log(`[g++] ${d}`));
             gpp.stderr.on('data', d => console.error(`[g++] ${d}`));
             gpp.on('close', (code) => resolve(code === 0));
@@ -126,7 +199,7 @@ async function startLab2() {
 
     function compileWithCl() {
         return new Promise((resolve) => {
-            const cl = spawn('cl', ['main.cpp', '/Fe:pciscan.exe'], { cwd: lab2Dir });
+            const cl = spawn('cl', ['main.cpp', 'pci_link.cpp', 'pci_topology.cpp', 'pci_aer.cpp', '../common/perf_stats.cpp', '../common/hal.cpp', '/Fe:pciscan.exe'], { cwd: lab2Dir });
             cl.stdout.on('data', d => console.log(`[cl] ${d}`));
             cl.stderr.on('data', d => console.error(`[cl] ${d}`));
             cl.on('close', (code) => resolve(code === 0));
@@ -203,7 +276,49 @@ app.post('/start-lab/:labId', async (req, res) => {
             return res.status(200).json({ message: 'Lab 1 process already running.' });
         }
 
-        const executablePath = path.join(__dirname, 'lab1', 'powermonitor.exe');
+        const fs = require('fs');
+        const lab1Dir = path.join(__dirname, 'lab1');
+        const executablePath = path.join(lab1Dir, 'powermonitor.exe');
+        const lab1Sources = ['main.cpp', 'energy_meter.cpp', 'throttle_monitor.cpp', 'power_source.cpp', '../common/perf_stats.cpp', '../common/hal.cpp'];
+
+        function compileWithGpp() {
+            return new Promise((resolve) => {
+                const gpp = spawn('g++', [...lab1Sources, '-O2', '-std=c++17', '-o', 'powermonitor.exe', '-lpowrprof', '-lsetupapi', '-ladvapi32', '-lole32', '-loleaut32', '-lwbemuuid', '-lntdll'], { cwd: lab1Dir });
+                gpp.stdout.on('data', d => console.log(`[g++] ${d}`));
+                gpp.stderr.on('data', d => console.error(`[g++] ${d}`));
+                gpp.on('close', (code) => resolve(code === 0));
+                gpp.on('error', () => resolve(false));
+            });
+        }
+
+        function compileWithCl() {
+            return new Promise((resolve) => {
+                const cl = spawn('cl', ['/EHsc', '/std:c++17', ...lab1Sources, '/Fe:powermonitor.exe'], { cwd: lab1Dir });
+                cl.stdout.on('data', d => console.log(`[cl] ${d}`));
+                cl.stderr.on('data', d => console.error(`[cl] ${d}`));
+                cl.on('close', (code) => resolve(code === 0));
+                cl.on('error', () => resolve(false));
+            });
+        }
+
+        // Rebuild when the executable is missing or older than any of its sources
+        const exeTime = fs.existsSync(executablePath) ? fs.statSync(executablePath).mtimeMs : 0;
+        const stale = lab1Sources.some((src) => {
+            const srcPath = path.join(lab1Dir, src);
+            return fs.existsSync(srcPath) && fs.statSync(srcPath).mtimeMs > exeTime;
+        });
+        if (stale) {
+            console.log('Lab 1 executable missing or out of date; compiling');
+            let built = await compileWithGpp();
+            if (!built) {
+                console.log('g++ compile failed or not found, trying cl (MSVC)');
+                built = await compileWithCl();
+            }
+            if (!built && exeTime === 0) {
+                return res.status(500).json({ message: `Failed to compile lab ${labId}. Please ensure a valid compiler is installed.` });
+            }
+            if (!built) console.log('Compilation failed; starting the previous powermonitor.exe');
+        }
         console.log(`Attempting to start: ${executablePath}`);
 
         powerMonitorProcess = spawn(executablePath);
@@ -250,7 +365,7 @@ app.post('/start-lab/:labId', async (req, res) => {
             // Helper: try compile with g++, then cl as fallback
             function compileWithGpp() {
                 return new Promise((resolve) => {
-                    const gpp = spawn('g++', ['main.cpp', 'pci_codes.cpp', '-O2', '-std=c++17', '-o', 'pciscan.exe', '-lsetupapi', '-lcfgmgr32'], { cwd: lab2Dir });
+                    const gpp = spawn('g++', ['main.cpp', 'pci_codes.cpp', 'pci_link.cpp', 'pci_topology.cpp', 'pci_aer.cpp', '../common/perf_stats.cpp', '../common/hal.cpp', '-O2', '-std=c++17', '-o', 'pciscan.exe', '-lsetupapi', '-lcfgmgr32'], { cwd: lab2Dir });
                     gpp.stdout.on('data', d => console.log(`[g++] ${d}`));
                     gpp.stderr.on('data', d => console.error(`[g++] ${d}`));
                     gpp.on('close', (code) => resolve(code === 0));
@@ -261,7 +376,7 @@ app.post('/start-lab/:labId', async (req, res) => {
             function compileWithCl() {
                 return new Promise((resolve) => {
                     // cl requires Visual Studio environment; try a simple call
-                    const cl = spawn('cl', ['main.cpp', '/Fe:pciscan.exe'], { cwd: lab2Dir });
+                    const cl = spawn('cl', ['main.cpp', 'pci_link.cpp', 'pci_topology.cpp', 'pci_aer.cpp', '../common/perf_stats.cpp', '../common/hal.cpp', '/Fe:pciscan.exe'], { cwd: lab2Dir });
                     cl.stdout.on('data', d => console.log(`[cl] ${d}`));
                     cl.stderr.on('data', d => console.error(`[cl] ${d}`));
                     cl.on('close', (code) => resolve(code === 0));
@@ -338,7 +453,7 @@ app.post('/start-lab/:labId', async (req, res) => {
             // For lab3, we'll compile and run the main.cpp file
             function compileWithGpp() {
                 return new Promise((resolve) => {
-                    const gpp = spawn('g++', ['main.cpp', '-O2', '-std=c++98', '-m32', '-o', 'diskscan.exe', '-lsetupapi', '-lcfgmgr32'], { cwd: lab3Dir });
+                    const gpp = spawn('g++', ['main.cpp', 'space_usage.cpp', '../common/perf_stats.cpp', '../common/hal.cpp', '-O2', '-std=c++98', '-m32', '-o', 'diskscan.exe', '-lsetupapi', '-lcfgmgr32'], { cwd: lab3Dir });
                     gpp.stdout.on('data', d => console.log(`[g++] ${d}`));
                     gpp.stderr.on('data', d => console.error(`[g++] ${d}`));
                     gpp.on('close', (code) => resolve(code === 0));
@@ -348,7 +463,7 @@ app.post('/start-lab/:labId', async (req, res) => {
 
             function compileWithCl() {
                 return new Promise((resolve) => {
-                    const cl = spawn('cl', ['main.cpp', '/Fe:diskscan.exe'], { cwd: lab3Dir });
+                    const cl = spawn('cl', ['main.cpp', 'space_usage.cpp', '../common/perf_stats.cpp', '../common/hal.cpp', '/Fe:diskscan.exe'], { cwd: lab3Dir });
                     cl.stdout.on('data', d => console.log(`[cl] ${d}`));
                     cl.stderr.on('data', d => console.error(`[cl] ${d}`));
                     cl.on('close', (code) => resolve(code === 0));
@@ -486,6 +601,22 @@ app.post('/start-lab/:labId', async (req, res) => {
                     // For MSVC compilation with OpenCV (fallback approach)
                     const cl = spawn('cl', [
                         'main.cpp',
+                        'camera_app.cpp',
+                        'bench.cpp',
+                        'serve_protocol.cpp',
+                        'mjpeg_passthrough.cpp',
+                        'status_block.cpp',
+                        'hal_capture.cpp',
+                        'multi_capture.cpp',
+                        'change_gate.cpp',
+                        'frame_timing.cpp',
+                        'live_preview.cpp',
+                        'plugin_capture.cpp',
+                        'synthetic_camera_plugin.cpp',
+                        'burst_capture.cpp',
+                        'photo_index.cpp',
+                        '../common/perf_stats.cpp',
+                        '../common/hal.cpp',
                         '/EHsc',
                         '/std:c++17',
                         '/I"C:\\VS Code\\HadesHub\\lab4\\opencv-4.12.0\\include"',
@@ -539,7 +670,7 @@ app.post('/start-lab/:labId', async (req, res) => {
             try {
                 if (fs.existsSync(exePath)) {
                     console.log(`Attempting to start existing executable: ${exePath}`);
-                    global.lab4Process = spawn(exePath, [], { cwd: lab4Dir });
+                    global.lab4Process = spawn(exePath, ['serve'], { cwd: lab4Dir });
                 } else {
                     throw new Error('Executable does not exist'); // Force compilation if executable doesn't exist
                 }
@@ -555,7 +686,7 @@ app.post('/start-lab/:labId', async (req, res) => {
 
                     if (built && fs.existsSync(path.join(lab4Dir, 'webcam_monitor.exe'))) {
                         console.log('Compilation succeeded; starting webcam_monitor.exe');
-                        global.lab4Process = spawn(path.join(lab4Dir, 'webcam_monitor.exe'), [], { cwd: lab4Dir });
+                        global.lab4Process = spawn(path.join(lab4Dir, 'webcam_monitor.exe'), ['serve'], { cwd: lab4Dir });
                     } else {
                         console.log(`Lab 4 source present but failed to compile (checked: ${srcPath})`);
                         return res.status(500).json({ message: `Failed to compile lab ${labId}. Please ensure a valid compiler is installed.` });
@@ -566,93 +697,55 @@ app.post('/start-lab/:labId', async (req, res) => {
                 }
             }
 
-            // Initialize status file with default values
-            const statusPath = path.join(lab4Dir, 'webcam_status.json');
-            fs.writeFileSync(statusPath, JSON.stringify({
-                webcam_active: false,
-                recording: false,
-                hidden_mode: false,
-                camera_info: {
-                    index: 0,
-                    name: "Not initialized",
-                    width: 0,
-                    height: 0,
-                    fps: 0,
-                    sensor_type: "Unknown",
-                    matrix_type: "Unknown",
-                    min_illumination: 0,
-                    focus_type: "Unknown",
-                    video_hdr: "Not supported",
-                    brightness: 0,
-                    contrast: 0,
-                    sharpness: 0,
-                    saturation: 0,
-                    is_opened: false,
-                    simulated: true
-                }
-            }, null, 2));
+            // Initialize status with default values
+            lab4StatusPath = path.join(lab4Dir, 'webcam_status.json');
+            global.lab4Status = defaultLab4Status();
+            fs.writeFileSync(lab4StatusPath, JSON.stringify(global.lab4Status, null, 2));
 
             const rl4 = readline.createInterface({ input: global.lab4Process.stdout });
             rl4.on('line', (line) => {
                 try {
                     const parsed = JSON.parse(line);
+                    // Replies to /lab4/command go back to the waiting HTTP request
+                    if (parsed.id && global.lab4Pending.has(parsed.id)) {
+                        const resolve = global.lab4Pending.get(parsed.id);
+                        global.lab4Pending.delete(parsed.id);
+                        resolve(parsed);
+                    }
                     // Broadcast webcam information to all WebSocket clients with lab identifier
                     broadcast({ type: 'lab4', data: parsed });
 
-                    // Update status file with current status (not just the received data)
-                    try {
-                        // Read current status and update it with the received data
-                        let currentStatus;
-                        try {
-                            currentStatus = JSON.parse(fs.readFileSync(statusPath, 'utf8'));
-                        } catch (e) {
-                            currentStatus = {
-                                webcam_active: false,
-                                recording: false,
-                                hidden_mode: false,
-                                camera_info: {
-                                    index: 0,
-                                    name: "Not initialized",
-                                    width: 0,
-                                    height: 0,
-                                    fps: 0,
-                                    sensor_type: "Unknown",
-                                    matrix_type: "Unknown",
-                                    min_illumination: 0,
-                                    focus_type: "Unknown",
-                                    video_hdr: "Not supported",
-                                    brightness: 0,
-                                    contrast: 0,
-                                    sharpness: 0,
-                                    saturation: 0,
-                                    is_opened: false,
-                                    simulated: true
-                                }
-                            };
-                        }
-
-                        // Update status based on received data
-                        if (parsed.action === 'photo_taken') {
-                            currentStatus.webcam_active = true;
-                        } else if (parsed.action === 'recording_started') {
-                            currentStatus.recording = true;
-                        } else if (parsed.action === 'recording_stopped') {
-                            currentStatus.recording = false;
-                        } else if (parsed.action === 'console_hidden') {
-                            currentStatus.hidden_mode = true;
-                        } else if (parsed.action === 'console_shown') {
-                            currentStatus.hidden_mode = false;
-                        } else if (parsed.status === 'ready') {
-                            currentStatus.webcam_active = true;
-                        } else if (parsed.status === 'active' && parsed.camera_info) {
-                            // Update with full camera info
-                            currentStatus.webcam_active = true;
-                            currentStatus.camera_info = parsed.camera_info;
-                        }
+                    // Update status based on received data
+                    const currentStatus = global.lab4Status;
+                    const before = JSON.stringify(currentStatus);
+                    if (parsed.action === 'photo_taken') {
+                        currentStatus.webcam_active = true;
+                    } else if (parsed.action === 'recording_started') {
+                        currentStatus.recording = true;
+                    } else if (parsed.action === 'recording_stopped') {
+                        currentStatus.recording = false;
+                    } else if (parsed.action === 'console_hidden') {
+                        currentStatus.hidden_mode = true;
+                    } else if (parsed.action === 'console_shown') {
+                        currentStatus.hidden_mode = false;
+                    } else if (parsed.status === 'ready') {
+                        currentStatus.webcam_active = true;
+                        if (parsed.camera_info) currentStatus.camera_info = parsed.camera_info;
+                    } else if (parsed.event === 'photo') {
+                        currentStatus.webcam_active = true;
+                    } else if (parsed.ok && parsed.result && parsed.result.camera_info) {
+                        currentStatus.webcam_active = parsed.result.camera_info.is_opened;
+                        currentStatus.camera_info = parsed.result.camera_info;
+                    } else if (parsed.ok && (parsed.cmd === 'start_periodic' || parsed.cmd === 'stop_periodic')) {
+                        currentStatus.hidden_mode = parsed.cmd === 'start_periodic';
+                    } else if (parsed.status === 'active' && parsed.camera_info) {
+                        // Update with full camera info
+                        currentStatus.webcam_active = true;
+                        currentStatus.camera_info = parsed.camera_info;
+                    }
 
-                        fs.writeFileSync(statusPath, JSON.stringify(currentStatus, null, 2));
-                    } catch (e) {
-                        console.error('Error updating webcam_status.json:', e);
+                    if (JSON.stringify(currentStatus) !== before) {
+                        saveLab4Status();
                     }
                 } catch (e) {
                     // Error silently - not logging to keep console clean
@@ -665,6 +758,10 @@ app.post('/start-lab/:labId', async (req, res) => {
 
             global.lab4Process.on('close', (code) => {
                 console.log(`Lab4 process exited with code ${code}`);
+                for (const resolve of global.lab4Pending.values()) {
+                    resolve({ ok: false, error: 'Lab 4 process exited' });
+                }
+                global.lab4Pending.clear();
                 broadcast({ event: 'process_exited', code: code });
             });
 
@@ -689,7 +786,7 @@ app.post('/start-lab/:labId', async (req, res) => {
 
             function compileWithGpp() {
                 return new Promise((resolve) => {
-                    const gpp = spawn('g++', ['main.cpp', '-O2', '-std=c++17', '-o', 'usbmonitor.exe', '-lsetupapi', '-lole32', '-loleaut32', '-lwbemuuid', '-ladvapi32'], { cwd: lab5Dir });
+                    const gpp = spawn('g++', ['main.cpp', 'usb_topology.cpp', '../common/perf_stats.cpp', '../common/hal.cpp', '-O2', '-std=c++17', '-o', 'usbmonitor.exe', '-lsetupapi', '-lole32', '-loleaut32', '-lwbemuuid', '-ladvapi32'], { cwd: lab5Dir });
                     gpp.stdout.on('data', d => console.log(`[g++] lab5: ${d}`));
                     gpp.stderr.on('data', d => console.error(`[g++] lab5: ${d}`));
                     gpp.on('close', (code) => resolve(code === 0));
@@ -703,7 +800,7 @@ app.post('/start-lab/:labId', async (req, res) => {
             function compileWithCl() {
                 return new Promise((resolve) => {
                     // MSVC compilation
-                    const cl = spawn('cl', ['main.cpp', '/EHsc', '/Fe:usbmonitor.exe', '/link', 'setupapi.lib', 'ole32.lib', 'oleaut32.lib', 'uuid.lib'], { cwd: lab5Dir });
+                    const cl = spawn('cl', ['main.cpp', 'usb_topology.cpp', '../common/perf_stats.cpp', '../common/hal.cpp', '/EHsc', '/Fe:usbmonitor.exe', '/link', 'setupapi.lib', 'ole32.lib', 'oleaut32.lib', 'uuid.lib'], { cwd: lab5Dir });
                     cl.stdout.on('data', d => console.log(`[cl] lab5: ${d}`));
                     cl.stderr.on('data', d => console.error(`[cl] lab5: ${d}`));
                     cl.on('close', (code) => resolve(code === 0));